@@ -28,6 +28,7 @@
 #include "system/replay.h"
 #include "exec/icount.h"
 #include "qemu/main-loop.h"
+#include "qemu/timeline.h"
 #include "qemu/notify.h"
 #include "qemu/guest-random.h"
 #include "hw/boards.h"
@@ -79,6 +80,7 @@ static void *mttcg_cpu_thread_fn(void *arg)
     qemu_thread_get_self(cpu->thread);
 
     cpu->thread_id = qemu_get_thread_id();
+    timeline_set_thread_name("vCPU");
     cpu->neg.can_do_io = true;
     current_cpu = cpu;
     cpu_thread_signal_created(cpu);
@@ -29,6 +29,7 @@
 #include "system/replay.h"
 #include "exec/icount.h"
 #include "qemu/main-loop.h"
+#include "qemu/timeline.h"
 #include "qemu/notify.h"
 #include "qemu/guest-random.h"
 #include "exec/cpu-common.h"
@@ -192,6 +193,7 @@ static void *rr_cpu_thread_fn(void *arg)
     qemu_thread_get_self(cpu->thread);
 
     cpu->thread_id = qemu_get_thread_id();
+    timeline_set_thread_name("vCPU");
     cpu->neg.can_do_io = true;
     cpu_thread_signal_created(cpu);
     qemu_guest_random_seed_thread_part2(cpu->random_seed);
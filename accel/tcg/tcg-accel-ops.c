@@ -34,6 +34,7 @@
 #include "qemu/main-loop.h"
 #include "qemu/guest-random.h"
 #include "qemu/timer.h"
+#include "qemu/timeline.h"
 #include "exec/cputlb.h"
 #include "exec/hwaddr.h"
 #include "exec/tb-flush.h"
@@ -79,7 +80,9 @@ int tcg_cpu_exec(CPUState *cpu)
     int ret;
     assert(tcg_enabled());
     cpu_exec_start(cpu);
+    timeline_begin("cpu_exec");
     ret = cpu_exec(cpu);
+    timeline_end();
     cpu_exec_end(cpu);
 
     return ret;
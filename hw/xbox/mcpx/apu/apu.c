@@ -247,7 +247,9 @@ static void se_frame(MCPXAPUState *d)
     /* Buffer for all mixbins for this frame */
     float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME] = { 0 };
 
+    timeline_begin("VP");
     mcpx_apu_vp_frame(d, mixbins);
+    timeline_end();
     mcpx_apu_dsp_frame(d, mixbins);
     mcpx_apu_monitor_frame(d);
 
@@ -259,9 +261,13 @@ static void se_frame(MCPXAPUState *d)
 static void *mcpx_apu_frame_thread(void *arg)
 {
     MCPXAPUState *d = MCPX_APU_DEVICE(arg);
+    timeline_set_thread_name("APU");
     qemu_mutex_lock(&d->lock);
     while (!qatomic_read(&d->exiting)) {
+        mcpx_apu_vp_apply_fe_queue(d);
+
         if (d->pause_requested) {
+            mcpx_apu_dsp_sync(d);
             d->is_idle = true;
             qemu_cond_signal(&d->idle_cond);
             qemu_cond_wait(&d->cond, &d->lock);
@@ -297,8 +303,12 @@ static void *mcpx_apu_frame_thread(void *arg)
             continue;
         }
 
+        timeline_begin("Throttle");
         throttle(d);
+        timeline_end();
+        timeline_begin("SE Frame");
         se_frame(d);
+        timeline_end();
     }
     qemu_mutex_unlock(&d->lock);
     return NULL;
@@ -326,10 +336,8 @@ static void mcpx_apu_reset_locked(MCPXAPUState *d)
     mcpx_apu_vp_reset(d);
 
     // FIXME: Reset DSP state
-    memset(d->gp.dsp->core.pram_opcache, 0,
-           sizeof(d->gp.dsp->core.pram_opcache));
-    memset(d->ep.dsp->core.pram_opcache, 0,
-           sizeof(d->ep.dsp->core.pram_opcache));
+    dsp56k_invalidate_decoded(&d->gp.dsp->core);
+    dsp56k_invalidate_decoded(&d->ep.dsp->core);
     d->set_irq = false;
 }
 
@@ -436,6 +444,7 @@ static void mcpx_apu_exitfn(PCIDevice *dev)
     bql_lock();
 
     qemu_thread_join(&d->apu_thread);
+    mcpx_apu_dsp_finalize(d);
     mcpx_apu_vp_finalize(d);
     mcpx_apu_monitor_finalize(d);
 }
@@ -455,10 +464,17 @@ const VMStateDescription vmstate_vp_dsp_dma_state = {
     }
 };
 
+static int vp_dsp_core_post_load(void *opaque, int version_id)
+{
+    dsp56k_invalidate_decoded(opaque);
+    return 0;
+}
+
 const VMStateDescription vmstate_vp_dsp_core_state = {
     .name = "mcpx-apu/dsp-state/core",
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = vp_dsp_core_post_load,
     .fields      = (VMStateField[]) {
         // FIXME: Remove unnecessary fields
         VMSTATE_UINT16(instr_cycle, dsp_core_t),
@@ -595,4 +611,5 @@ void mcpx_apu_init(PCIBus *bus, int devfn, MemoryRegion *ram)
 
     d->ram = ram;
     d->ram_ptr = memory_region_get_ram_ptr(d->ram);
+    mcpx_apu_vp_init_ram(d);
 }
@@ -68,6 +68,8 @@ struct McpxApuDebugVp
 struct McpxApuDebugDsp
 {
     int cycles;
+    int idle_skips;
+    int idle_skipped;
 };
 
 struct McpxApuDebug
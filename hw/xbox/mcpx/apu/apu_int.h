@@ -32,6 +32,7 @@
 #include "migration/vmstate.h"
 #include "qemu/main-loop.h"
 #include "qemu/thread.h"
+#include "qemu/timeline.h"
 #include "system/runstate.h"
 #include "ui/xemu-settings.h"
 
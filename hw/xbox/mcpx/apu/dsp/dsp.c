@@ -71,6 +71,9 @@ void dsp_reset(DSPState* dsp)
 
 void dsp_destroy(DSPState* dsp)
 {
+    dsp56k_destroy_cpu(&dsp->core);
+    free(dsp->dma.buf);
+    free(dsp->dma.planar_buf);
     free(dsp);
 }
 
@@ -154,9 +157,17 @@ void dsp_run(DSPState* dsp, int cycles)
 
     while (dsp->save_cycles > 0)
     {
-        dsp56k_execute_instruction(&dsp->core);
-        dsp->save_cycles -= dsp->core.instr_cycle;
-        dsp->core.cycle_count++;
+        /* DMA completion is timed in instructions, so step while it runs */
+        uint32_t count = 0;
+        if (!(dsp->dma.control & DMA_CONTROL_RUNNING)) {
+            count = dsp56k_execute_block(&dsp->core, &dsp->save_cycles);
+        }
+        if (count == 0) {
+            dsp56k_execute_instruction(&dsp->core);
+            dsp->save_cycles -= dsp->core.instr_cycle;
+            count = 1;
+        }
+        dsp->core.cycle_count += count;
 
         if (dsp->dma.control & DMA_CONTROL_RUNNING) {
             dma_timer++;
@@ -189,7 +200,7 @@ void dsp_bootstrap(DSPState* dsp)
             dsp->core.pram[i] &= 0x00ffffff;
         }
     }
-    memset(dsp->core.pram_opcache, 0, sizeof(dsp->core.pram_opcache));
+    dsp56k_invalidate_decoded(&dsp->core);
 }
 
 void dsp_start_frame(DSPState* dsp)
@@ -197,46 +208,41 @@ void dsp_start_frame(DSPState* dsp)
     dsp->interrupts |= INTERRUPT_START_FRAME;
 }
 
-uint32_t dsp_read_memory(DSPState* dsp, char space, uint32_t address)
+static int get_space_id(char space)
 {
-    int space_id;
-
     switch (space) {
     case 'X':
-        space_id = DSP_SPACE_X;
-        break;
+        return DSP_SPACE_X;
     case 'Y':
-        space_id = DSP_SPACE_Y;
-        break;
+        return DSP_SPACE_Y;
     case 'P':
-        space_id = DSP_SPACE_P;
-        break;
+        return DSP_SPACE_P;
     default:
         assert(false);
-        return 0;
+        return -1;
     }
+}
 
-    return dsp56k_read_memory(&dsp->core, space_id, address);
+uint32_t dsp_read_memory(DSPState* dsp, char space, uint32_t address)
+{
+    return dsp56k_read_memory(&dsp->core, get_space_id(space), address);
 }
 
 void dsp_write_memory(DSPState* dsp, char space, uint32_t address, uint32_t value)
 {
-    int space_id;
+    dsp56k_write_memory(&dsp->core, get_space_id(space), address, value);
+}
 
-    switch (space) {
-    case 'X':
-        space_id = DSP_SPACE_X;
-        break;
-    case 'Y':
-        space_id = DSP_SPACE_Y;
-        break;
-    case 'P':
-        space_id = DSP_SPACE_P;
-        break;
-    default:
-        assert(false);
-        return;
-    }
+void dsp_read_memory_block(DSPState* dsp, char space, uint32_t address,
+                           uint32_t *dst, size_t count)
+{
+    dsp56k_read_memory_block(&dsp->core, get_space_id(space), address, dst,
+                             count);
+}
 
-    dsp56k_write_memory(&dsp->core, space_id, address, value);
+void dsp_write_memory_block(DSPState* dsp, char space, uint32_t address,
+                            const uint32_t *src, size_t count)
+{
+    dsp56k_write_memory_block(&dsp->core, get_space_id(space), address, src,
+                              count);
 }
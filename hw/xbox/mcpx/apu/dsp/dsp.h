@@ -50,6 +50,10 @@ void dsp_start_frame(DSPState* dsp);
 
 uint32_t dsp_read_memory(DSPState* dsp, char space, uint32_t addr);
 void dsp_write_memory(DSPState* dsp, char space, uint32_t address, uint32_t value);
+void dsp_read_memory_block(DSPState* dsp, char space, uint32_t address,
+                           uint32_t *dst, size_t count);
+void dsp_write_memory_block(DSPState* dsp, char space, uint32_t address,
+                            const uint32_t *src, size_t count);
 
 void dsp_info(DSPState* dsp);
 void dsp_print_registers(DSPState* dsp);
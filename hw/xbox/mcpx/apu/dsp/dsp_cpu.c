@@ -41,11 +41,14 @@
 #define SIGN_PLUS  0
 #define SIGN_MINUS 1
 
+/* Longest backward jump considered for polling loop fast-forward */
+#define DSP_IDLE_LOOP_MAX_LEN 8
+
 /**********************************
  *  Functions
  **********************************/
 
-static void dsp_postexecute_update_pc(dsp_core_t* dsp);
+static inline QEMU_ALWAYS_INLINE void dsp_postexecute_update_pc(dsp_core_t* dsp);
 static void dsp_postexecute_interrupts(dsp_core_t* dsp);
 
 static uint32_t read_memory_p(dsp_core_t* dsp, uint32_t address);
@@ -56,6 +59,10 @@ static void write_memory_disasm(dsp_core_t* dsp, int space, uint32_t address, ui
 
 static void dsp_write_reg(dsp_core_t* dsp, uint32_t numreg, uint32_t value);
 
+static void dsp_jit_invalidate(dsp_core_t* dsp, uint32_t address);
+static void dsp_jit_invalidate_all(dsp_core_t* dsp);
+static void dsp_jit_destroy(dsp_core_t* dsp);
+
 static void dsp_stack_push(dsp_core_t* dsp, uint32_t curpc, uint32_t cursr, uint16_t sshOnly);
 static void dsp_stack_pop(dsp_core_t* dsp, uint32_t *curpc, uint32_t *cursr);
 static void dsp_compute_ssh_ssl(dsp_core_t* dsp);
@@ -134,13 +141,14 @@ static const int registers_mask[64] = {
 
 typedef bool (*match_func_t)(uint32_t op);
 
-typedef struct OpcodeEntry {
+struct OpcodeEntry {
     const char* template;
     const char* name;
     dis_func_t dis_func;
     emu_func_t emu_func;
     match_func_t match_func;
-} OpcodeEntry;
+    emu_decode_func_t decode_func;
+};
 
 static bool match_MMMRRR(uint32_t op)
 {
@@ -153,17 +161,17 @@ static bool match_MMMRRR(uint32_t op)
 }
 
 static const OpcodeEntry nonparallel_opcodes[] = {
-    { "0000000101iiiiii1000d000", "add #xx, D", dis_add_imm, emu_add_imm },
-    { "00000001010000001100d000", "add #xxxx, D", dis_add_long, emu_add_long },
-    { "0000000101iiiiii1000d110", "and #xx, D", dis_and_imm, emu_and_imm },
-    { "00000001010000001100d110", "and #xxxx, D", dis_and_long, emu_and_long },
-    { "00000000iiiiiiii101110EE", "andi #xx, D", dis_andi, emu_andi },
-    { "0000110000011101SiiiiiiD", "asl #ii, S2, D", dis_asl_imm, emu_asl_imm },
+    { "0000000101iiiiii1000d000", "add #xx, D", dis_add_imm, emu_add_imm, NULL, emu_decode_alu_imm },
+    { "00000001010000001100d000", "add #xxxx, D", dis_add_long, emu_add_long, NULL, emu_decode_alu_long },
+    { "0000000101iiiiii1000d110", "and #xx, D", dis_and_imm, emu_and_imm, NULL, emu_decode_alu_imm },
+    { "00000001010000001100d110", "and #xxxx, D", dis_and_long, emu_and_long, NULL, emu_decode_alu_long },
+    { "00000000iiiiiiii101110EE", "andi #xx, D", dis_andi, emu_andi, NULL, emu_decode_alu_ccr },
+    { "0000110000011101SiiiiiiD", "asl #ii, S2, D", dis_asl_imm, emu_asl_imm, NULL, emu_decode_alu_shift },
     { "0000110000011110010SsssD", "asl S1, S2, D", NULL, NULL },
-    { "0000110000011100SiiiiiiD", "asr #ii, S2, D", dis_asr_imm, emu_asr_imm },
+    { "0000110000011100SiiiiiiD", "asr #ii, S2, D", dis_asr_imm, emu_asr_imm, NULL, emu_decode_alu_shift },
     { "0000110000011110011SsssD", "asr S1, S2, D", NULL, NULL },
-    { "00001101000100000100CCCC", "bcc xxxx", dis_bcc_long, emu_bcc_long }, //??
-    { "00000101CCCC01aaaa0aaaaa", "bcc xxx", dis_bcc_imm, emu_bcc_imm },
+    { "00001101000100000100CCCC", "bcc xxxx", dis_bcc_long, emu_bcc_long, NULL, emu_decode_branch_long }, //??
+    { "00000101CCCC01aaaa0aaaaa", "bcc xxx", dis_bcc_imm, emu_bcc_imm, NULL, emu_decode_branch_imm },
     { "0000110100011RRR0100CCCC", "bcc Rn", NULL, NULL },
     { "0000101101MMMRRR0S00bbbb", "bchg #n, [X or Y]:ea", dis_bchg_ea, emu_bchg_ea, match_MMMRRR },
     { "0000101100aaaaaa0S00bbbb", "bchg #n, [X or Y]:aa", dis_bchg_aa, emu_bchg_aa },
@@ -175,8 +183,8 @@ static const OpcodeEntry nonparallel_opcodes[] = {
     { "0000101010pppppp0S00bbbb", "bclr #n, [X or Y]:pp", dis_bclr_pp, emu_bclr_pp },
     { "0000000100qqqqqq0S00bbbb", "bclr #n, [X or Y]:qq", NULL, NULL },
     { "0000101011DDDDDD010bbbbb", "bclr #n, D", dis_bclr_reg, emu_bclr_reg },
-    { "000011010001000011000000", "bra xxxx", dis_bra_long, emu_bra_long },
-    { "00000101000011aaaa0aaaaa", "bra xxx", dis_bra_imm, emu_bra_imm },
+    { "000011010001000011000000", "bra xxxx", dis_bra_long, emu_bra_long, NULL, emu_decode_branch_long },
+    { "00000101000011aaaa0aaaaa", "bra xxx", dis_bra_imm, emu_bra_imm, NULL, emu_decode_branch_imm },
     { "0000110100011RRR11000000", "bra Rn", NULL, NULL },
     { "0000110010MMMRRR0S0bbbbb", "brclr #n, [X or Y]:ea, xxxx", NULL, NULL, match_MMMRRR },
     { "0000110010aaaaaa1S0bbbbb", "brclr #n, [X or Y]:aa, xxxx", NULL, NULL },
@@ -216,23 +224,23 @@ static const OpcodeEntry nonparallel_opcodes[] = {
     { "0000000101qqqqqq0S10bbbb", "btst #n, [X or Y]:qq", NULL, NULL },
     { "0000101111DDDDDD0110bbbb", "btst #n, D", dis_btst_reg, emu_btst_reg },
     { "0000110000011110000000SD", "clb S, D", NULL, NULL },
-    { "0000000101iiiiii1000d101", "cmp #xx, S2", dis_cmp_imm, emu_cmp_imm },
-    { "00000001010000001100d101", "cmp #xxxx, S2", dis_cmp_long, emu_cmp_long },
+    { "0000000101iiiiii1000d101", "cmp #xx, S2", dis_cmp_imm, emu_cmp_imm, NULL, emu_decode_alu_imm },
+    { "00000001010000001100d101", "cmp #xxxx, S2", dis_cmp_long, emu_cmp_long, NULL, emu_decode_alu_long },
     { "00001100000111111111gggd", "cmpu S1, S2", dis_cmpu, emu_cmpu },
     { "000000000000001000000000", "debug", NULL, NULL },
     { "00000000000000110000CCCC", "debugcc", NULL, NULL },
     { "00000000000000000000101d", "dec D", NULL /*dis_dec*/, emu_dec },
     { "000000011000000001JJd000", "div S, D", dis_div, emu_div },
     { "000000010010010s1sdkQQQQ", "dmac S1, S2, D", NULL, NULL },
-    { "0000011001MMMRRR0S000000", "do [X or Y]:ea, expr", dis_do_ea, emu_do_ea, match_MMMRRR },
-    { "0000011000aaaaaa0S000000", "do [X or Y]:aa, expr", dis_do_aa, emu_do_aa },
-    { "00000110iiiiiiii1000hhhh", "do #xxx, expr", dis_do_imm, emu_do_imm },
-    { "0000011011DDDDDD00000000", "do S, expr", dis_do_reg, emu_do_reg },
+    { "0000011001MMMRRR0S000000", "do [X or Y]:ea, expr", dis_do_ea, emu_do_ea, match_MMMRRR, emu_decode_loop },
+    { "0000011000aaaaaa0S000000", "do [X or Y]:aa, expr", dis_do_aa, emu_do_aa, NULL, emu_decode_loop },
+    { "00000110iiiiiiii1000hhhh", "do #xxx, expr", dis_do_imm, emu_do_imm, NULL, emu_decode_loop },
+    { "0000011011DDDDDD00000000", "do S, expr", dis_do_reg, emu_do_reg, NULL, emu_decode_loop },
     { "000000000000001000000011", "do_f", NULL, NULL },
     { "0000011001MMMRRR0S010000", "dor [X or Y]:ea, label", NULL, NULL, match_MMMRRR },
     { "0000011000aaaaaa0S010000", "dor [X or Y]:aa, label", NULL, NULL },
-    { "00000110iiiiiiii1001hhhh", "dor #xxx, label", dis_dor_imm, emu_dor_imm },
-    { "0000011011DDDDDD00010000", "dor S, label", dis_dor_reg, emu_dor_reg },
+    { "00000110iiiiiiii1001hhhh", "dor #xxx, label", dis_dor_imm, emu_dor_imm, NULL, emu_decode_loop_rel },
+    { "0000011011DDDDDD00010000", "dor S, label", dis_dor_reg, emu_dor_reg, NULL, emu_decode_loop_rel },
     { "000000000000001000000010", "dor_f", NULL, NULL },
     { "000000000000000010001100", "enddo", NULL, emu_enddo },
     { "0000000101iiiiii1000d011", "eor #xx, D", NULL, NULL },
@@ -245,15 +253,15 @@ static const OpcodeEntry nonparallel_opcodes[] = {
     { "00000000000000000000100d", "inc D", NULL, emu_inc },
     { "00001100000110110qqqSSSD", "insert S1, S2, D", NULL, NULL },
     { "00001100000110010qqq000D", "insert #CO, S2, D", NULL, NULL },
-    { "00001110CCCCaaaaaaaaaaaa", "jcc xxx", dis_jcc_imm, emu_jcc_imm },
-    { "0000101011MMMRRR1010CCCC", "jcc ea", dis_jcc_ea, emu_jcc_ea, match_MMMRRR },
+    { "00001110CCCCaaaaaaaaaaaa", "jcc xxx", dis_jcc_imm, emu_jcc_imm, NULL, emu_decode_jump_imm },
+    { "0000101011MMMRRR1010CCCC", "jcc ea", dis_jcc_ea, emu_jcc_ea, match_MMMRRR, emu_decode_jump_ea },
     { "0000101001MMMRRR1S00bbbb", "jclr #n, [X or Y]:ea, xxxx", dis_jclr_ea, emu_jclr_ea, match_MMMRRR },
     { "0000101000aaaaaa1S00bbbb", "jclr #n, [X or Y]:aa, xxxx", dis_jclr_aa, emu_jclr_aa },
     { "0000101010pppppp1S00bbbb", "jclr #n, [X or Y]:pp, xxxx", dis_jclr_pp, emu_jclr_pp },
     { "0000000110qqqqqq1S00bbbb", "jclr #n, [X or Y]:qq, xxxx", NULL, NULL },
     { "0000101011DDDDDD0000bbbb", "jclr #n, S, xxxx", dis_jclr_reg, emu_jclr_reg },
-    { "0000101011MMMRRR10000000", "jmp ea", dis_jmp_ea, emu_jmp_ea, match_MMMRRR },
-    { "000011000000aaaaaaaaaaaa", "jmp xxx", dis_jmp_imm, emu_jmp_imm },
+    { "0000101011MMMRRR10000000", "jmp ea", dis_jmp_ea, emu_jmp_ea, match_MMMRRR, emu_decode_jump_ea },
+    { "000011000000aaaaaaaaaaaa", "jmp xxx", dis_jmp_imm, emu_jmp_imm, NULL, emu_decode_jump_imm },
     { "00001111CCCCaaaaaaaaaaaa", "jscc xxx", dis_jscc_imm, emu_jscc_imm },
     { "0000101111MMMRRR1010CCCC", "jscc ea", dis_jscc_ea, emu_jscc_ea, match_MMMRRR },
     { "0000101101MMMRRR1S00bbbb", "jsclr #n, [X or Y]:ea, xxxx", dis_jsclr_ea, emu_jsclr_ea, match_MMMRRR },
@@ -287,14 +295,14 @@ static const OpcodeEntry nonparallel_opcodes[] = {
     { "00000001000sssss11QQdk11", "macr S1, S2, D", NULL, NULL },
     { "000000010100000111qqdk11", "macri #xxxx, S, D", NULL, NULL },
     { "00001100000110111000sssD", "merge S, D", NULL, NULL },
-    { "0000101001110RRR1WDDDDDD", "move X:(Rn + xxxx) <-> R", dis_move_x_long, emu_move_x_long },
+    { "0000101001110RRR1WDDDDDD", "move X:(Rn + xxxx) <-> R", dis_move_x_long, emu_move_x_long, NULL, emu_decode_move_long },
     { "0000101101110RRR1WDDDDDD", "move Y:(Rn + xxxx) <-> R", NULL, NULL },
-    { "0000001aaaaaaRRR1a0WDDDD", "move X:(Rn + xxx) <-> R", dis_move_x_imm, emu_move_x_imm },
-    { "0000001aaaaaaRRR1a1WDDDD", "move Y:(Rn + xxx) <-> R", dis_move_y_imm, emu_move_y_imm },
-    { "00000101W1MMMRRR0s1ddddd", "movec [X or Y]:ea <-> R", dis_movec_ea, emu_movec_ea, match_MMMRRR },
-    { "00000101W0aaaaaa0s1ddddd", "movec [X or Y]:aa <-> R", dis_movec_aa, emu_movec_aa, match_MMMRRR },
-    { "00000100W1eeeeee101ddddd", "movec R1, R2", dis_movec_reg, emu_movec_reg },
-    { "00000101iiiiiiii101ddddd", "movec #xx, D1", dis_movec_imm, emu_movec_imm },
+    { "0000001aaaaaaRRR1a0WDDDD", "move X:(Rn + xxx) <-> R", dis_move_x_imm, emu_move_x_imm, NULL, emu_decode_move_imm },
+    { "0000001aaaaaaRRR1a1WDDDD", "move Y:(Rn + xxx) <-> R", dis_move_y_imm, emu_move_y_imm, NULL, emu_decode_move_imm },
+    { "00000101W1MMMRRR0s1ddddd", "movec [X or Y]:ea <-> R", dis_movec_ea, emu_movec_ea, match_MMMRRR, emu_decode_movec },
+    { "00000101W0aaaaaa0s1ddddd", "movec [X or Y]:aa <-> R", dis_movec_aa, emu_movec_aa, match_MMMRRR, emu_decode_movec },
+    { "00000100W1eeeeee101ddddd", "movec R1, R2", dis_movec_reg, emu_movec_reg, NULL, emu_decode_movec },
+    { "00000101iiiiiiii101ddddd", "movec #xx, D1", dis_movec_imm, emu_movec_imm, NULL, emu_decode_movec },
     { "00000111W1MMMRRR10dddddd", "movem P:ea <-> R", dis_movem_ea, emu_movem_ea, match_MMMRRR },
     { "00000111W0aaaaaa00dddddd", "movem P:ea <-> R", dis_movem_aa, emu_movem_aa, match_MMMRRR },
     { "0000100sW1MMMRRR1Spppppp", "movep [X or Y]:ea <-> [X or Y]:pp", dis_movep_23, emu_movep_23, match_MMMRRR },
@@ -314,8 +322,8 @@ static const OpcodeEntry nonparallel_opcodes[] = {
     { "0000000111011RRR0001d101", "norm Rn, D", dis_norm, emu_norm },
     { "00001100000111100010sssD", "normf S, D", NULL, NULL },
     { "0000000101iiiiii1000d010", "or #xx, D", NULL, NULL },
-    { "00000001010000001100d010", "or #xxxx, D", dis_or_long, emu_or_long },
-    { "00000000iiiiiiii111110EE", "ori #xx, D", dis_ori, emu_ori },
+    { "00000001010000001100d010", "or #xxxx, D", dis_or_long, emu_or_long, NULL, emu_decode_alu_long },
+    { "00000000iiiiiiii111110EE", "ori #xx, D", dis_ori, emu_ori, NULL, emu_decode_alu_ccr },
     { "000000000000000000000011", "pflush", NULL, NULL },
     { "000000000000000000000001", "pflushun", NULL, NULL },
     { "000000000000000000000010", "pfree", NULL, NULL },
@@ -323,16 +331,16 @@ static const OpcodeEntry nonparallel_opcodes[] = {
     { "000000000000000000001111", "plockr xxxx", NULL, NULL },
     { "0000101011MMMRRR10000001", "punlock ea", NULL, NULL, match_MMMRRR },
     { "000000000000000000001110", "punlockr xxxx", NULL, NULL },
-    { "0000011001MMMRRR0S100000", "rep [X or Y]:ea", dis_rep_ea, emu_rep_ea, match_MMMRRR },
-    { "0000011000aaaaaa0S100000", "rep [X or Y]:aa", dis_rep_aa, emu_rep_aa },
-    { "00000110iiiiiiii1010hhhh", "rep #xxx", dis_rep_imm, emu_rep_imm },
-    { "0000011011dddddd00100000", "rep S", dis_rep_reg, emu_rep_reg },
+    { "0000011001MMMRRR0S100000", "rep [X or Y]:ea", dis_rep_ea, emu_rep_ea, match_MMMRRR, emu_decode_loop },
+    { "0000011000aaaaaa0S100000", "rep [X or Y]:aa", dis_rep_aa, emu_rep_aa, NULL, emu_decode_loop },
+    { "00000110iiiiiiii1010hhhh", "rep #xxx", dis_rep_imm, emu_rep_imm, NULL, emu_decode_loop },
+    { "0000011011dddddd00100000", "rep S", dis_rep_reg, emu_rep_reg, NULL, emu_decode_loop },
     { "000000000000000010000100", "reset", NULL, emu_reset },
     { "000000000000000000000100", "rti", NULL, emu_rti },
     { "000000000000000000001100", "rts", NULL, emu_rts },
     { "000000000000000010000111", "stop", NULL, emu_stop },
-    { "0000000101iiiiii1000d100", "sub #xx, D", dis_sub_imm, emu_sub_imm },
-    { "00000001010000001100d100", "sub #xxxx, D", dis_sub_long, emu_sub_long },
+    { "0000000101iiiiii1000d100", "sub #xx, D", dis_sub_imm, emu_sub_imm, NULL, emu_decode_alu_imm },
+    { "00000001010000001100d100", "sub #xxxx, D", dis_sub_long, emu_sub_long, NULL, emu_decode_alu_long },
     { "00000010CCCC00000JJJd000", "tcc S1, D1", dis_tcc, emu_tcc },
     { "00000011CCCC0ttt0JJJdTTT", "tcc S1,D2 S2,D2", dis_tcc, emu_tcc },
     { "00000010CCCC1ttt00000TTT", "tcc S2, D2", dis_tcc, emu_tcc },
@@ -407,11 +415,18 @@ void dsp56k_reset_cpu(dsp_core_t* dsp)
 
     // start_time = SDL_GetTicks();
     dsp->num_inst = 0;
+    dsp->idle_skips = 0;
+    dsp->idle_skipped = 0;
 
     dsp->exception_debugging = true;
     dsp->disasm_prev_inst_pc = 0xFFFFFFFF;
 }
 
+void dsp56k_destroy_cpu(dsp_core_t* dsp)
+{
+    dsp_jit_destroy(dsp);
+}
+
 static const OpcodeEntry *lookup_opcode_slow(uint32_t op) {
     for (int i = 0; i < ARRAY_SIZE(nonparallel_opcodes); i++) {
         if ((op & nonparallel_matches[i][0]) == nonparallel_matches[i][1]) {
@@ -426,23 +441,55 @@ static const OpcodeEntry *lookup_opcode_slow(uint32_t op) {
     return NULL;
 }
 
-static const OpcodeEntry *lookup_opcode(uint32_t op) {
-    static struct opcache_entry {
-        uint32_t op;
-        const OpcodeEntry *entry;
-    } opcache[256];
-
+static const OpcodeEntry *lookup_opcode(dsp_core_t* dsp, uint32_t op) {
     uint8_t tag =
         ((op >> 24) & 0xff) ^
         ((op >> 16) & 0xff) ^
         ((op >>  8) & 0xff) ^
         ((op >>  0) & 0xff);
-    if (opcache[tag].op != op || opcache[tag].entry == NULL) {
-        opcache[tag].op = op;
-        opcache[tag].entry = lookup_opcode_slow(op);
+    dsp_opcache_entry_t *e = &dsp->opcache[tag];
+    if (e->op != op || e->entry == NULL) {
+        e->op = op;
+        e->entry = lookup_opcode_slow(op);
     }
 
-    return opcache[tag].entry;
+    return e->entry;
+}
+
+static void decode_instruction(dsp_core_t* dsp, uint32_t address, uint32_t inst)
+{
+    dsp_decoded_inst_t *decoded = &dsp->pram_decoded[address];
+
+    memset(decoded, 0, sizeof(*decoded));
+
+    if (inst < 0x100000) {
+        const OpcodeEntry *op = lookup_opcode(dsp, inst);
+        if (op->emu_func) {
+            decoded->emu_func = op->emu_func;
+        } else {
+            DPRINTF("%x - %s\n", inst, op->name);
+            decoded->emu_func = emu_undefined;
+        }
+        if (op->decode_func) {
+            /* Writes to the extension word invalidate this one too */
+            uint32_t ext = address + 1 < DSP_PRAM_SIZE ?
+                read_memory_p(dsp, address + 1) : 0;
+            op->decode_func(decoded, address, inst, ext);
+        }
+    } else {
+        /* Parallel moves run the ALU part themselves */
+        decoded->alu_func = opcodes_alu[inst & BITMASK(8)];
+        emu_decode_parmove(decoded, inst);
+        if (decoded->emu_func == NULL) {
+            decoded->emu_func = decoded->alu_func;
+        }
+    }
+}
+
+void dsp56k_invalidate_decoded(dsp_core_t* dsp)
+{
+    memset(dsp->pram_decoded, 0, sizeof(dsp->pram_decoded));
+    dsp_jit_invalidate_all(dsp);
 }
 
 static uint16_t disasm_instruction(dsp_core_t* dsp, dsp_trace_disasm_t mode)
@@ -467,7 +514,7 @@ static uint16_t disasm_instruction(dsp_core_t* dsp, dsp_trace_disasm_t mode)
     dsp->disasm_parallelmove_name[0] = 0;
 
     if (dsp->disasm_cur_inst < 0x100000) {
-        const OpcodeEntry *op = lookup_opcode(dsp->disasm_cur_inst);
+        const OpcodeEntry *op = lookup_opcode(dsp, dsp->disasm_cur_inst);
         if (op->template) {
             if (op->dis_func) {
                 op->dis_func(dsp);
@@ -625,22 +672,12 @@ void dsp56k_execute_instruction(dsp_core_t* dsp)
         }
     }
 
-    if (dsp->cur_inst < 0x100000) {
-        const OpcodeEntry *op = dsp->pram_opcache[dsp->pc];
-        if (op == NULL) {
-            op = lookup_opcode(dsp->cur_inst);
-            dsp->pram_opcache[dsp->pc] = op;
-        }
-        if (op->emu_func) {
-            op->emu_func(dsp);
-        } else {
-            DPRINTF("%x - %s\n", dsp->cur_inst, op->name);
-            emu_undefined(dsp);
-        }
-    } else {
-        /* Do parallel move read */
-        opcodes_parmove[(dsp->cur_inst>>20) & BITMASK(4)](dsp);
+    const dsp_decoded_inst_t *decoded = &dsp->pram_decoded[dsp->pc];
+    if (unlikely(decoded->emu_func == NULL)) {
+        decode_instruction(dsp, dsp->pc, dsp->cur_inst);
     }
+    dsp->cur_decoded = decoded;
+    decoded->emu_func(dsp);
 
     /* Disasm current instruction ? (trace mode only) */
     if (tracing && disasm_return) {
@@ -682,11 +719,174 @@ void dsp56k_execute_instruction(dsp_core_t* dsp)
 #endif
 }
 
+/* Core state at the head of a candidate polling loop */
+typedef struct dsp_idle_loop_s {
+    uint32_t pc;
+    uint32_t count;
+    int cycles;
+    uint32_t write_count;
+    uint32_t registers[DSP_REG_MAX];
+    uint32_t stack[2][16];
+} dsp_idle_loop_t;
+
+/*
+ * Called after a short backward jump. If the core is back at the same loop
+ * head with the same registers and stack, and nothing was written since, the
+ * loop only polls state that cannot change until the block ends. Whole
+ * iterations are then charged without running them, leaving the last partial
+ * iteration of the budget to run as usual.
+ */
+static void dsp_idle_loop_check(dsp_core_t* dsp, dsp_idle_loop_t *loop,
+                                uint32_t *count, int *cycles)
+{
+    if (dsp->loop_rep || dsp->interrupt_counter ||
+        dsp->interrupt_state != DSP_INTERRUPT_NONE ||
+        (dsp->registers[DSP_REG_SR] & (1<<DSP_SR_T))) {
+        loop->pc = -1;
+        return;
+    }
+
+    if (loop->pc == dsp->pc && loop->write_count == dsp->write_count &&
+        !memcmp(loop->registers, dsp->registers, sizeof(loop->registers)) &&
+        !memcmp(loop->stack, dsp->stack, sizeof(loop->stack))) {
+        uint32_t iter_count = *count - loop->count;
+        int iter_cycles = loop->cycles - *cycles;
+        int n = (*cycles - 1) / iter_cycles;
+
+        if (n > 0) {
+            *count += n * iter_count;
+            *cycles -= n * iter_cycles;
+            dsp->num_inst += n * iter_cycles;
+            dsp->idle_skips++;
+            dsp->idle_skipped += n * iter_count;
+        }
+    } else {
+        loop->pc = dsp->pc;
+        loop->write_count = dsp->write_count;
+        memcpy(loop->registers, dsp->registers, sizeof(loop->registers));
+        memcpy(loop->stack, dsp->stack, sizeof(loop->stack));
+    }
+
+    loop->count = *count;
+    loop->cycles = *cycles;
+}
+
+/* Progress of a call to dsp56k_execute_block() */
+typedef struct dsp_block_s {
+    int cycles;             /* budget left */
+    uint32_t count;         /* instructions executed */
+    bool fast_forward;
+    dsp_idle_loop_t loop;
+} dsp_block_t;
+
+static void dsp_block_init(dsp_core_t* dsp, dsp_block_t *block, int cycles)
+{
+    block->cycles = cycles;
+    block->count = 0;
+    /* Skipped iterations would be missing from the peripheral trace */
+    block->fast_forward = !trace_event_get_state(TRACE_DSP_READ_PERIPHERAL);
+    block->loop.pc = -1;
+
+    dsp->periph_written = false;
+}
+
+/*
+ * Finishes the instruction at pc once its handler has run. Returns true when
+ * the block has to end.
+ */
+static inline QEMU_ALWAYS_INLINE bool dsp_block_post(dsp_core_t* dsp,
+                                                     dsp_block_t *block,
+                                                     uint32_t pc)
+{
+    dsp_postexecute_update_pc(dsp);
+
+    /* Nothing to do for interrupts unless one is pending or in flight */
+    if (dsp->loop_rep || dsp->interrupt_counter ||
+        dsp->interrupt_state == DSP_INTERRUPT_DISABLED ||
+        (dsp->registers[DSP_REG_SR] & (1<<DSP_SR_T))) {
+        dsp_postexecute_interrupts(dsp);
+    }
+
+    dsp->num_inst += dsp->instr_cycle;
+    block->cycles -= dsp->instr_cycle;
+    block->count++;
+
+    if (dsp->is_idle || dsp->periph_written) {
+        return true;
+    }
+
+    if (unlikely(dsp->cur_inst_len == 0 && dsp->pc <= pc &&
+                 pc - dsp->pc < DSP_IDLE_LOOP_MAX_LEN) &&
+        block->fast_forward && block->cycles > 0) {
+        dsp_idle_loop_check(dsp, &block->loop, &block->count, &block->cycles);
+    }
+
+    return block->cycles <= 0;
+}
+
+/* Executes the instruction at PC, returns true when the block has to end */
+static inline QEMU_ALWAYS_INLINE bool dsp_block_step(dsp_core_t* dsp,
+                                                     dsp_block_t *block)
+{
+    dsp_decoded_inst_t *decoded = &dsp->pram_decoded[dsp->pc];
+    uint32_t pc = dsp->pc;
+
+    dsp->cur_inst = read_memory_p(dsp, dsp->pc);
+    dsp->cur_inst_len = 1;
+    dsp->instr_cycle = 2;
+
+    if (unlikely(decoded->emu_func == NULL)) {
+        decode_instruction(dsp, dsp->pc, dsp->cur_inst);
+    }
+    dsp->cur_decoded = decoded;
+    decoded->emu_func(dsp);
+
+    /* Jumps taken leave 0, anything else the instruction length */
+    if (dsp->cur_inst_len) {
+        decoded->len = dsp->cur_inst_len;
+    }
+
+    return dsp_block_post(dsp, block, pc);
+}
+
+#include "dsp_jit.c.inc"
+
+/*
+ * Executes instructions back to back, without the per-instruction tracing
+ * of dsp56k_execute_instruction(). Stops once the cycle budget is used up,
+ * the core goes idle or a peripheral register is written, and returns the
+ * number of instructions executed, or 0 if tracing requires single steps.
+ * With jit_enabled, instructions run from translated host code where the
+ * host supports it.
+ */
+uint32_t dsp56k_execute_block(dsp_core_t* dsp, int *cycles)
+{
+    if (TRACE_DSP_DISASM || TRACE_DSP_DISASM_MEM ||
+        trace_event_get_state(TRACE_DSP56K_EXECUTE_INSTRUCTION) ||
+        trace_event_get_state(TRACE_DSP56K_EXECUTE_INSTRUCTION_DISASM)) {
+        return 0;
+    }
+
+    dsp_block_t block;
+    dsp_block_init(dsp, &block, *cycles);
+
+    if (!dsp->jit_enabled || !dsp_jit_execute(dsp, &block)) {
+        while (block.cycles > 0) {
+            if (dsp_block_step(dsp, &block)) {
+                break;
+            }
+        }
+    }
+
+    *cycles = block.cycles;
+    return block.count;
+}
+
 /**********************************
  *  Update the PC
 **********************************/
 
-static void dsp_postexecute_update_pc(dsp_core_t* dsp)
+static inline QEMU_ALWAYS_INLINE void dsp_postexecute_update_pc(dsp_core_t* dsp)
 {
     /* When running a REP, PC must stay on the current instruction */
     if (dsp->loop_rep) {
@@ -967,6 +1167,83 @@ void dsp56k_write_memory(dsp_core_t* dsp, int space, uint32_t address, uint32_t
         write_memory_raw(dsp, space, address, value);
 }
 
+/*
+ * Returns the words backing count words at address if they are all in one
+ * plain memory region, or NULL for peripherals, out of bounds accesses and
+ * ranges that cross regions.
+ */
+static uint32_t *memory_span(dsp_core_t* dsp, int space, uint32_t address, uint32_t count)
+{
+    uint32_t end = address + count;
+
+    if (space == DSP_SPACE_X) {
+        if (address >= DSP_MIXBUFFER_BASE && end <= DSP_MIXBUFFER_BASE+DSP_MIXBUFFER_SIZE) {
+            return &dsp->mixbuffer[address-DSP_MIXBUFFER_BASE];
+        } else if (address >= 0xc00 && end <= 0xc00+DSP_MIXBUFFER_SIZE) {
+            return &dsp->mixbuffer[address-0xc00];
+        } else if (end <= 0xc00) {
+            return &dsp->xram[address];
+        }
+    } else if (space == DSP_SPACE_Y) {
+        if (end <= DSP_YRAM_SIZE) {
+            return &dsp->yram[address];
+        }
+    } else if (space == DSP_SPACE_P) {
+        if (end <= DSP_PRAM_SIZE) {
+            return &dsp->pram[address];
+        }
+    }
+
+    return NULL;
+}
+
+/* Same as reading each word with dsp56k_read_memory() */
+void dsp56k_read_memory_block(dsp_core_t* dsp, int space, uint32_t address, uint32_t *dst, uint32_t count)
+{
+    const uint32_t *src = memory_span(dsp, space, address, count);
+
+    if (src == NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            dst[i] = dsp56k_read_memory(dsp, space, address + i);
+        }
+    } else if (space == DSP_SPACE_P) {
+        for (uint32_t i = 0; i < count; i++) {
+            dst[i] = ldl_le_p(&src[i]);
+        }
+    } else {
+        memcpy(dst, src, count * sizeof(uint32_t));
+    }
+}
+
+/* Same as writing each word with dsp56k_write_memory() */
+void dsp56k_write_memory_block(dsp_core_t* dsp, int space, uint32_t address, const uint32_t *src, uint32_t count)
+{
+    uint32_t *dst = memory_span(dsp, space, address, count);
+
+    if (dst == NULL || TRACE_DSP_DISASM_MEM) {
+        for (uint32_t i = 0; i < count; i++) {
+            dsp56k_write_memory(dsp, space, address + i, src[i]);
+        }
+        return;
+    }
+
+    if (space == DSP_SPACE_P) {
+        for (uint32_t i = 0; i < count; i++) {
+            assert((src[i] & 0xFF000000) == 0);
+            stl_le_p(&dst[i], src[i]);
+            dsp->pram_decoded[address + i].emu_func = NULL;
+            dsp_jit_invalidate(dsp, address + i);
+        }
+        /* The word before may have been decoded with this one as extension */
+        if (address > 0) {
+            dsp->pram_decoded[address - 1].emu_func = NULL;
+        }
+    } else {
+        memcpy(dst, src, count * sizeof(uint32_t));
+    }
+    dsp->write_count++;
+}
+
 static void write_memory_raw(dsp_core_t* dsp, int space, uint32_t address, uint32_t value)
 {
     assert((value & 0xFF000000) == 0);
@@ -976,6 +1253,7 @@ static void write_memory_raw(dsp_core_t* dsp, int space, uint32_t address, uint3
         if (address >= DSP_PERIPH_BASE) {
             assert(dsp->write_peripheral);
             dsp->write_peripheral(dsp, address, value);
+            dsp->periph_written = true;
             return;
         } else if (address >= DSP_MIXBUFFER_BASE && address < DSP_MIXBUFFER_BASE+DSP_MIXBUFFER_SIZE) {
             dsp->mixbuffer[address-DSP_MIXBUFFER_BASE] = value;
@@ -991,10 +1269,15 @@ static void write_memory_raw(dsp_core_t* dsp, int space, uint32_t address, uint3
     } else if (space == DSP_SPACE_P) {
         assert(address < DSP_PRAM_SIZE);
         stl_le_p(&dsp->pram[address], value);
-        dsp->pram_opcache[address] = NULL;
+        dsp->pram_decoded[address].emu_func = NULL;
+        if (address > 0) {
+            dsp->pram_decoded[address - 1].emu_func = NULL;
+        }
+        dsp_jit_invalidate(dsp, address);
     } else {
         assert(false);
     }
+    dsp->write_count++;
 }
 
 static uint32_t read_memory_disasm(dsp_core_t* dsp, int space, uint32_t address)
@@ -45,11 +45,61 @@ typedef struct dsp_interrupt_s {
 
 typedef struct dsp_core_s dsp_core_t;
 
+typedef void (*dsp_emu_func_t)(dsp_core_t* dsp);
+
+typedef struct OpcodeEntry OpcodeEntry;
+
+/* Hosts the block translator in dsp_jit.c.inc generates code for */
+#if defined(__x86_64__)
+#define DSP_JIT_HOST 1
+#endif
+
+typedef struct dsp_jit_s dsp_jit_t;
+
+/* Recent non-parallel opcode lookups, kept per core as GP and EP run in parallel */
+typedef struct dsp_opcache_entry_s {
+    uint32_t op;
+    const OpcodeEntry *entry;
+} dsp_opcache_entry_t;
+
+/* PRAM word decoded for dispatch, valid while emu_func is set */
+typedef struct dsp_decoded_inst_s {
+    dsp_emu_func_t emu_func;
+    dsp_emu_func_t alu_func;    /* ALU part of parallel instructions */
+
+    /* Operands of the common instructions, see the emu_decode_* functions */
+    uint32_t imm;       /* immediate value or extension word */
+    uint32_t addr;      /* absolute branch target or loop end */
+    uint8_t ea;         /* MMMRRR mode, or short absolute address */
+    uint8_t ea2;        /* y: mode of x:/y: parallel moves */
+    uint8_t reg1;
+    uint8_t reg2;
+    uint8_t reg3;
+    uint8_t space;      /* DSP_SPACE_X or DSP_SPACE_Y */
+    uint8_t cc;         /* condition code */
+    uint8_t len;        /* words, once seen from an execution not jumping */
+    bool write : 1;     /* move into reg1, rather than out of it */
+    bool write2 : 1;    /* same for reg2 */
+    bool use_ea : 1;    /* ea is a mode rather than an absolute address */
+} dsp_decoded_inst_t;
+
 struct dsp_core_s {
     bool is_gp;
     bool is_idle;
+    bool periph_written;
     uint32_t cycle_count;
 
+    /* Block translator, see dsp_jit.c.inc */
+    bool jit_enabled;
+    bool jit_dirty;         /* translated PRAM words were written */
+    uint32_t jit_blocks;    /* blocks translated */
+    dsp_jit_t *jit;
+
+    /* Polling loop fast-forward */
+    uint32_t write_count;   /* X/Y/P writes, to spot loops that only read */
+    uint32_t idle_skips;
+    uint32_t idle_skipped;  /* Instructions skipped, counted in cycle_count */
+
     /* DSP instruction Cycle counter */
     uint16_t instr_cycle;
 
@@ -63,7 +113,8 @@ struct dsp_core_s {
     uint32_t xram[DSP_XRAM_SIZE];
     uint32_t yram[DSP_YRAM_SIZE];
     uint32_t pram[DSP_PRAM_SIZE];
-    const void *pram_opcache[DSP_PRAM_SIZE];
+    dsp_decoded_inst_t pram_decoded[DSP_PRAM_SIZE];
+    dsp_opcache_entry_t opcache[256];
 
     uint32_t mixbuffer[DSP_MIXBUFFER_SIZE];
 
@@ -100,6 +151,7 @@ struct dsp_core_s {
     uint32_t cur_inst_len; /* =0:jump, >0:increment */
     /* Current instruction */
     uint32_t cur_inst;
+    const dsp_decoded_inst_t *cur_decoded;
 
     char str_disasm_memory[2][50];     /* Buffer for memory change text in disasm mode */
     uint32_t disasm_memory_ptr;        /* Pointer for memory change in disasm mode */
@@ -137,10 +189,15 @@ struct dsp_core_s {
 
 /* Functions */
 void dsp56k_reset_cpu(dsp_core_t* dsp);		/* Set dsp_core to use */
+void dsp56k_destroy_cpu(dsp_core_t* dsp);	/* Free translated code */
 void dsp56k_execute_instruction(dsp_core_t* dsp);	/* Execute 1 instruction */
+void dsp56k_invalidate_decoded(dsp_core_t* dsp);	/* Call after writing pram directly */
+uint32_t dsp56k_execute_block(dsp_core_t* dsp, int *cycles);	/* Execute until out of cycles */
 
 uint32_t dsp56k_read_memory(dsp_core_t* dsp, int space, uint32_t address);
 void dsp56k_write_memory(dsp_core_t* dsp, int space, uint32_t address, uint32_t value);
+void dsp56k_read_memory_block(dsp_core_t* dsp, int space, uint32_t address, uint32_t *dst, uint32_t count);
+void dsp56k_write_memory_block(dsp_core_t* dsp, int space, uint32_t address, const uint32_t *src, uint32_t count);
 
 /* Interrupt relative functions */
 void dsp56k_add_interrupt(dsp_core_t* dsp, uint16_t inter);
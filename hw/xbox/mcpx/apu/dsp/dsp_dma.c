@@ -99,6 +99,16 @@ static void scratch_circular_copy(
     }
 }
 
+static uint32_t *dma_get_buffer(uint32_t **buf, size_t *buf_words,
+                                size_t words)
+{
+    if (words > *buf_words) {
+        *buf_words = words;
+        *buf = realloc(*buf, words * sizeof(uint32_t));
+    }
+    return *buf;
+}
+
 static void dsp_dma_run(DSPDMAState *s)
 {
     if (!(s->control & DMA_CONTROL_RUNNING)
@@ -202,13 +212,9 @@ static void dsp_dma_run(DSPDMAState *s)
 
         size_t transfer_size = count * item_size;
 
-        // FIXME: Remove this intermediate buffer
-        static uint8_t *scratch_buf = NULL;
-        static ssize_t scratch_buf_size = -1;
-        if (count * item_size > scratch_buf_size) {
-            scratch_buf_size = count * item_size;
-            scratch_buf = malloc(scratch_buf_size);
-        }
+        /* Sized for whole words, so 16-bit items can be converted in place */
+        uint32_t *words = dma_get_buffer(&s->buf, &s->buf_words, count);
+        uint8_t *scratch_buf = (uint8_t *)words;
 
         if (direction) {
             if (dsp_interleave) {
@@ -216,11 +222,17 @@ static void dsp_dma_run(DSPDMAState *s)
                 // overwriting here
                 transfer_size = block_count * item_size * channel_count;
 
+                size_t planar_count = block_count * channel_count;
+                uint32_t *planar = dma_get_buffer(&s->planar_buf,
+                                                  &s->planar_buf_words,
+                                                  planar_count);
+                dsp56k_read_memory_block(s->core, mem_space, mem_address,
+                                         planar, planar_count);
+
                 // Interleave samples
                 for (int i = 0; i < block_count; i++) {
                     for (int ch = 0; ch < channel_count; ch++) {
-                        uint32_t v = dsp56k_read_memory(s->core,
-                            mem_space, mem_address+ch*block_count+i);
+                        uint32_t v = planar[ch*block_count+i];
                         switch(item_size) {
                         case 2:
                             *(uint16_t*)(scratch_buf + i*2*channel_count + ch*2) = v >> 8;
@@ -235,21 +247,14 @@ static void dsp_dma_run(DSPDMAState *s)
                     }
                 }
             } else {
-                for (int i = 0; i < count; i++) {
-                    uint32_t v = dsp56k_read_memory(s->core, mem_space, mem_address+i);
-                    switch(item_size) {
-                    case 2:
-                        *(uint16_t*)(scratch_buf + i*2) = v >> 8;
-                        break;
-                    case 4:
-                        *(uint32_t*)(scratch_buf + i*4) = v;
-                        break;
-                    default:
-                        assert(false);
-                        break;
+                dsp56k_read_memory_block(s->core, mem_space, mem_address,
+                                         words, count);
+                if (item_size == 2) {
+                    /* Narrow in place, front to back */
+                    for (int i = 0; i < count; i++) {
+                        *(uint16_t*)(scratch_buf + i*2) = words[i] >> 8;
                     }
                 }
-
             }
 
             /* FIXME: Move to function; then reuse for both directions */
@@ -283,23 +288,23 @@ static void dsp_dma_run(DSPDMAState *s)
                 assert(false);
             }
 
-            for (int i = 0; i < count; i++) {
-                uint32_t v;
+            /* Widen in place, back to front */
+            for (int i = count - 1; i >= 0; i--) {
                 switch(item_size) {
                 case 2:
-                    v = *(uint16_t*)(scratch_buf + i*2) << 8;
+                    words[i] = *(uint16_t*)(scratch_buf + i*2) << 8;
                     break;
                 case 4:
-                    v = (*(uint32_t*)(scratch_buf + i*4)) & item_mask;
+                    words[i] &= item_mask;
                     break;
                 default:
-                    v = 0;
                     assert(false);
                     break;
                 }
-
-                dsp56k_write_memory(s->core, mem_space, mem_address+i, v);
             }
+
+            dsp56k_write_memory_block(s->core, mem_space, mem_address,
+                                      words, count);
         }
 
         if (buffer_offset_writeback) {
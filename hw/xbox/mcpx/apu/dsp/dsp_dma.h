@@ -50,6 +50,12 @@ typedef struct DSPDMAState {
 
     bool error;
     bool eol;
+
+    /* Transfer staging, per DSP as the GP and EP may run concurrently */
+    uint32_t *buf;
+    size_t buf_words;
+    uint32_t *planar_buf;
+    size_t planar_buf_words;
 } DSPDMAState;
 
 uint32_t dsp_dma_read(DSPDMAState *s, DSPDMARegister reg);
@@ -66,17 +66,29 @@ static void scatter_gather_rw(MCPXAPUState *d, hwaddr sge_base,
             bytes_to_copy = len;
         }
 
-        assert(paddr + bytes_to_copy < memory_region_size(d->ram));
+        /* Copy runs of physically contiguous pages at once */
+        size_t run = bytes_to_copy;
+        while (run < len && page_entry < max_sge) {
+            uint32_t next = ldl_le_phys(&address_space_memory,
+                                        sge_base + (page_entry + 1) * 8 + 0);
+            if (next != paddr + run) {
+                break;
+            }
+            run += MIN(len - run, TARGET_PAGE_SIZE);
+            page_entry += 1;
+        }
+
+        assert(paddr + run < memory_region_size(d->ram));
 
         if (dir) {
-            memcpy(&d->ram_ptr[paddr], ptr, bytes_to_copy);
-            memory_region_set_dirty(d->ram, paddr, bytes_to_copy);
+            memcpy(&d->ram_ptr[paddr], ptr, run);
+            memory_region_set_dirty(d->ram, paddr, run);
         } else {
-            memcpy(ptr, &d->ram_ptr[paddr], bytes_to_copy);
+            memcpy(ptr, &d->ram_ptr[paddr], run);
         }
 
-        ptr += bytes_to_copy;
-        len -= bytes_to_copy;
+        ptr += run;
+        len -= run;
 
         /* After the first iteration, we are page aligned */
         page_entry += 1;
@@ -159,7 +171,12 @@ static void gp_fifo_rw(void *opaque, uint8_t *ptr, unsigned int index,
         cur_reg = NV_PAPU_GPIFCUR0 + 0x10 * index;
     }
 
-    uint32_t cur = GET_MASK(d->regs[cur_reg], NV_PAPU_GPOFCUR0_VALUE);
+    uint32_t cur;
+    if (dir && (d->gp.deferred_fifos & (1 << index))) {
+        cur = d->gp.deferred_cur[index];
+    } else {
+        cur = GET_MASK(d->regs[cur_reg], NV_PAPU_GPOFCUR0_VALUE);
+    }
 
     // fprintf(stderr, "GP %s fifo #%d, base = %x, end = %x, cur = %x, len = %x\n",
     //     dir ? "writing to" : "reading from", index,
@@ -171,6 +188,28 @@ static void gp_fifo_rw(void *opaque, uint8_t *ptr, unsigned int index,
         cur = base;
     }
 
+    if (dir && d->ep.in_flight) {
+        /* Keep the EP frame's input as it would be if run serially */
+        GPFifoWrite w = {
+            .sge_base = d->regs[NV_PAPU_GPFADDR],
+            .max_sge = d->regs[NV_PAPU_GPFMAXSGE],
+            .base = base,
+            .end = end,
+            .cur = cur,
+            .len = len,
+        };
+        g_array_append_val(d->gp.deferred_writes, w);
+        g_byte_array_append(d->gp.deferred_data, ptr, len);
+
+        /*
+         * The guest must not see the cursor move before the data lands, so
+         * keep it here until gp_flush_deferred_writes publishes both.
+         */
+        d->gp.deferred_cur[index] = base + (cur - base + len) % (end - base);
+        d->gp.deferred_fifos |= 1 << index;
+        return;
+    }
+
     cur = circular_scatter_gather_rw(d,
         d->regs[NV_PAPU_GPFADDR], d->regs[NV_PAPU_GPFMAXSGE],
         ptr, base, end, cur, len, dir);
@@ -178,6 +217,29 @@ static void gp_fifo_rw(void *opaque, uint8_t *ptr, unsigned int index,
     SET_MASK(d->regs[cur_reg], NV_PAPU_GPOFCUR0_VALUE, cur);
 }
 
+static void gp_flush_deferred_writes(MCPXAPUState *d)
+{
+    uint8_t *data = d->gp.deferred_data->data;
+
+    for (int i = 0; i < d->gp.deferred_writes->len; i++) {
+        GPFifoWrite *w = &g_array_index(d->gp.deferred_writes, GPFifoWrite, i);
+        circular_scatter_gather_rw(d, w->sge_base, w->max_sge, data, w->base,
+                                   w->end, w->cur, w->len, true);
+        data += w->len;
+    }
+
+    g_array_set_size(d->gp.deferred_writes, 0);
+    g_byte_array_set_size(d->gp.deferred_data, 0);
+
+    for (int i = 0; i < GP_OUTPUT_FIFO_COUNT; i++) {
+        if (d->gp.deferred_fifos & (1 << i)) {
+            SET_MASK(d->regs[NV_PAPU_GPOFCUR0 + 0x10 * i],
+                     NV_PAPU_GPOFCUR0_VALUE, d->gp.deferred_cur[i]);
+        }
+    }
+    d->gp.deferred_fifos = 0;
+}
+
 static bool ep_sink_samples(MCPXAPUState *d, uint8_t *ptr, size_t len)
 {
     if (d->monitor.point == MCPX_APU_DEBUG_MON_AC97) {
@@ -356,6 +418,9 @@ static uint64_t ep_read(void *opaque, hwaddr addr, unsigned int size)
 {
     MCPXAPUState *d = opaque;
 
+    qemu_mutex_lock(&d->lock);
+    mcpx_apu_dsp_sync(d);
+
     assert(size == 4);
     assert(addr % 4 == 0);
 
@@ -385,6 +450,8 @@ static uint64_t ep_read(void *opaque, hwaddr addr, unsigned int size)
     }
     DPRINTF("mcpx apu EP: read [0x%" HWADDR_PRIx "] -> 0x%lx\n", addr, r);
 
+    qemu_mutex_unlock(&d->lock);
+
     return r;
 }
 
@@ -393,6 +460,7 @@ static void ep_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
     MCPXAPUState *d = opaque;
 
     qemu_mutex_lock(&d->lock);
+    mcpx_apu_dsp_sync(d);
 
     assert(size == 4);
     assert(addr % 4 == 0);
@@ -436,16 +504,59 @@ const MemoryRegionOps ep_ops = {
     .write = ep_write,
 };
 
-void mcpx_apu_dsp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME])
+static void ep_run_frame(MCPXAPUState *d)
 {
-    /* Write VP results to the GP DSP MIXBUF */
-    for (int mixbin = 0; mixbin < NUM_MIXBINS; mixbin++) {
-        uint32_t base = GP_DSP_MIXBUF_BASE + mixbin * NUM_SAMPLES_PER_FRAME;
-        for (int sample = 0; sample < NUM_SAMPLES_PER_FRAME; sample++) {
-            dsp_write_memory(d->gp.dsp, 'X', base + sample,
-                             float_to_24b(mixbins[mixbin][sample]));
+    timeline_begin("EP");
+    do {
+        dsp_run(d->ep.dsp, 1000);
+    } while (!d->ep.dsp->core.is_idle && d->ep.realtime);
+    timeline_end();
+    g_dbg.ep.cycles = d->ep.dsp->core.cycle_count;
+    g_dbg.ep.idle_skips = d->ep.dsp->core.idle_skips;
+    g_dbg.ep.idle_skipped = d->ep.dsp->core.idle_skipped;
+}
+
+static void *ep_thread(void *arg)
+{
+    MCPXAPUState *d = arg;
+
+    rcu_register_thread();
+    timeline_set_thread_name("EP");
+
+    while (true) {
+        qemu_event_wait(&d->ep.wake);
+        qemu_event_reset(&d->ep.wake);
+        if (qatomic_read(&d->ep.should_exit)) {
+            break;
         }
+
+        ep_run_frame(d);
+
+        qatomic_store_release(&d->ep.frame_done, true);
+        qemu_event_set(&d->ep.finished);
+    }
+
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/* The EP thread is only needed once a frame is pipelined */
+static void ep_start_thread(MCPXAPUState *d)
+{
+    if (!d->ep.thread_started) {
+        qemu_thread_create(&d->ep.thread, "mcpx.ep_thread", ep_thread, d,
+                           QEMU_THREAD_JOINABLE);
+        d->ep.thread_started = true;
     }
+}
+
+void mcpx_apu_dsp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME])
+{
+    /* Write VP results to the GP DSP MIXBUF, laid out the same way */
+    uint32_t mixbuf[NUM_MIXBINS * NUM_SAMPLES_PER_FRAME];
+    float_to_24b_array(mixbuf, &mixbins[0][0], ARRAY_SIZE(mixbuf));
+    dsp_write_memory_block(d->gp.dsp, 'X', GP_DSP_MIXBUF_BASE, mixbuf,
+                           ARRAY_SIZE(mixbuf));
 
     bool ep_enabled = (d->ep.regs[NV_PAPU_EPRST] & NV_PAPU_GPRST_GPRST) &&
                       (d->ep.regs[NV_PAPU_EPRST] & NV_PAPU_GPRST_GPDSPRST);
@@ -456,37 +567,74 @@ void mcpx_apu_dsp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_
         dsp_start_frame(d->gp.dsp);
         d->gp.dsp->core.is_idle = false;
         d->gp.dsp->core.cycle_count = 0;
+        d->gp.dsp->core.idle_skips = 0;
+        d->gp.dsp->core.idle_skipped = 0;
+        d->gp.dsp->core.jit_enabled = g_config.audio.dsp_jit;
+        timeline_begin("GP");
         do {
             dsp_run(d->gp.dsp, 1000);
         } while (!d->gp.dsp->core.is_idle && d->gp.realtime);
+        timeline_end();
         g_dbg.gp.cycles = d->gp.dsp->core.cycle_count;
+        g_dbg.gp.idle_skips = d->gp.dsp->core.idle_skips;
+        g_dbg.gp.idle_skipped = d->gp.dsp->core.idle_skipped;
 
         if ((d->monitor.point == MCPX_APU_DEBUG_MON_GP) ||
             (d->monitor.point == MCPX_APU_DEBUG_MON_GP_OR_EP && !ep_enabled)) {
             int off = (d->ep_frame_div % 8) * NUM_SAMPLES_PER_FRAME;
+            uint32_t lr[2][NUM_SAMPLES_PER_FRAME];
+            dsp_read_memory_block(d->gp.dsp, 'X', 0x1400, &lr[0][0],
+                                  2 * NUM_SAMPLES_PER_FRAME);
             for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
-                uint32_t l = dsp_read_memory(d->gp.dsp, 'X', 0x1400 + i);
-                d->monitor.frame_buf[off + i][0] = l >> 8;
-                uint32_t r =
-                    dsp_read_memory(d->gp.dsp, 'X', 0x1400 + 1 * 0x20 + i);
-                d->monitor.frame_buf[off + i][1] = r >> 8;
+                d->monitor.frame_buf[off + i][0] = lr[0][i] >> 8;
+                d->monitor.frame_buf[off + i][1] = lr[1][i] >> 8;
             }
         }
     }
 
     /* Run EP */
-    if ((d->ep.regs[NV_PAPU_EPRST] & NV_PAPU_GPRST_GPRST) &&
-        (d->ep.regs[NV_PAPU_EPRST] & NV_PAPU_GPRST_GPDSPRST)) {
-        if (d->ep_frame_div % 8 == 0) {
-            dsp_start_frame(d->ep.dsp);
-            d->ep.dsp->core.is_idle = false;
-            d->ep.dsp->core.cycle_count = 0;
-            do {
-                dsp_run(d->ep.dsp, 1000);
-            } while (!d->ep.dsp->core.is_idle && d->ep.realtime);
-            g_dbg.ep.cycles = d->ep.dsp->core.cycle_count;
+    if (ep_enabled && d->ep_frame_div % 8 == 0) {
+        mcpx_apu_dsp_sync(d);
+        dsp_start_frame(d->ep.dsp);
+        d->ep.dsp->core.is_idle = false;
+        d->ep.dsp->core.cycle_count = 0;
+        d->ep.dsp->core.idle_skips = 0;
+        d->ep.dsp->core.idle_skipped = 0;
+        d->ep.dsp->core.jit_enabled = g_config.audio.dsp_jit;
+        if (g_config.audio.pipelined_dsp && d->ep.realtime) {
+            ep_start_thread(d);
+            d->ep.in_flight = true;
+            qatomic_set(&d->ep.frame_done, false);
+            qemu_event_reset(&d->ep.finished);
+            qemu_event_set(&d->ep.wake);
+        } else {
+            ep_run_frame(d);
         }
     }
+
+    /* The monitor picks up EP output at the end of the EP period */
+    if ((d->ep_frame_div + 1) % 8 == 0 ||
+        (d->ep.in_flight && qatomic_load_acquire(&d->ep.frame_done))) {
+        mcpx_apu_dsp_sync(d);
+    }
+}
+
+/*
+ * Waits for a pipelined EP frame to finish and writes out the GP output held
+ * back while it ran. Must be called with the APU lock held.
+ */
+void mcpx_apu_dsp_sync(MCPXAPUState *d)
+{
+    if (!d->ep.in_flight) {
+        return;
+    }
+
+    timeline_begin("EP Wait");
+    qemu_event_wait(&d->ep.finished);
+    timeline_end();
+    d->ep.in_flight = false;
+
+    gp_flush_deferred_writes(d);
 }
 
 void mcpx_apu_dsp_init(MCPXAPUState *d)
@@ -495,8 +643,7 @@ void mcpx_apu_dsp_init(MCPXAPUState *d)
     for (int i = 0; i < DSP_PRAM_SIZE; i++) {
         d->gp.dsp->core.pram[i] = 0xCACACACA;
     }
-    memset(d->gp.dsp->core.pram_opcache, 0,
-           sizeof(d->gp.dsp->core.pram_opcache));
+    dsp56k_invalidate_decoded(&d->gp.dsp->core);
     d->gp.dsp->is_gp = true;
     d->gp.dsp->core.is_gp = true;
     d->gp.dsp->core.is_idle = false;
@@ -506,8 +653,7 @@ void mcpx_apu_dsp_init(MCPXAPUState *d)
     for (int i = 0; i < DSP_PRAM_SIZE; i++) {
         d->ep.dsp->core.pram[i] = 0xCACACACA;
     }
-    memset(d->ep.dsp->core.pram_opcache, 0,
-           sizeof(d->ep.dsp->core.pram_opcache));
+    dsp56k_invalidate_decoded(&d->ep.dsp->core);
     for (int i = 0; i < DSP_XRAM_SIZE; i++) {
         d->ep.dsp->core.xram[i] = 0xCACACACA;
     }
@@ -519,8 +665,31 @@ void mcpx_apu_dsp_init(MCPXAPUState *d)
     d->ep.dsp->core.is_idle = false;
     d->ep.dsp->core.cycle_count = 0;
 
+    d->gp.deferred_writes = g_array_new(false, false, sizeof(GPFifoWrite));
+    d->gp.deferred_data = g_byte_array_new();
+
+    d->ep.thread_started = false;
+    d->ep.in_flight = false;
+    d->ep.should_exit = false;
+    qemu_event_init(&d->ep.wake, false);
+    qemu_event_init(&d->ep.finished, false);
+
     /* Until DSP is more performant, a switch to decide whether or not we should
      * use the full audio pipeline or not.
      */
     mcpx_apu_update_dsp_preference(d);
 }
+
+void mcpx_apu_dsp_finalize(MCPXAPUState *d)
+{
+    if (d->ep.thread_started) {
+        qatomic_set(&d->ep.should_exit, true);
+        qemu_event_set(&d->ep.wake);
+        qemu_thread_join(&d->ep.thread);
+    }
+    qemu_event_destroy(&d->ep.wake);
+    qemu_event_destroy(&d->ep.finished);
+
+    g_array_free(d->gp.deferred_writes, true);
+    g_byte_array_free(d->gp.deferred_data, true);
+}
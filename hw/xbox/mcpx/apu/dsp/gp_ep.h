@@ -24,6 +24,7 @@
 #include "qemu/osdep.h"
 #include "hw/hw.h"
 #include "hw/pci/pci.h"
+#include "qemu/thread.h"
 #include "hw/xbox/mcpx/apu/apu_regs.h"
 
 #include "dsp.h"
@@ -33,11 +34,26 @@
 
 typedef struct MCPXAPUState MCPXAPUState;
 
+/* GP output FIFO write held back while an EP frame is in flight */
+typedef struct GPFifoWrite {
+    hwaddr sge_base;
+    unsigned int max_sge;
+    uint32_t base, end, cur;
+    uint32_t len;
+} GPFifoWrite;
+
 typedef struct MCPXAPUGPState {
     bool realtime;
     MemoryRegion mmio;
     DSPState *dsp;
     uint32_t regs[0x10000];
+
+    GArray *deferred_writes; // GPFifoWrite
+    GByteArray *deferred_data;
+
+    /* Output FIFO cursors past the deferred writes, not yet in GPOFCUR */
+    uint32_t deferred_cur[GP_OUTPUT_FIFO_COUNT];
+    uint32_t deferred_fifos; // Bitmask of FIFOs with a deferred_cur
 } MCPXAPUGPState;
 
 typedef struct MCPXAPUEPState {
@@ -45,12 +61,23 @@ typedef struct MCPXAPUEPState {
     MemoryRegion mmio;
     DSPState *dsp;
     uint32_t regs[0x10000];
+
+    /* Pipelined EP frames run on this thread while the GP moves on */
+    QemuThread thread;
+    bool thread_started;
+    QemuEvent wake;
+    QemuEvent finished;
+    bool frame_done;
+    bool in_flight;
+    bool should_exit;
 } MCPXAPUEPState;
 
 extern const MemoryRegionOps gp_ops;
 extern const MemoryRegionOps ep_ops;
 
 void mcpx_apu_dsp_init(MCPXAPUState *d);
+void mcpx_apu_dsp_finalize(MCPXAPUState *d);
+void mcpx_apu_dsp_sync(MCPXAPUState *d);
 void mcpx_apu_update_dsp_preference(MCPXAPUState *d);
 void mcpx_apu_dsp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME]);
 
@@ -21,8 +21,15 @@
 #ifndef FLOATCONV_H
 #define FLOATCONV_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 static inline float int8_to_float(int8_t x)
 {
     return x / 128.0f;
@@ -67,4 +74,41 @@ static inline uint32_t float_to_24b(float value)
     return int24 & 0xffffff;
 }
 
+/* Same as float_to_24b() on each value, four at a time where possible */
+static inline void float_to_24b_array(uint32_t *dst, const float *src,
+                                      size_t count)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(8.0f * 0x100000);
+    const __m128 hi = _mm_set1_ps(1.0f * 0x7fffff);
+    const __m128 lo = _mm_set1_ps(-8.0f * 0x100000);
+    const __m128i mask = _mm_set1_epi32(0xffffff);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(&src[i]), scale);
+        v = _mm_max_ps(lo, _mm_min_ps(hi, v));
+        __m128i r = _mm_and_si128(_mm_cvtps_epi32(v), mask);
+        _mm_storeu_si128((__m128i *)&dst[i], r);
+    }
+#elif defined(__aarch64__)
+    const float32x4_t scale = vdupq_n_f32(8.0f * 0x100000);
+    const float32x4_t hi = vdupq_n_f32(1.0f * 0x7fffff);
+    const float32x4_t lo = vdupq_n_f32(-8.0f * 0x100000);
+    const uint32x4_t mask = vdupq_n_u32(0xffffff);
+
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t v = vmulq_f32(vld1q_f32(&src[i]), scale);
+        v = vmaxq_f32(lo, vminq_f32(hi, v));
+        uint32x4_t r = vreinterpretq_u32_s32(vcvtnq_s32_f32(v));
+        vst1q_u32(&dst[i], vandq_u32(r, mask));
+    }
+#endif
+
+    for (; i < count; i++) {
+        dst[i] = float_to_24b(src[i]);
+    }
+}
+
 #endif
@@ -0,0 +1,75 @@
+/*
+ * ADPCM decoder from the ADPCM-XQ project: https://github.com/dbry/adpcm-xq
+ *
+ *                        Copyright (c) David Bryant
+ *                           All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice,
+ *       this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Conifer Software nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qemu/osdep.h"
+#include "adpcm.h"
+
+/* step table */
+const uint16_t adpcm_step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,
+    16,    17,    19,    21,    23,    25,    28,    31,
+    34,    37,    41,    45,    50,    55,    60,    66,
+    73,    80,    88,    97,    107,   118,   130,   143,
+    157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,
+    724,   796,   876,   963,   1060,  1166,  1282,  1411,
+    1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,
+    3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,
+    7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+/* step index tables */
+const int8_t adpcm_index_table[8] = {
+    /* adpcm data size is 4 */
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+int32_t adpcm_delta_table[89][16];
+uint8_t adpcm_next_index_table[89][16];
+
+void adpcm_init_tables(void)
+{
+    for (int index = 0; index < 89; index++) {
+        for (int nibble = 0; nibble < 16; nibble++) {
+            int step = adpcm_step_table[index], delta = step >> 3;
+
+            if (nibble & 1) delta += (step >> 2);
+            if (nibble & 2) delta += (step >> 1);
+            if (nibble & 4) delta += step;
+            if (nibble & 8) delta = -delta;
+
+            int next = index + adpcm_index_table[nibble & 7];
+            adpcm_delta_table[index][nibble] = delta;
+            adpcm_next_index_table[index][nibble] = next < 0 ? 0 : next > 88 ? 88 : next;
+        }
+    }
+}
@@ -0,0 +1,231 @@
+/*
+ * HRTF Filter
+ *
+ * Copyright (c) 2025 Matt Borgerson
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hrtf.h"
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+#include "host/cpuinfo.h"
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Every kernel returns the dot products of the coefficients with the window
+ * and with the window advanced by one sample, for the fractional delay. Sums
+ * are kept in 8 lanes and reduced in the same order by all kernels.
+ */
+typedef void (*HrtfDotFn)(const float *coeff, const float *window,
+                          float out[2]);
+
+static inline float reduce8(const float *v)
+{
+    return ((v[0] + v[4]) + (v[2] + v[6])) + ((v[1] + v[5]) + (v[3] + v[7]));
+}
+
+static inline void hrtf_dot_generic(const float *coeff, const float *window,
+                                    float out[2])
+{
+    float a[8] = { 0 }, b[8] = { 0 };
+
+    for (int k = 0; k < HRTF_PADDED_TAPS; k += 8) {
+        for (int j = 0; j < 8; j++) {
+            a[j] += coeff[k + j] * window[k + j];
+            b[j] += coeff[k + j] * window[k + j + 1];
+        }
+    }
+
+    out[0] = reduce8(a);
+    out[1] = reduce8(b);
+}
+
+/*
+ * Frame loop shared by all kernels, so that each is inlined into a copy
+ * compiled for its target.
+ */
+static inline __attribute__((always_inline)) void
+hrtf_filter_process_frame(HrtfFilter *f, float in[HRTF_SAMPLES_PER_FRAME][2],
+                          float out[HRTF_SAMPLES_PER_FRAME][2], HrtfDotFn dot)
+{
+    for (int n = 0; n < HRTF_SAMPLES_PER_FRAME; n++) {
+        hrtf_filter_step_parameters(f);
+
+        f->buf_pos = (f->buf_pos + HRTF_BUFLEN - 1) % HRTF_BUFLEN;
+
+        for (int ch = 0; ch < 2; ch++) {
+            float *buf = f->ch[ch].buf;
+
+            // Push new sample
+            buf[f->buf_pos] = buf[f->buf_pos + HRTF_BUFLEN] = in[n][ch];
+
+            // Interaural time difference (channel delay)
+            float d = f->itd_cur * (ch == 0 ? +1.0f : -1.0f);
+            if (d < 0.0f) {
+                d = 0.0f;
+            }
+            int di = d;
+            float dfrac = d - di;
+
+            // HRIR convolution, linearly interpolating the fractional delay
+            float acc[2];
+            dot(f->ch[ch].hrir_coeff_cur, &buf[f->buf_pos + di], acc);
+            out[n][ch] = acc[0] * (1 - dfrac) + acc[1] * dfrac;
+        }
+    }
+}
+
+static void hrtf_filter_process_generic(HrtfFilter *f,
+                                        float in[HRTF_SAMPLES_PER_FRAME][2],
+                                        float out[HRTF_SAMPLES_PER_FRAME][2])
+{
+    hrtf_filter_process_frame(f, in, out, hrtf_dot_generic);
+}
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+
+static inline __attribute__((target("sse2"))) float reduce_sse2(__m128 lo,
+                                                               __m128 hi)
+{
+    __m128 v = _mm_add_ps(lo, hi);
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static inline __attribute__((target("sse2"))) void
+hrtf_dot_sse2(const float *coeff, const float *window, float out[2])
+{
+    __m128 a_lo = _mm_setzero_ps(), a_hi = _mm_setzero_ps();
+    __m128 b_lo = _mm_setzero_ps(), b_hi = _mm_setzero_ps();
+
+    for (int k = 0; k < HRTF_PADDED_TAPS; k += 8) {
+        __m128 c_lo = _mm_loadu_ps(&coeff[k]);
+        __m128 c_hi = _mm_loadu_ps(&coeff[k + 4]);
+        a_lo = _mm_add_ps(a_lo, _mm_mul_ps(c_lo, _mm_loadu_ps(&window[k])));
+        a_hi = _mm_add_ps(a_hi, _mm_mul_ps(c_hi, _mm_loadu_ps(&window[k + 4])));
+        b_lo = _mm_add_ps(b_lo, _mm_mul_ps(c_lo, _mm_loadu_ps(&window[k + 1])));
+        b_hi = _mm_add_ps(b_hi, _mm_mul_ps(c_hi, _mm_loadu_ps(&window[k + 5])));
+    }
+
+    out[0] = reduce_sse2(a_lo, a_hi);
+    out[1] = reduce_sse2(b_lo, b_hi);
+}
+
+static void __attribute__((target("sse2")))
+hrtf_filter_process_sse2(HrtfFilter *f, float in[HRTF_SAMPLES_PER_FRAME][2],
+                         float out[HRTF_SAMPLES_PER_FRAME][2])
+{
+    hrtf_filter_process_frame(f, in, out, hrtf_dot_sse2);
+}
+
+#ifdef CONFIG_AVX2_OPT
+static inline __attribute__((target("avx2"))) void
+hrtf_dot_avx2(const float *coeff, const float *window, float out[2])
+{
+    __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
+
+    for (int k = 0; k < HRTF_PADDED_TAPS; k += 8) {
+        __m256 c = _mm256_loadu_ps(&coeff[k]);
+        a = _mm256_add_ps(a, _mm256_mul_ps(c, _mm256_loadu_ps(&window[k])));
+        b = _mm256_add_ps(b, _mm256_mul_ps(c, _mm256_loadu_ps(&window[k + 1])));
+    }
+
+    out[0] = reduce_sse2(_mm256_castps256_ps128(a),
+                         _mm256_extractf128_ps(a, 1));
+    out[1] = reduce_sse2(_mm256_castps256_ps128(b),
+                         _mm256_extractf128_ps(b, 1));
+}
+
+static void __attribute__((target("avx2")))
+hrtf_filter_process_avx2(HrtfFilter *f, float in[HRTF_SAMPLES_PER_FRAME][2],
+                         float out[HRTF_SAMPLES_PER_FRAME][2])
+{
+    hrtf_filter_process_frame(f, in, out, hrtf_dot_avx2);
+}
+#endif /* CONFIG_AVX2_OPT */
+
+#elif defined(__ARM_NEON)
+
+static inline float reduce_neon(float32x4_t lo, float32x4_t hi)
+{
+    float32x4_t v = vaddq_f32(lo, hi);
+    float32x2_t h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(h, 0) + vget_lane_f32(h, 1);
+}
+
+static inline void hrtf_dot_neon(const float *coeff, const float *window,
+                                 float out[2])
+{
+    float32x4_t a_lo = vdupq_n_f32(0), a_hi = vdupq_n_f32(0);
+    float32x4_t b_lo = vdupq_n_f32(0), b_hi = vdupq_n_f32(0);
+
+    for (int k = 0; k < HRTF_PADDED_TAPS; k += 8) {
+        float32x4_t c_lo = vld1q_f32(&coeff[k]);
+        float32x4_t c_hi = vld1q_f32(&coeff[k + 4]);
+        a_lo = vaddq_f32(a_lo, vmulq_f32(c_lo, vld1q_f32(&window[k])));
+        a_hi = vaddq_f32(a_hi, vmulq_f32(c_hi, vld1q_f32(&window[k + 4])));
+        b_lo = vaddq_f32(b_lo, vmulq_f32(c_lo, vld1q_f32(&window[k + 1])));
+        b_hi = vaddq_f32(b_hi, vmulq_f32(c_hi, vld1q_f32(&window[k + 5])));
+    }
+
+    out[0] = reduce_neon(a_lo, a_hi);
+    out[1] = reduce_neon(b_lo, b_hi);
+}
+
+static void hrtf_filter_process_neon(HrtfFilter *f,
+                                     float in[HRTF_SAMPLES_PER_FRAME][2],
+                                     float out[HRTF_SAMPLES_PER_FRAME][2])
+{
+    hrtf_filter_process_frame(f, in, out, hrtf_dot_neon);
+}
+
+#endif
+
+typedef void (*HrtfProcessFn)(HrtfFilter *f,
+                              float in[HRTF_SAMPLES_PER_FRAME][2],
+                              float out[HRTF_SAMPLES_PER_FRAME][2]);
+
+static HrtfProcessFn hrtf_filter_process_accel = hrtf_filter_process_generic;
+
+static void __attribute__((constructor)) init_hrtf_accel(void)
+{
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+    unsigned info = cpuinfo_init();
+
+#ifdef CONFIG_AVX2_OPT
+    if (info & CPUINFO_AVX2) {
+        hrtf_filter_process_accel = hrtf_filter_process_avx2;
+        return;
+    }
+#endif
+    if (info & CPUINFO_SSE2) {
+        hrtf_filter_process_accel = hrtf_filter_process_sse2;
+    }
+#elif defined(__ARM_NEON)
+    hrtf_filter_process_accel = hrtf_filter_process_neon;
+#endif
+}
+
+void hrtf_filter_process(HrtfFilter *f, float in[HRTF_SAMPLES_PER_FRAME][2],
+                         float out[HRTF_SAMPLES_PER_FRAME][2])
+{
+    hrtf_filter_process_accel(f, in, out);
+}
@@ -28,16 +28,20 @@
 
 #define HRTF_SAMPLES_PER_FRAME  NUM_SAMPLES_PER_FRAME
 #define HRTF_NUM_TAPS           31
+#define HRTF_PADDED_TAPS        32 // Zero padded for the vector kernels
 #define HRTF_MAX_DELAY_SAMPLES  42
-#define HRTF_BUFLEN             (HRTF_NUM_TAPS + HRTF_MAX_DELAY_SAMPLES)
+#define HRTF_BUFLEN             (HRTF_PADDED_TAPS + HRTF_MAX_DELAY_SAMPLES + 1)
 #define HRTF_PARAM_SMOOTH_ALPHA 0.01f
+#define HRTF_PARAM_SETTLE_STEPS 2048 // Remaining difference is below 1e-8
 
 typedef struct {
     int buf_pos;
+    int settle_steps;
     struct {
-        float buf[HRTF_BUFLEN];
-        float hrir_coeff_cur[HRTF_NUM_TAPS];
-        float hrir_coeff_tar[HRTF_NUM_TAPS];
+        // Newest sample first, stored twice so every window is contiguous
+        float buf[2 * HRTF_BUFLEN];
+        float hrir_coeff_cur[HRTF_PADDED_TAPS];
+        float hrir_coeff_tar[HRTF_PADDED_TAPS];
     } ch[2];
     float itd_cur;
     float itd_tar;
@@ -59,12 +63,16 @@ static inline void
 hrtf_filter_set_target_params(HrtfFilter *f, float hrir_coeff[2][HRTF_NUM_TAPS],
                               float itd)
 {
-    f->itd_tar =
+    float coeff_tar[2][HRTF_NUM_TAPS];
+    float itd_tar =
         fmaxf(-HRTF_MAX_DELAY_SAMPLES, fminf(itd, HRTF_MAX_DELAY_SAMPLES));
 
+    memcpy(coeff_tar[0], f->ch[0].hrir_coeff_tar, sizeof(coeff_tar[0]));
+    memcpy(coeff_tar[1], f->ch[1].hrir_coeff_tar, sizeof(coeff_tar[1]));
+
     for (int ch = 0; ch < 2; ch++) {
-        float *coeff = f->ch[ch].hrir_coeff_tar;
-        memcpy(coeff, hrir_coeff[ch], sizeof(f->ch[ch].hrir_coeff_tar));
+        float *coeff = coeff_tar[ch];
+        memcpy(coeff, hrir_coeff[ch], sizeof(coeff_tar[ch]));
 
         // Normalize coefficients for unity filter gain
         float s = 0.0f;
@@ -78,6 +86,17 @@ hrtf_filter_set_target_params(HrtfFilter *f, float hrir_coeff[2][HRTF_NUM_TAPS],
             coeff[k] /= s;
         }
     }
+
+    if (itd_tar == f->itd_tar &&
+        !memcmp(coeff_tar[0], f->ch[0].hrir_coeff_tar, sizeof(coeff_tar[0])) &&
+        !memcmp(coeff_tar[1], f->ch[1].hrir_coeff_tar, sizeof(coeff_tar[1]))) {
+        return;
+    }
+
+    f->itd_tar = itd_tar;
+    memcpy(f->ch[0].hrir_coeff_tar, coeff_tar[0], sizeof(coeff_tar[0]));
+    memcpy(f->ch[1].hrir_coeff_tar, coeff_tar[1], sizeof(coeff_tar[1]));
+    f->settle_steps = HRTF_PARAM_SETTLE_STEPS;
 }
 
 static inline float hrtf_filter_smooth_param(float cur, float tar)
@@ -88,57 +107,31 @@ static inline float hrtf_filter_smooth_param(float cur, float tar)
 
 static inline void hrtf_filter_step_parameters(HrtfFilter *f)
 {
+    if (f->settle_steps == 0) {
+        return;
+    }
+
+    if (--f->settle_steps == 0) {
+        for (int ch = 0; ch < 2; ch++) {
+            memcpy(f->ch[ch].hrir_coeff_cur, f->ch[ch].hrir_coeff_tar,
+                   sizeof(f->ch[ch].hrir_coeff_cur));
+        }
+        f->itd_cur = f->itd_tar;
+        return;
+    }
+
     for (int ch = 0; ch < 2; ch++) {
         float *coeff_cur = f->ch[ch].hrir_coeff_cur;
         float *coeff_tar = f->ch[ch].hrir_coeff_tar;
-        for (int k = 0; k < HRTF_NUM_TAPS; k++) {
+        for (int k = 0; k < HRTF_PADDED_TAPS; k++) {
             coeff_cur[k] = hrtf_filter_smooth_param(coeff_cur[k], coeff_tar[k]);
         }
     }
     f->itd_cur = hrtf_filter_smooth_param(f->itd_cur, f->itd_tar);
 }
 
-static inline void hrtf_filter_process(HrtfFilter *f,
-                                       float in[HRTF_SAMPLES_PER_FRAME][2],
-                                       float out[HRTF_SAMPLES_PER_FRAME][2])
-{
-    for (int n = 0; n < HRTF_SAMPLES_PER_FRAME; n++) {
-        hrtf_filter_step_parameters(f);
-
-        for (int ch = 0; ch < 2; ch++) {
-            float *buf = f->ch[ch].buf;
-            float *coeff = f->ch[ch].hrir_coeff_cur;
-
-            // Push new sample
-            buf[f->buf_pos] = in[n][ch];
-
-            // Interaural time difference (channel delay)
-            float d = f->itd_cur * (ch == 0 ? +1.0f : -1.0f);
-            if (d < 0.0f) {
-                d = 0.0f;
-            }
-            int di = d;
-            float dfrac = d - di;
-
-            // HRIR Convolution
-            float acc = 0.0f;
-            for (int k = 0; k < HRTF_NUM_TAPS; k++) {
-                int idx1 = (f->buf_pos - di - k + HRTF_BUFLEN) % HRTF_BUFLEN;
-                float s = buf[idx1];
-
-                // Linear interpolation for fractional part
-                if (dfrac > 0.0f) {
-                    int idx2 = (idx1 - 1 + HRTF_BUFLEN) % HRTF_BUFLEN;
-                    s = s * (1 - dfrac) + buf[idx2] * dfrac;
-                }
-                acc += coeff[k] * s;
-            }
-
-            out[n][ch] = acc;
-        }
-
-        f->buf_pos = (f->buf_pos + 1) % HRTF_BUFLEN;
-    }
-}
+/* Selects an AVX2, SSE2 or NEON kernel for the host at startup */
+void hrtf_filter_process(HrtfFilter *f, float in[HRTF_SAMPLES_PER_FRAME][2],
+                         float out[HRTF_SAMPLES_PER_FRAME][2]);
 
 #endif
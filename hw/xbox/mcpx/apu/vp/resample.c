@@ -0,0 +1,381 @@
+/*
+ * Voice Resampler
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "resample.h"
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+#include "host/cpuinfo.h"
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Filters are stored for this many fractional positions and interpolated */
+#define RESAMPLE_PHASE_BITS 8
+#define RESAMPLE_PHASES     (1 << RESAMPLE_PHASE_BITS)
+#define RESAMPLE_PHASE_FRAC_BITS (32 - RESAMPLE_PHASE_BITS)
+
+/*
+ * When input is consumed faster than output is produced, the cutoff is lowered
+ * with the ratio so that input above the output Nyquist frequency is removed
+ * instead of aliasing. Filters are kept for half-octave steps down to
+ * RESAMPLE_MIN_CUTOFF_RATIO, and the step at or below the ratio is used.
+ */
+#define RESAMPLE_CUTOFF_BANDS 5
+#define RESAMPLE_MIN_CUTOFF_RATIO 0.25
+
+/* Windowed sinc for each phase, plus one row for a position of 1.0 */
+static float sinc8_table[RESAMPLE_CUTOFF_BANDS][RESAMPLE_PHASES + 1][8];
+static float sinc32_table[RESAMPLE_CUTOFF_BANDS][RESAMPLE_PHASES + 1][32];
+
+static void init_sinc_table(float *table, int taps, double cutoff)
+{
+    int half = taps / 2;
+
+    for (int p = 0; p <= RESAMPLE_PHASES; p++) {
+        float *row = &table[p * taps];
+        double sum = 0;
+
+        for (int j = 0; j < taps; j++) {
+            /* Distance of tap j from the output position */
+            double x = j - (half - 1) - (double)p / RESAMPLE_PHASES;
+            double s = x == 0 ? 1 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+            double w = 0.42 + 0.5 * cos(M_PI * x / half) +
+                       0.08 * cos(2 * M_PI * x / half);
+            row[j] = fabs(x) < half ? s * w : 0;
+            sum += row[j];
+        }
+
+        /* Unity gain at DC */
+        for (int j = 0; j < taps; j++) {
+            row[j] /= sum;
+        }
+    }
+}
+
+static void __attribute__((constructor)) init_sinc_tables(void)
+{
+    for (int b = 0; b < RESAMPLE_CUTOFF_BANDS; b++) {
+        double scale = exp2(-0.5 * b);
+        init_sinc_table(&sinc8_table[b][0][0], 8, 0.8 * scale);
+        init_sinc_table(&sinc32_table[b][0][0], 32, 0.92 * scale);
+    }
+}
+
+static int resampler_cutoff_band(double ratio)
+{
+    if (ratio >= 1) {
+        return 0;
+    }
+    if (ratio <= RESAMPLE_MIN_CUTOFF_RATIO) {
+        return RESAMPLE_CUTOFF_BANDS - 1;
+    }
+
+    /* Allow for rounding on ratios that are exact half-octave steps */
+    return MIN((int)ceil(-2 * log2(ratio) - 1e-9), RESAMPLE_CUTOFF_BANDS - 1);
+}
+
+void resampler_reset(Resampler *r)
+{
+    /* Start with silence before the first input frame */
+    r->pos = MAX(r->taps / 2 - 1, 0);
+    r->frac = 0;
+    r->len = r->pos;
+    memset(r->buf, 0, sizeof(r->buf));
+}
+
+void resampler_init(Resampler *r, ResampleQuality quality)
+{
+    static const int taps[] = {
+        [RESAMPLE_QUALITY_LINEAR] = 2,
+        [RESAMPLE_QUALITY_SINC8] = 8,
+        [RESAMPLE_QUALITY_SINC32] = 32,
+    };
+
+    assert(quality < ARRAY_SIZE(taps));
+    r->quality = quality;
+    r->taps = taps[quality];
+    resampler_reset(r);
+}
+
+/* Make frames up to pos + taps / 2 available, reading more input if needed */
+static void resampler_fill(Resampler *r, bool stereo, ResampleReadFn read,
+                           void *opaque)
+{
+    int half = r->taps / 2;
+    int first = r->pos - (half - 1); // Oldest frame still needed
+    int skip = 0;
+
+    if (first >= r->len) {
+        skip = first - r->len;
+        r->len = 0;
+    } else if (first > 0) {
+        r->len -= first;
+        memmove(r->buf[0], &r->buf[0][first], r->len * sizeof(float));
+        memmove(r->buf[1], &r->buf[1][first], r->len * sizeof(float));
+    }
+    r->pos -= first;
+
+    float frames[RESAMPLE_READ_CHUNK][2] = { 0 };
+
+    /* Input stepped over entirely */
+    while (skip > 0) {
+        int count = read(opaque, frames, MIN(skip, RESAMPLE_READ_CHUNK));
+        if (count <= 0) {
+            break;
+        }
+        skip -= count;
+    }
+
+    while (r->len <= r->pos + half) {
+        int want = MIN(RESAMPLE_READ_CHUNK, RESAMPLE_BUF_FRAMES - r->len);
+        int count = read(opaque, frames, want);
+        if (count <= 0) {
+            /* Starved, continue with silence */
+            count = want;
+            memset(frames, 0, sizeof(frames));
+        }
+        for (int i = 0; i < count; i++) {
+            r->buf[0][r->len + i] = frames[i][0];
+            r->buf[1][r->len + i] = stereo ? frames[i][1] : 0;
+        }
+        r->len += count;
+    }
+}
+
+static inline void resampler_advance(Resampler *r, uint64_t step)
+{
+    uint64_t frac = (uint64_t)r->frac + (uint32_t)step;
+    r->frac = frac;
+    r->pos += (step >> 32) + (frac >> 32);
+}
+
+static void resampler_process_linear(Resampler *r, uint64_t step, bool stereo,
+                                     float out[][2], int num_frames,
+                                     ResampleReadFn read, void *opaque)
+{
+    for (int n = 0; n < num_frames; n++) {
+        if (r->pos + 1 >= r->len) {
+            resampler_fill(r, stereo, read, opaque);
+        }
+
+        float t = r->frac * (1.0f / 4294967296.0f);
+        for (int ch = 0; ch < 2; ch++) {
+            const float *x = &r->buf[ch][r->pos];
+            out[n][ch] = x[0] + (x[1] - x[0]) * t;
+        }
+
+        resampler_advance(r, step);
+    }
+}
+
+/*
+ * Sums are kept in 8 lanes and reduced in the same order by every kernel, so
+ * all of them produce the same output.
+ */
+typedef float (*ResampleDotFn)(const float *coeff, const float *x, int taps);
+
+static inline float reduce8(const float *v)
+{
+    return ((v[0] + v[4]) + (v[2] + v[6])) + ((v[1] + v[5]) + (v[3] + v[7]));
+}
+
+static inline float resample_dot_generic(const float *coeff, const float *x,
+                                         int taps)
+{
+    float acc[8] = { 0 };
+
+    for (int k = 0; k < taps; k += 8) {
+        for (int j = 0; j < 8; j++) {
+            acc[j] += coeff[k + j] * x[k + j];
+        }
+    }
+
+    return reduce8(acc);
+}
+
+/*
+ * Frame loop shared by all kernels, so that each is inlined into a copy
+ * compiled for its target with a constant number of taps.
+ */
+static inline __attribute__((always_inline)) void
+resampler_process_sinc(Resampler *r, uint64_t step, bool stereo,
+                       float out[][2], int num_frames, ResampleReadFn read,
+                       void *opaque, const float *table, const int taps,
+                       ResampleDotFn dot)
+{
+    const int half = taps / 2;
+
+    for (int n = 0; n < num_frames; n++) {
+        if (r->pos + half >= r->len) {
+            resampler_fill(r, stereo, read, opaque);
+        }
+
+        /* Filter for the exact position, between two stored phases */
+        const float *c0 = &table[(r->frac >> RESAMPLE_PHASE_FRAC_BITS) * taps];
+        const float *c1 = c0 + taps;
+        float t = (r->frac & ((1u << RESAMPLE_PHASE_FRAC_BITS) - 1)) *
+                  (1.0f / (1u << RESAMPLE_PHASE_FRAC_BITS));
+        float coeff[RESAMPLE_MAX_TAPS];
+        for (int k = 0; k < taps; k++) {
+            coeff[k] = c0[k] + (c1[k] - c0[k]) * t;
+        }
+
+        int first = r->pos - (half - 1);
+        out[n][0] = dot(coeff, &r->buf[0][first], taps);
+        out[n][1] = stereo ? dot(coeff, &r->buf[1][first], taps) : 0;
+
+        resampler_advance(r, step);
+    }
+}
+
+#define RESAMPLE_SINC_FN(name, attr, dot)                                     \
+    static void attr name(Resampler *r, uint64_t step, int band, bool stereo, \
+                          float out[][2], int num_frames, ResampleReadFn read, \
+                          void *opaque)                                       \
+    {                                                                         \
+        if (r->taps == 8) {                                                   \
+            resampler_process_sinc(r, step, stereo, out, num_frames, read,    \
+                                   opaque, &sinc8_table[band][0][0], 8, dot); \
+        } else {                                                              \
+            resampler_process_sinc(r, step, stereo, out, num_frames, read,    \
+                                   opaque, &sinc32_table[band][0][0], 32,     \
+                                   dot);                                      \
+        }                                                                     \
+    }
+
+RESAMPLE_SINC_FN(resampler_process_sinc_generic, , resample_dot_generic)
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+
+static inline __attribute__((target("sse2"))) float reduce_sse2(__m128 lo,
+                                                               __m128 hi)
+{
+    __m128 v = _mm_add_ps(lo, hi);
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static inline __attribute__((target("sse2"))) float
+resample_dot_sse2(const float *coeff, const float *x, int taps)
+{
+    __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+
+    for (int k = 0; k < taps; k += 8) {
+        lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(&coeff[k]),
+                                       _mm_loadu_ps(&x[k])));
+        hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(&coeff[k + 4]),
+                                       _mm_loadu_ps(&x[k + 4])));
+    }
+
+    return reduce_sse2(lo, hi);
+}
+
+RESAMPLE_SINC_FN(resampler_process_sinc_sse2, __attribute__((target("sse2"))),
+                 resample_dot_sse2)
+
+#ifdef CONFIG_AVX2_OPT
+static inline __attribute__((target("avx2"))) float
+resample_dot_avx2(const float *coeff, const float *x, int taps)
+{
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int k = 0; k < taps; k += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(&coeff[k]),
+                                               _mm256_loadu_ps(&x[k])));
+    }
+
+    return reduce_sse2(_mm256_castps256_ps128(acc),
+                       _mm256_extractf128_ps(acc, 1));
+}
+
+RESAMPLE_SINC_FN(resampler_process_sinc_avx2, __attribute__((target("avx2"))),
+                 resample_dot_avx2)
+#endif /* CONFIG_AVX2_OPT */
+
+#elif defined(__ARM_NEON)
+
+static inline float resample_dot_neon(const float *coeff, const float *x,
+                                      int taps)
+{
+    float32x4_t lo = vdupq_n_f32(0), hi = vdupq_n_f32(0);
+
+    for (int k = 0; k < taps; k += 8) {
+        lo = vaddq_f32(lo, vmulq_f32(vld1q_f32(&coeff[k]), vld1q_f32(&x[k])));
+        hi = vaddq_f32(hi, vmulq_f32(vld1q_f32(&coeff[k + 4]),
+                                     vld1q_f32(&x[k + 4])));
+    }
+
+    float32x4_t v = vaddq_f32(lo, hi);
+    float32x2_t h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(h, 0) + vget_lane_f32(h, 1);
+}
+
+RESAMPLE_SINC_FN(resampler_process_sinc_neon, , resample_dot_neon)
+
+#endif
+
+typedef void (*ResampleProcessFn)(Resampler *r, uint64_t step, int band,
+                                  bool stereo, float out[][2], int num_frames,
+                                  ResampleReadFn read, void *opaque);
+
+static ResampleProcessFn resampler_process_sinc_accel =
+    resampler_process_sinc_generic;
+
+static void __attribute__((constructor)) init_resample_accel(void)
+{
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+    unsigned info = cpuinfo_init();
+
+#ifdef CONFIG_AVX2_OPT
+    if (info & CPUINFO_AVX2) {
+        resampler_process_sinc_accel = resampler_process_sinc_avx2;
+        return;
+    }
+#endif
+    if (info & CPUINFO_SSE2) {
+        resampler_process_sinc_accel = resampler_process_sinc_sse2;
+    }
+#elif defined(__ARM_NEON)
+    resampler_process_sinc_accel = resampler_process_sinc_neon;
+#endif
+}
+
+int resampler_process(Resampler *r, double ratio, bool stereo,
+                      float out[][2], int num_frames, ResampleReadFn read,
+                      void *opaque)
+{
+    if (!isfinite(ratio) || ratio < RESAMPLE_MIN_RATIO) {
+        return -1;
+    }
+
+    uint64_t step = llround(ldexp(1.0 / ratio, 32));
+
+    if (r->quality == RESAMPLE_QUALITY_LINEAR) {
+        resampler_process_linear(r, step, stereo, out, num_frames, read,
+                                 opaque);
+    } else {
+        resampler_process_sinc_accel(r, step, resampler_cutoff_band(ratio),
+                                     stereo, out, num_frames, read, opaque);
+    }
+
+    return num_frames;
+}
@@ -0,0 +1,71 @@
+/*
+ * Voice Resampler
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_XBOX_MCPX_RESAMPLE_H
+#define HW_XBOX_MCPX_RESAMPLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RESAMPLE_MAX_TAPS   32
+#define RESAMPLE_BUF_FRAMES 128
+#define RESAMPLE_READ_CHUNK 32
+#define RESAMPLE_MIN_RATIO  (1.0 / 65536)
+
+typedef enum ResampleQuality {
+    RESAMPLE_QUALITY_LINEAR,
+    RESAMPLE_QUALITY_SINC8,
+    RESAMPLE_QUALITY_SINC32,
+} ResampleQuality;
+
+/*
+ * Supplies up to max_frames of interleaved stereo input, returning the number
+ * of frames written. Returning 0 means the source has run dry, and silence is
+ * used instead.
+ */
+typedef int (*ResampleReadFn)(void *opaque, float frames[][2], int max_frames);
+
+/*
+ * Polyphase resampler with a 32.32 fixed-point input position. Input is kept
+ * in planar form, oldest frame first, so each output sample is a dot product
+ * of contiguous memory.
+ */
+typedef struct Resampler {
+    ResampleQuality quality;
+    int taps;
+    int pos; // Input frame at or before the current position
+    uint32_t frac; // Position between pos and pos + 1
+    int len; // Frames in buf
+    float buf[2][RESAMPLE_BUF_FRAMES];
+} Resampler;
+
+void resampler_init(Resampler *r, ResampleQuality quality);
+void resampler_reset(Resampler *r);
+
+/*
+ * Produces num_frames of output, consuming input at 1 / ratio frames per
+ * output frame. Only the left channel is computed for mono input, the right
+ * one is zero. Returns num_frames, or -1 without producing output if ratio is
+ * not finite or below RESAMPLE_MIN_RATIO.
+ */
+int resampler_process(Resampler *r, double ratio, bool stereo,
+                      float out[][2], int num_frames, ResampleReadFn read,
+                      void *opaque);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Batched low pass SV filter
+ *
+ * Adapted from SWH LADSPA Plugins package, modified for xemu
+ *
+ * Source:  https://github.com/swh/ladspa/blob/master/svf_1214.xml
+ * Author:  Steve Harris, andy@vellocet
+ * License: GPLv2
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "svf.h"
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+#include "host/cpuinfo.h"
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define SVF_MAX_LANES (SVF_MAX_BATCH * 2)
+
+/*
+ * Structure-of-arrays state for a batch: lane 2*k+ch holds channel ch of
+ * voice k. Unused lanes up to the kernel width are zero and stay zero.
+ */
+typedef struct SvfLanes {
+    float f[SVF_MAX_LANES] QEMU_ALIGNED(32);
+    float q[SVF_MAX_LANES] QEMU_ALIGNED(32);
+    float qnrm[SVF_MAX_LANES] QEMU_ALIGNED(32);
+    float h[SVF_MAX_LANES] QEMU_ALIGNED(32);
+    float b[SVF_MAX_LANES] QEMU_ALIGNED(32);
+    float l[SVF_MAX_LANES] QEMU_ALIGNED(32);
+    float x[SVF_SAMPLES_PER_FRAME][SVF_MAX_LANES] QEMU_ALIGNED(32);
+} SvfLanes;
+
+/*
+ * Every kernel evaluates the same expressions as run_svf_stereo in the same
+ * order, without fused multiply-add, so results are bit-identical.
+ */
+typedef void (*SvfBatchFn)(SvfLanes *s, int num_lanes);
+
+static void run_svf_lanes_generic(SvfLanes *s, int num_lanes)
+{
+    for (int i = 0; i < SVF_SAMPLES_PER_FRAME; i++) {
+        for (int j = 0; j < num_lanes; j++) {
+            float in = s->qnrm[j] * s->x[i][j];
+            float b = s->b[j], l = s->l[j], h;
+
+            b = b - b * b * b * 0.001f;
+            h = in - l - s->q[j] * b;
+            b = b + s->f[j] * h;
+            l = l + s->f[j] * b;
+
+            s->h[j] = h;
+            s->b[j] = b;
+            s->l[j] = l;
+            s->x[i][j] = fminf(fmaxf(l, -1.0f), 1.0f);
+        }
+    }
+}
+
+static SvfBatchFn run_svf_lanes_accel = run_svf_lanes_generic;
+static int svf_lane_width = 1;
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+
+static void __attribute__((target("sse2")))
+run_svf_lanes_sse2(SvfLanes *s, int num_lanes)
+{
+    const __m128 k = _mm_set1_ps(0.001f);
+    const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f);
+
+    for (int j = 0; j < num_lanes; j += 4) {
+        __m128 f = _mm_load_ps(&s->f[j]);
+        __m128 q = _mm_load_ps(&s->q[j]);
+        __m128 qnrm = _mm_load_ps(&s->qnrm[j]);
+        __m128 h = _mm_load_ps(&s->h[j]);
+        __m128 b = _mm_load_ps(&s->b[j]);
+        __m128 l = _mm_load_ps(&s->l[j]);
+
+        for (int i = 0; i < SVF_SAMPLES_PER_FRAME; i++) {
+            __m128 in = _mm_mul_ps(qnrm, _mm_load_ps(&s->x[i][j]));
+            b = _mm_sub_ps(b, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(b, b), b), k));
+            h = _mm_sub_ps(_mm_sub_ps(in, l), _mm_mul_ps(q, b));
+            b = _mm_add_ps(b, _mm_mul_ps(f, h));
+            l = _mm_add_ps(l, _mm_mul_ps(f, b));
+            /* maxps returns the second operand for NaN, like fmaxf */
+            _mm_store_ps(&s->x[i][j], _mm_min_ps(_mm_max_ps(l, lo), hi));
+        }
+
+        _mm_store_ps(&s->h[j], h);
+        _mm_store_ps(&s->b[j], b);
+        _mm_store_ps(&s->l[j], l);
+    }
+}
+
+#ifdef CONFIG_AVX2_OPT
+static void __attribute__((target("avx2")))
+run_svf_lanes_avx2(SvfLanes *s, int num_lanes)
+{
+    const __m256 k = _mm256_set1_ps(0.001f);
+    const __m256 lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(1.0f);
+
+    for (int j = 0; j < num_lanes; j += 8) {
+        __m256 f = _mm256_load_ps(&s->f[j]);
+        __m256 q = _mm256_load_ps(&s->q[j]);
+        __m256 qnrm = _mm256_load_ps(&s->qnrm[j]);
+        __m256 h = _mm256_load_ps(&s->h[j]);
+        __m256 b = _mm256_load_ps(&s->b[j]);
+        __m256 l = _mm256_load_ps(&s->l[j]);
+
+        for (int i = 0; i < SVF_SAMPLES_PER_FRAME; i++) {
+            __m256 in = _mm256_mul_ps(qnrm, _mm256_load_ps(&s->x[i][j]));
+            b = _mm256_sub_ps(
+                b, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(b, b), b), k));
+            h = _mm256_sub_ps(_mm256_sub_ps(in, l), _mm256_mul_ps(q, b));
+            b = _mm256_add_ps(b, _mm256_mul_ps(f, h));
+            l = _mm256_add_ps(l, _mm256_mul_ps(f, b));
+            _mm256_store_ps(&s->x[i][j],
+                            _mm256_min_ps(_mm256_max_ps(l, lo), hi));
+        }
+
+        _mm256_store_ps(&s->h[j], h);
+        _mm256_store_ps(&s->b[j], b);
+        _mm256_store_ps(&s->l[j], l);
+    }
+}
+#endif /* CONFIG_AVX2_OPT */
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+static void run_svf_lanes_neon(SvfLanes *s, int num_lanes)
+{
+    const float32x4_t k = vdupq_n_f32(0.001f);
+    const float32x4_t lo = vdupq_n_f32(-1.0f), hi = vdupq_n_f32(1.0f);
+
+    for (int j = 0; j < num_lanes; j += 4) {
+        float32x4_t f = vld1q_f32(&s->f[j]);
+        float32x4_t q = vld1q_f32(&s->q[j]);
+        float32x4_t qnrm = vld1q_f32(&s->qnrm[j]);
+        float32x4_t h = vld1q_f32(&s->h[j]);
+        float32x4_t b = vld1q_f32(&s->b[j]);
+        float32x4_t l = vld1q_f32(&s->l[j]);
+
+        for (int i = 0; i < SVF_SAMPLES_PER_FRAME; i++) {
+            float32x4_t in = vmulq_f32(qnrm, vld1q_f32(&s->x[i][j]));
+            b = vsubq_f32(b, vmulq_f32(vmulq_f32(vmulq_f32(b, b), b), k));
+            h = vsubq_f32(vsubq_f32(in, l), vmulq_f32(q, b));
+            b = vaddq_f32(b, vmulq_f32(f, h));
+            l = vaddq_f32(l, vmulq_f32(f, b));
+            /* maxnm/minnm ignore NaN operands, like fmaxf/fminf */
+            vst1q_f32(&s->x[i][j], vminnmq_f32(vmaxnmq_f32(l, lo), hi));
+        }
+
+        vst1q_f32(&s->h[j], h);
+        vst1q_f32(&s->b[j], b);
+        vst1q_f32(&s->l[j], l);
+    }
+}
+
+#endif
+
+static void __attribute__((constructor)) init_svf_accel(void)
+{
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+    unsigned info = cpuinfo_init();
+
+#ifdef CONFIG_AVX2_OPT
+    if (info & CPUINFO_AVX2) {
+        run_svf_lanes_accel = run_svf_lanes_avx2;
+        svf_lane_width = 8;
+        return;
+    }
+#endif
+    if (info & CPUINFO_SSE2) {
+        run_svf_lanes_accel = run_svf_lanes_sse2;
+        svf_lane_width = 4;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    run_svf_lanes_accel = run_svf_lanes_neon;
+    svf_lane_width = 4;
+#endif
+}
+
+void run_svf_batch(sv_filter *const sv[], float (*const samples[])[2],
+                   int num_voices)
+{
+    SvfLanes s;
+    int num_lanes, j;
+
+    assert(num_voices > 0 && num_voices <= SVF_MAX_BATCH);
+
+    num_lanes = ROUND_UP(num_voices * 2, svf_lane_width);
+    memset(&s, 0, sizeof(s));
+
+    for (j = 0; j < num_voices * 2; j++) {
+        const sv_filter *f = &sv[j / 2][j % 2];
+
+        assert(f->t == F_LP);
+        s.f[j] = f->f;
+        s.q[j] = f->q;
+        s.qnrm[j] = f->qnrm;
+        s.h[j] = f->h;
+        s.b[j] = f->b;
+        s.l[j] = f->l;
+        for (int i = 0; i < SVF_SAMPLES_PER_FRAME; i++) {
+            s.x[i][j] = samples[j / 2][i][j % 2];
+        }
+    }
+
+    run_svf_lanes_accel(&s, num_lanes);
+
+    for (j = 0; j < num_voices * 2; j++) {
+        sv_filter *f = &sv[j / 2][j % 2];
+
+        f->h = s.h[j];
+        f->b = s.b[j];
+        f->l = s.l[j];
+        f->n = s.l[j] + s.h[j];
+        f->p = s.l[j] - s.h[j];
+        for (int i = 0; i < SVF_SAMPLES_PER_FRAME; i++) {
+            samples[j / 2][i][j % 2] = s.x[i][j];
+        }
+    }
+}
@@ -12,6 +12,8 @@
 
 #include <math.h>
 
+#include "hw/xbox/mcpx/apu/apu_regs.h"
+
 #define flush_to_zero(x) x
 
 // Constants to match filter types
@@ -36,6 +38,7 @@ typedef struct {
     float p;     // peaking output (allpass with resonance)
     float n;     // notch output
     float *op;   // pointer to output value
+    int t;       // filter type
 } sv_filter;
 
 /* Store data in SVF struct, takes the sampling frequency, cutoff frequency
@@ -49,6 +52,7 @@ static inline void setup_svf(sv_filter *sv, float fc, float q, int t) {
     sv->f = fc;
     sv->q = q;
     sv->qnrm = sqrt(sv->q/2.0+0.01);
+    sv->t = t;
     switch(t) {
     case F_LP:
         sv->op = &(sv->l);
@@ -88,4 +92,58 @@ static inline float run_svf(sv_filter *sv, float in) {
     return out;
 }
 
+/* Run a frame through the filters of both channels in lockstep, keeping the
+   state in registers, then clamp to [-1, 1]. Matches run_svf per channel. */
+static inline void run_svf_stereo(sv_filter sv[2], float samples[][2],
+                                  int num_samples) {
+    float h[2], b[2], l[2];
+    int i, ch, r;
+
+    for (ch = 0; ch < 2; ch++) {
+        h[ch] = sv[ch].h;
+        b[ch] = sv[ch].b;
+        l[ch] = sv[ch].l;
+    }
+
+    for (i = 0; i < num_samples; i++) {
+        for (ch = 0; ch < 2; ch++) {
+            float in = sv[ch].qnrm * samples[i][ch];
+            float out;
+            for (r = 0; r < F_R; r++) {
+                b[ch] = flush_to_zero(b[ch] - b[ch] * b[ch] * b[ch] * 0.001f);
+                h[ch] = flush_to_zero(in - l[ch] - sv[ch].q * b[ch]);
+                b[ch] = b[ch] + sv[ch].f * h[ch];
+                l[ch] = flush_to_zero(l[ch] + sv[ch].f * b[ch]);
+                switch (sv[ch].t) {
+                case F_LP: out = l[ch]; break;
+                case F_HP: out = h[ch]; break;
+                case F_BP: out = b[ch]; break;
+                case F_BR: out = l[ch] + h[ch]; break;
+                default:   out = l[ch] - h[ch]; break;
+                }
+                in = out;
+            }
+            samples[i][ch] = fminf(fmaxf(out, -1.0f), 1.0f);
+        }
+    }
+
+    for (ch = 0; ch < 2; ch++) {
+        sv[ch].h = h[ch];
+        sv[ch].b = b[ch];
+        sv[ch].l = l[ch];
+        sv[ch].n = l[ch] + h[ch];
+        sv[ch].p = l[ch] - h[ch];
+    }
+}
+
+/* Most voices run_svf_batch() filters together */
+#define SVF_MAX_BATCH 8
+#define SVF_SAMPLES_PER_FRAME NUM_SAMPLES_PER_FRAME
+
+/* Run the low pass filters of up to SVF_MAX_BATCH stereo voices, with the
+   channels of all voices side by side in vector lanes. Voice k uses the
+   filters sv[k][0..1] on samples[k]. Matches run_svf_stereo per voice. */
+void run_svf_batch(sv_filter *const sv[], float (*const samples[])[2],
+                   int num_voices);
+
 #endif
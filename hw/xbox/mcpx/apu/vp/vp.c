@@ -20,8 +20,17 @@
  */
 
 #include "hw/xbox/mcpx/apu/apu_int.h"
+#include "qemu/processor.h"
+#include "qemu/bitmap.h"
 #include "adpcm.h"
 
+/* Bounds for the adaptive spin before a voice worker or dispatcher parks */
+#define VOICE_WORK_SPIN_MIN 16
+#define VOICE_WORK_SPIN_MAX 2048
+
+/* Voices a worker holds back to batch their low pass filters */
+#define VOICE_WORK_MAX_PENDING (SVF_MAX_BATCH * 2)
+
 static const struct {
     hwaddr top, current, next;
 } voice_list_regs[] = {
@@ -56,9 +65,7 @@ static void voice_reset_filters(MCPXAPUState *d, uint16_t v)
     assert(v < MCPX_HW_MAX_VOICES);
     memset(&d->vp.filters[v].svf, 0, sizeof(d->vp.filters[v].svf));
     hrtf_filter_clear_history(&d->vp.filters[v].hrtf);
-    if (d->vp.filters[v].resampler) {
-        src_reset(d->vp.filters[v].resampler);
-    }
+    resampler_reset(&d->vp.filters[v].resampler);
 }
 
 static bool voice_should_mute(uint16_t v)
@@ -97,22 +104,80 @@ static float attenuate(uint16_t vol)
     return (vol == 0xFFF) ? 0.0 : powf(10.0f, vol/(64.0 * -20.0f));
 }
 
+/*
+ * Voice descriptors are only written by the front end, so they are read from
+ * guest memory once and kept on the host. Guest memory is refreshed whenever a
+ * field changes, since software reads back state such as CBO and envelopes.
+ * Software may write descriptors directly while a voice is locked, so they are
+ * reloaded when it is unlocked or turned on.
+ */
+static void voice_cache_sync_base(MCPXAPUState *d)
+{
+    hwaddr base = qatomic_read(&d->regs[NV_PAPU_VPVADDR]);
+
+    if (d->vp.voice_cache.base != base) {
+        d->vp.voice_cache.base = base;
+        memset(d->vp.voice_cache.valid, 0, sizeof(d->vp.voice_cache.valid));
+    }
+}
+
+static void voice_cache_invalidate(MCPXAPUState *d, uint16_t v)
+{
+    if (v < MCPX_HW_MAX_VOICES) {
+        d->vp.voice_cache.valid[v] = false;
+    }
+}
+
+static uint32_t *voice_cache_get(MCPXAPUState *d, uint16_t v)
+{
+    uint32_t *regs = d->vp.voice_cache.regs[v];
+
+    if (!d->vp.voice_cache.valid[v]) {
+        hwaddr voice = d->vp.voice_cache.base + v * NV_PAVS_SIZE;
+        address_space_read(&address_space_memory, voice,
+                           MEMTXATTRS_UNSPECIFIED, regs, NV_PAVS_SIZE);
+        for (int i = 0; i < NV_PAVS_SIZE / 4; i++) {
+            regs[i] = le32_to_cpu(regs[i]);
+        }
+        d->vp.voice_cache.valid[v] = true;
+    }
+
+    return regs;
+}
+
 static uint32_t voice_get_mask(MCPXAPUState *d, uint16_t voice_handle,
                                hwaddr offset, uint32_t mask)
 {
-    hwaddr voice = d->regs[NV_PAPU_VPVADDR] + voice_handle * NV_PAVS_SIZE;
-    return (ldl_le_phys(&address_space_memory, voice + offset) & mask) >>
-           ctz32(mask);
+    uint32_t val;
+
+    if (voice_handle < MCPX_HW_MAX_VOICES) {
+        val = voice_cache_get(d, voice_handle)[offset / 4];
+    } else {
+        hwaddr voice = d->vp.voice_cache.base + voice_handle * NV_PAVS_SIZE;
+        val = ldl_le_phys(&address_space_memory, voice + offset);
+    }
+
+    return (val & mask) >> ctz32(mask);
 }
 
 static void voice_set_mask(MCPXAPUState *d, uint16_t voice_handle,
                            hwaddr offset, uint32_t mask, uint32_t val)
 {
-    hwaddr voice = d->regs[NV_PAPU_VPVADDR]
-                    + voice_handle * NV_PAVS_SIZE;
-    uint32_t v = ldl_le_phys(&address_space_memory, voice + offset) & ~mask;
-    stl_le_phys(&address_space_memory, voice + offset,
-                v | ((val << ctz32(mask)) & mask));
+    hwaddr voice = d->vp.voice_cache.base + voice_handle * NV_PAVS_SIZE;
+
+    if (voice_handle >= MCPX_HW_MAX_VOICES) {
+        uint32_t v = ldl_le_phys(&address_space_memory, voice + offset) & ~mask;
+        stl_le_phys(&address_space_memory, voice + offset,
+                    v | ((val << ctz32(mask)) & mask));
+        return;
+    }
+
+    uint32_t *reg = &voice_cache_get(d, voice_handle)[offset / 4];
+    uint32_t v = (*reg & ~mask) | ((val << ctz32(mask)) & mask);
+    if (v != *reg) {
+        *reg = v;
+        stl_le_phys(&address_space_memory, voice + offset, v);
+    }
 }
 
 static void voice_off(MCPXAPUState *d, uint16_t v)
@@ -134,7 +199,6 @@ static void voice_off(MCPXAPUState *d, uint16_t v)
 static void voice_lock(MCPXAPUState *d, uint16_t v, bool lock)
 {
     assert(v < MCPX_HW_MAX_VOICES);
-    qemu_mutex_lock(&d->lock);
 
     uint64_t mask = 1LL << (v % 64);
     if (lock) {
@@ -144,7 +208,6 @@ static void voice_lock(MCPXAPUState *d, uint16_t v, bool lock)
     }
 
     qemu_cond_signal(&d->cond);
-    qemu_mutex_unlock(&d->lock);
 }
 
 static bool is_voice_locked(MCPXAPUState *d, uint16_t v)
@@ -161,6 +224,11 @@ static void set_hrir_coeff_tar(MCPXAPUState *d, int channel, int coeff_idx,
     d->vp.hrtf.entries[entry].hrir[channel][coeff_idx] = int8_to_float(value);
 }
 
+/*
+ * Must be called with the APU lock held, which keeps FE updates to the voice
+ * descriptor cache from racing the frame and its voice workers. Methods from
+ * the PIO window are queued and applied through mcpx_apu_vp_apply_fe_queue.
+ */
 static void fe_method(MCPXAPUState *d, uint32_t method, uint32_t argument)
 {
     unsigned int slot;
@@ -171,9 +239,14 @@ static void fe_method(MCPXAPUState *d, uint32_t method, uint32_t argument)
 
     d->regs[NV_PAPU_FEDECMETH] = method;
     d->regs[NV_PAPU_FEDECPARAM] = argument;
+    voice_cache_sync_base(d);
+
     unsigned int selected_handle, list;
     switch (method) {
     case NV1BA0_PIO_VOICE_LOCK:
+        if (!(argument & 1)) {
+            voice_cache_invalidate(d, d->regs[NV_PAPU_FECV]);
+        }
         voice_lock(d, d->regs[NV_PAPU_FECV], argument & 1);
         break;
     case NV1BA0_PIO_SET_ANTECEDENT_VOICE:
@@ -187,6 +260,7 @@ static void fe_method(MCPXAPUState *d, uint32_t method, uint32_t argument)
         if (!locked) {
             voice_lock(d, selected_handle, true);
         }
+        voice_cache_invalidate(d, selected_handle);
 
         list = GET_MASK(d->regs[NV_PAPU_FEAV], NV_PAPU_FEAV_LST);
         if (list != NV1BA0_PIO_SET_ANTECEDENT_VOICE_LIST_INHERIT) {
@@ -574,6 +648,25 @@ static void fe_method(MCPXAPUState *d, uint32_t method, uint32_t argument)
     }
 }
 
+/*
+ * Applies the methods written through the PIO window since the last call.
+ * Must be called with the APU lock held.
+ */
+void mcpx_apu_vp_apply_fe_queue(MCPXAPUState *d)
+{
+    qemu_mutex_lock(&d->vp.fe_queue.lock);
+    GArray *methods = d->vp.fe_queue.pending;
+    d->vp.fe_queue.pending = d->vp.fe_queue.applying;
+    d->vp.fe_queue.applying = methods;
+    qemu_mutex_unlock(&d->vp.fe_queue.lock);
+
+    for (int i = 0; i < methods->len; i++) {
+        MCPXAPUFEMethod *m = &g_array_index(methods, MCPXAPUFEMethod, i);
+        fe_method(d, m->method, m->argument);
+    }
+    g_array_set_size(methods, 0);
+}
+
 static uint64_t vp_read(void *opaque, hwaddr addr, unsigned int size)
 {
     DPRINTF("mcpx apu VP: read [0x%" HWADDR_PRIx "] (%s)\n", addr,
@@ -643,9 +736,23 @@ static void vp_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
     case NV1BA0_PIO_SET_HRTF_HEADROOM:
     case NV1BA0_PIO_SET_SUBMIX_HEADROOM ...
          NV1BA0_PIO_SET_SUBMIX_HEADROOM+4*(NUM_MIXBINS-1):
-        /* TODO: these should instead be queueing up fe commands */
-        fe_method(d, addr, val);
+    {
+        MCPXAPUFEMethod m = { .method = addr, .argument = val };
+        qemu_mutex_lock(&d->vp.fe_queue.lock);
+        g_array_append_val(d->vp.fe_queue.pending, m);
+        qemu_mutex_unlock(&d->vp.fe_queue.lock);
+
+        /*
+         * Software may write the descriptor of a locked voice as soon as the
+         * method is accepted, so a lock must wait for the frame to finish.
+         */
+        if (addr == NV1BA0_PIO_VOICE_LOCK && (val & 1)) {
+            qemu_mutex_lock(&d->lock);
+            mcpx_apu_vp_apply_fe_queue(d);
+            qemu_mutex_unlock(&d->lock);
+        }
         break;
+    }
 
     case NV1BA0_PIO_GET_VOICE_POSITION:
     case NV1BA0_PIO_SET_CONTEXT_DMA_NOTIFY:
@@ -675,6 +782,91 @@ static hwaddr get_data_ptr(hwaddr sge_base, unsigned int max_sge, uint32_t addr)
     return prd_address + addr % TARGET_PAGE_SIZE;
 }
 
+static void read_sge_data(MCPXAPUState *d, uint32_t addr, void *buf,
+                          size_t len)
+{
+    uint8_t *out = buf;
+
+    while (len > 0) {
+        size_t chunk = MIN(len, TARGET_PAGE_SIZE - addr % TARGET_PAGE_SIZE);
+        address_space_read(&address_space_memory,
+                           get_data_ptr(d->regs[NV_PAPU_VPSGEADDR], 0xFFFFFFFF,
+                                        addr),
+                           MEMTXATTRS_UNSPECIFIED, out, chunk);
+        out += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+}
+
+/*
+ * Decoded ADPCM blocks are cached by guest address and channel count, so
+ * looping voices and voices sharing a buffer decode each block once. Pages
+ * holding cached blocks are checked for guest writes through the APU dirty
+ * memory client at the start of every frame, before any voice runs, and
+ * written pages drop their blocks by bumping the page epoch. Blocks are only
+ * decoded while voices run, after their page was last checked, so a write
+ * racing the decode is caught by the next check.
+ */
+static void adpcm_cache_invalidate_written(MCPXAPUState *d)
+{
+    size_t num_pages = d->vp.adpcm_cache.num_pages;
+    unsigned long *pages_used = d->vp.adpcm_cache.pages_used;
+
+    for (size_t page = find_first_bit(pages_used, num_pages); page < num_pages;
+         page = find_next_bit(pages_used, num_pages, page + 1)) {
+        if (memory_region_test_and_clear_dirty(d->ram,
+                                               page << TARGET_PAGE_BITS,
+                                               TARGET_PAGE_SIZE,
+                                               DIRTY_MEMORY_APU)) {
+            d->vp.adpcm_cache.page_epoch[page]++;
+            clear_bit(page, pages_used);
+        }
+    }
+}
+
+static void adpcm_cache_reset(MCPXAPUState *d)
+{
+    if (!d->vp.adpcm_cache.num_pages) {
+        return;
+    }
+
+    memset(d->vp.adpcm_cache.entries, 0,
+           sizeof(MCPXAPUADPCMCacheEntry) << MCPX_APU_ADPCM_CACHE_BITS);
+    bitmap_zero(d->vp.adpcm_cache.pages_used, d->vp.adpcm_cache.num_pages);
+}
+
+static bool adpcm_cache_can_hold(MCPXAPUState *d, hwaddr addr,
+                                 size_t block_size)
+{
+    return addr % TARGET_PAGE_SIZE + block_size <= TARGET_PAGE_SIZE &&
+           (addr >> TARGET_PAGE_BITS) < d->vp.adpcm_cache.num_pages;
+}
+
+/* Decodes the block at guest address addr, which must be in a single page */
+static void voice_decode_adpcm_block(MCPXAPUState *d, hwaddr addr,
+                                     size_t block_size, unsigned int channels,
+                                     int16_t *decoded)
+{
+    size_t page = addr >> TARGET_PAGE_BITS;
+    uint32_t hash = (addr * 0x9E3779B97F4A7C15ULL) >>
+                    (64 - MCPX_APU_ADPCM_CACHE_BITS);
+    MCPXAPUADPCMCacheEntry *e = &d->vp.adpcm_cache.entries[hash];
+
+    qemu_mutex_lock(&d->vp.adpcm_cache.lock);
+    uint32_t epoch = d->vp.adpcm_cache.page_epoch[page];
+    if (e->addr != addr || e->channels != channels || e->epoch != epoch) {
+        adpcm_decode_block(e->decoded, &d->ram_ptr[addr], block_size,
+                           channels);
+        e->addr = addr;
+        e->channels = channels;
+        e->epoch = epoch;
+        set_bit(page, d->vp.adpcm_cache.pages_used);
+    }
+    memcpy(decoded, e->decoded, 65 * channels * sizeof(int16_t));
+    qemu_mutex_unlock(&d->vp.adpcm_cache.lock);
+}
+
 static float voice_step_envelope(MCPXAPUState *d, uint16_t v, uint32_t reg_0,
                            uint32_t reg_a, uint32_t rr_reg, uint32_t rr_mask,
                            uint32_t lvl_reg, uint32_t lvl_mask,
@@ -885,8 +1077,7 @@ static int voice_get_samples(MCPXAPUState *d, uint32_t v, float samples[][2],
     size_t block_size;
 
     int adpcm_block_index = -1;
-    uint32_t adpcm_block[36*2/4];
-    int16_t adpcm_decoded[65*2]; // FIXME: Move out of here
+    int16_t adpcm_decoded[65 * 2];
 
     // FIXME: Only update if necessary
     struct McpxApuDebugVoice *dbg = &g_dbg.vp.v[v];
@@ -1015,25 +1206,32 @@ static int voice_get_samples(MCPXAPUState *d, uint32_t v, float samples[][2],
             unsigned int block_position = cbo % ADPCM_SAMPLES_PER_BLOCK;
             if (adpcm_block_index != block_index) {
                 uint32_t linear_addr = block_index * block_size;
+                uint8_t adpcm_block[36 * 2];
+                assert(block_size <= sizeof(adpcm_block));
+                hwaddr addr;
                 if (stream) {
-                    hwaddr addr = segment_offset + linear_addr;
+                    addr = segment_offset + linear_addr;
                     int max_seg_byte = (seg_len >> 6) * block_size;
                     assert(linear_addr + block_size <= max_seg_byte);
-                    memcpy(adpcm_block, &d->ram_ptr[addr],
-                           block_size); // FIXME: Use idiomatic DMA function
                 } else {
-                    linear_addr += ba;
-                    for (unsigned int word_index = 0;
-                         word_index < (9 * samples_per_block); word_index++) {
-                        hwaddr addr = get_data_ptr(d->regs[NV_PAPU_VPSGEADDR],
-                                                   0xFFFFFFFF, linear_addr);
-                        adpcm_block[word_index] =
-                            ldl_le_phys(&address_space_memory, addr);
-                        linear_addr += 4;
+                    addr = get_data_ptr(d->regs[NV_PAPU_VPSGEADDR],
+                                        0xFFFFFFFF, ba + linear_addr);
+                }
+                if (adpcm_cache_can_hold(d, addr, block_size)) {
+                    voice_decode_adpcm_block(d, addr, block_size, channels,
+                                             adpcm_decoded);
+                } else {
+                    /* Straddles a page, too rare to be worth caching */
+                    if (stream) {
+                        memcpy(adpcm_block, &d->ram_ptr[addr],
+                               block_size); // FIXME: Use idiomatic DMA function
+                    } else {
+                        read_sge_data(d, ba + linear_addr, adpcm_block,
+                                      block_size);
                     }
+                    adpcm_decode_block(adpcm_decoded, adpcm_block, block_size,
+                                       channels);
                 }
-                adpcm_decode_block(adpcm_decoded, (uint8_t *)adpcm_block,
-                                   block_size, channels);
                 adpcm_block_index = block_index;
             }
 
@@ -1119,74 +1317,58 @@ static int voice_get_samples(MCPXAPUState *d, uint32_t v, float samples[][2],
     return sample_count;
 }
 
-static long voice_resample_callback(void *cb_data, float **data)
+static int voice_resample_read(void *opaque, float frames[][2], int max_frames)
 {
-    MCPXAPUVoiceFilter *filter = cb_data;
+    MCPXAPUVoiceFilter *filter = opaque;
     uint16_t v = filter->voice;
     assert(v < MCPX_HW_MAX_VOICES);
     MCPXAPUState *d = container_of(filter, MCPXAPUState, vp.filters[v]);
 
     int sample_count = 0;
-    while (sample_count < NUM_SAMPLES_PER_FRAME) {
+    while (sample_count < max_frames) {
         int active = voice_get_mask(d, v, NV_PAVS_VOICE_PAR_STATE,
                                     NV_PAVS_VOICE_PAR_STATE_ACTIVE_VOICE);
         if (!active) {
             break;
         }
-        int count = voice_get_samples(
-            d, v, (float(*)[2]) & filter->resample_buf[2 * sample_count],
-            NUM_SAMPLES_PER_FRAME - sample_count);
+        int count = voice_get_samples(d, v, &frames[sample_count],
+                                      max_frames - sample_count);
         if (count < 0) {
             break;
         }
         sample_count += count;
     }
 
-    if (sample_count < NUM_SAMPLES_PER_FRAME) {
-        /* Starvation causes SRC hang on repeated calls. Provide silence. */
-        memset(&filter->resample_buf[2*sample_count], 0,
-            2*(NUM_SAMPLES_PER_FRAME-sample_count)*sizeof(float));
-        sample_count = NUM_SAMPLES_PER_FRAME;
-    }
-
-    *data = filter->resample_buf;
     return sample_count;
 }
 
 static int voice_resample(MCPXAPUState *d, uint16_t v, float samples[][2],
                           int requested_num, float rate)
 {
+    static const ResampleQuality qualities[CONFIG_AUDIO_VP_RESAMPLER__COUNT] = {
+        [CONFIG_AUDIO_VP_RESAMPLER_LINEAR] = RESAMPLE_QUALITY_LINEAR,
+        [CONFIG_AUDIO_VP_RESAMPLER_SINC8] = RESAMPLE_QUALITY_SINC8,
+        [CONFIG_AUDIO_VP_RESAMPLER_SINC32] = RESAMPLE_QUALITY_SINC32,
+    };
+
     assert(v < MCPX_HW_MAX_VOICES);
     MCPXAPUVoiceFilter *filter = &d->vp.filters[v];
+    ResampleQuality quality = qualities[g_config.audio.vp.resampler];
 
-    if (filter->resampler == NULL) {
-        filter->voice = v;
-        int err;
-
-        /* Note: Using a sinc based resampler for quality. Unsure about
-         * hardware's actual interpolation method; it could just be linear, in
-         * which case using this resampler is overkill, but quality is good
-         * so use it for now.
-         */
-        // FIXME: Don't do 2ch resampling if this is a mono voice
-        filter->resampler = src_callback_new(&voice_resample_callback,
-                                           SRC_SINC_FASTEST, 2, &err, filter);
-        if (filter->resampler == NULL) {
-            fprintf(stderr, "src error: %s\n", src_strerror(err));
-            assert(0);
-        }
-    }
-
-    int count = src_callback_read(filter->resampler, rate, requested_num,
-                                  (float *)samples);
-    if (count == -1) {
-        DPRINTF("resample error\n");
+    /* Note: Unsure about hardware's actual interpolation method; it could
+     * just be linear, but the sinc filters sound better so default to them.
+     */
+    if (!filter->resampler.taps || filter->resampler.quality != quality) {
+        resampler_init(&filter->resampler, quality);
     }
-    if (count != requested_num) {
-        DPRINTF("resample returned fewer than expected: %d\n", count);
 
-        if (count == 0)
-            return -1;
+    filter->voice = v;
+    bool stereo = voice_get_mask(d, v, NV_PAVS_VOICE_CFG_FMT,
+                                 NV_PAVS_VOICE_CFG_FMT_STEREO);
+    int count = resampler_process(&filter->resampler, rate, stereo, samples,
+                                  requested_num, voice_resample_read, filter);
+    if (count < 0) {
+        DPRINTF("resample error, rate %f\n", rate);
     }
 
     return count;
@@ -1284,10 +1466,30 @@ static void get_multipass_samples(MCPXAPUState *d,
     dump_multipass_unused_debug_info(d, v);
 }
 
-static void voice_process(MCPXAPUState *d,
-                          float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME],
-                          float sample_buf[NUM_SAMPLES_PER_FRAME][2],
-                          uint16_t v, int voice_list)
+/*
+ * A voice between voice_process_begin() and voice_process_end(). Its low pass
+ * filter is set up but not yet run, so that the filters of several voices can
+ * be run together.
+ */
+typedef struct VoicePending {
+    uint16_t v;
+    int voice_list;
+    unsigned int channels;
+    bool lpf;
+    int bin[8];
+    uint16_t vol[8];
+    float ea_value;
+    float samples[NUM_SAMPLES_PER_FRAME][2];
+} VoicePending;
+
+/*
+ * Fetches the samples of a voice and its mix parameters into `p`. Returns
+ * false if the voice has nothing to mix this frame.
+ */
+static bool
+voice_process_begin(MCPXAPUState *d,
+                    float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME],
+                    uint16_t v, int voice_list, VoicePending *p)
 {
     assert(v < MCPX_HW_MAX_VOICES);
     bool stereo = voice_get_mask(d, v, NV_PAVS_VOICE_CFG_FMT,
@@ -1302,7 +1504,7 @@ static void voice_process(MCPXAPUState *d,
     dbg->paused = paused;
 
     if (paused) {
-        return;
+        return false;
     }
 
     float ef_value = voice_step_envelope(
@@ -1327,7 +1529,8 @@ static void voice_process(MCPXAPUState *d,
     assert(ea_value >= 0.0f);
     assert(ea_value <= 1.0f);
 
-    float samples[NUM_SAMPLES_PER_FRAME][2] = { 0 };
+    float (*samples)[2] = p->samples;
+    memset(p->samples, 0, sizeof(p->samples));
 
     bool multipass = voice_get_mask(d, v, NV_PAVS_VOICE_CFG_FMT,
                                     NV_PAVS_VOICE_CFG_FMT_MULTIPASS);
@@ -1340,7 +1543,7 @@ static void voice_process(MCPXAPUState *d,
             int active = voice_get_mask(d, v, NV_PAVS_VOICE_PAR_STATE,
                                         NV_PAVS_VOICE_PAR_STATE_ACTIVE_VOICE);
             if (!active) {
-                return;
+                return false;
             }
             int count =
                 voice_resample(d, v, &samples[sample_count],
@@ -1355,10 +1558,10 @@ static void voice_process(MCPXAPUState *d,
     int active = voice_get_mask(d, v, NV_PAVS_VOICE_PAR_STATE,
                                 NV_PAVS_VOICE_PAR_STATE_ACTIVE_VOICE);
     if (!active) {
-        return;
+        return false;
     }
 
-    int bin[8];
+    int *bin = p->bin;
     bin[0] = voice_get_mask(d, v, NV_PAVS_VOICE_CFG_VBIN,
                             NV_PAVS_VOICE_CFG_VBIN_V0BIN);
     bin[1] = voice_get_mask(d, v, NV_PAVS_VOICE_CFG_VBIN,
@@ -1383,7 +1586,7 @@ static void voice_process(MCPXAPUState *d,
         bin[3] = d->vp.hrtf_submix[3];
     }
 
-    uint16_t vol[8];
+    uint16_t *vol = p->vol;
     vol[0] = voice_get_mask(d, v, NV_PAVS_VOICE_TAR_VOLA,
                             NV_PAVS_VOICE_TAR_VOLA_VOLUME0);
     vol[1] = voice_get_mask(d, v, NV_PAVS_VOICE_TAR_VOLA,
@@ -1419,7 +1622,7 @@ static void voice_process(MCPXAPUState *d,
     }
 
     if (voice_should_mute(v)) {
-        return;
+        return false;
     }
 
     int fmode = voice_get_mask(d, v, NV_PAVS_VOICE_CFG_MISC,
@@ -1445,15 +1648,35 @@ static void voice_process(MCPXAPUState *d,
                 d, v, NV_PAVS_VOICE_TAR_FCA + (ch % channels) * 4,
                 NV_PAVS_VOICE_TAR_FCA_FC1);
             float q_f = clampf(q / (1.0 * 0x8000), 0.079407f, 1.0f);
-            sv_filter *filter = &d->vp.filters[v].svf[ch];
-            setup_svf(filter, fc_f, q_f, F_LP);
-            for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
-                samples[i][ch] = run_svf(filter, samples[i][ch]);
-                samples[i][ch] = fmin(fmax(samples[i][ch], -1.0), 1.0);
-            }
+            setup_svf(&d->vp.filters[v].svf[ch], fc_f, q_f, F_LP);
         }
     }
 
+    p->v = v;
+    p->voice_list = voice_list;
+    p->channels = channels;
+    p->lpf = lpf;
+    p->ea_value = ea_value;
+    return true;
+}
+
+/*
+ * Mixes a voice begun with voice_process_begin(), after its low pass filter
+ * has been run.
+ */
+static void voice_process_end(MCPXAPUState *d,
+                              float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME],
+                              float sample_buf[NUM_SAMPLES_PER_FRAME][2],
+                              VoicePending *p)
+{
+    uint16_t v = p->v;
+    unsigned int channels = p->channels;
+    const int *bin = p->bin;
+    const uint16_t *vol = p->vol;
+    float ea_value = p->ea_value;
+    float (*samples)[2] = p->samples;
+    struct McpxApuDebugVoice *dbg = &g_dbg.vp.v[v];
+
     if (v < MCPX_HW_MAX_3D_VOICES && g_config.audio.hrtf) {
         uint16_t hrtf_handle =
             voice_get_mask(d, v, NV_PAVS_VOICE_CFG_HRTF_TARGET,
@@ -1498,7 +1721,7 @@ static void voice_process(MCPXAPUState *d,
          */
         int mp_bin = -1;
         uint16_t mp_dst_voice = 0xFFFF;
-        if (voice_list == NV1BA0_PIO_SET_ANTECEDENT_VOICE_LIST_MP_TOP - 1) {
+        if (p->voice_list == NV1BA0_PIO_SET_ANTECEDENT_VOICE_LIST_MP_TOP - 1) {
             mp_bin = peek_ahead_multipass_bin(d, v, &mp_dst_voice);
         }
         dbg->multipass_dst_voice = mp_dst_voice;
@@ -1581,63 +1804,223 @@ static void get_voice_bin_src_dst(MCPXAPUState *d, int v,
     }
 }
 
-static void *voice_worker_thread(void *arg)
+/*
+ * Waits for the dispatcher or the workers to publish `value` at `ptr`. Spins
+ * briefly first, since the other side is often only microseconds away, and
+ * adapts the spin length to how often spinning alone has been enough.
+ */
+static void voice_work_wait(unsigned int *ptr, unsigned int value,
+                            QemuEvent *ev, int *spin_limit)
 {
-    MCPXAPUState *d = arg;
-    VoiceWorkDispatch *vwd = &d->vp.voice_work_dispatch;
+    for (int i = 0; i < *spin_limit; i++) {
+        if (qatomic_load_acquire(ptr) == value) {
+            *spin_limit = MIN(*spin_limit * 2, VOICE_WORK_SPIN_MAX);
+            return;
+        }
+        cpu_relax();
+    }
+    *spin_limit = MAX(*spin_limit / 2, VOICE_WORK_SPIN_MIN);
 
-    rcu_register_thread();
-    qemu_mutex_lock(&vwd->lock);
+    while (qatomic_load_acquire(ptr) != value) {
+        qemu_event_reset(ev);
+        if (qatomic_load_acquire(ptr) == value) {
+            break;
+        }
+        qemu_event_wait(ev);
+    }
+}
 
-    int worker_id = ctz64(vwd->workers_pending);
-    VoiceWorker *self = &d->vp.voice_work_dispatch.workers[worker_id];
-    self->queue_len = 0;
+static void voice_work_signal(unsigned int *ptr, unsigned int value,
+                              QemuEvent *ev)
+{
+    qatomic_store_release(ptr, value);
+    qemu_event_set(ev);
+}
 
-    do {
-        int64_t start_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
-        g_dbg.vp.workers[worker_id].num_voices = self->queue_len;
+static int voice_work_claim_group(VoiceWorker *worker)
+{
+    if (qatomic_read(&worker->next_group) >= worker->num_groups) {
+        return -1;
+    }
+    int i = qatomic_fetch_inc(&worker->next_group);
+    return i < worker->num_groups ? worker->groups[i] : -1;
+}
 
-        if (self->queue_len) {
-            qemu_mutex_unlock(&vwd->lock);
+/*
+ * Runs the low pass filters of the pending voices as one batch, then mixes
+ * the voices in the order they were begun.
+ */
+static void voice_work_flush(MCPXAPUState *d, VoiceWorker *self,
+                             VoicePending *pending, int num_pending)
+{
+    sv_filter *sv[SVF_MAX_BATCH];
+    float (*samples[SVF_MAX_BATCH])[2];
+    int num_lpf = 0;
+
+    for (int i = 0; i < num_pending; i++) {
+        if (pending[i].lpf) {
+            assert(num_lpf < SVF_MAX_BATCH);
+            sv[num_lpf] = d->vp.filters[pending[i].v].svf;
+            samples[num_lpf] = pending[i].samples;
+            num_lpf++;
+        }
+    }
+    if (num_lpf > 0) {
+        run_svf_batch(sv, samples, num_lpf);
+    }
+
+    for (int i = 0; i < num_pending; i++) {
+        voice_process_end(d, self->mixbins, self->sample_buf, &pending[i]);
+    }
+}
+
+/*
+ * Processes the groups claimed from `victim`. Voices are held back until
+ * SVF_MAX_BATCH of them need their low pass filter run, and flushed before a
+ * multipass voice reads the bins its sources mix into.
+ */
+static int voice_work_process_groups(MCPXAPUState *d, VoiceWorker *self,
+                                     VoiceWorker *victim)
+{
+    VoiceWorkDispatch *vwd = &d->vp.voice_work_dispatch;
+    VoicePending pending[VOICE_WORK_MAX_PENDING];
+    int num_pending = 0, num_lpf = 0;
+    int num_voices = 0;
+    int g;
 
-            // Process queued voices
+    while ((g = voice_work_claim_group(victim)) >= 0) {
+        if (!self->has_data) {
             memset(self->mixbins, 0, sizeof(self->mixbins));
             if (d->monitor.point == MCPX_APU_DEBUG_MON_VP) {
                 memset(self->sample_buf, 0, sizeof(self->sample_buf));
             }
-            for (int i = 0; i < self->queue_len; i++) {
-                voice_process(d, self->mixbins, self->sample_buf,
-                              self->queue[i].voice, self->queue[i].list);
+            self->has_data = true;
+        }
+        for (int i = vwd->groups[g].start; i < vwd->groups[g].end; i++) {
+            uint16_t v = vwd->queue[i].voice;
+            VoicePending *p = &pending[num_pending];
+
+            if (num_pending > 0 &&
+                voice_get_mask(d, v, NV_PAVS_VOICE_CFG_FMT,
+                               NV_PAVS_VOICE_CFG_FMT_MULTIPASS)) {
+                voice_work_flush(d, self, pending, num_pending);
+                num_pending = num_lpf = 0;
+                p = &pending[0];
             }
+            num_voices++;
 
-            qemu_mutex_lock(&vwd->lock);
-
-            // Add voice contributions
-            for (int b = 0; b < NUM_MIXBINS; b++) {
-                for (int s = 0; s < NUM_SAMPLES_PER_FRAME; s++) {
-                    vwd->mixbins[b][s] += self->mixbins[b][s];
-                }
+            if (!voice_process_begin(d, self->mixbins, v, vwd->queue[i].list,
+                                     p)) {
+                continue;
             }
-            if (d->monitor.point == MCPX_APU_DEBUG_MON_VP) {
-                for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
-                    d->vp.sample_buf[i][0] += self->sample_buf[i][0];
-                    d->vp.sample_buf[i][1] += self->sample_buf[i][1];
-                }
+            if (!p->lpf && num_pending == 0) {
+                voice_process_end(d, self->mixbins, self->sample_buf, p);
+                continue;
             }
+            num_pending++;
+            num_lpf += p->lpf;
+            if (num_lpf == SVF_MAX_BATCH ||
+                num_pending == VOICE_WORK_MAX_PENDING) {
+                voice_work_flush(d, self, pending, num_pending);
+                num_pending = num_lpf = 0;
+            }
+        }
+    }
+
+    if (num_pending > 0) {
+        voice_work_flush(d, self, pending, num_pending);
+    }
+
+    return num_voices;
+}
+
+static void voice_work_accumulate(MCPXAPUState *d, VoiceWorker *dst,
+                                  VoiceWorker *src)
+{
+    if (!src->has_data) {
+        return;
+    }
+
+    if (!dst->has_data) {
+        memcpy(dst->mixbins, src->mixbins, sizeof(dst->mixbins));
+        memcpy(dst->sample_buf, src->sample_buf, sizeof(dst->sample_buf));
+        dst->has_data = true;
+        return;
+    }
+
+    for (int b = 0; b < NUM_MIXBINS; b++) {
+        for (int s = 0; s < NUM_SAMPLES_PER_FRAME; s++) {
+            dst->mixbins[b][s] += src->mixbins[b][s];
+        }
+    }
+    if (d->monitor.point == MCPX_APU_DEBUG_MON_VP) {
+        for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
+            dst->sample_buf[i][0] += src->sample_buf[i][0];
+            dst->sample_buf[i][1] += src->sample_buf[i][1];
+        }
+    }
+}
+
+/*
+ * Sums worker mixbins up a binary tree into worker 0. The second worker to
+ * arrive at a node adds its sibling's subtree and carries on upwards, so no
+ * worker ever waits on another. The last one signals the dispatcher.
+ */
+static void voice_work_reduce(MCPXAPUState *d, int id)
+{
+    VoiceWorkDispatch *vwd = &d->vp.voice_work_dispatch;
 
-            self->queue_len = 0;
+    for (int level = 0; (1 << level) < vwd->num_workers; level++) {
+        int left = id & ~((2 << level) - 1);
+        int right = left + (1 << level);
+        if (right >= vwd->num_workers) {
+            continue;
         }
+        if (qatomic_fetch_inc(&vwd->workers[right].arrivals) == 0) {
+            return;
+        }
+        voice_work_accumulate(d, &vwd->workers[left], &vwd->workers[right]);
+        id = left;
+    }
 
-        vwd->workers_pending &= ~(1 << worker_id);
-        if (!vwd->workers_pending) {
-            qemu_cond_signal(&vwd->work_finished);
+    voice_work_signal(&vwd->finished_generation,
+                      qatomic_read(&vwd->generation), &vwd->work_finished);
+}
+
+static void *voice_worker_thread(void *arg)
+{
+    VoiceWorker *self = arg;
+    MCPXAPUState *d = self->d;
+    VoiceWorkDispatch *vwd = &d->vp.voice_work_dispatch;
+    unsigned int generation = 0;
+
+    rcu_register_thread();
+    timeline_set_thread_name("VP Worker");
+
+    while (true) {
+        voice_work_wait(&vwd->generation, ++generation, &self->wake,
+                        &self->spin_limit);
+        if (qatomic_read(&vwd->workers_should_exit)) {
+            break;
         }
 
+        int64_t start_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+
+        timeline_begin("Voices");
+        int num_voices = voice_work_process_groups(d, self, self);
+        for (int i = 1; i < vwd->num_workers; i++) {
+            VoiceWorker *victim = &vwd->workers[(self->id + i) %
+                                                vwd->num_workers];
+            num_voices += voice_work_process_groups(d, self, victim);
+        }
+        timeline_end();
+
         int64_t end_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
-        g_dbg.vp.workers[worker_id].time_us = end_time - start_time;
+        g_dbg.vp.workers[self->id].num_voices = num_voices;
+        g_dbg.vp.workers[self->id].time_us = end_time - start_time;
 
-        qemu_cond_wait(&vwd->work_pending, &vwd->lock);
-    } while (!vwd->workers_should_exit);
+        voice_work_reduce(d, self->id);
+    }
 
     rcu_unregister_thread();
     return NULL;
@@ -1661,6 +2044,16 @@ static void voice_work_schedule(MCPXAPUState *d)
     bool group = false;
     uint32_t dirty = 0;
 
+    for (int i = 0; i < vwd->num_workers; i++) {
+        vwd->workers[i].num_groups = 0;
+        vwd->workers[i].next_group = 0;
+        vwd->workers[i].arrivals = 0;
+        vwd->workers[i].has_data = false;
+    }
+
+    vwd->num_groups = 0;
+    int group_start = 0;
+
     for (int i = 0; i < vwd->queue_len; i++) {
         uint32_t src, dst, clr;
         get_voice_bin_src_dst(d, vwd->queue[i].voice, &src, &dst, &clr);
@@ -1686,17 +2079,20 @@ static void voice_work_schedule(MCPXAPUState *d)
             group = true;
         }
 
-        // Assign voice to worker
-        VoiceWorker *worker = &vwd->workers[next_worker_to_schedule];
-        worker->queue[worker->queue_len++] = vwd->queue[i];
-        vwd->workers_pending |= 1 << next_worker_to_schedule;
-
         dirty = (dirty & ~clr) | dst;
         if (clr & MULTIPASS_BIN_MASK) {
             group = false;
         }
 
-        if (!group) {
+        if (!group || i == vwd->queue_len - 1) {
+            // Assign group to worker. Idle workers may steal it later.
+            VoiceWorker *worker = &vwd->workers[next_worker_to_schedule];
+            worker->groups[worker->num_groups++] = vwd->num_groups;
+            vwd->groups[vwd->num_groups++] = (VoiceWorkGroup){
+                .start = group_start,
+                .end = i + 1,
+            };
+            group_start = i + 1;
             next_worker_to_schedule =
                 (next_worker_to_schedule + 1) % vwd->num_workers;
         }
@@ -1735,32 +2131,41 @@ voice_work_dispatch(MCPXAPUState *d,
         }
 
         qemu_cond_timedwait(&d->cond, &d->lock, 1);
+        mcpx_apu_vp_apply_fe_queue(d);
     }
 
-    qemu_mutex_lock(&vwd->lock);
-
     if (vwd->queue_len) {
-        memset(vwd->mixbins, 0, sizeof(vwd->mixbins));
+        voice_work_schedule(d);
 
         // Signal workers and wait for completion
-        voice_work_schedule(d);
-        qemu_cond_broadcast(&vwd->work_pending);
-        qemu_cond_wait(&vwd->work_finished, &vwd->lock);
-        assert(!vwd->workers_pending);
+        unsigned int generation = vwd->generation + 1;
+        qatomic_store_release(&vwd->generation, generation);
+        for (int i = 0; i < vwd->num_workers; i++) {
+            qemu_event_set(&vwd->workers[i].wake);
+        }
+        voice_work_wait(&vwd->finished_generation, generation,
+                        &vwd->work_finished, &vwd->spin_limit);
         vwd->queue_len = 0;
 
         // Add voice contributions
-        for (int b = 0; b < NUM_MIXBINS; b++) {
-            for (int s = 0; s < NUM_SAMPLES_PER_FRAME; s++) {
-                mixbins[b][s] += vwd->mixbins[b][s];
+        VoiceWorker *root = &vwd->workers[0];
+        if (root->has_data) {
+            for (int b = 0; b < NUM_MIXBINS; b++) {
+                for (int s = 0; s < NUM_SAMPLES_PER_FRAME; s++) {
+                    mixbins[b][s] += root->mixbins[b][s];
+                }
+            }
+            if (d->monitor.point == MCPX_APU_DEBUG_MON_VP) {
+                for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
+                    d->vp.sample_buf[i][0] += root->sample_buf[i][0];
+                    d->vp.sample_buf[i][1] += root->sample_buf[i][1];
+                }
             }
         }
     }
 
     int64_t end_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     g_dbg.vp.total_worker_time_us = end_time - start_time;
-
-    qemu_mutex_unlock(&vwd->lock);
 }
 
 static void voice_work_init(MCPXAPUState *d)
@@ -1771,43 +2176,49 @@ static void voice_work_init(MCPXAPUState *d)
     vwd->num_workers = MAX(1, MIN(num_workers, MAX_VOICE_WORKERS));
     vwd->workers = g_malloc0_n(vwd->num_workers, sizeof(VoiceWorker));
     vwd->workers_should_exit = false;
-    vwd->workers_pending = 0;
+    vwd->generation = 0;
+    vwd->finished_generation = 0;
+    vwd->spin_limit = VOICE_WORK_SPIN_MAX;
     vwd->queue_len = 0;
 
     g_dbg.vp.num_workers = vwd->num_workers;
 
-    qemu_mutex_init(&vwd->lock);
-    qemu_mutex_lock(&vwd->lock);
-    qemu_cond_init(&vwd->work_pending);
-    qemu_cond_init(&vwd->work_finished);
+    qemu_event_init(&vwd->work_finished, false);
     for (int i = 0; i < vwd->num_workers; i++) {
-        vwd->workers_pending |= 1 << i;
-        qemu_thread_create(&vwd->workers[i].thread, "mcpx.voice_worker",
-                           voice_worker_thread, d, QEMU_THREAD_JOINABLE);
+        VoiceWorker *worker = &vwd->workers[i];
+        worker->d = d;
+        worker->id = i;
+        worker->spin_limit = VOICE_WORK_SPIN_MAX;
+        qemu_event_init(&worker->wake, false);
+        qemu_thread_create(&worker->thread, "mcpx.voice_worker",
+                           voice_worker_thread, worker, QEMU_THREAD_JOINABLE);
     }
-    qemu_cond_wait(&vwd->work_finished, &vwd->lock);
-    assert(!vwd->workers_pending);
-    qemu_mutex_unlock(&vwd->lock);
 }
 
 static void voice_work_finalize(MCPXAPUState *d)
 {
     VoiceWorkDispatch *vwd = &d->vp.voice_work_dispatch;
 
-    qemu_mutex_lock(&vwd->lock);
-    vwd->workers_should_exit = true;
-    qemu_cond_broadcast(&vwd->work_pending);
-    qemu_mutex_unlock(&vwd->lock);
+    qatomic_set(&vwd->workers_should_exit, true);
+    qatomic_store_release(&vwd->generation, vwd->generation + 1);
+    for (int i = 0; i < vwd->num_workers; i++) {
+        qemu_event_set(&vwd->workers[i].wake);
+    }
     for (int i = 0; i < vwd->num_workers; i++) {
         qemu_thread_join(&vwd->workers[i].thread);
+        qemu_event_destroy(&vwd->workers[i].wake);
     }
+    qemu_event_destroy(&vwd->work_finished);
     g_free(vwd->workers);
     vwd->workers = NULL;
 }
 
 void mcpx_apu_vp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME])
 {
+    mcpx_apu_vp_apply_fe_queue(d);
     memset(d->vp.sample_buf, 0, sizeof(d->vp.sample_buf));
+    voice_cache_sync_base(d);
+    adpcm_cache_invalidate_written(d);
 
     /* Process all voices, mixing each into the affected MIXBINs */
     for (int list = 0; list < 3; list++) {
@@ -1858,22 +2269,54 @@ void mcpx_apu_vp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_P
 
 void mcpx_apu_vp_init(MCPXAPUState *d)
 {
+    adpcm_init_tables();
+    qemu_mutex_init(&d->vp.adpcm_cache.lock);
+    d->vp.adpcm_cache.entries =
+        g_new0(MCPXAPUADPCMCacheEntry, 1 << MCPX_APU_ADPCM_CACHE_BITS);
     voice_work_init(d);
+    qemu_mutex_init(&d->vp.fe_queue.lock);
+    d->vp.fe_queue.pending = g_array_new(false, false, sizeof(MCPXAPUFEMethod));
+    d->vp.fe_queue.applying = g_array_new(false, false, sizeof(MCPXAPUFEMethod));
+}
+
+/* Sizes the ADPCM cache page tracking once guest RAM is known */
+void mcpx_apu_vp_init_ram(MCPXAPUState *d)
+{
+    size_t num_pages = memory_region_size(d->ram) >> TARGET_PAGE_BITS;
+
+    d->vp.adpcm_cache.page_epoch = g_new0(uint32_t, num_pages);
+    d->vp.adpcm_cache.pages_used = bitmap_new(num_pages);
+    d->vp.adpcm_cache.num_pages = num_pages;
+    memory_region_set_log(d->ram, true, DIRTY_MEMORY_APU);
 }
 
 void mcpx_apu_vp_finalize(MCPXAPUState *d)
 {
     voice_work_finalize(d);
+    qemu_mutex_destroy(&d->vp.adpcm_cache.lock);
+    g_free(d->vp.adpcm_cache.entries);
+    g_free(d->vp.adpcm_cache.page_epoch);
+    g_free(d->vp.adpcm_cache.pages_used);
+    g_array_free(d->vp.fe_queue.pending, true);
+    g_array_free(d->vp.fe_queue.applying, true);
+    qemu_mutex_destroy(&d->vp.fe_queue.lock);
 }
 
 void mcpx_apu_vp_reset(MCPXAPUState *d)
 {
+    qemu_mutex_lock(&d->vp.fe_queue.lock);
+    g_array_set_size(d->vp.fe_queue.pending, 0);
+    qemu_mutex_unlock(&d->vp.fe_queue.lock);
+
     d->vp.ssl_base_page = 0;
     d->vp.hrtf_headroom = 0;
     memset(d->vp.ssl, 0, sizeof(d->vp.ssl));
     memset(d->vp.hrtf_submix, 0, sizeof(d->vp.hrtf_submix));
     memset(d->vp.submix_headroom, 0, sizeof(d->vp.submix_headroom));
     memset(d->vp.voice_locked, 0, sizeof(d->vp.voice_locked));
+    d->vp.voice_cache.base = 0;
+    memset(d->vp.voice_cache.valid, 0, sizeof(d->vp.voice_cache.valid));
+    adpcm_cache_reset(d);
     for (int v = 0; v < ARRAY_SIZE(d->vp.filters); v++) {
         hrtf_filter_init(&d->vp.filters[v].hrtf);
     }
@@ -30,6 +30,7 @@
 #include "hw/xbox/mcpx/apu/apu_regs.h"
 #include "svf.h"
 #include "hrtf.h"
+#include "resample.h"
 
 typedef struct MCPXAPUState MCPXAPUState;
 
@@ -42,36 +43,65 @@ typedef struct MCPXAPUVPSSLData {
 
 typedef struct MCPXAPUVoiceFilter {
     uint16_t voice;
-    float resample_buf[NUM_SAMPLES_PER_FRAME * 2];
-    SRC_STATE *resampler;
+    Resampler resampler;
     sv_filter svf[2];
     HrtfFilter hrtf;
 } MCPXAPUVoiceFilter;
 
+#define MCPX_APU_ADPCM_CACHE_BITS 12
+
+/* Decoded ADPCM block, valid while the epoch of its page is unchanged */
+typedef struct MCPXAPUADPCMCacheEntry {
+    hwaddr addr; // Of the raw block in guest memory
+    uint32_t epoch;
+    unsigned int channels; // 0 if the entry is unused
+    int16_t decoded[65 * 2];
+} MCPXAPUADPCMCacheEntry;
+
+/* FE method written through the PIO window, applied by the frame thread */
+typedef struct MCPXAPUFEMethod {
+    uint32_t method;
+    uint32_t argument;
+} MCPXAPUFEMethod;
+
 typedef struct VoiceWorkItem {
     int voice;
     int list;
 } VoiceWorkItem;
 
+/* Voices which must be processed in order by the same worker */
+typedef struct VoiceWorkGroup {
+    int start;
+    int end;
+} VoiceWorkGroup;
+
 typedef struct VoiceWorker {
+    MCPXAPUState *d;
+    int id;
     QemuThread thread;
+    QemuEvent wake;
+    int spin_limit;
     float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME];
     float sample_buf[NUM_SAMPLES_PER_FRAME][2];
-    VoiceWorkItem queue[MCPX_HW_MAX_VOICES];
-    int queue_len;
+    bool has_data;
+    int groups[MCPX_HW_MAX_VOICES];
+    int num_groups;
+    int next_group; // Claimed atomically by the owner and by thieves
+    unsigned int arrivals; // Reduction tree node this worker is right child of
 } VoiceWorker;
 
 typedef struct VoiceWorkDispatch {
-    QemuMutex lock;
     int num_workers;
     VoiceWorker *workers;
     bool workers_should_exit;
-    QemuCond work_pending;
-    uint64_t workers_pending;
-    QemuCond work_finished;
-    float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME];
+    unsigned int generation;
+    unsigned int finished_generation;
+    QemuEvent work_finished;
+    int spin_limit;
     VoiceWorkItem queue[MCPX_HW_MAX_VOICES];
     int queue_len;
+    VoiceWorkGroup groups[MCPX_HW_MAX_VOICES];
+    int num_groups;
 } VoiceWorkDispatch;
 
 typedef struct {
@@ -88,6 +118,29 @@ typedef struct {
     float sample_buf[NUM_SAMPLES_PER_FRAME][2];
     uint64_t voice_locked[4];
 
+    // Host copy of the voice descriptors at NV_PAPU_VPVADDR
+    struct {
+        hwaddr base;
+        bool valid[MCPX_HW_MAX_VOICES];
+        uint32_t regs[MCPX_HW_MAX_VOICES][NV_PAVS_SIZE / 4];
+    } voice_cache;
+
+    // Decoded ADPCM blocks shared by all voices, direct mapped by address
+    struct {
+        QemuMutex lock;
+        MCPXAPUADPCMCacheEntry *entries;
+        uint32_t *page_epoch; // Bumped when guest writes to the page are seen
+        unsigned long *pages_used; // Pages to check for writes each frame
+        size_t num_pages;
+    } adpcm_cache;
+
+    // PIO methods not yet applied, so vCPUs don't wait for a frame to finish
+    struct {
+        QemuMutex lock;
+        GArray *pending; // MCPXAPUFEMethod
+        GArray *applying; // Only used with the APU lock held
+    } fe_queue;
+
     struct {
         int current_entry;
         // FIXME: Stored in RAM
@@ -104,8 +157,10 @@ typedef struct {
 extern const MemoryRegionOps vp_ops;
 
 void mcpx_apu_vp_init(MCPXAPUState *d);
+void mcpx_apu_vp_init_ram(MCPXAPUState *d);
 void mcpx_apu_vp_finalize(MCPXAPUState *d);
 void mcpx_apu_vp_frame(MCPXAPUState *d, float mixbins[NUM_MIXBINS][NUM_SAMPLES_PER_FRAME]);
 void mcpx_apu_vp_reset(MCPXAPUState *d);
+void mcpx_apu_vp_apply_fe_queue(MCPXAPUState *d);
 
 #endif
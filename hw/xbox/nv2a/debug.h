@@ -91,22 +91,31 @@
     _X(NV2A_PROF_INLINE_ARRAYS) \
     _X(NV2A_PROF_INLINE_ELEMENTS) \
     _X(NV2A_PROF_QUERY) \
+    _X(NV2A_PROF_QUERY_REPORT_LATENT) \
     _X(NV2A_PROF_SHADER_GEN) \
     _X(NV2A_PROF_SHADER_BIND) \
     _X(NV2A_PROF_SHADER_BIND_NOTDIRTY) \
     _X(NV2A_PROF_SHADER_UBO_DIRTY) \
     _X(NV2A_PROF_SHADER_UBO_NOTDIRTY) \
+    _X(NV2A_PROF_DESCRIPTOR_POOL_GROW) \
     _X(NV2A_PROF_ATTR_BIND) \
+    _X(NV2A_PROF_TEX_CACHE_HIT) \
+    _X(NV2A_PROF_TEX_CACHE_MISS) \
     _X(NV2A_PROF_TEX_UPLOAD) \
+    _X(NV2A_PROF_TEX_UPLOAD_BYTES) \
+    _X(NV2A_PROF_TEX_PALETTE_UPLOAD) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_1) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_2) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_3) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_4) \
     _X(NV2A_PROF_GEOM_BUFFER_UPDATE_4_NOTDIRTY) \
+    _X(NV2A_PROF_VERTEX_SYNC_BYTES) \
     _X(NV2A_PROF_SURF_SWIZZLE) \
     _X(NV2A_PROF_SURF_CREATE) \
     _X(NV2A_PROF_SURF_DOWNLOAD) \
+    _X(NV2A_PROF_SURF_DOWNLOAD_BYTES) \
     _X(NV2A_PROF_SURF_UPLOAD) \
+    _X(NV2A_PROF_SURF_UPLOAD_BYTES) \
     _X(NV2A_PROF_SURF_TO_TEX) \
     _X(NV2A_PROF_SURF_TO_TEX_FALLBACK) \
     _X(NV2A_PROF_QUEUE_SUBMIT_1) \
@@ -133,6 +142,18 @@ typedef struct NV2AStats {
         int counters[NV2A_PROF__COUNT];
     } frame_working, frame_history[NV2A_PROF_NUM_FRAMES];
     unsigned int frame_ptr;
+    uint64_t totals[NV2A_PROF__COUNT]; // Sum of all completed frames
+    struct {
+        unsigned int textures, textures_max;
+        unsigned int shaders, shaders_max;
+        unsigned int pipelines, pipelines_max;
+        unsigned int surfaces;
+    } occupancy; // Renderer caches, updated at flip
+    struct {
+        int64_t latency_us; // Guest flip to UI present, smoothed
+        int64_t jitter_us; // Deviation of present intervals, smoothed
+        unsigned int dropped;
+    } present;
 } NV2AStats;
 
 #ifdef __cplusplus
@@ -145,12 +166,19 @@ const char *nv2a_profile_get_counter_name(unsigned int cnt);
 int nv2a_profile_get_counter_value(unsigned int cnt);
 void nv2a_profile_increment(void);
 void nv2a_profile_flip_stall(void);
+void nv2a_profile_register_stats(void);
 
 static inline void nv2a_profile_inc_counter(enum NV2A_PROF_COUNTERS_ENUM cnt)
 {
     g_nv2a_stats.frame_working.counters[cnt] += 1;
 }
 
+static inline void nv2a_profile_add_counter(enum NV2A_PROF_COUNTERS_ENUM cnt,
+                                            int value)
+{
+    g_nv2a_stats.frame_working.counters[cnt] += value;
+}
+
 #ifdef CONFIG_RENDERDOC
 void nv2a_dbg_renderdoc_init(void);
 void *nv2a_dbg_renderdoc_get_api(void);
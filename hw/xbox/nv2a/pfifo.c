@@ -456,6 +456,7 @@ void *pfifo_thread(void *arg)
     pgraph_init_thread(d);
 
     rcu_register_thread();
+    timeline_set_thread_name("PFIFO");
 
     qemu_mutex_lock(&d->pfifo.lock);
     while (true) {
@@ -464,7 +465,9 @@ void *pfifo_thread(void *arg)
         pgraph_process_pending(d);
 
         if (!d->pfifo.halt) {
+            timeline_begin("Pusher");
             pfifo_run_pusher(d);
+            timeline_end();
         }
 
         pgraph_process_pending_reports(d);
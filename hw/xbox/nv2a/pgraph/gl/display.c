@@ -23,6 +23,7 @@
 #include "hw/display/vga_int.h"
 #include "hw/xbox/nv2a/nv2a_int.h"
 #include "hw/xbox/nv2a/pgraph/util.h"
+#include "hw/xbox/nv2a/pgraph/yuv.h"
 #include "renderer.h"
 
 #include <math.h>
@@ -34,12 +35,14 @@ void pgraph_gl_init_display(NV2AState *d)
 
     glo_set_current(g_nv2a_context_display);
 
-    glGenTextures(1, &r->gl_display_buffer);
-    r->gl_display_buffer_internal_format = 0;
-    r->gl_display_buffer_width = 0;
-    r->gl_display_buffer_height = 0;
-    r->gl_display_buffer_format = 0;
-    r->gl_display_buffer_type = 0;
+    for (int i = 0; i < ARRAY_SIZE(r->display_buffers); i++) {
+        glGenTextures(1, &r->display_buffers[i].tex);
+        r->display_buffers[i].internal_format = 0;
+        r->display_buffers[i].width = 0;
+        r->display_buffers[i].height = 0;
+        r->display_buffers[i].format = 0;
+        r->display_buffers[i].type = 0;
+    }
 
     const char *vs =
         "#version 330\n"
@@ -64,6 +67,7 @@ void pgraph_gl_init_display(NV2AState *d)
         "uniform vec2 display_size;\n"
         "uniform float line_offset;\n"
         "layout(location = 0) out vec4 out_Color;\n"
+        PVIDEO_YUY2_GLSL
         "void main()\n"
         "{\n"
         "    vec2 texCoord = gl_FragCoord.xy/display_size;\n"
@@ -77,9 +81,9 @@ void pgraph_gl_init_display(NV2AState *d)
         "                           greaterThan(screenCoord, output_region.zw));\n"
         "        if (!any(clip) && (!pvideo_color_key_enable || out_Color.rgb == pvideo_color_key)) {\n"
         "            vec2 out_xy = (screenCoord - pvideo_pos.xy) * pvideo_scale.z;\n"
-        "            vec2 in_st = (pvideo_in_pos + out_xy * pvideo_scale.xy) / textureSize(pvideo_tex, 0);\n"
-        "            in_st.y *= -1.0;\n"
-        "            out_Color.rgba = texture(pvideo_tex, in_st);\n"
+        "            vec2 in_xy = pvideo_in_pos + out_xy * pvideo_scale.xy;\n"
+        "            in_xy.y = float(textureSize(pvideo_tex, 0).y) - in_xy.y;\n"
+        "            out_Color.rgba = pvideo_sample(in_xy);\n"
         "        }\n"
         "    }\n"
         "}\n";
@@ -114,8 +118,10 @@ void pgraph_gl_finalize_display(PGRAPHState *pg)
 
     glo_set_current(g_nv2a_context_display);
 
-    glDeleteTextures(1, &r->gl_display_buffer);
-    r->gl_display_buffer = 0;
+    for (int i = 0; i < ARRAY_SIZE(r->display_buffers); i++) {
+        glDeleteTextures(1, &r->display_buffers[i].tex);
+        r->display_buffers[i].tex = 0;
+    }
 
     glDeleteProgram(r->disp_rndr.prog);
     r->disp_rndr.prog = 0;
@@ -135,25 +141,6 @@ void pgraph_gl_finalize_display(PGRAPHState *pg)
     glo_set_current(g_nv2a_context_render);
 }
 
-static uint8_t *convert_texture_data__CR8YB8CB8YA8(const uint8_t *data,
-                                                   unsigned int width,
-                                                   unsigned int height,
-                                                   unsigned int pitch)
-{
-    uint8_t *converted_data = (uint8_t *)g_malloc(width * height * 4);
-    int x, y;
-    for (y = 0; y < height; y++) {
-        const uint8_t *line = &data[y * pitch];
-        const uint32_t row_offset = y * width;
-        for (x = 0; x < width; x++) {
-            uint8_t *pixel = &converted_data[(row_offset + x) * 4];
-            convert_yuy2_to_rgb(line, x, &pixel[0], &pixel[1], &pixel[2]);
-            pixel[3] = 255;
-        }
-    }
-    return converted_data;
-}
-
 static float pvideo_calculate_scale(unsigned int din_dout,
                                            unsigned int output_size)
 {
@@ -162,7 +149,8 @@ static float pvideo_calculate_scale(unsigned int din_dout,
     return (calculated_in + 1.0f) / output_size;
 }
 
-static void render_display_pvideo_overlay(NV2AState *d)
+static void render_display_pvideo_overlay(NV2AState *d,
+                                          unsigned int display_height)
 {
     PGRAPHState *pg = &d->pgraph;
     PGRAPHGLState *r = pg->gl_renderer_state;
@@ -256,18 +244,21 @@ static void render_display_pvideo_overlay(NV2AState *d)
     pgraph_apply_scaling_factor(pg, &out_width, &out_height);
 
     // Translate for the GL viewport origin.
-    out_y = MAX(r->gl_display_buffer_height - 1 - (int)(out_y + out_height), 0);
+    out_y = MAX((int)display_height - 1 - (int)(out_y + out_height), 0);
 
     glActiveTexture(GL_TEXTURE0 + 1);
     glBindTexture(GL_TEXTURE_2D, r->disp_rndr.pvideo_tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    uint8_t *tex_rgba = convert_texture_data__CR8YB8CB8YA8(
-        d->vram_ptr + base + offset, in_width, in_height, in_pitch);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, in_width, in_height, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, tex_rgba);
-    g_free(tex_rgba);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Packed YUY2 is uploaded as-is, one texel per pixel pair, and converted
+    // in the display shader
+    assert(in_pitch % 4 == 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, in_pitch / 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (in_width + 1) / 2, in_height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, d->vram_ptr + base + offset);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     glUniform1i(r->disp_rndr.pvideo_tex_loc, 1);
     glUniform2f(r->disp_rndr.pvideo_in_pos_loc, in_s / 16.f, in_t / 8.f);
     glUniform4f(r->disp_rndr.pvideo_pos_loc,
@@ -276,10 +267,11 @@ static void render_display_pvideo_overlay(NV2AState *d)
                 scale_x, scale_y, 1.0f / pg->surface_scale_factor);
 }
 
-static void render_display(NV2AState *d, SurfaceBinding *surface)
+static void render_display(NV2AState *d, SurfaceBinding *surface, int slot)
 {
     struct PGRAPHState *pg = &d->pgraph;
     PGRAPHGLState *r = pg->gl_renderer_state;
+    GLDisplayBuffer *buf = &r->display_buffers[slot];
 
     unsigned int width, height;
     VGADisplayParams vga_display_params;
@@ -296,13 +288,13 @@ static void render_display(NV2AState *d, SurfaceBinding *surface)
 
     glBindFramebuffer(GL_FRAMEBUFFER, r->disp_rndr.fbo);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, r->gl_display_buffer);
+    glBindTexture(GL_TEXTURE_2D, buf->tex);
     bool recreate = (
-        surface->fmt.gl_internal_format != r->gl_display_buffer_internal_format
-        || width != r->gl_display_buffer_width
-        || height != r->gl_display_buffer_height
-        || surface->fmt.gl_format != r->gl_display_buffer_format
-        || surface->fmt.gl_type != r->gl_display_buffer_type
+        surface->fmt.gl_internal_format != buf->internal_format
+        || width != buf->width
+        || height != buf->height
+        || surface->fmt.gl_format != buf->format
+        || surface->fmt.gl_type != buf->type
         );
 
     if (recreate) {
@@ -317,23 +309,23 @@ static void render_display(NV2AState *d, SurfaceBinding *surface)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        r->gl_display_buffer_internal_format = surface->fmt.gl_internal_format;
-        r->gl_display_buffer_width = width;
-        r->gl_display_buffer_height = height;
-        r->gl_display_buffer_format = surface->fmt.gl_format;
-        r->gl_display_buffer_type = surface->fmt.gl_type;
+        buf->internal_format = surface->fmt.gl_internal_format;
+        buf->width = width;
+        buf->height = height;
+        buf->format = surface->fmt.gl_format;
+        buf->type = surface->fmt.gl_type;
         glTexImage2D(GL_TEXTURE_2D, 0,
-            r->gl_display_buffer_internal_format,
-            r->gl_display_buffer_width,
-            r->gl_display_buffer_height,
+            buf->internal_format,
+            buf->width,
+            buf->height,
             0,
-            r->gl_display_buffer_format,
-            r->gl_display_buffer_type,
+            buf->format,
+            buf->type,
             NULL);
     }
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-        GL_TEXTURE_2D, r->gl_display_buffer, 0);
+        GL_TEXTURE_2D, buf->tex, 0);
     GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
     glDrawBuffers(1, DrawBuffers);
     assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
@@ -345,7 +337,7 @@ static void render_display(NV2AState *d, SurfaceBinding *surface)
     glProgramUniform1i(r->disp_rndr.prog, r->disp_rndr.tex_loc, 0);
     glUniform2f(r->disp_rndr.display_size_loc, width, height);
     glUniform1f(r->disp_rndr.line_offset_loc, line_offset);
-    render_display_pvideo_overlay(d);
+    render_display_pvideo_overlay(d, height);
 
     glViewport(0, 0, width, height);
     glColorMask(true, true, true, true);
@@ -379,12 +371,15 @@ void pgraph_gl_sync(NV2AState *d)
 
     SurfaceBinding *surface = pgraph_gl_surface_get_within(d, d->pcrtc.start + vga_display_params.line_offset);
     if (surface == NULL || !surface->color || !surface->width || !surface->height) {
+        qatomic_set(&d->pgraph.sync_pending, false);
         qemu_event_set(&d->pgraph.sync_complete);
         return;
     }
 
     /* FIXME: Sanity check surface dimensions */
 
+    timeline_begin("Compose Display");
+
     /* Wait for queued commands to complete */
     pgraph_gl_upload_surface_data(d, surface, !tcg_enabled());
     gl_fence();
@@ -392,13 +387,17 @@ void pgraph_gl_sync(NV2AState *d)
 
     /* Render framebuffer in display context */
     glo_set_current(g_nv2a_context_display);
-    render_display(d, surface);
+    int slot = pgraph_present_begin(&d->pgraph.present);
+    render_display(d, surface, slot);
     gl_fence();
     assert(glGetError() == GL_NO_ERROR);
+    pgraph_present_end(&d->pgraph.present, slot, surface->draw_time);
 
     /* Switch back to original context */
     glo_set_current(g_nv2a_context_render);
 
+    timeline_end();
+
     qatomic_set(&d->pgraph.sync_pending, false);
     qemu_event_set(&d->pgraph.sync_complete);
 }
@@ -430,11 +429,8 @@ int pgraph_gl_get_framebuffer_surface(NV2AState *d)
         );
 
     surface->frame_time = pg->frame_time;
-    qemu_event_reset(&d->pgraph.sync_complete);
-    qatomic_set(&pg->sync_pending, true);
-    pfifo_kick(d);
-    qemu_mutex_unlock(&d->pfifo.lock);
-    qemu_event_wait(&d->pgraph.sync_complete);
+    int slot = pgraph_present_acquire(d, surface->draw_time,
+                                      surface->upload_pending);
 
-    return r->gl_display_buffer;
+    return slot >= 0 ? r->display_buffers[slot].tex : 0;
 }
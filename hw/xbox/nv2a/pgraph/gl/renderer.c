@@ -26,12 +26,25 @@
 
 GloContext *g_nv2a_context_render;
 GloContext *g_nv2a_context_display;
+GloContext *g_nv2a_context_shader_workers[NV2A_GL_MAX_SHADER_WORKERS];
+int g_nv2a_num_shader_workers;
 
 static void early_context_init(void)
 {
     g_nv2a_context_render = glo_context_create();
     g_nv2a_context_display = glo_context_create();
 
+    // Shared contexts used to link cached shader programs in parallel. There
+    // is nothing to link at startup without the disk cache.
+    g_nv2a_num_shader_workers = 0;
+    if (g_config.perf.cache_shaders) {
+        g_nv2a_num_shader_workers = MIN(NV2A_GL_MAX_SHADER_WORKERS,
+                                        MAX(1, g_get_num_processors() / 2));
+    }
+    for (int i = 0; i < g_nv2a_num_shader_workers; i++) {
+        g_nv2a_context_shader_workers[i] = glo_context_create();
+    }
+
     // Note: Due to use of shared contexts, this must happen after some other
     // context is created so the temporary context will not become the thread
     // context. After destroying the context, some a durable context should be
@@ -99,10 +112,30 @@ static void pgraph_gl_finalize(NV2AState *d)
     pg->gl_renderer_state = NULL;
 }
 
+static void update_cache_stats(PGRAPHGLState *r)
+{
+    g_nv2a_stats.occupancy.textures = r->texture_cache.num_used;
+    g_nv2a_stats.occupancy.textures_max =
+        r->texture_cache.num_used + r->texture_cache.num_free;
+    g_nv2a_stats.occupancy.shaders = r->shader_cache.num_used;
+    g_nv2a_stats.occupancy.shaders_max =
+        r->shader_cache.num_used + r->shader_cache.num_free;
+
+    unsigned int num_surfaces = 0;
+    SurfaceBinding *surface;
+    QTAILQ_FOREACH(surface, &r->surfaces, entry) {
+        num_surfaces++;
+    }
+    g_nv2a_stats.occupancy.surfaces = num_surfaces;
+}
+
 static void pgraph_gl_flip_stall(NV2AState *d)
 {
+    update_cache_stats(d->pgraph.gl_renderer_state);
     NV2A_GL_DFRAME_TERMINATOR();
+    timeline_begin("glFinish");
     glFinish();
+    timeline_end();
 }
 
 static void pgraph_gl_flush(NV2AState *d)
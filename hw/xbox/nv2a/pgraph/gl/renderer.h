@@ -38,6 +38,8 @@
 #include "gloffscreen.h"
 #include "constants.h"
 
+#define NV2A_GL_MAX_SHADER_WORKERS 4
+
 typedef struct SurfaceBinding {
     QTAILQ_ENTRY(SurfaceBinding) entry;
     MemAccessCallback *access_cb;
@@ -70,6 +72,7 @@ typedef struct TextureBinding {
     unsigned int refcnt;
     int draw_time;
     uint64_t data_hash;
+    uint64_t palette_hash;
     unsigned int scale;
     unsigned int min_filter;
     unsigned int mag_filter;
@@ -81,6 +84,10 @@ typedef struct TextureBinding {
     bool border_color_set;
     GLenum gl_target;
     GLuint gl_texture;
+    GLuint gl_index_texture;
+    GLuint gl_palette_texture;
+    hwaddr palette_vram_offset;
+    hwaddr palette_length;
 } TextureBinding;
 
 typedef struct ShaderModuleCacheKey {
@@ -112,14 +119,12 @@ typedef struct ShaderBinding {
     bool initialized;
 
     bool cached;
-    void *program;
-    size_t program_size;
-    GLenum program_format;
+    uint32_t use_count;
     ShaderState state;
-    QemuThread *save_thread;
 
     GLuint gl_program;
     GLenum gl_primitive_mode;
+    GLsync gl_fence;
 
     struct {
         PshUniformLocs psh;
@@ -167,14 +172,18 @@ typedef struct QueryReport {
     GLuint *queries;
 } QueryReport;
 
+typedef struct GLDisplayBuffer {
+    GLuint tex;
+    GLint internal_format;
+    GLsizei width;
+    GLsizei height;
+    GLenum format;
+    GLenum type;
+} GLDisplayBuffer;
+
 typedef struct PGRAPHGLState {
     GLuint gl_framebuffer;
-    GLuint gl_display_buffer;
-    GLint gl_display_buffer_internal_format;
-    GLsizei gl_display_buffer_width;
-    GLsizei gl_display_buffer_height;
-    GLenum gl_display_buffer_format;
-    GLenum gl_display_buffer_type;
+    GLDisplayBuffer display_buffers[PGRAPH_PRESENT_MAX_SLOTS];
 
     Lru element_cache;
     VertexLruNode *element_cache_entries;
@@ -199,6 +208,8 @@ typedef struct PGRAPHGLState {
     ShaderBinding *shader_binding;
     QemuMutex shader_cache_lock;
     QemuThread shader_disk_thread;
+    struct ShaderArchive *shader_archive;
+    bool shader_warmup_cancel;
 
     Lru shader_module_cache;
     ShaderModuleCacheEntry *shader_module_cache_entries;
@@ -216,6 +227,11 @@ typedef struct PGRAPHGLState {
         GLuint tex_loc, surface_size_loc;
     } s2t_rndr;
 
+    struct pal_rndr {
+        GLuint fbo, vao, prog;
+        GLint index_tex_loc, palette_tex_loc, level_loc;
+    } pal_rndr;
+
     struct disp_rndr {
         GLuint fbo, vao, vbo, prog;
         GLuint display_size_loc;
@@ -242,6 +258,8 @@ typedef struct PGRAPHGLState {
 
 extern GloContext *g_nv2a_context_render;
 extern GloContext *g_nv2a_context_display;
+extern GloContext *g_nv2a_context_shader_workers[NV2A_GL_MAX_SHADER_WORKERS];
+extern int g_nv2a_num_shader_workers;
 
 unsigned int pgraph_gl_bind_inline_array(NV2AState *d);
 void pgraph_gl_bind_shaders(PGRAPHState *pg);
@@ -285,8 +303,7 @@ SurfaceBinding *pgraph_gl_surface_get_within(NV2AState *d, hwaddr addr);
 void pgraph_gl_surface_invalidate(NV2AState *d, SurfaceBinding *e);
 void pgraph_gl_unbind_surface(NV2AState *d, bool color);
 void pgraph_gl_upload_surface_data(NV2AState *d, SurfaceBinding *surface, bool force);
-void pgraph_gl_shader_cache_to_disk(ShaderBinding *snode);
-bool pgraph_gl_shader_load_from_memory(ShaderBinding *snode);
+void pgraph_gl_shader_cache_to_disk(PGRAPHGLState *r, ShaderBinding *snode);
 void pgraph_gl_shader_write_cache_reload_list(PGRAPHState *pg);
 void pgraph_gl_set_surface_scale_factor(NV2AState *d, unsigned int scale);
 unsigned int pgraph_gl_get_surface_scale_factor(NV2AState *d);
@@ -22,10 +22,12 @@
 #include "qemu/osdep.h"
 #include "qemu/fast-hash.h"
 #include "qemu/mstring.h"
+#include <glib/gstdio.h>
 
 #include "xemu-version.h"
 #include "ui/xemu-settings.h"
 #include "hw/xbox/nv2a/pgraph/util.h"
+#include "hw/xbox/nv2a/pgraph/shader_archive.h"
 #include "debug.h"
 #include "renderer.h"
 
@@ -260,15 +262,91 @@ static void shader_create_cache_folder(void)
     g_free(shader_path);
 }
 
+static char *shader_get_archive_path(void)
+{
+    return g_strdup_printf("%sshaders/gl_programs.bin",
+                           xemu_settings_get_base_path());
+}
+
+static bool is_hex_name(const char *name, size_t len)
+{
+    if (strlen(name) != len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!g_ascii_isxdigit(name[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Programs used to be stored one file each, as shaders/<hash[63:48]>/<hash>.
+ * They are no longer read, so remove them once the archive is in use.
+ */
+static void shader_remove_legacy_cache_files(void)
+{
+    g_autofree char *shader_path =
+        g_strdup_printf("%sshaders", xemu_settings_get_base_path());
+    GDir *dir = g_dir_open(shader_path, 0, NULL);
+    if (!dir) {
+        return;
+    }
+
+    const char *name;
+    while ((name = g_dir_read_name(dir))) {
+        if (!is_hex_name(name, 4)) {
+            continue;
+        }
+
+        g_autofree char *bin_path = g_build_filename(shader_path, name, NULL);
+        GDir *bin_dir = g_dir_open(bin_path, 0, NULL);
+        if (!bin_dir) {
+            continue;
+        }
+
+        const char *bin_name;
+        while ((bin_name = g_dir_read_name(bin_dir))) {
+            if (is_hex_name(bin_name, 12)) {
+                g_autofree char *path =
+                    g_build_filename(bin_path, bin_name, NULL);
+                qemu_unlink(path);
+            }
+        }
+        g_dir_close(bin_dir);
+        g_rmdir(bin_path);
+    }
+    g_dir_close(dir);
+}
+
 static char *shader_get_lru_cache_path(void)
 {
     return g_strdup_printf("%s/shader_cache_list", xemu_settings_get_base_path());
 }
 
+#define SHADER_RELOAD_LIST_MAGIC 0x3154534c52444853ULL
+
+typedef struct ShaderReloadListEntry {
+    uint64_t hash;
+    uint32_t uses;
+    uint32_t reserved;
+} ShaderReloadListEntry;
+
+typedef struct ShaderArchiveProgramHeader {
+    GLenum program_format;
+    ShaderState state;
+} ShaderArchiveProgramHeader;
+
 static void shader_write_lru_list_entry_to_disk(Lru *lru, LruNode *node, void *opaque)
 {
     FILE *lru_list_file = (FILE*) opaque;
-    size_t written = fwrite(&node->hash, sizeof(uint64_t), 1, lru_list_file);
+    ShaderBinding *binding = container_of(node, ShaderBinding, node);
+    ShaderReloadListEntry entry = {
+        .hash = node->hash,
+        .uses = binding->use_count,
+    };
+    size_t written = fwrite(&entry, sizeof(entry), 1, lru_list_file);
     if (written != 1) {
         fprintf(stderr, "nv2a: Failed to write shader list entry %llx to disk\n",
                 (unsigned long long) node->hash);
@@ -286,6 +364,7 @@ void pgraph_gl_shader_write_cache_reload_list(PGRAPHState *pg)
     }
 
     char *shader_lru_path = shader_get_lru_cache_path();
+    qatomic_set(&r->shader_warmup_cancel, true);
     qemu_thread_join(&r->shader_disk_thread);
 
     FILE *lru_list = qemu_fopen(shader_lru_path, "wb");
@@ -295,26 +374,27 @@ void pgraph_gl_shader_write_cache_reload_list(PGRAPHState *pg)
         return;
     }
 
+    uint64_t magic = SHADER_RELOAD_LIST_MAGIC;
+    fwrite(&magic, sizeof(magic), 1, lru_list);
     lru_visit_active(&r->shader_cache, shader_write_lru_list_entry_to_disk, lru_list);
     fclose(lru_list);
 
+    shader_archive_flush(r->shader_archive);
+
     lru_flush(&r->shader_cache);
 
     qatomic_set(&r->shader_cache_writeback_pending, false);
     qemu_event_set(&r->shader_cache_writeback_complete);
 }
 
-bool pgraph_gl_shader_load_from_memory(ShaderBinding *binding)
+static bool shader_load_program_binary(ShaderBinding *binding,
+                                       GLenum program_format,
+                                       const void *program, size_t program_size)
 {
     assert(glGetError() == GL_NO_ERROR);
 
-    if (!binding->program) {
-        return false;
-    }
-
     GLuint gl_program = glCreateProgram();
-    glProgramBinary(gl_program, binding->program_format, binding->program,
-                    binding->program_size);
+    glProgramBinary(gl_program, program_format, program, program_size);
     GLint gl_error = glGetError();
     if (gl_error != GL_NO_ERROR) {
         NV2A_DPRINTF(
@@ -335,14 +415,10 @@ bool pgraph_gl_shader_load_from_memory(ShaderBinding *binding)
 
     glUseProgram(gl_program);
 
-    g_free(binding->program);
-
-    binding->program = NULL;
     binding->gl_program = gl_program;
     binding->gl_primitive_mode =
         get_gl_primitive_mode(binding->state.geom.polygon_front_mode,
                               binding->state.geom.primitive_mode);
-    binding->initialized = true;
 
     set_texture_sampler_uniforms(binding);
 
@@ -354,145 +430,234 @@ bool pgraph_gl_shader_load_from_memory(ShaderBinding *binding)
         glGetProgramInfoLog(gl_program, 1024, NULL, log);
         NV2A_DPRINTF("failed to load shader binary from disk: %s\n", log);
         glDeleteProgram(gl_program);
+        binding->gl_program = 0;
         return false;
     }
 
     update_shader_uniform_locs(binding);
+    binding->initialized = true;
 
     return true;
 }
 
-static char *shader_get_bin_directory(uint64_t hash)
+static bool shader_get_archive_program(PGRAPHGLState *r, uint64_t hash,
+                                       ShaderArchiveProgramHeader *hdr,
+                                       const void **program,
+                                       size_t *program_size)
 {
-    const char *cfg_dir = xemu_settings_get_base_path();
-    char *shader_bin_dir =
-        g_strdup_printf("%s/shaders/%04x", cfg_dir, (uint32_t)(hash >> 48));
-    return shader_bin_dir;
-}
+    const void *data;
+    size_t size;
+    if (!shader_archive_lookup(r->shader_archive, hash, &data, &size)) {
+        return false;
+    }
 
-static char *shader_get_binary_path(const char *shader_bin_dir, uint64_t hash)
-{
-    uint64_t bin_mask = (uint64_t)0xffff << 48;
-    return g_strdup_printf("%s/%012" PRIx64, shader_bin_dir, hash & ~bin_mask);
+    if (size <= sizeof(*hdr)) {
+        /* Remove the entry so it won't be loaded again */
+        shader_archive_remove(r->shader_archive, hash);
+        return false;
+    }
+
+    memcpy(hdr, data, sizeof(*hdr));
+    *program = (const uint8_t *)data + sizeof(*hdr);
+    *program_size = size - sizeof(*hdr);
+    return true;
 }
 
-static void shader_load_from_disk(PGRAPHState *pg, uint64_t hash)
+static bool shader_load_from_archive(PGRAPHGLState *r, ShaderBinding *binding)
 {
-    PGRAPHGLState *r = pg->gl_renderer_state;
+    ShaderArchiveProgramHeader hdr;
+    const void *program;
+    size_t program_size;
+
+    if (!g_config.perf.cache_shaders ||
+        !shader_get_archive_program(r, binding->node.hash, &hdr, &program,
+                                    &program_size) ||
+        memcmp(&hdr.state, &binding->state, sizeof(ShaderState))) {
+        return false;
+    }
 
-    char *shader_bin_dir = shader_get_bin_directory(hash);
-    char *shader_path = shader_get_binary_path(shader_bin_dir, hash);
-    char *cached_xemu_version = NULL;
-    char *cached_gl_vendor = NULL;
-    void *program_buffer = NULL;
+    if (!shader_load_program_binary(binding, hdr.program_format, program,
+                                    program_size)) {
+        shader_archive_remove(r->shader_archive, binding->node.hash);
+        return false;
+    }
 
-    uint64_t cached_xemu_version_len;
-    uint64_t gl_vendor_len;
-    GLenum program_binary_format;
-    ShaderState state;
-    size_t shader_size;
+    binding->cached = true;
+    return true;
+}
 
-    g_free(shader_bin_dir);
+static void shader_load_from_disk(PGRAPHState *pg,
+                                  const ShaderReloadListEntry *entry)
+{
+    PGRAPHGLState *r = pg->gl_renderer_state;
 
     qemu_mutex_lock(&r->shader_cache_lock);
-    if (lru_contains_hash(&r->shader_cache, hash)) {
+    if (lru_contains_hash(&r->shader_cache, entry->hash)) {
         qemu_mutex_unlock(&r->shader_cache_lock);
         return;
     }
     qemu_mutex_unlock(&r->shader_cache_lock);
 
-    FILE *shader_file = qemu_fopen(shader_path, "rb");
-    if (!shader_file) {
-        goto error;
-    }
-
-    size_t nread;
-    #define READ_OR_ERR(data, data_len) \
-        do { \
-            nread = fread(data, data_len, 1, shader_file); \
-            if (nread != 1) { \
-                fclose(shader_file); \
-                goto error; \
-            } \
-        } while (0)
-
-    READ_OR_ERR(&cached_xemu_version_len, sizeof(cached_xemu_version_len));
-
-    cached_xemu_version = g_malloc(cached_xemu_version_len +1);
-    READ_OR_ERR(cached_xemu_version, cached_xemu_version_len);
-    if (strcmp(cached_xemu_version, xemu_version) != 0) {
-        fclose(shader_file);
-        goto error;
+    ShaderArchiveProgramHeader hdr;
+    const void *program;
+    size_t program_size;
+    if (!shader_get_archive_program(r, entry->hash, &hdr, &program,
+                                    &program_size)) {
+        return;
     }
 
-    READ_OR_ERR(&gl_vendor_len, sizeof(gl_vendor_len));
-
-    cached_gl_vendor = g_malloc(gl_vendor_len);
-    READ_OR_ERR(cached_gl_vendor, gl_vendor_len);
-    if (strcmp(cached_gl_vendor, shader_gl_vendor) != 0) {
-        fclose(shader_file);
-        goto error;
+    /* Link outside of the cache lock, then publish the result */
+    ShaderBinding *loaded = g_new0(ShaderBinding, 1);
+    loaded->state = hdr.state;
+    if (!shader_load_program_binary(loaded, hdr.program_format, program,
+                                    program_size)) {
+        shader_archive_remove(r->shader_archive, entry->hash);
+        g_free(loaded);
+        return;
     }
 
-    READ_OR_ERR(&program_binary_format, sizeof(program_binary_format));
-    READ_OR_ERR(&state, sizeof(state));
-    READ_OR_ERR(&shader_size, sizeof(shader_size));
-
-    program_buffer = g_malloc(shader_size);
-    READ_OR_ERR(program_buffer, shader_size);
-
-    #undef READ_OR_ERR
-
-    fclose(shader_file);
-    g_free(shader_path);
-    g_free(cached_xemu_version);
-    g_free(cached_gl_vendor);
+    /* Make the program visible to the rendering context */
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
 
     qemu_mutex_lock(&r->shader_cache_lock);
-    LruNode *node = lru_lookup(&r->shader_cache, hash, &state);
+    LruNode *node = lru_lookup(&r->shader_cache, entry->hash, &hdr.state);
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
 
     /* If we happened to regenerate this shader already, then we may as well use the new one */
     if (binding->initialized) {
         qemu_mutex_unlock(&r->shader_cache_lock);
+        glDeleteSync(fence);
+        glDeleteProgram(loaded->gl_program);
+        g_free(loaded);
         return;
     }
 
-    binding->program_format = program_binary_format;
-    binding->program_size = shader_size;
-    binding->program = program_buffer;
+    binding->gl_program = loaded->gl_program;
+    binding->gl_primitive_mode = loaded->gl_primitive_mode;
+    memcpy(&binding->uniform_locs, &loaded->uniform_locs,
+           sizeof(binding->uniform_locs));
+    binding->gl_fence = fence;
+    binding->use_count = entry->uses;
     binding->cached = true;
+    binding->initialized = true;
     qemu_mutex_unlock(&r->shader_cache_lock);
-    return;
 
-error:
-    /* Delete the shader so it won't be loaded again */
-    qemu_unlink(shader_path);
-    g_free(shader_path);
-    g_free(program_buffer);
-    g_free(cached_xemu_version);
-    g_free(cached_gl_vendor);
+    g_free(loaded);
+}
+
+typedef struct ShaderWarmup {
+    PGRAPHState *pg;
+    ShaderReloadListEntry *entries;
+    int num_entries;
+    int next_entry;
+} ShaderWarmup;
+
+typedef struct ShaderWarmupWorker {
+    ShaderWarmup *warmup;
+    GloContext *context;
+    QemuThread thread;
+} ShaderWarmupWorker;
+
+static void *shader_warmup_worker(void *opaque)
+{
+    ShaderWarmupWorker *worker = opaque;
+    ShaderWarmup *warmup = worker->warmup;
+    PGRAPHState *pg = warmup->pg;
+    PGRAPHGLState *r = pg->gl_renderer_state;
+
+    glo_set_current(worker->context);
+
+    while (!qatomic_read(&r->shader_warmup_cancel)) {
+        int i = qatomic_fetch_inc(&warmup->next_entry);
+        if (i >= warmup->num_entries) {
+            break;
+        }
+        shader_load_from_disk(pg, &warmup->entries[i]);
+        qatomic_inc(&pg->shader_warmup_done);
+    }
+
+    glUseProgram(0);
+    glo_set_current(NULL);
+
+    return NULL;
+}
+
+static int shader_reload_entry_compare(const void *a, const void *b)
+{
+    const ShaderReloadListEntry *ea = a, *eb = b;
+    return (ea->uses < eb->uses) - (ea->uses > eb->uses);
+}
+
+static ShaderReloadListEntry *shader_read_reload_list(int *num_entries)
+{
+    char *shader_lru_path = shader_get_lru_cache_path();
+    gchar *contents;
+    gsize length;
+    bool ok = g_file_get_contents(shader_lru_path, &contents, &length, NULL);
+    g_free(shader_lru_path);
+    if (!ok) {
+        return NULL;
+    }
+
+    ShaderReloadListEntry *entries;
+    uint64_t magic = 0;
+    if (length >= sizeof(magic)) {
+        memcpy(&magic, contents, sizeof(magic));
+    }
+
+    if (magic == SHADER_RELOAD_LIST_MAGIC) {
+        *num_entries = (length - sizeof(magic)) / sizeof(*entries);
+        entries = g_new(ShaderReloadListEntry, *num_entries);
+        memcpy(entries, contents + sizeof(magic),
+               *num_entries * sizeof(*entries));
+        qsort(entries, *num_entries, sizeof(*entries),
+              shader_reload_entry_compare);
+    } else {
+        /* Older list of hashes only, keep the recorded order */
+        *num_entries = length / sizeof(uint64_t);
+        entries = g_new0(ShaderReloadListEntry, *num_entries);
+        for (int i = 0; i < *num_entries; i++) {
+            memcpy(&entries[i].hash, contents + i * sizeof(uint64_t),
+                   sizeof(uint64_t));
+        }
+    }
+
+    g_free(contents);
+    return entries;
 }
 
 static void *shader_reload_lru_from_disk(void *arg)
 {
-    if (!g_config.perf.cache_shaders) {
+    if (!g_config.perf.cache_shaders || !g_nv2a_num_shader_workers) {
         return NULL;
     }
 
     PGRAPHState *pg = (PGRAPHState*) arg;
-    char *shader_lru_path = shader_get_lru_cache_path();
 
-    FILE *lru_shaders_list = qemu_fopen(shader_lru_path, "rb");
-    g_free(shader_lru_path);
-    if (!lru_shaders_list) {
+    ShaderWarmup warmup = { .pg = pg };
+    warmup.entries = shader_read_reload_list(&warmup.num_entries);
+    if (!warmup.entries) {
         return NULL;
     }
 
-    uint64_t hash;
-    while (fread(&hash, sizeof(uint64_t), 1, lru_shaders_list) == 1) {
-        shader_load_from_disk(pg, hash);
+    qatomic_set(&pg->shader_warmup_done, 0);
+    qatomic_set(&pg->shader_warmup_total, warmup.num_entries);
+
+    ShaderWarmupWorker workers[NV2A_GL_MAX_SHADER_WORKERS];
+    for (int i = 0; i < g_nv2a_num_shader_workers; i++) {
+        workers[i].warmup = &warmup;
+        workers[i].context = g_nv2a_context_shader_workers[i];
+        qemu_thread_create(&workers[i].thread, "nv2a.shader_warmup",
+                           shader_warmup_worker, &workers[i],
+                           QEMU_THREAD_JOINABLE);
     }
+    for (int i = 0; i < g_nv2a_num_shader_workers; i++) {
+        qemu_thread_join(&workers[i].thread);
+    }
+
+    qatomic_set(&pg->shader_warmup_total, 0);
+    g_free(warmup.entries);
 
     return NULL;
 }
@@ -503,27 +668,21 @@ static void shader_cache_entry_init(Lru *lru, LruNode *node, const void *state)
     memcpy(&binding->state, state, sizeof(ShaderState));
     binding->initialized = false;
     binding->cached = false;
-    binding->program = NULL;
-    binding->save_thread = NULL;
+    binding->gl_fence = NULL;
+    binding->use_count = 0;
 }
 
 static void shader_cache_entry_post_evict(Lru *lru, LruNode *node)
 {
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
 
-    if (binding->save_thread) {
-        qemu_thread_join(binding->save_thread);
-        g_free(binding->save_thread);
+    if (binding->gl_fence) {
+        glDeleteSync(binding->gl_fence);
+        binding->gl_fence = NULL;
     }
-
     glDeleteProgram(binding->gl_program);
-    if (binding->program) {
-        g_free(binding->program);
-    }
 
     binding->cached = false;
-    binding->save_thread = NULL;
-    binding->program = NULL;
     memset(&binding->state, 0, sizeof(ShaderState));
 }
 
@@ -546,6 +705,13 @@ void pgraph_gl_init_shaders(PGRAPHState *pg)
 
     shader_create_cache_folder();
 
+    g_autofree char *archive_path = shader_get_archive_path();
+    g_autofree char *archive_tag =
+        g_strdup_printf("%s\n%s", xemu_version, shader_gl_vendor);
+    r->shader_archive = shader_archive_open(archive_path, archive_tag);
+    shader_archive_set_first_write_fn(r->shader_archive,
+                                      shader_remove_legacy_cache_files);
+
     /* FIXME: Make this configurable */
     const size_t shader_cache_size = 50*1024;
     lru_init(&r->shader_cache);
@@ -583,83 +749,22 @@ void pgraph_gl_finalize_shaders(PGRAPHState *pg)
 
     // Clear out shader cache
     pgraph_gl_shader_write_cache_reload_list(pg); // FIXME: also flushes, rename for clarity
+    lru_destroy(&r->shader_cache);
     free(r->shader_cache_entries);
     r->shader_cache_entries = NULL;
 
+    shader_archive_close(r->shader_archive);
+    r->shader_archive = NULL;
+
     lru_flush(&r->shader_module_cache);
+    lru_destroy(&r->shader_module_cache);
     g_free(r->shader_module_cache_entries);
     r->shader_module_cache_entries = NULL;
 
     qemu_mutex_destroy(&r->shader_cache_lock);
 }
 
-static void *shader_write_to_disk(void *arg)
-{
-    ShaderBinding *binding = (ShaderBinding*) arg;
-
-    char *shader_bin = shader_get_bin_directory(binding->node.hash);
-    char *shader_path = shader_get_binary_path(shader_bin, binding->node.hash);
-
-    static uint64_t gl_vendor_len;
-    if (gl_vendor_len == 0) {
-        gl_vendor_len = (uint64_t) (strlen(shader_gl_vendor) + 1);
-    }
-
-    static uint64_t xemu_version_len = 0;
-    if (xemu_version_len == 0) {
-        xemu_version_len = (uint64_t) (strlen(xemu_version) + 1);
-    }
-
-    qemu_mkdir(shader_bin);
-    g_free(shader_bin);
-
-    FILE *shader_file = qemu_fopen(shader_path, "wb");
-    if (!shader_file) {
-        goto error;
-    }
-
-    size_t written;
-    #define WRITE_OR_ERR(data, data_size) \
-        do { \
-            written = fwrite(data, data_size, 1, shader_file); \
-            if (written != 1) { \
-                fclose(shader_file); \
-                goto error; \
-            } \
-        } while (0)
-
-    WRITE_OR_ERR(&xemu_version_len, sizeof(xemu_version_len));
-    WRITE_OR_ERR(xemu_version, xemu_version_len);
-
-    WRITE_OR_ERR(&gl_vendor_len, sizeof(gl_vendor_len));
-    WRITE_OR_ERR(shader_gl_vendor, gl_vendor_len);
-
-    WRITE_OR_ERR(&binding->program_format, sizeof(binding->program_format));
-    WRITE_OR_ERR(&binding->state, sizeof(binding->state));
-
-    WRITE_OR_ERR(&binding->program_size, sizeof(binding->program_size));
-    WRITE_OR_ERR(binding->program, binding->program_size);
-
-    #undef WRITE_OR_ERR
-
-    fclose(shader_file);
-
-    g_free(shader_path);
-    g_free(binding->program);
-    binding->program = NULL;
-
-    return NULL;
-
-error:
-    fprintf(stderr, "nv2a: Failed to write shader binary file to %s\n", shader_path);
-    qemu_unlink(shader_path);
-    g_free(shader_path);
-    g_free(binding->program);
-    binding->program = NULL;
-    return NULL;
-}
-
-void pgraph_gl_shader_cache_to_disk(ShaderBinding *binding)
+void pgraph_gl_shader_cache_to_disk(PGRAPHGLState *r, ShaderBinding *binding)
 {
     if (binding->cached) {
         return;
@@ -668,29 +773,23 @@ void pgraph_gl_shader_cache_to_disk(ShaderBinding *binding)
     GLint program_size;
     glGetProgramiv(binding->gl_program, GL_PROGRAM_BINARY_LENGTH, &program_size);
 
-    if (binding->program) {
-        g_free(binding->program);
-        binding->program = NULL;
-    }
-
     /* program_size might be zero on some systems, if no binary formats are supported */
     if (program_size == 0) {
         return;
     }
 
-    binding->program = g_malloc(program_size);
+    ShaderArchiveProgramHeader hdr = { .state = binding->state };
+    uint8_t *data = g_malloc(sizeof(hdr) + program_size);
     GLsizei program_size_copied;
     glGetProgramBinary(binding->gl_program, program_size, &program_size_copied,
-                       &binding->program_format, binding->program);
+                       &hdr.program_format, data + sizeof(hdr));
     assert(glGetError() == GL_NO_ERROR);
+    memcpy(data, &hdr, sizeof(hdr));
 
-    binding->program_size = program_size_copied;
     binding->cached = true;
 
-    char name[24];
-    snprintf(name, sizeof(name), "scache-%llx", (unsigned long long) binding->node.hash);
-    binding->save_thread = g_malloc0(sizeof(QemuThread));
-    qemu_thread_create(binding->save_thread, name, shader_write_to_disk, binding, QEMU_THREAD_JOINABLE);
+    shader_archive_put(r->shader_archive, binding->node.hash, data,
+                       sizeof(hdr) + program_size_copied);
 }
 
 static void apply_uniform_updates(const UniformInfo *info, int *locs,
@@ -789,14 +888,22 @@ void pgraph_gl_bind_shaders(PGRAPHState *pg)
     LruNode *node = lru_lookup(&r->shader_cache, shader_state_hash, &state);
     ShaderBinding *binding = container_of(node, ShaderBinding, node);
 
-    if (!binding->initialized && !pgraph_gl_shader_load_from_memory(binding)) {
+    if (!binding->initialized && !shader_load_from_archive(r, binding)) {
         nv2a_profile_inc_counter(NV2A_PROF_SHADER_GEN);
         generate_shaders(r, binding);
         if (g_config.perf.cache_shaders) {
-            pgraph_gl_shader_cache_to_disk(binding);
+            pgraph_gl_shader_cache_to_disk(r, binding);
         }
     }
     assert(binding->initialized);
+    if (binding->gl_fence) {
+        glWaitSync(binding->gl_fence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(binding->gl_fence);
+        binding->gl_fence = NULL;
+    }
+    if (binding->use_count < UINT32_MAX) {
+        binding->use_count++;
+    }
     r->shader_binding = binding;
     pg->program_data_dirty = false;
 
@@ -772,6 +772,8 @@ static void surface_download(NV2AState *d, SurfaceBinding *surface, bool force)
     /* FIXME: Respect write enable at last TOU? */
 
     nv2a_profile_inc_counter(NV2A_PROF_SURF_DOWNLOAD);
+    nv2a_profile_add_counter(NV2A_PROF_SURF_DOWNLOAD_BYTES,
+                             surface->pitch * surface->height);
 
     surface_download_to_buffer(d, surface, true, false, true,
                                d->vram_ptr + surface->vram_addr);
@@ -874,6 +876,8 @@ void pgraph_gl_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
     }
 
     nv2a_profile_inc_counter(NV2A_PROF_SURF_UPLOAD);
+    nv2a_profile_add_counter(NV2A_PROF_SURF_UPLOAD_BYTES,
+                             surface->pitch * surface->height);
 
     trace_nv2a_pgraph_surface_upload(
                  surface->color ? "COLOR" : "ZETA",
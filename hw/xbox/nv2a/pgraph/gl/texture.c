@@ -27,8 +27,23 @@
 #include "debug.h"
 #include "renderer.h"
 
-static TextureBinding* generate_texture(const TextureShape s, const uint8_t *texture_data, const uint8_t *palette_data);
+static TextureBinding* generate_texture(PGRAPHGLState *r, const TextureShape s, const uint8_t *texture_data, const uint8_t *palette_data, size_t palette_length);
 static void texture_binding_destroy(gpointer data);
+static void expand_indexed_texture(PGRAPHGLState *r, TextureBinding *binding,
+                                   const TextureShape s,
+                                   const uint8_t *texture_data,
+                                   const uint8_t *palette_data,
+                                   size_t palette_length);
+
+/*
+ * Palettized 2D textures are expanded on the GPU, with the palette held in a
+ * texture of its own; other palettized textures are converted on the CPU.
+ */
+static bool expands_palette_on_gpu(const TextureShape *s)
+{
+    return s->color_format == NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8 &&
+           !s->cubemap && s->dimensionality == 2;
+}
 
 struct pgraph_texture_possibly_dirty_struct {
     hwaddr addr, end;
@@ -54,6 +69,12 @@ static void mark_textures_possibly_dirty_visitor(Lru *lru, LruNode *node, void *
         overlapping |= !(test->addr > k_pal_end || k_pal_addr > test->end);
     }
 
+    if (tnode->binding->palette_length > 0) {
+        uintptr_t b_pal_addr = tnode->binding->palette_vram_offset;
+        uintptr_t b_pal_end = b_pal_addr + tnode->binding->palette_length - 1;
+        overlapping |= !(test->addr > b_pal_end || b_pal_addr > test->end);
+    }
+
     tnode->possibly_dirty |= overlapping;
 }
 
@@ -249,6 +270,7 @@ void pgraph_gl_bind_textures(NV2AState *d)
                < memory_region_size(d->vram));
         bool is_indexed = (state.color_format ==
                 NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8);
+        bool palette_on_gpu = expands_palette_on_gpu(&state);
         bool possibly_dirty = false;
         bool possibly_dirty_checked = false;
 
@@ -318,7 +340,9 @@ void pgraph_gl_bind_textures(NV2AState *d)
         key.state = state;
         key.texture_vram_offset = texture_vram_offset;
         key.texture_length = length;
-        if (is_indexed) {
+        if (is_indexed && !palette_on_gpu) {
+            // GPU expanded textures keep the palette out of the key, so a
+            // palette moving around in memory only swaps the palette texture
             key.palette_vram_offset = palette_vram_offset;
             key.palette_length = palette_length;
         }
@@ -330,6 +354,12 @@ void pgraph_gl_bind_textures(NV2AState *d)
         TextureLruNode *key_out = container_of(found, TextureLruNode, node);
         possibly_dirty |= (key_out->binding == NULL) || key_out->possibly_dirty;
 
+        bool palette_moved =
+            palette_on_gpu && key_out->binding != NULL &&
+            (key_out->binding->palette_vram_offset != palette_vram_offset ||
+             key_out->binding->palette_length != palette_length);
+        possibly_dirty |= palette_moved;
+
         if (!surf_to_tex && !possibly_dirty_checked) {
             possibly_dirty |= check_texture_possibly_dirty(
                     d,
@@ -344,10 +374,11 @@ void pgraph_gl_bind_textures(NV2AState *d)
         void *palette_data = (char*)d->vram_ptr + palette_vram_offset;
 
         uint64_t tex_data_hash = 0;
+        uint64_t palette_hash = 0;
         if (!surf_to_tex && possibly_dirty) {
             tex_data_hash = fast_hash(texture_data, length);
             if (is_indexed) {
-                tex_data_hash ^= fast_hash(palette_data, palette_length);
+                palette_hash = fast_hash(palette_data, palette_length);
             }
         }
 
@@ -355,6 +386,13 @@ void pgraph_gl_bind_textures(NV2AState *d)
         bool must_destroy = (key_out->binding != NULL)
                             && possibly_dirty
                             && (key_out->binding->data_hash != tex_data_hash);
+        bool palette_changed = !must_destroy
+                               && (key_out->binding != NULL)
+                               && possibly_dirty
+                               && (key_out->binding->palette_hash != palette_hash);
+        if (palette_changed && !key_out->binding->gl_palette_texture) {
+            must_destroy = true;
+        }
         if (must_destroy) {
             texture_binding_destroy(key_out->binding);
             key_out->binding = NULL;
@@ -362,13 +400,38 @@ void pgraph_gl_bind_textures(NV2AState *d)
 
         if (key_out->binding == NULL) {
             // Must create the texture
-            key_out->binding = generate_texture(state, texture_data, palette_data);
+            nv2a_profile_inc_counter(NV2A_PROF_TEX_CACHE_MISS);
+            if (!surf_to_tex) {
+                nv2a_profile_add_counter(
+                    NV2A_PROF_TEX_UPLOAD_BYTES,
+                    length + (is_indexed ? palette_length : 0));
+            }
+            key_out->binding = generate_texture(r, state, texture_data,
+                                                palette_data,
+                                                is_indexed ? palette_length : 0);
             key_out->binding->data_hash = tex_data_hash;
+            key_out->binding->palette_hash = palette_hash;
+            if (palette_on_gpu) {
+                key_out->binding->palette_vram_offset = palette_vram_offset;
+                key_out->binding->palette_length = palette_length;
+            }
             key_out->binding->scale = 1;
         } else {
             // Saved an upload! Reuse existing texture in graphics memory.
+            nv2a_profile_inc_counter(NV2A_PROF_TEX_CACHE_HIT);
             glBindTexture(key_out->binding->gl_target,
                           key_out->binding->gl_texture);
+            if (palette_changed) {
+                nv2a_profile_add_counter(NV2A_PROF_TEX_UPLOAD_BYTES,
+                                         palette_length);
+                expand_indexed_texture(r, key_out->binding, state, NULL,
+                                       palette_data, palette_length);
+                key_out->binding->palette_hash = palette_hash;
+            }
+            if (palette_moved) {
+                key_out->binding->palette_vram_offset = palette_vram_offset;
+                key_out->binding->palette_length = palette_length;
+            }
         }
 
         key_out->possibly_dirty = false;
@@ -421,10 +484,179 @@ gl_internal_format_to_s3tc_enum(GLint gl_internal_format)
     }
 }
 
+/*
+ * Palettized 2D textures keep their indices in an R8UI texture and their
+ * palette in a small texture of its own, and are expanded into the sampled
+ * texture on the GPU. If only the palette changes (texture_data is NULL), the
+ * palette is uploaded again and the retained indices are re-expanded.
+ */
+static void expand_indexed_texture(PGRAPHGLState *r, TextureBinding *binding,
+                                   const TextureShape s,
+                                   const uint8_t *texture_data,
+                                   const uint8_t *palette_data,
+                                   size_t palette_length)
+{
+    unsigned int width = s.width, height = s.height;
+    unsigned int levels = s.levels;
+    if (s.border) {
+        width = MAX(16, width * 2);
+        height = MAX(16, height * 2);
+    }
+
+    assert(binding->gl_target == GL_TEXTURE_2D);
+
+    GLint prev_active_texture;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &prev_active_texture);
+
+    if (texture_data) {
+        nv2a_profile_inc_counter(NV2A_PROF_TEX_UPLOAD);
+
+        unsigned int w = width, h = height;
+        for (int level = 0; level < levels; level++) {
+            w = MAX(w, 1);
+            h = MAX(h, 1);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_BGRA,
+                         GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+            w /= 2;
+            h /= 2;
+        }
+
+        glGenTextures(1, &binding->gl_index_texture);
+        glActiveTexture(GL_TEXTURE0 + NV2A_MAX_TEXTURES);
+        glBindTexture(GL_TEXTURE_2D, binding->gl_index_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        w = width;
+        h = height;
+        for (int level = 0; level < levels; level++) {
+            w = MAX(w, 1);
+            h = MAX(h, 1);
+            uint8_t *unswizzled = (uint8_t *)g_malloc(w * h);
+            unswizzle_rect(texture_data, w, h, unswizzled, w, 1);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R8UI, w, h, 0,
+                         GL_RED_INTEGER, GL_UNSIGNED_BYTE, unswizzled);
+            g_free(unswizzled);
+            texture_data += w * h;
+            w /= 2;
+            h /= 2;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glGenTextures(1, &binding->gl_palette_texture);
+        glActiveTexture(GL_TEXTURE0 + NV2A_MAX_TEXTURES + 1);
+        glBindTexture(GL_TEXTURE_2D, binding->gl_palette_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+
+    nv2a_profile_inc_counter(NV2A_PROF_TEX_PALETTE_UPLOAD);
+
+    glActiveTexture(GL_TEXTURE0 + NV2A_MAX_TEXTURES);
+    glBindTexture(GL_TEXTURE_2D, binding->gl_index_texture);
+    glActiveTexture(GL_TEXTURE0 + NV2A_MAX_TEXTURES + 1);
+    glBindTexture(GL_TEXTURE_2D, binding->gl_palette_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, palette_length / 4, 1, 0,
+                 GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, palette_data);
+    glActiveTexture(prev_active_texture);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, r->pal_rndr.fbo);
+    GLenum draw_buffers[1] = { GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers(1, draw_buffers);
+    glBindVertexArray(r->pal_rndr.vao);
+    glUseProgram(r->pal_rndr.prog);
+
+    glColorMask(true, true, true, true);
+    glDisable(GL_DITHER);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_STENCIL_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    for (int level = 0; level < levels; level++) {
+        width = MAX(width, 1);
+        height = MAX(height, 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, binding->gl_texture, level);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+               GL_FRAMEBUFFER_COMPLETE);
+        glProgramUniform1i(r->pal_rndr.prog, r->pal_rndr.level_loc, level);
+        glViewport(0, 0, width, height);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        width /= 2;
+        height /= 2;
+    }
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->gl_framebuffer);
+    glBindVertexArray(r->gl_vertex_array);
+    glUseProgram(r->shader_binding ? r->shader_binding->gl_program : 0);
+    glBindTexture(GL_TEXTURE_2D, binding->gl_texture);
+}
+
+static void init_palette_expansion(PGRAPHGLState *r)
+{
+    const char *vs =
+        "#version 330\n"
+        "void main()\n"
+        "{\n"
+        "    float x = -1.0 + float((gl_VertexID & 1) << 2);\n"
+        "    float y = -1.0 + float((gl_VertexID & 2) << 1);\n"
+        "    gl_Position = vec4(x, y, 0, 1);\n"
+        "}\n";
+    const char *fs =
+        "#version 330\n"
+        "uniform usampler2D index_tex;\n"
+        "uniform sampler2D palette_tex;\n"
+        "uniform int level;\n"
+        "layout(location = 0) out vec4 out_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    int index = int(texelFetch(index_tex, ivec2(gl_FragCoord.xy), level).r);\n"
+        "    index = min(index, textureSize(palette_tex, 0).x - 1);\n"
+        "    out_Color = texelFetch(palette_tex, ivec2(index, 0), 0);\n"
+        "}\n";
+
+    r->pal_rndr.prog = pgraph_gl_compile_shader(vs, fs);
+    r->pal_rndr.index_tex_loc =
+        glGetUniformLocation(r->pal_rndr.prog, "index_tex");
+    r->pal_rndr.palette_tex_loc =
+        glGetUniformLocation(r->pal_rndr.prog, "palette_tex");
+    r->pal_rndr.level_loc = glGetUniformLocation(r->pal_rndr.prog, "level");
+    glProgramUniform1i(r->pal_rndr.prog, r->pal_rndr.index_tex_loc,
+                       NV2A_MAX_TEXTURES);
+    glProgramUniform1i(r->pal_rndr.prog, r->pal_rndr.palette_tex_loc,
+                       NV2A_MAX_TEXTURES + 1);
+
+    glGenVertexArrays(1, &r->pal_rndr.vao);
+    glGenFramebuffers(1, &r->pal_rndr.fbo);
+}
+
+static void finalize_palette_expansion(PGRAPHGLState *r)
+{
+    glDeleteProgram(r->pal_rndr.prog);
+    r->pal_rndr.prog = 0;
+
+    glDeleteVertexArrays(1, &r->pal_rndr.vao);
+    r->pal_rndr.vao = 0;
+
+    glDeleteFramebuffers(1, &r->pal_rndr.fbo);
+    r->pal_rndr.fbo = 0;
+}
+
 static void upload_gl_texture(GLenum gl_target,
                               const TextureShape s,
                               const uint8_t *texture_data,
-                              const uint8_t *palette_data)
+                              const uint8_t *palette_data,
+                              size_t palette_length)
 {
     ColorFormatInfo f = kelvin_color_format_gl_map[s.color_format];
     nv2a_profile_inc_counter(NV2A_PROF_TEX_UPLOAD);
@@ -450,8 +682,8 @@ static void upload_gl_texture(GLenum gl_target,
             assert(s.pitch % f.bytes_per_pixel == 0);
 
             uint8_t *converted = pgraph_convert_texture_data(
-                s, texture_data, palette_data, adjusted_width, adjusted_height, 1,
-                adjusted_pitch, 0, NULL);
+                s, texture_data, palette_data, palette_length, adjusted_width,
+                adjusted_height, 1, adjusted_pitch, 0, NULL);
             glPixelStorei(GL_UNPACK_ROW_LENGTH,
                           converted ? 0 : adjusted_pitch / f.bytes_per_pixel);
             glTexImage2D(GL_TEXTURE_2D, 0, f.gl_internal_format,
@@ -525,8 +757,8 @@ static void upload_gl_texture(GLenum gl_target,
                 unswizzle_rect(texture_data, width, height,
                                unswizzled, pitch, f.bytes_per_pixel);
                 uint8_t *converted = pgraph_convert_texture_data(
-                    s, unswizzled, palette_data, width, height, 1, pitch, 0,
-                    NULL);
+                    s, unswizzled, palette_data, palette_length, width, height,
+                    1, pitch, 0, NULL);
                 uint8_t *pixel_data = converted ? converted : unswizzled;
                 unsigned int tex_width = width;
                 unsigned int tex_height = height;
@@ -611,8 +843,8 @@ static void upload_gl_texture(GLenum gl_target,
                                row_pitch, slice_pitch, f.bytes_per_pixel);
 
                 uint8_t *converted = pgraph_convert_texture_data(
-                    s, unswizzled, palette_data, width, height, depth,
-                    row_pitch, slice_pitch, NULL);
+                    s, unswizzled, palette_data, palette_length, width, height,
+                    depth, row_pitch, slice_pitch, NULL);
 
                 glTexImage3D(gl_target, level, f.gl_internal_format,
                              width, height, depth, 0,
@@ -639,9 +871,11 @@ static void upload_gl_texture(GLenum gl_target,
     }
 }
 
-static TextureBinding* generate_texture(const TextureShape s,
+static TextureBinding* generate_texture(PGRAPHGLState *r,
+                                        const TextureShape s,
                                         const uint8_t *texture_data,
-                                        const uint8_t *palette_data)
+                                        const uint8_t *palette_data,
+                                        size_t palette_length)
 {
     ColorFormatInfo f = kelvin_color_format_gl_map[s.color_format];
 
@@ -672,6 +906,9 @@ static TextureBinding* generate_texture(const TextureShape s,
 
     glBindTexture(gl_target, gl_texture);
 
+    bool expand_on_gpu = expands_palette_on_gpu(&s);
+    assert(!expand_on_gpu || gl_target == GL_TEXTURE_2D);
+
     NV2A_GL_DLABEL(GL_TEXTURE, gl_texture,
                    "offset: 0x%08lx, format: 0x%02X%s, %d dimensions%s, "
                    "width: %d, height: %d, depth: %d",
@@ -711,19 +948,26 @@ static TextureBinding* generate_texture(const TextureShape s,
         length = (length + NV2A_CUBEMAP_FACE_ALIGNMENT - 1) & ~(NV2A_CUBEMAP_FACE_ALIGNMENT - 1);
 
         upload_gl_texture(GL_TEXTURE_CUBE_MAP_POSITIVE_X,
-                          s, texture_data + 0 * length, palette_data);
+                          s, texture_data + 0 * length, palette_data,
+                          palette_length);
         upload_gl_texture(GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-                          s, texture_data + 1 * length, palette_data);
+                          s, texture_data + 1 * length, palette_data,
+                          palette_length);
         upload_gl_texture(GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-                          s, texture_data + 2 * length, palette_data);
+                          s, texture_data + 2 * length, palette_data,
+                          palette_length);
         upload_gl_texture(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-                          s, texture_data + 3 * length, palette_data);
+                          s, texture_data + 3 * length, palette_data,
+                          palette_length);
         upload_gl_texture(GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-                          s, texture_data + 4 * length, palette_data);
+                          s, texture_data + 4 * length, palette_data,
+                          palette_length);
         upload_gl_texture(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-                          s, texture_data + 5 * length, palette_data);
-    } else {
-        upload_gl_texture(gl_target, s, texture_data, palette_data);
+                          s, texture_data + 5 * length, palette_data,
+                          palette_length);
+    } else if (!expand_on_gpu) {
+        upload_gl_texture(gl_target, s, texture_data, palette_data,
+                          palette_length);
     }
 
     /* Linear textures don't support mipmapping */
@@ -743,9 +987,14 @@ static TextureBinding* generate_texture(const TextureShape s,
     TextureBinding* ret = (TextureBinding *)g_malloc(sizeof(TextureBinding));
     ret->gl_target = gl_target;
     ret->gl_texture = gl_texture;
+    ret->gl_index_texture = 0;
+    ret->gl_palette_texture = 0;
+    ret->palette_vram_offset = 0;
+    ret->palette_length = 0;
     ret->refcnt = 1;
     ret->draw_time = 0;
     ret->data_hash = 0;
+    ret->palette_hash = 0;
     ret->min_filter = 0xFFFFFFFF;
     ret->mag_filter = 0xFFFFFFFF;
     ret->lod_bias = 0xFFFFFFFF;
@@ -753,6 +1002,12 @@ static TextureBinding* generate_texture(const TextureShape s,
     ret->addrv = 0xFFFFFFFF;
     ret->addrp = 0xFFFFFFFF;
     ret->border_color_set = false;
+
+    if (expand_on_gpu) {
+        expand_indexed_texture(r, ret, s, texture_data, palette_data,
+                               palette_length);
+    }
+
     return ret;
 }
 
@@ -763,6 +1018,10 @@ static void texture_binding_destroy(gpointer data)
     binding->refcnt--;
     if (binding->refcnt == 0) {
         glDeleteTextures(1, &binding->gl_texture);
+        if (binding->gl_index_texture) {
+            glDeleteTextures(1, &binding->gl_index_texture);
+            glDeleteTextures(1, &binding->gl_palette_texture);
+        }
         g_free(binding);
     }
 }
@@ -810,6 +1069,8 @@ void pgraph_gl_init_textures(NV2AState *d)
     r->texture_cache.init_node = texture_cache_entry_init;
     r->texture_cache.compare_nodes = texture_cache_entry_compare;
     r->texture_cache.post_node_evict = texture_cache_entry_post_evict;
+
+    init_palette_expansion(r);
 }
 
 void pgraph_gl_finalize_textures(PGRAPHState *pg)
@@ -821,7 +1082,10 @@ void pgraph_gl_finalize_textures(PGRAPHState *pg)
     }
 
     lru_flush(&r->texture_cache);
+    lru_destroy(&r->texture_cache);
     free(r->texture_cache_entries);
 
     r->texture_cache_entries = NULL;
+
+    finalize_palette_expansion(r);
 }
@@ -49,6 +49,7 @@ static void update_memory_buffer(NV2AState *d, hwaddr addr, hwaddr size,
         glBufferSubData(GL_ARRAY_BUFFER, addr, size,
                         d->vram_ptr + addr);
         nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_1);
+        nv2a_profile_add_counter(NV2A_PROF_VERTEX_SYNC_BYTES, size);
     }
 }
 
@@ -293,6 +294,7 @@ void pgraph_gl_finalize_buffers(PGRAPHState *pg)
     }
     glDeleteBuffers(element_cache_size, element_cache_buffers);
     lru_flush(&r->element_cache);
+    lru_destroy(&r->element_cache);
 
     g_free(r->element_cache_entries);
     r->element_cache_entries = NULL;
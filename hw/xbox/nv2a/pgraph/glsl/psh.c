@@ -804,7 +804,7 @@ static void define_colorkey_comparator(MString *preflight)
 
 static MString* psh_convert(struct PixelShader *ps)
 {
-    MString *preflight = mstring_new();
+    MString *preflight = mstring_new_sized(8192);
     pgraph_glsl_get_vtx_header(preflight, ps->opts.vulkan,
                              ps->state->smooth_shading, true, false, false);
 
@@ -1082,7 +1082,7 @@ static MString* psh_convert(struct PixelShader *ps)
     mstring_append(vars, "vec4 cd;\n");
     mstring_append(vars, "vec4 mux_sum;\n");
 
-    ps->code = mstring_new();
+    ps->code = mstring_new_sized(4096);
 
     bool color_key_comparator_defined = false;
 
@@ -1503,16 +1503,19 @@ static MString* psh_convert(struct PixelShader *ps)
         break;
     }
 
-    MString *final = mstring_new();
+    MString *final = mstring_new_sized(
+        mstring_get_length(preflight) + mstring_get_length(clip) +
+        mstring_get_length(vars) + mstring_get_length(ps->code) + 64);
     mstring_append_fmt(final, "#version %d\n\n", ps->opts.vulkan ? 450 : 400);
-    mstring_append(final, mstring_get_str(preflight));
+    mstring_append_mstring(final, preflight);
     mstring_append(final, "void main() {\n");
-    mstring_append(final, mstring_get_str(clip));
-    mstring_append(final, mstring_get_str(vars));
-    mstring_append(final, mstring_get_str(ps->code));
+    mstring_append_mstring(final, clip);
+    mstring_append_mstring(final, vars);
+    mstring_append_mstring(final, ps->code);
     mstring_append(final, "}\n");
 
     mstring_unref(preflight);
+    mstring_unref(clip);
     mstring_unref(vars);
     mstring_unref(ps->code);
 
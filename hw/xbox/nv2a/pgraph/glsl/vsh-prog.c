@@ -256,8 +256,8 @@ static int16_t convert_c_register(const int16_t c_reg)
     return r; //FIXME: = c_reg?!
 }
 
-static MString *decode_swizzle(const uint32_t *shader_token,
-                               VshFieldName swizzle_field)
+static void append_swizzle(MString *out, const uint32_t *shader_token,
+                           VshFieldName swizzle_field)
 {
     const char* swizzle_str = "xyzw";
     VshSwizzle x, y, z, w;
@@ -276,57 +276,54 @@ static MString *decode_swizzle(const uint32_t *shader_token,
     if (x == SWIZZLE_X && y == SWIZZLE_Y
         && z == SWIZZLE_Z && w == SWIZZLE_W) {
         /* Don't print the swizzle if it's .xyzw */
-        return mstring_from_str(""); // Will turn ".xyzw" into "."
+        return; // Will turn ".xyzw" into "."
+    }
+
+    char swizzle[5] = { '.', swizzle_str[x], swizzle_str[y], swizzle_str[z],
+                        swizzle_str[w] };
+    int len;
     /* Don't print duplicates */
-    } else if (x == y && y == z && z == w) {
-        return mstring_from_str((char[]){'.', swizzle_str[x], '\0'});
+    if (x == y && y == z && z == w) {
+        len = 2;
     } else if (y == z && z == w) {
-        return mstring_from_str((char[]){'.',
-            swizzle_str[x], swizzle_str[y], '\0'});
+        len = 3;
     } else if (z == w) {
-        return mstring_from_str((char[]){'.',
-            swizzle_str[x], swizzle_str[y], swizzle_str[z], '\0'});
+        len = 4;
     } else {
-        return mstring_from_str((char[]){'.',
-                                       swizzle_str[x], swizzle_str[y],
-                                       swizzle_str[z], swizzle_str[w],
-                                       '\0'}); // Normal swizzle mask
+        len = 5; // Normal swizzle mask
     }
+    mstring_append_len(out, swizzle, len);
 }
 
-static MString *decode_opcode_input(const uint32_t *shader_token,
-                                    VshParameterType param,
-                                    VshFieldName neg_field, int reg_num)
+static void append_opcode_input(MString *out, const uint32_t *shader_token,
+                                VshParameterType param,
+                                VshFieldName neg_field, int reg_num)
 {
     /* This function decodes a vertex shader opcode parameter into a string.
      * Input A, B or C is controlled via the Param and NEG fieldnames,
      * the R-register address for each input is already given by caller. */
 
-    MString *ret_str = mstring_new();
-
-
     if (vsh_get_field(shader_token, neg_field) > 0) {
-        mstring_append_fmt(ret_str, "-");
+        mstring_append_chr(out, '-');
     }
 
     /* PARAM_R uses the supplied reg_num, but the other two need to be
      * determined */
-    char tmp[40];
     switch (param) {
     case PARAM_R:
-        snprintf(tmp, sizeof(tmp), "R%d", reg_num);
+        mstring_append_fmt(out, "R%d", reg_num);
         break;
     case PARAM_V:
         reg_num = vsh_get_field(shader_token, FLD_V);
-        snprintf(tmp, sizeof(tmp), "v%d", reg_num);
+        mstring_append_fmt(out, "v%d", reg_num);
         break;
     case PARAM_C:
         reg_num = convert_c_register(vsh_get_field(shader_token, FLD_CONST));
         if (vsh_get_field(shader_token, FLD_A0X) > 0) {
             //FIXME: does this really require the "correction" doe in convert_c_register?!
-            snprintf(tmp, sizeof(tmp), "c[A0+%d]", reg_num);
+            mstring_append_fmt(out, "c[A0+%d]", reg_num);
         } else {
-            snprintf(tmp, sizeof(tmp), "c[%d]", reg_num);
+            mstring_append_fmt(out, "c[%d]", reg_num);
         }
         break;
     default:
@@ -334,16 +331,9 @@ static MString *decode_opcode_input(const uint32_t *shader_token,
         assert(false);
         break;
     }
-    mstring_append(ret_str, tmp);
-
-    {
-        /* swizzle bits are next to the neg bit */
-        MString *swizzle_str = decode_swizzle(shader_token, neg_field+1);
-        mstring_append(ret_str, mstring_get_str(swizzle_str));
-        mstring_unref(swizzle_str);
-    }
 
-    return ret_str;
+    /* swizzle bits are next to the neg bit */
+    append_swizzle(out, shader_token, neg_field + 1);
 }
 
 static MString *decode_opcode(const uint32_t *shader_token,
@@ -444,39 +434,33 @@ static MString *decode_token(const uint32_t *shader_token)
     }
 
     /* Since it's potentially used twice, decode input C once: */
-    MString *input_c =
-        decode_opcode_input(shader_token,
-                            vsh_get_field(shader_token, FLD_C_MUX),
-                            FLD_C_NEG,
-                            (vsh_get_field(shader_token, FLD_C_R_HIGH) << 2)
-                                | vsh_get_field(shader_token, FLD_C_R_LOW));
+    MString *input_c = mstring_new();
+    append_opcode_input(input_c, shader_token,
+                        vsh_get_field(shader_token, FLD_C_MUX),
+                        FLD_C_NEG,
+                        (vsh_get_field(shader_token, FLD_C_R_HIGH) << 2)
+                            | vsh_get_field(shader_token, FLD_C_R_LOW));
 
     MString *mac_suffix = NULL;
     if (mac != MAC_NOP) {
         MString *inputs_mac = mstring_new();
         if (mac_opcode_params[mac].A) {
-            MString *input_a =
-                decode_opcode_input(shader_token,
-                                    vsh_get_field(shader_token, FLD_A_MUX),
-                                    FLD_A_NEG,
-                                    vsh_get_field(shader_token, FLD_A_R));
             mstring_append(inputs_mac, ", ");
-            mstring_append(inputs_mac, mstring_get_str(input_a));
-            mstring_unref(input_a);
+            append_opcode_input(inputs_mac, shader_token,
+                                vsh_get_field(shader_token, FLD_A_MUX),
+                                FLD_A_NEG,
+                                vsh_get_field(shader_token, FLD_A_R));
         }
         if (mac_opcode_params[mac].B) {
-            MString *input_b =
-                decode_opcode_input(shader_token,
-                                    vsh_get_field(shader_token, FLD_B_MUX),
-                                    FLD_B_NEG,
-                                    vsh_get_field(shader_token, FLD_B_R));
             mstring_append(inputs_mac, ", ");
-            mstring_append(inputs_mac, mstring_get_str(input_b));
-            mstring_unref(input_b);
+            append_opcode_input(inputs_mac, shader_token,
+                                vsh_get_field(shader_token, FLD_B_MUX),
+                                FLD_B_NEG,
+                                vsh_get_field(shader_token, FLD_B_R));
         }
         if (mac_opcode_params[mac].C) {
             mstring_append(inputs_mac, ", ");
-            mstring_append(inputs_mac, mstring_get_str(input_c));
+            mstring_append_mstring(inputs_mac, input_c);
         }
 
         /* Then prepend these inputs with the actual opcode, mask, and input : */
@@ -493,7 +477,7 @@ static MString *decode_token(const uint32_t *shader_token)
 
     if (ilu != ILU_NOP) {
         MString *inputs_c = mstring_from_str(", ");
-        mstring_append(inputs_c, mstring_get_str(input_c));
+        mstring_append_mstring(inputs_c, input_c);
 
         /* Append the ILU opcode, mask and (the already determined) input C: */
         MString *ilu_op =
@@ -504,7 +488,7 @@ static MString *decode_token(const uint32_t *shader_token)
                           mstring_get_str(inputs_c),
                           NULL);
 
-        mstring_append(ret, mstring_get_str(ilu_op));
+        mstring_append_mstring(ret, ilu_op);
 
         mstring_unref(inputs_c);
         mstring_unref(ilu_op);
@@ -513,7 +497,7 @@ static MString *decode_token(const uint32_t *shader_token)
     mstring_unref(input_c);
 
     if (mac_suffix) {
-        mstring_append(ret, mstring_get_str(mac_suffix));
+        mstring_append_mstring(ret, mac_suffix);
         mstring_unref(mac_suffix);
     }
 
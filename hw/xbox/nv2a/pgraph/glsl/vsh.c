@@ -284,7 +284,8 @@ MString *pgraph_glsl_gen_vsh(const VshState *state, GenVshGlslOptions opts)
 
     mstring_append(header, "\n");
 
-    MString *body = mstring_from_str("void main() {\n");
+    MString *body = mstring_new_sized(8192);
+    mstring_append(body, "void main() {\n");
 
     for (int i = 0; i < NV2A_VERTEXSHADER_ATTRIBUTES; i++) {
         if (state->compressed_attrs & (1 << i)) {
@@ -444,8 +445,10 @@ MString *pgraph_glsl_gen_vsh(const VshState *state, GenVshGlslOptions opts)
     mstring_append(body, "}\n");
 
     /* Return combined header + source */
-    MString *output =
-        mstring_from_fmt("#version %d\n\n", opts.vulkan ? 450 : 400);
+    MString *output = mstring_new_sized(
+        mstring_get_length(uniforms) + mstring_get_length(header) +
+        mstring_get_length(body) + 256);
+    mstring_append_fmt(output, "#version %d\n\n", opts.vulkan ? 450 : 400);
 
     if (opts.vulkan) {
         // FIXME: Optimize uniforms
@@ -464,14 +467,14 @@ MString *pgraph_glsl_gen_vsh(const VshState *state, GenVshGlslOptions opts)
             "};\n\n",
             opts.ubo_binding, mstring_get_str(uniforms));
     } else {
-        mstring_append(
-            output, mstring_get_str(uniforms));
+        mstring_append_mstring(output, uniforms);
     }
+    mstring_unref(uniforms);
 
-    mstring_append(output, mstring_get_str(header));
+    mstring_append_mstring(output, header);
     mstring_unref(header);
 
-    mstring_append(output, mstring_get_str(body));
+    mstring_append_mstring(output, body);
     mstring_unref(body);
 
     return output;
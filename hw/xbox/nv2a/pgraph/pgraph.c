@@ -114,6 +114,8 @@ void pgraph_write(void *opaque, hwaddr addr, uint64_t val, unsigned int size)
                         % PG_GET_MASK(NV_PGRAPH_SURFACE,
                                    NV_PGRAPH_SURFACE_MODULO_3D) );
             nv2a_profile_increment();
+            timeline_instant("Flip");
+            pgraph_present_flip(d);
             pfifo_kick(d);
         }
         break;
@@ -226,6 +228,7 @@ void pgraph_init(NV2AState *d)
     qemu_event_init(&pg->flush_complete, false);
     qemu_cond_init(&pg->framebuffer_released);
     qemu_event_init(&pg->renderer_switch_complete, false);
+    pgraph_present_init(&pg->present);
     pg->renderer_switch_phase = PGRAPH_RENDERER_SWITCH_PHASE_IDLE;
 
     pg->frame_time = 0;
@@ -244,6 +247,8 @@ void pgraph_init(NV2AState *d)
     }
 
     pgraph_clear_dirty_reg_map(pg);
+
+    nv2a_profile_register_stats();
 }
 
 void pgraph_clear_dirty_reg_map(PGRAPHState *pg)
@@ -317,6 +322,8 @@ static bool attempt_renderer_init(PGRAPHState *pg)
 
 static void init_renderer(PGRAPHState *pg)
 {
+    pgraph_present_reset(&pg->present);
+
     if (attempt_renderer_init(pg)) {
         return;  // Success
     }
@@ -351,6 +358,7 @@ void pgraph_destroy(PGRAPHState *pg)
        pg->renderer->ops.finalize(d);
     }
 
+    pgraph_present_finalize(&pg->present);
     qemu_mutex_destroy(&pg->lock);
 }
 
@@ -381,6 +389,11 @@ void nv2a_release_framebuffer_surface(void)
     qemu_mutex_unlock(&pg->renderer_lock);
 }
 
+void nv2a_framebuffer_presented(void)
+{
+    pgraph_present_shown(&g_nv2a->pgraph.present);
+}
+
 void nv2a_set_surface_scale_factor(unsigned int scale)
 {
     NV2AState *d = g_nv2a;
@@ -410,6 +423,20 @@ unsigned int nv2a_get_surface_scale_factor(void)
     return s;
 }
 
+bool nv2a_get_shader_warmup_progress(int *done, int *total)
+{
+    NV2AState *d = g_nv2a;
+
+    if (!d) {
+        return false;
+    }
+
+    *total = qatomic_read(&d->pgraph.shader_warmup_total);
+    *done = MIN(qatomic_read(&d->pgraph.shader_warmup_done), *total);
+
+    return *total > 0;
+}
+
 #define METHOD_ADDR(gclass, name) \
     gclass ## _ ## name
 #define METHOD_ADDR_TO_INDEX(x) ((x)>>2)
@@ -901,8 +928,10 @@ DEF_METHOD(NV097, FLIP_INCREMENT_WRITE)
 DEF_METHOD(NV097, FLIP_STALL)
 {
     trace_nv2a_pgraph_flip_stall();
+    timeline_begin("Flip Stall");
     d->pgraph.renderer->ops.surface_update(d, false, true, true);
     d->pgraph.renderer->ops.flip_stall(d);
+    timeline_end();
     nv2a_profile_flip_stall();
     pg->waiting_for_flip = true;
 }
@@ -2505,7 +2534,9 @@ DEF_METHOD(NV097, SET_BEGIN_END)
             return;
         }
         nv2a_profile_inc_counter(NV2A_PROF_BEGIN_ENDS);
+        timeline_begin("Draw");
         d->pgraph.renderer->ops.draw_end(d);
+        timeline_end();
         pgraph_reset_inline_buffers(pg);
         pg->primitive_mode = PRIM_TYPE_INVALID;
     } else {
@@ -2665,7 +2696,9 @@ static void pgraph_expand_draw_arrays(NV2AState *d)
      * triggered if a set of BEGIN+DA+END triplets is followed by the
      * BEGIN+DA+ARRAY_ELEMENT+... chain that caused this expansion. */
     if (pg->draw_arrays_length > 1) {
+        timeline_begin("Draw");
         d->pgraph.renderer->ops.flush_draw(d);
+        timeline_end();
         pgraph_reset_inline_buffers(pg);
     }
     assert((pg->inline_elements_length + count) < NV2A_MAX_BATCH_LENGTH);
@@ -69,6 +69,40 @@ typedef struct Surface {
     hwaddr offset;
 } Surface;
 
+#define PGRAPH_PRESENT_MAX_SLOTS 3
+
+typedef enum PresentSlotState {
+    PRESENT_SLOT_FREE,
+    PRESENT_SLOT_RENDERING,
+    PRESENT_SLOT_READY,
+    PRESENT_SLOT_DISPLAYED,
+} PresentSlotState;
+
+typedef struct PresentSlot {
+    PresentSlotState state;
+    uint64_t seq;
+    int64_t flip_time; // Guest flip that produced this frame, 0 if none
+    bool shown;
+} PresentSlot;
+
+/*
+ * Composed display frames handed from the PGRAPH thread to the UI thread.
+ * The renderer owns one display image per slot.
+ */
+typedef struct PresentQueue {
+    QemuMutex lock;
+    PresentSlot slots[PGRAPH_PRESENT_MAX_SLOTS];
+    int num_slots;
+    int displayed;
+    uint64_t next_seq;
+    int64_t pending_flip_time;
+    bool stale; // Display changed without a guest flip
+    int composed_draw_time; // Of the scan-out surface in the newest frame
+    int idle_acquires; // UI frames that reused the displayed frame
+    int64_t last_shown_time;
+    int64_t interval_avg;
+} PresentQueue;
+
 typedef struct KelvinState {
     hwaddr object_instance;
 } KelvinState;
@@ -254,6 +288,8 @@ typedef struct PGRAPHState {
     bool framebuffer_in_use;
     QemuCond framebuffer_released;
 
+    PresentQueue present;
+
     enum {
         PGRAPH_RENDERER_SWITCH_PHASE_IDLE,
         PGRAPH_RENDERER_SWITCH_PHASE_STARTED,
@@ -264,6 +300,9 @@ typedef struct PGRAPHState {
     unsigned int surface_scale_factor;
     uint8_t *scale_buf;
 
+    int shader_warmup_total;
+    int shader_warmup_done;
+
     const PGRAPHRenderer *renderer;
     union {
         PGRAPHNullState *null_renderer_state;
@@ -400,6 +439,17 @@ void pgraph_get_inline_values(PGRAPHState *pg, uint16_t attrs,
                                float values[NV2A_VERTEXSHADER_ATTRIBUTES][4],
                                int *count);
 
+/* Presentation */
+void pgraph_present_init(PresentQueue *q);
+void pgraph_present_finalize(PresentQueue *q);
+void pgraph_present_reset(PresentQueue *q);
+void pgraph_present_flip(NV2AState *d);
+void pgraph_present_invalidate(PresentQueue *q);
+int pgraph_present_begin(PresentQueue *q);
+void pgraph_present_end(PresentQueue *q, int slot, int draw_time);
+int pgraph_present_acquire(NV2AState *d, int draw_time, bool upload_pending);
+void pgraph_present_shown(PresentQueue *q);
+
 /* RDI */
 uint32_t pgraph_rdi_read(PGRAPHState *pg, unsigned int select,
                          unsigned int address);
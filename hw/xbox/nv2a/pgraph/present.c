@@ -0,0 +1,257 @@
+/*
+ * Geforce NV2A PGRAPH Presentation Queue
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hw/xbox/nv2a/nv2a_int.h"
+
+/* Weight of new samples in the smoothed latency and jitter, as a shift */
+#define PRESENT_STATS_SMOOTHING 4
+
+/*
+ * Recompose after this many UI frames without a known change, to pick up CPU
+ * writes to scan-out memory that have not reached the surface yet
+ */
+#define PRESENT_MAX_IDLE_ACQUIRES 4
+
+static void smooth(int64_t *avg, int64_t sample)
+{
+    *avg = *avg ? *avg + ((sample - *avg) >> PRESENT_STATS_SMOOTHING) : sample;
+}
+
+void pgraph_present_init(PresentQueue *q)
+{
+    qemu_mutex_init(&q->lock);
+    pgraph_present_reset(q);
+}
+
+void pgraph_present_finalize(PresentQueue *q)
+{
+    qemu_mutex_destroy(&q->lock);
+}
+
+/* Renderer display images are about to be (re)created, forget all frames */
+void pgraph_present_reset(PresentQueue *q)
+{
+    qemu_mutex_lock(&q->lock);
+    memset(q->slots, 0, sizeof(q->slots));
+    q->num_slots = MAX(2, MIN(g_config.display.presentation.queue_depth,
+                              PGRAPH_PRESENT_MAX_SLOTS));
+    q->displayed = -1;
+    q->pending_flip_time = 0;
+    q->stale = false;
+    q->composed_draw_time = 0;
+    q->idle_acquires = 0;
+    q->last_shown_time = 0;
+    q->interval_avg = 0;
+    qemu_mutex_unlock(&q->lock);
+}
+
+/* Guest flipped to a new frame, compose it without waiting for the UI */
+void pgraph_present_flip(NV2AState *d)
+{
+    PresentQueue *q = &d->pgraph.present;
+
+    qemu_mutex_lock(&q->lock);
+    if (!q->pending_flip_time) {
+        q->pending_flip_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    }
+    qemu_mutex_unlock(&q->lock);
+
+    qatomic_set(&d->pgraph.sync_pending, true);
+}
+
+/*
+ * Scan-out changed outside of PGRAPH, e.g. a CRTC start address or video
+ * overlay update, so the displayed frame must be composed again
+ */
+void pgraph_present_invalidate(PresentQueue *q)
+{
+    qemu_mutex_lock(&q->lock);
+    q->stale = true;
+    qemu_mutex_unlock(&q->lock);
+}
+
+/* Pick a slot for the renderer to compose the next frame into */
+int pgraph_present_begin(PresentQueue *q)
+{
+    int slot = -1;
+
+    qemu_mutex_lock(&q->lock);
+
+    for (int i = 0; i < q->num_slots; i++) {
+        if (q->slots[i].state == PRESENT_SLOT_FREE) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot < 0) {
+        /* UI is behind, replace the oldest queued frame */
+        for (int i = 0; i < q->num_slots; i++) {
+            if (q->slots[i].state == PRESENT_SLOT_READY &&
+                (slot < 0 || q->slots[i].seq < q->slots[slot].seq)) {
+                slot = i;
+            }
+        }
+        g_nv2a_stats.present.dropped++;
+    }
+    assert(slot >= 0);
+
+    q->slots[slot].state = PRESENT_SLOT_RENDERING;
+    q->slots[slot].flip_time = q->pending_flip_time;
+    q->pending_flip_time = 0;
+
+    qemu_mutex_unlock(&q->lock);
+
+    return slot;
+}
+
+/*
+ * Frame in slot has finished rendering on the GPU, composed from a scan-out
+ * surface last drawn at draw_time
+ */
+void pgraph_present_end(PresentQueue *q, int slot, int draw_time)
+{
+    qemu_mutex_lock(&q->lock);
+    assert(q->slots[slot].state == PRESENT_SLOT_RENDERING);
+    q->slots[slot].state = PRESENT_SLOT_READY;
+    q->slots[slot].seq = q->next_seq++;
+    q->slots[slot].shown = false;
+    q->composed_draw_time = draw_time;
+    q->idle_acquires = 0;
+    qemu_mutex_unlock(&q->lock);
+}
+
+static int take_ready_slot(PresentQueue *q)
+{
+    bool newest = g_config.display.presentation.low_latency;
+    int slot = -1;
+
+    qemu_mutex_lock(&q->lock);
+
+    for (int i = 0; i < q->num_slots; i++) {
+        if (q->slots[i].state != PRESENT_SLOT_READY) {
+            continue;
+        }
+        if (slot < 0 || (newest ? q->slots[i].seq > q->slots[slot].seq :
+                                  q->slots[i].seq < q->slots[slot].seq)) {
+            slot = i;
+        }
+    }
+
+    if (slot >= 0) {
+        if (newest) {
+            for (int i = 0; i < q->num_slots; i++) {
+                if (i != slot && q->slots[i].state == PRESENT_SLOT_READY) {
+                    q->slots[i].state = PRESENT_SLOT_FREE;
+                    g_nv2a_stats.present.dropped++;
+                }
+            }
+        }
+        if (q->displayed >= 0) {
+            q->slots[q->displayed].state = PRESENT_SLOT_FREE;
+        }
+        q->slots[slot].state = PRESENT_SLOT_DISPLAYED;
+        q->displayed = slot;
+    }
+
+    qemu_mutex_unlock(&q->lock);
+
+    return slot;
+}
+
+/*
+ * Called from the UI thread with pfifo.lock held, which is released. Returns
+ * the slot to display, or -1 if nothing has been composed.
+ *
+ * Only waits for the PGRAPH thread if no frame has been composed yet.
+ * Otherwise the previous frame is shown, and a new one is composed in the
+ * background if scan-out may have changed without a guest flip: the overlay or
+ * CRTC start changed, the scan-out surface (last drawn at draw_time) was drawn
+ * to or has data waiting to be uploaded, or the frame has been reused for a
+ * while. Guest flips are composed as they happen.
+ */
+int pgraph_present_acquire(NV2AState *d, int draw_time, bool upload_pending)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PresentQueue *q = &pg->present;
+
+    int slot = take_ready_slot(q);
+    if (slot >= 0) {
+        qemu_mutex_unlock(&d->pfifo.lock);
+        return slot;
+    }
+
+    qemu_mutex_lock(&q->lock);
+    slot = q->displayed;
+    bool stale = q->stale || upload_pending ||
+                 draw_time != q->composed_draw_time ||
+                 ++q->idle_acquires >= PRESENT_MAX_IDLE_ACQUIRES;
+    q->stale = false;
+    if (stale) {
+        q->idle_acquires = 0;
+    }
+    qemu_mutex_unlock(&q->lock);
+
+    if (slot >= 0) {
+        if (stale) {
+            qatomic_set(&pg->sync_pending, true);
+            pfifo_kick(d);
+        }
+        qemu_mutex_unlock(&d->pfifo.lock);
+        return slot;
+    }
+
+    qemu_event_reset(&pg->sync_complete);
+    qatomic_set(&pg->sync_pending, true);
+    pfifo_kick(d);
+    qemu_mutex_unlock(&d->pfifo.lock);
+    qemu_event_wait(&pg->sync_complete);
+
+    return take_ready_slot(q);
+}
+
+/* UI has presented the displayed slot, update latency and pacing stats */
+void pgraph_present_shown(PresentQueue *q)
+{
+    int64_t now = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+
+    qemu_mutex_lock(&q->lock);
+
+    if (q->displayed < 0 || q->slots[q->displayed].shown) {
+        qemu_mutex_unlock(&q->lock);
+        return;
+    }
+
+    PresentSlot *s = &q->slots[q->displayed];
+    s->shown = true;
+
+    if (s->flip_time) {
+        smooth(&g_nv2a_stats.present.latency_us, now - s->flip_time);
+    }
+
+    if (q->last_shown_time) {
+        int64_t interval = now - q->last_shown_time;
+        smooth(&q->interval_avg, interval);
+        smooth(&g_nv2a_stats.present.jitter_us,
+               ABS(interval - q->interval_avg));
+    }
+    q->last_shown_time = now;
+
+    qemu_mutex_unlock(&q->lock);
+}
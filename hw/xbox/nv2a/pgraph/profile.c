@@ -18,6 +18,7 @@
  */
 
 #include "hw/xbox/nv2a/nv2a_int.h"
+#include "system/stats.h"
 
 NV2AStats g_nv2a_stats;
 
@@ -50,6 +51,9 @@ void nv2a_profile_flip_stall(void)
     g_nv2a_stats.frame_ptr =
         (g_nv2a_stats.frame_ptr + 1) % NV2A_PROF_NUM_FRAMES;
     g_nv2a_stats.frame_count++;
+    for (int i = 0; i < NV2A_PROF__COUNT; i++) {
+        g_nv2a_stats.totals[i] += g_nv2a_stats.frame_working.counters[i];
+    }
     memset(&g_nv2a_stats.frame_working, 0, sizeof(g_nv2a_stats.frame_working));
 }
 
@@ -72,3 +76,145 @@ int nv2a_profile_get_counter_value(unsigned int cnt)
                        NV2A_PROF_NUM_FRAMES;
     return g_nv2a_stats.frame_history[idx].counters[cnt];
 }
+
+/*
+ * Statistics for QMP query-stats and HMP "info stats vm nv2a". Every profile
+ * counter is reported both as a total over all completed frames and as its
+ * value in the last completed frame.
+ */
+
+typedef struct NV2AStatValue {
+    char *name;
+    StatsType type;
+    int unit; // StatsUnit, or -1 for none
+    int exponent;
+    int64_t value;
+} NV2AStatValue;
+
+static void add_stat(GArray *stats, const char *name, StatsType type, int unit,
+                     int exponent, int64_t value)
+{
+    NV2AStatValue v = {
+        .name = g_ascii_strdown(name, -1),
+        .type = type,
+        .unit = unit,
+        .exponent = exponent,
+        .value = value,
+    };
+    g_array_append_val(stats, v);
+}
+
+static void clear_stat(gpointer data)
+{
+    g_free(((NV2AStatValue *)data)->name);
+}
+
+static GArray *get_stats(void)
+{
+    GArray *stats = g_array_new(false, false, sizeof(NV2AStatValue));
+    g_array_set_clear_func(stats, clear_stat);
+
+    add_stat(stats, "frames", STATS_TYPE_CUMULATIVE, -1, 0,
+             g_nv2a_stats.frame_count);
+    add_stat(stats, "fps", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.increment_fps);
+    unsigned int last = (g_nv2a_stats.frame_ptr + NV2A_PROF_NUM_FRAMES - 1) %
+                        NV2A_PROF_NUM_FRAMES;
+    add_stat(stats, "frame_time", STATS_TYPE_INSTANT, STATS_UNIT_SECONDS, -3,
+             g_nv2a_stats.frame_history[last].mspf);
+
+    add_stat(stats, "texture_cache_entries", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.textures);
+    add_stat(stats, "texture_cache_capacity", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.textures_max);
+    add_stat(stats, "shader_cache_entries", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.shaders);
+    add_stat(stats, "shader_cache_capacity", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.shaders_max);
+    add_stat(stats, "pipeline_cache_entries", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.pipelines);
+    add_stat(stats, "pipeline_cache_capacity", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.pipelines_max);
+    add_stat(stats, "surfaces", STATS_TYPE_INSTANT, -1, 0,
+             g_nv2a_stats.occupancy.surfaces);
+
+    add_stat(stats, "present_latency", STATS_TYPE_INSTANT, STATS_UNIT_SECONDS,
+             -6, g_nv2a_stats.present.latency_us);
+    add_stat(stats, "present_jitter", STATS_TYPE_INSTANT, STATS_UNIT_SECONDS,
+             -6, g_nv2a_stats.present.jitter_us);
+    add_stat(stats, "present_dropped", STATS_TYPE_CUMULATIVE, -1, 0,
+             g_nv2a_stats.present.dropped);
+
+    for (int i = 0; i < NV2A_PROF__COUNT; i++) {
+        const char *name = nv2a_profile_get_counter_name(i);
+        int unit = g_str_has_suffix(name, "_BYTES") ? STATS_UNIT_BYTES : -1;
+        g_autofree char *frame_name = g_strconcat("frame_", name, NULL);
+
+        add_stat(stats, name, STATS_TYPE_CUMULATIVE, unit, 0,
+                 g_nv2a_stats.totals[i]);
+        add_stat(stats, frame_name, STATS_TYPE_INSTANT, unit, 0,
+                 nv2a_profile_get_counter_value(i));
+    }
+
+    return stats;
+}
+
+static void nv2a_stats_cb(StatsResultList **result, StatsTarget target,
+                          strList *names, strList *targets, Error **errp)
+{
+    if (target != STATS_TARGET_VM) {
+        return;
+    }
+
+    g_autoptr(GArray) values = get_stats();
+    StatsList *stats_list = NULL;
+
+    for (int i = values->len - 1; i >= 0; i--) {
+        NV2AStatValue *v = &g_array_index(values, NV2AStatValue, i);
+        if (!apply_str_list_filter(v->name, names)) {
+            continue;
+        }
+
+        Stats *stats = g_new0(Stats, 1);
+        stats->name = g_strdup(v->name);
+        stats->value = g_new0(StatsValue, 1);
+        stats->value->type = QTYPE_QNUM;
+        stats->value->u.scalar = v->value;
+        QAPI_LIST_PREPEND(stats_list, stats);
+    }
+
+    if (stats_list) {
+        add_stats_entry(result, STATS_PROVIDER_NV2A, NULL, stats_list);
+    }
+}
+
+static void nv2a_schemas_cb(StatsSchemaList **result, Error **errp)
+{
+    g_autoptr(GArray) values = get_stats();
+    StatsSchemaValueList *schema_list = NULL;
+
+    for (int i = values->len - 1; i >= 0; i--) {
+        NV2AStatValue *v = &g_array_index(values, NV2AStatValue, i);
+
+        StatsSchemaValue *schema = g_new0(StatsSchemaValue, 1);
+        schema->name = g_strdup(v->name);
+        schema->type = v->type;
+        if (v->unit >= 0) {
+            schema->has_unit = true;
+            schema->unit = v->unit;
+        }
+        if (v->exponent) {
+            schema->has_base = true;
+            schema->base = 10;
+            schema->exponent = v->exponent;
+        }
+        QAPI_LIST_PREPEND(schema_list, schema);
+    }
+
+    add_stats_schema(result, STATS_PROVIDER_NV2A, STATS_TARGET_VM, schema_list);
+}
+
+void nv2a_profile_register_stats(void)
+{
+    add_stats_callbacks(STATS_PROVIDER_NV2A, nv2a_stats_cb, nv2a_schemas_cb);
+}
@@ -23,118 +23,91 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/bswap.h"
 #include "s3tc.h"
 
-static void decode_bc1_colors(uint16_t c0, uint16_t c1, uint8_t r[4],
-                              uint8_t g[4], uint8_t b[4], uint8_t a[16],
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Levels smaller than this are decoded on the calling thread only */
+#define S3TC_PARALLEL_MIN_TEXELS (256 * 256)
+#define S3TC_MAX_THREADS 4
+#define S3TC_ROWS_PER_TASK 8
+
+static inline uint32_t pack_rgba(uint32_t r, uint32_t g, uint32_t b,
+                                 uint32_t a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static void decode_bc1_colors(uint16_t c0, uint16_t c1, uint32_t colors[4],
                               bool transparent)
 {
-    r[0] = ((c0 & 0xF800) >> 8) * 0xFF / 0xF8,
-    g[0] = ((c0 & 0x07E0) >> 3) * 0xFF / 0xFC,
-    b[0] = ((c0 & 0x001F) << 3) * 0xFF / 0xF8,
-    a[0] = 255;
+    uint32_t r0 = ((c0 & 0xF800) >> 8) * 0xFF / 0xF8,
+             g0 = ((c0 & 0x07E0) >> 3) * 0xFF / 0xFC,
+             b0 = ((c0 & 0x001F) << 3) * 0xFF / 0xF8;
+    uint32_t r1 = ((c1 & 0xF800) >> 8) * 0xFF / 0xF8,
+             g1 = ((c1 & 0x07E0) >> 3) * 0xFF / 0xFC,
+             b1 = ((c1 & 0x001F) << 3) * 0xFF / 0xF8;
 
-    r[1] = ((c1 & 0xF800) >> 8) * 0xFF / 0xF8,
-    g[1] = ((c1 & 0x07E0) >> 3) * 0xFF / 0xFC,
-    b[1] = ((c1 & 0x001F) << 3) * 0xFF / 0xF8,
-    a[1] = 255;
+    colors[0] = pack_rgba(r0, g0, b0, 255);
+    colors[1] = pack_rgba(r1, g1, b1, 255);
 
     if (transparent) {
-        r[2] = (r[0]+r[1])/2;
-        g[2] = (g[0]+g[1])/2;
-        b[2] = (b[0]+b[1])/2;
-        a[2] = 255;
-
-        r[3] = 0;
-        g[3] = 0;
-        b[3] = 0;
-        a[3] = 0;
+        colors[2] = pack_rgba((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+        colors[3] = 0;
     } else {
-        r[2] = (2*r[0]+r[1])/3;
-        g[2] = (2*g[0]+g[1])/3,
-        b[2] = (2*b[0]+b[1])/3;
-        a[2] = 255;
-
-        r[3] = (r[0]+2*r[1])/3;
-        g[3] = (g[0]+2*g[1])/3;
-        b[3] = (b[0]+2*b[1])/3;
-        a[3] = 255;
-    }
-}
-
-static void write_block_to_texture(uint8_t *converted_data, uint32_t indices,
-                                   int i, int j, int width, int height,
-                                   int z_pos_factor, uint8_t r[4],
-                                   uint8_t g[4], uint8_t b[4], uint8_t a[16],
-                                   bool separate_alpha)
-{
-    int x0 = i * 4,
-        y0 = j * 4;
-
-    int x1 = x0 + 4,
-        y1 = y0 + 4;
-
-    for (int y = y0; y < y1 && y < height; y++) {
-        int y_index = 4 * (y - y0);
-        int z_plus_y_pos_factor = z_pos_factor + y * width;
-        for (int x = x0; x < x1 && x < width; x++) {
-            int xy_index = y_index + x - x0;
-            uint8_t index = (indices >> 2 * xy_index) & 0x03;
-            uint8_t alpha_index = separate_alpha ? xy_index : index;
-            uint8_t *p = converted_data + (z_plus_y_pos_factor + x) * 4;
-            *p++ = r[index];
-            *p++ = g[index];
-            *p++ = b[index];
-            *p++ = a[alpha_index];
-        }
+        colors[2] = pack_rgba((2 * r0 + r1) / 3, (2 * g0 + g1) / 3,
+                              (2 * b0 + b1) / 3, 255);
+        colors[3] = pack_rgba((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3,
+                              (b0 + 2 * b1) / 3, 255);
     }
 }
 
-static void decompress_dxt1_block(const uint8_t block_data[8],
-                                  uint8_t *converted_data, int i, int j,
-                                  int width, int height, int z_pos_factor)
+/*
+ * Expand one row of 2-bit color indices into 4 texels. If alpha is given, it
+ * replaces the alpha channel of the selected colors.
+ */
+static inline void decode_row(uint8_t indices, const uint32_t colors[4],
+                              const uint8_t *alpha, uint32_t out[4])
 {
-    uint16_t c0 = ((uint16_t*)block_data)[0],
-             c1 = ((uint16_t*)block_data)[1];
-    uint8_t r[4], g[4], b[4], a[16];
-    decode_bc1_colors(c0, c1, r, g, b, a, c0 <= c1);
-
-    uint32_t indices = ((uint32_t*)block_data)[1];
-    write_block_to_texture(converted_data, indices,
-                           i, j, width, height, z_pos_factor,
-                           r, g, b, a, false);
+#ifdef __SSE2__
+    __m128i idx = _mm_setr_epi32(indices & 3, (indices >> 2) & 3,
+                                 (indices >> 4) & 3, indices >> 6);
+    __m128i px = _mm_setzero_si128();
+    for (int k = 0; k < 4; k++) {
+        __m128i sel = _mm_cmpeq_epi32(idx, _mm_set1_epi32(k));
+        px = _mm_or_si128(px, _mm_and_si128(sel, _mm_set1_epi32(colors[k])));
+    }
+    if (alpha) {
+        __m128i a = _mm_setr_epi32(alpha[0], alpha[1], alpha[2], alpha[3]);
+        px = _mm_or_si128(_mm_and_si128(px, _mm_set1_epi32(0x00FFFFFF)),
+                          _mm_slli_epi32(a, 24));
+    }
+    _mm_storeu_si128((__m128i *)out, px);
+#else
+    for (int k = 0; k < 4; k++) {
+        out[k] = colors[(indices >> (2 * k)) & 3];
+        if (alpha) {
+            out[k] = (out[k] & 0x00FFFFFF) | ((uint32_t)alpha[k] << 24);
+        }
+    }
+#endif
 }
 
-static void decompress_dxt3_block(const uint8_t block_data[16],
-                                  uint8_t *converted_data, int i, int j,
-                                  int width, int height, int z_pos_factor)
+static void decode_dxt3_alpha(const uint8_t block_data[16], uint8_t a[16])
 {
-    uint16_t c0 = ((uint16_t*)block_data)[4],
-             c1 = ((uint16_t*)block_data)[5];
-    uint8_t r[4], g[4], b[4], a[16];
-    decode_bc1_colors(c0, c1, r, g, b, a, false);
-
-    uint64_t alpha = ((uint64_t*)block_data)[0];
-    for (int a_i=0; a_i < 16; a_i++) {
-        a[a_i] = (((alpha >> 4*a_i) & 0x0F) << 4) * 0xFF / 0xF0;
+    uint64_t alpha = ldq_le_p(block_data);
+    for (int i = 0; i < 16; i++) {
+        a[i] = ((alpha >> (4 * i)) & 0x0F) * 0x11;
     }
-
-    uint32_t indices = ((uint32_t*)block_data)[3];
-    write_block_to_texture(converted_data, indices,
-                           i, j, width, height, z_pos_factor,
-                           r, g, b, a, true);
 }
 
-static void decompress_dxt5_block(const uint8_t block_data[16],
-                                  uint8_t *converted_data, int i, int j,
-                                  int width, int height, int z_pos_factor)
+static void decode_dxt5_alpha(const uint8_t block_data[16], uint8_t a[16])
 {
-    uint16_t c0 = ((uint16_t*)block_data)[4],
-             c1 = ((uint16_t*)block_data)[5];
-    uint8_t r[4], g[4], b[4], a[16];
-    decode_bc1_colors(c0, c1, r, g, b, a, false);
-
-    uint64_t alpha = ((uint64_t*)block_data)[0];
+    uint64_t alpha = ldq_le_p(block_data);
     uint8_t a0 = block_data[0];
     uint8_t a1 = block_data[1];
     uint8_t a_palette[8];
@@ -155,56 +128,212 @@ static void decompress_dxt5_block(const uint8_t block_data[16],
         a_palette[6] = 0;
         a_palette[7] = 255;
     }
-    for (int a_i = 0; a_i < 16; a_i++) {
-        a[a_i] = a_palette[(alpha >> (16+3*a_i)) & 0x07];
+    for (int i = 0; i < 16; i++) {
+        a[i] = a_palette[(alpha >> (16 + 3 * i)) & 0x07];
+    }
+}
+
+static void decode_block(enum S3TC_DECOMPRESS_FORMAT format,
+                         const uint8_t *block_data, uint32_t texels[16])
+{
+    uint32_t colors[4];
+    uint8_t a[16];
+    const uint8_t *alpha = NULL;
+
+    if (format == S3TC_DECOMPRESS_FORMAT_DXT1) {
+        uint16_t c0 = lduw_le_p(block_data), c1 = lduw_le_p(block_data + 2);
+        decode_bc1_colors(c0, c1, colors, c0 <= c1);
+        block_data += 4;
+    } else {
+        if (format == S3TC_DECOMPRESS_FORMAT_DXT3) {
+            decode_dxt3_alpha(block_data, a);
+        } else {
+            assert(format == S3TC_DECOMPRESS_FORMAT_DXT5);
+            decode_dxt5_alpha(block_data, a);
+        }
+        alpha = a;
+        decode_bc1_colors(lduw_le_p(block_data + 8),
+                          lduw_le_p(block_data + 10), colors, false);
+        block_data += 12;
     }
 
-    uint32_t indices = ((uint32_t*)block_data)[3];
-    write_block_to_texture(converted_data, indices,
-                           i, j, width, height, z_pos_factor,
-                           r, g, b, a, true);
+    for (int y = 0; y < 4; y++) {
+        decode_row(block_data[y], colors, alpha ? &alpha[4 * y] : NULL,
+                   &texels[4 * y]);
+    }
 }
 
-uint8_t *s3tc_decompress_3d(enum S3TC_DECOMPRESS_FORMAT color_format,
-                            const uint8_t *data, unsigned int width,
-                            unsigned int height, unsigned int depth)
+static size_t get_block_size(enum S3TC_DECOMPRESS_FORMAT format)
 {
-    assert(width > 0);
-    assert(height > 0);
-    assert(depth > 0);
-    unsigned int physical_width = (width + 3) & ~3,
-                 physical_height = (height + 3) & ~3;
-    int num_blocks_x = physical_width/4,
-        num_blocks_y = physical_height/4,
-        num_blocks_z = (depth + 3)/4;
-    uint8_t *converted_data = (uint8_t*)g_malloc(width * height * depth * 4);
-    int cur_depth = 0;
-    int sub_block_index = 0;
-    for (int k = 0; k < num_blocks_z; k++) {
-        int residual_depth = depth - cur_depth;
-        int block_depth = MIN(residual_depth, 4);
-        for (int j = 0; j < num_blocks_y; j++) {
-            for (int i = 0; i < num_blocks_x; i++) {
-                for (int slice = 0; slice < block_depth; slice++) {
-                    int z_pos_factor = (cur_depth + slice) * width * height;
-                    if (color_format == S3TC_DECOMPRESS_FORMAT_DXT1) {
-                        decompress_dxt1_block(data + 8 * sub_block_index, converted_data,
-                                              i, j, width, height, z_pos_factor);
-                    } else if (color_format == S3TC_DECOMPRESS_FORMAT_DXT3) {
-                        decompress_dxt3_block(data + 16 * sub_block_index, converted_data,
-                                              i, j, width, height, z_pos_factor);
-                    } else if (color_format == S3TC_DECOMPRESS_FORMAT_DXT5) {
-                        decompress_dxt5_block(data + 16 * sub_block_index, converted_data,
-                                              i, j, width, height, z_pos_factor);
-                    } else {
-                        assert(false);
-                    }
-                    sub_block_index++;
+    return format == S3TC_DECOMPRESS_FORMAT_DXT1 ? 8 : 16;
+}
+
+typedef struct S3TCJob {
+    enum S3TC_DECOMPRESS_FORMAT format;
+    const uint8_t *data;
+    unsigned int width, height, depth;
+    uint8_t *out;
+
+    /* One row of blocks in one group of (up to) 4 slices */
+    int num_rows;
+    int next_row;
+
+    GMutex lock;
+    GCond cond;
+    int active_workers;
+} S3TCJob;
+
+/*
+ * Volume textures store the blocks covering up to 4 consecutive slices next
+ * to each other; 2D textures are the single slice case.
+ */
+static void decode_block_row(S3TCJob *job, int row)
+{
+    unsigned int num_blocks_x = (job->width + 3) / 4,
+                 num_blocks_y = (job->height + 3) / 4;
+    int k = row / num_blocks_y, j = row % num_blocks_y;
+    int z0 = k * 4;
+    int block_depth = MIN(job->depth - z0, 4);
+    size_t block_size = get_block_size(job->format);
+    const uint8_t *block_data =
+        job->data + block_size * ((size_t)z0 * num_blocks_x * num_blocks_y +
+                                  (size_t)j * num_blocks_x * block_depth);
+    size_t row_pitch = job->width * 4;
+    size_t slice_pitch = row_pitch * job->height;
+    int y0 = j * 4;
+    int rows = MIN(job->height - y0, 4);
+
+    for (int i = 0; i < num_blocks_x; i++) {
+        int x0 = i * 4;
+        int cols = MIN(job->width - x0, 4);
+        for (int slice = 0; slice < block_depth; slice++) {
+            uint32_t texels[16];
+            decode_block(job->format, block_data, texels);
+            block_data += block_size;
+
+            uint8_t *dst = job->out + (z0 + slice) * slice_pitch +
+                           y0 * row_pitch + x0 * 4;
+            if (cols == 4) {
+                for (int y = 0; y < rows; y++) {
+                    memcpy(dst + y * row_pitch, &texels[4 * y], 16);
+                }
+            } else {
+                for (int y = 0; y < rows; y++) {
+                    memcpy(dst + y * row_pitch, &texels[4 * y], cols * 4);
                 }
             }
         }
-        cur_depth += block_depth;
     }
+}
+
+static void run_job(S3TCJob *job)
+{
+    for (;;) {
+        int row = qatomic_fetch_add(&job->next_row, S3TC_ROWS_PER_TASK);
+        if (row >= job->num_rows) {
+            break;
+        }
+        int end = MIN(row + S3TC_ROWS_PER_TASK, job->num_rows);
+        for (; row < end; row++) {
+            decode_block_row(job, row);
+        }
+    }
+}
+
+static void worker_func(gpointer data, gpointer user_data)
+{
+    S3TCJob *job = data;
+
+    run_job(job);
+
+    g_mutex_lock(&job->lock);
+    if (--job->active_workers == 0) {
+        g_cond_signal(&job->cond);
+    }
+    g_mutex_unlock(&job->lock);
+}
+
+static GThreadPool *thread_pool;
+static int thread_pool_size;
+
+static gpointer init_thread_pool(gpointer opaque)
+{
+    thread_pool_size = MIN(g_get_num_processors(), S3TC_MAX_THREADS) - 1;
+    if (thread_pool_size > 0) {
+        thread_pool = g_thread_pool_new(worker_func, NULL, thread_pool_size,
+                                        false, NULL);
+    }
+    if (!thread_pool) {
+        thread_pool_size = 0;
+    }
+    return NULL;
+}
+
+void s3tc_decompress_3d_to(enum S3TC_DECOMPRESS_FORMAT color_format,
+                           const uint8_t *data, unsigned int width,
+                           unsigned int height, unsigned int depth,
+                           uint8_t *out)
+{
+    assert(width > 0);
+    assert(height > 0);
+    assert(depth > 0);
+
+    S3TCJob job = {
+        .format = color_format,
+        .data = data,
+        .width = width,
+        .height = height,
+        .depth = depth,
+        .out = out,
+        .num_rows = (depth + 3) / 4 * ((height + 3) / 4),
+    };
+
+    int num_workers = 0;
+    if ((size_t)width * height * depth >= S3TC_PARALLEL_MIN_TEXELS) {
+        static GOnce once = G_ONCE_INIT;
+        g_once(&once, init_thread_pool, NULL);
+        num_workers = MIN(thread_pool_size,
+                          job.num_rows / S3TC_ROWS_PER_TASK - 1);
+    }
+
+    if (num_workers <= 0) {
+        run_job(&job);
+        return;
+    }
+
+    g_mutex_init(&job.lock);
+    g_cond_init(&job.cond);
+    job.active_workers = num_workers;
+    for (int i = 0; i < num_workers; i++) {
+        g_thread_pool_push(thread_pool, &job, NULL);
+    }
+
+    run_job(&job);
+
+    g_mutex_lock(&job.lock);
+    while (job.active_workers > 0) {
+        g_cond_wait(&job.cond, &job.lock);
+    }
+    g_mutex_unlock(&job.lock);
+
+    g_cond_clear(&job.cond);
+    g_mutex_clear(&job.lock);
+}
+
+void s3tc_decompress_2d_to(enum S3TC_DECOMPRESS_FORMAT color_format,
+                           const uint8_t *data, unsigned int width,
+                           unsigned int height, uint8_t *out)
+{
+    s3tc_decompress_3d_to(color_format, data, width, height, 1, out);
+}
+
+uint8_t *s3tc_decompress_3d(enum S3TC_DECOMPRESS_FORMAT color_format,
+                            const uint8_t *data, unsigned int width,
+                            unsigned int height, unsigned int depth)
+{
+    uint8_t *converted_data = (uint8_t*)g_malloc(width * height * depth * 4);
+    s3tc_decompress_3d_to(color_format, data, width, height, depth,
+                          converted_data);
     return converted_data;
 }
 
@@ -212,28 +341,29 @@ uint8_t *s3tc_decompress_2d(enum S3TC_DECOMPRESS_FORMAT color_format,
                             const uint8_t *data, unsigned int width,
                             unsigned int height)
 {
-    assert(width > 0);
-    assert(height > 0);
-    unsigned int physical_width = (width + 3) & ~3,
-                 physical_height = (height + 3) & ~3;
-    int num_blocks_x = physical_width / 4, num_blocks_y = physical_height / 4;
     uint8_t *converted_data = (uint8_t *)g_malloc(width * height * 4);
-    for (int j = 0; j < num_blocks_y; j++) {
-        for (int i = 0; i < num_blocks_x; i++) {
-            int block_index = j * num_blocks_x + i;
-            if (color_format == S3TC_DECOMPRESS_FORMAT_DXT1) {
-                decompress_dxt1_block(data + 8 * block_index,
-                                      converted_data, i, j, width, height, 0);
-            } else if (color_format == S3TC_DECOMPRESS_FORMAT_DXT3) {
-                decompress_dxt3_block(data + 16 * block_index,
-                                      converted_data, i, j, width, height, 0);
-            } else if (color_format == S3TC_DECOMPRESS_FORMAT_DXT5) {
-                decompress_dxt5_block(data + 16 * block_index,
-                                      converted_data, i, j, width, height, 0);
-            } else {
-                assert(false);
+    s3tc_decompress_2d_to(color_format, data, width, height, converted_data);
+    return converted_data;
+}
+
+void s3tc_reorder_3d_blocks(enum S3TC_DECOMPRESS_FORMAT color_format,
+                            const uint8_t *data, unsigned int width,
+                            unsigned int height, unsigned int depth,
+                            uint8_t *out)
+{
+    unsigned int num_blocks_x = (width + 3) / 4,
+                 num_blocks_y = (height + 3) / 4;
+    size_t block_size = get_block_size(color_format);
+    size_t slice_size = num_blocks_x * num_blocks_y * block_size;
+
+    for (unsigned int z0 = 0; z0 < depth; z0 += 4) {
+        unsigned int block_depth = MIN(depth - z0, 4);
+        for (unsigned int b = 0; b < num_blocks_x * num_blocks_y; b++) {
+            for (unsigned int slice = 0; slice < block_depth; slice++) {
+                memcpy(out + (z0 + slice) * slice_size + b * block_size, data,
+                       block_size);
+                data += block_size;
             }
         }
     }
-    return converted_data;
 }
@@ -41,4 +41,26 @@ uint8_t *s3tc_decompress_2d(enum S3TC_DECOMPRESS_FORMAT color_format,
                             const uint8_t *data, unsigned int width,
                             unsigned int height);
 
+/*
+ * Decode into caller-provided memory, tightly packed as RGBA8. Large images
+ * are decoded in parallel.
+ */
+void s3tc_decompress_3d_to(enum S3TC_DECOMPRESS_FORMAT color_format,
+                           const uint8_t *data, unsigned int width,
+                           unsigned int height, unsigned int depth,
+                           uint8_t *out);
+
+void s3tc_decompress_2d_to(enum S3TC_DECOMPRESS_FORMAT color_format,
+                           const uint8_t *data, unsigned int width,
+                           unsigned int height, uint8_t *out);
+
+/*
+ * Rearrange the blocks of a volume texture, which interleaves the blocks of
+ * groups of 4 slices, into consecutive slices as expected by host BCn formats.
+ */
+void s3tc_reorder_3d_blocks(enum S3TC_DECOMPRESS_FORMAT color_format,
+                            const uint8_t *data, unsigned int width,
+                            unsigned int height, unsigned int depth,
+                            uint8_t *out);
+
 #endif
@@ -0,0 +1,678 @@
+/*
+ * Geforce NV2A PGRAPH Shader Archive
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Append-only shader archive
+ *
+ * All entries live in a single log file: a header carrying the archive tag,
+ * followed by checksummed records (a zero-sized record removes a key). A
+ * separate open-addressing hash index maps keys to record offsets; both files
+ * are memory mapped at open so loading a cached shader needs no file I/O.
+ *
+ * Records appended since the index was written are picked up by scanning the
+ * log tail. New entries are written by a single background thread, one write
+ * and one sync per batch. On close the index is rewritten from the old index
+ * plus the records appended since, and the log is compacted first if most of
+ * it is made up of stale records.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/host-utils.h"
+#include "qemu/thread.h"
+#include "qemu/fast-hash.h"
+#include <glib/gstdio.h>
+#include "shader_archive.h"
+
+#define ARCHIVE_MAGIC "XSHDARC1"
+#define ARCHIVE_INDEX_MAGIC 0x3158444948535831ULL
+#define ARCHIVE_RECORD_MAGIC 0x43455253
+#define ARCHIVE_ALIGN 8
+#define ARCHIVE_COMPACT_MIN_DEAD_BYTES (4 * 1024 * 1024)
+
+typedef struct ArchiveHeader {
+    char magic[8];
+    uint64_t generation;
+    uint32_t tag_len;
+    uint32_t reserved;
+} ArchiveHeader;
+
+typedef struct RecordHeader {
+    uint32_t magic;
+    uint32_t size;
+    uint64_t key;
+    uint64_t checksum;
+} RecordHeader;
+
+typedef struct IndexHeader {
+    uint64_t magic;
+    uint64_t generation;
+    uint64_t log_size;
+    uint32_t num_buckets;
+    uint32_t num_entries;
+} IndexHeader;
+
+typedef struct IndexEntry {
+    uint64_t key;
+    uint64_t offset; // Of the record header, 0 if the bucket is empty
+} IndexEntry;
+
+typedef struct ArchiveEntry {
+    uint64_t key;
+    uint64_t offset;
+    bool removed;
+} ArchiveEntry;
+
+typedef struct ArchiveWrite {
+    uint64_t key;
+    void *data;
+    size_t size;
+} ArchiveWrite;
+
+struct ShaderArchive {
+    char *path;
+    char *index_path;
+    char *tag;
+    uint64_t generation;
+    uint64_t data_start;
+
+    GMappedFile *log_map;
+    const uint8_t *log_data;
+    uint64_t log_mapped_size;
+
+    GMappedFile *index_map;
+    const IndexHeader *index;
+
+    int fd;
+    uint64_t log_size;
+    bool write_failed;
+    void (*first_write_fn)(void);
+
+    QemuMutex lock;
+    QemuCond work_cond;
+    QemuCond idle_cond;
+    QemuThread writer;
+    GQueue pending;
+    bool writing;
+    bool shutdown;
+    GHashTable *overlay; // Entries not covered by the index
+};
+
+static inline uint64_t align_size(uint64_t size)
+{
+    return ROUND_UP(size, ARCHIVE_ALIGN);
+}
+
+static GHashTable *new_entry_table(void)
+{
+    return g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+}
+
+static void set_entry(GHashTable *table, uint64_t key, uint64_t offset,
+                      bool removed)
+{
+    ArchiveEntry *e = g_hash_table_lookup(table, &key);
+    if (!e) {
+        e = g_new(ArchiveEntry, 1);
+        e->key = key;
+        g_hash_table_insert(table, &e->key, e);
+    }
+    e->offset = offset;
+    e->removed = removed;
+}
+
+static const RecordHeader *get_record(const uint8_t *data, uint64_t size,
+                                      uint64_t offset)
+{
+    if (offset + sizeof(RecordHeader) > size) {
+        return NULL;
+    }
+
+    const RecordHeader *hdr = (const RecordHeader *)(data + offset);
+    if (hdr->magic != ARCHIVE_RECORD_MAGIC ||
+        offset + sizeof(RecordHeader) + align_size(hdr->size) > size) {
+        return NULL;
+    }
+
+    uint64_t checksum = hdr->size ? fast_hash((const uint8_t *)(hdr + 1),
+                                              hdr->size) : 0;
+    if (checksum != hdr->checksum) {
+        return NULL;
+    }
+
+    return hdr;
+}
+
+/* Returns the end of the last intact record */
+static uint64_t scan_log(const uint8_t *data, uint64_t size, uint64_t offset,
+                         GHashTable *entries)
+{
+    const RecordHeader *hdr;
+    while ((hdr = get_record(data, size, offset))) {
+        set_entry(entries, hdr->key, offset, hdr->size == 0);
+        offset += sizeof(RecordHeader) + align_size(hdr->size);
+    }
+
+    return offset;
+}
+
+static uint64_t get_data_start(const char *tag)
+{
+    return align_size(sizeof(ArchiveHeader) + strlen(tag));
+}
+
+static bool map_log(ShaderArchive *ar)
+{
+    ar->log_map = g_mapped_file_new(ar->path, false, NULL);
+    if (!ar->log_map) {
+        return false;
+    }
+
+    const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(ar->log_map);
+    uint64_t size = g_mapped_file_get_length(ar->log_map);
+    const ArchiveHeader *hdr = (const ArchiveHeader *)data;
+    size_t tag_len = strlen(ar->tag);
+
+    if (size < ar->data_start ||
+        memcmp(hdr->magic, ARCHIVE_MAGIC, sizeof(hdr->magic)) ||
+        hdr->tag_len != tag_len ||
+        memcmp(data + sizeof(ArchiveHeader), ar->tag, tag_len)) {
+        g_mapped_file_unref(ar->log_map);
+        ar->log_map = NULL;
+        return false;
+    }
+
+    ar->log_data = data;
+    ar->log_mapped_size = size;
+    ar->generation = hdr->generation;
+    return true;
+}
+
+static void unmap_log(ShaderArchive *ar)
+{
+    if (ar->log_map) {
+        g_mapped_file_unref(ar->log_map);
+        ar->log_map = NULL;
+    }
+    ar->log_data = NULL;
+    ar->log_mapped_size = 0;
+}
+
+static bool map_index(ShaderArchive *ar)
+{
+    ar->index_map = g_mapped_file_new(ar->index_path, false, NULL);
+    if (!ar->index_map) {
+        return false;
+    }
+
+    const IndexHeader *hdr =
+        (const IndexHeader *)g_mapped_file_get_contents(ar->index_map);
+    uint64_t size = g_mapped_file_get_length(ar->index_map);
+
+    if (size < sizeof(IndexHeader) || hdr->magic != ARCHIVE_INDEX_MAGIC ||
+        hdr->generation != ar->generation ||
+        hdr->log_size < ar->data_start ||
+        hdr->log_size > ar->log_mapped_size ||
+        !is_power_of_2(hdr->num_buckets) ||
+        size != sizeof(IndexHeader) +
+                    (uint64_t)hdr->num_buckets * sizeof(IndexEntry)) {
+        g_mapped_file_unref(ar->index_map);
+        ar->index_map = NULL;
+        return false;
+    }
+
+    ar->index = hdr;
+    return true;
+}
+
+static void unmap_index(ShaderArchive *ar)
+{
+    if (ar->index_map) {
+        g_mapped_file_unref(ar->index_map);
+        ar->index_map = NULL;
+    }
+    ar->index = NULL;
+}
+
+static uint64_t index_lookup(const IndexHeader *index, uint64_t key)
+{
+    if (!index) {
+        return 0;
+    }
+
+    const IndexEntry *entries = (const IndexEntry *)(index + 1);
+    uint32_t mask = index->num_buckets - 1;
+
+    for (uint32_t i = key & mask, n = 0; n < index->num_buckets;
+         i = (i + 1) & mask, n++) {
+        if (!entries[i].offset) {
+            break;
+        }
+        if (entries[i].key == key) {
+            return entries[i].offset;
+        }
+    }
+
+    return 0;
+}
+
+static bool write_file(const char *path, const void *data, size_t size)
+{
+    g_autofree char *tmp_path = g_strdup_printf("%s.tmp", path);
+
+    int fd = qemu_open_old(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+                           0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = qemu_write_full(fd, data, size) == size &&
+              qemu_fdatasync(fd) == 0;
+    close(fd);
+
+    if (!ok || g_rename(tmp_path, path) != 0) {
+        qemu_unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool create_log(ShaderArchive *ar)
+{
+    size_t tag_len = strlen(ar->tag);
+    g_autofree uint8_t *buf = g_malloc0(ar->data_start);
+    ArchiveHeader *hdr = (ArchiveHeader *)buf;
+
+    memcpy(hdr->magic, ARCHIVE_MAGIC, sizeof(hdr->magic));
+    hdr->generation = ((uint64_t)g_random_int() << 32) | g_random_int();
+    hdr->tag_len = tag_len;
+    memcpy(buf + sizeof(ArchiveHeader), ar->tag, tag_len);
+
+    qemu_unlink(ar->index_path);
+    if (!write_file(ar->path, buf, ar->data_start)) {
+        return false;
+    }
+
+    ar->generation = hdr->generation;
+    return true;
+}
+
+static void *writer_thread(void *opaque)
+{
+    ShaderArchive *ar = opaque;
+    g_autoptr(GByteArray) buf = g_byte_array_new();
+    static const uint8_t padding[ARCHIVE_ALIGN];
+
+    qemu_mutex_lock(&ar->lock);
+    while (true) {
+        while (g_queue_is_empty(&ar->pending) && !ar->shutdown) {
+            qemu_cond_wait(&ar->work_cond, &ar->lock);
+        }
+        if (g_queue_is_empty(&ar->pending)) {
+            break;
+        }
+
+        GQueue batch = ar->pending;
+        g_queue_init(&ar->pending);
+        ar->writing = true;
+        qemu_mutex_unlock(&ar->lock);
+
+        g_byte_array_set_size(buf, 0);
+        for (GList *l = batch.head; l; l = l->next) {
+            ArchiveWrite *w = l->data;
+            RecordHeader hdr = {
+                .magic = ARCHIVE_RECORD_MAGIC,
+                .size = w->size,
+                .key = w->key,
+                .checksum = w->size ? fast_hash(w->data, w->size) : 0,
+            };
+            g_byte_array_append(buf, (const uint8_t *)&hdr, sizeof(hdr));
+            if (w->size) {
+                g_byte_array_append(buf, w->data, w->size);
+                g_byte_array_append(buf, padding,
+                                    align_size(w->size) - w->size);
+            }
+        }
+
+        uint64_t offset = ar->log_size;
+        bool ok = !ar->write_failed &&
+                  qemu_write_full(ar->fd, buf->data, buf->len) == buf->len;
+        if (ok) {
+            qemu_fdatasync(ar->fd);
+            ar->log_size += buf->len;
+            if (ar->first_write_fn) {
+                ar->first_write_fn();
+                ar->first_write_fn = NULL;
+            }
+        } else if (!ar->write_failed) {
+            fprintf(stderr, "nv2a: Failed to write to shader archive %s\n",
+                    ar->path);
+            ar->write_failed = true;
+        }
+
+        qemu_mutex_lock(&ar->lock);
+        ArchiveWrite *w;
+        while ((w = g_queue_pop_head(&batch))) {
+            if (ok) {
+                set_entry(ar->overlay, w->key, offset, w->size == 0);
+                offset += sizeof(RecordHeader) + align_size(w->size);
+            }
+            g_free(w->data);
+            g_free(w);
+        }
+        ar->writing = false;
+        qemu_cond_broadcast(&ar->idle_cond);
+    }
+    qemu_mutex_unlock(&ar->lock);
+
+    return NULL;
+}
+
+ShaderArchive *shader_archive_open(const char *path, const char *tag)
+{
+    ShaderArchive *ar = g_new0(ShaderArchive, 1);
+    ar->path = g_strdup(path);
+    ar->index_path = g_strdup_printf("%s.idx", path);
+    ar->tag = g_strdup(tag);
+    ar->data_start = get_data_start(tag);
+    ar->overlay = new_entry_table();
+    ar->fd = -1;
+
+    uint64_t valid_size;
+    if (map_log(ar)) {
+        uint64_t scan_start = ar->data_start;
+        if (map_index(ar)) {
+            scan_start = ar->index->log_size;
+        }
+        valid_size = scan_log(ar->log_data, ar->log_mapped_size, scan_start,
+                              ar->overlay);
+    } else {
+        valid_size = ar->data_start;
+        if (!create_log(ar)) {
+            fprintf(stderr, "nv2a: Failed to create shader archive %s\n", path);
+            ar->write_failed = true;
+        }
+    }
+
+    if (!ar->write_failed) {
+        ar->fd = qemu_open_old(path, O_WRONLY | O_BINARY);
+        if (ar->fd < 0 || lseek(ar->fd, valid_size, SEEK_SET) < 0) {
+            ar->write_failed = true;
+        } else if (valid_size < ar->log_mapped_size) {
+            /* Drop a torn tail left behind by an interrupted write */
+            if (ftruncate(ar->fd, valid_size)) {
+                ar->write_failed = true;
+            }
+        }
+    }
+    ar->log_size = valid_size;
+    ar->log_mapped_size = MIN(ar->log_mapped_size, valid_size);
+
+    qemu_mutex_init(&ar->lock);
+    qemu_cond_init(&ar->work_cond);
+    qemu_cond_init(&ar->idle_cond);
+    g_queue_init(&ar->pending);
+    qemu_thread_create(&ar->writer, "nv2a.shader_archive", writer_thread, ar,
+                       QEMU_THREAD_JOINABLE);
+
+    return ar;
+}
+
+bool shader_archive_lookup(ShaderArchive *ar, uint64_t key, const void **data,
+                           size_t *size)
+{
+    uint64_t offset;
+
+    qemu_mutex_lock(&ar->lock);
+    ArchiveEntry *e = g_hash_table_lookup(ar->overlay, &key);
+    if (e) {
+        offset = e->removed ? 0 : e->offset;
+    } else {
+        offset = index_lookup(ar->index, key);
+    }
+    qemu_mutex_unlock(&ar->lock);
+
+    if (!offset) {
+        return false;
+    }
+
+    const RecordHeader *hdr =
+        get_record(ar->log_data, ar->log_mapped_size, offset);
+    if (!hdr || hdr->key != key || !hdr->size) {
+        return false;
+    }
+
+    *data = hdr + 1;
+    *size = hdr->size;
+    return true;
+}
+
+void shader_archive_put(ShaderArchive *ar, uint64_t key, void *data,
+                        size_t size)
+{
+    assert(size <= UINT32_MAX);
+
+    ArchiveWrite *w = g_new(ArchiveWrite, 1);
+    w->key = key;
+    w->data = data;
+    w->size = size;
+
+    qemu_mutex_lock(&ar->lock);
+    g_queue_push_tail(&ar->pending, w);
+    qemu_cond_signal(&ar->work_cond);
+    qemu_mutex_unlock(&ar->lock);
+}
+
+void shader_archive_remove(ShaderArchive *ar, uint64_t key)
+{
+    shader_archive_put(ar, key, NULL, 0);
+}
+
+void shader_archive_set_first_write_fn(ShaderArchive *ar, void (*fn)(void))
+{
+    qemu_mutex_lock(&ar->lock);
+    assert(g_queue_is_empty(&ar->pending) && !ar->writing);
+    ar->first_write_fn = fn;
+    qemu_mutex_unlock(&ar->lock);
+}
+
+void shader_archive_flush(ShaderArchive *ar)
+{
+    qemu_mutex_lock(&ar->lock);
+    while (!g_queue_is_empty(&ar->pending) || ar->writing) {
+        qemu_cond_wait(&ar->idle_cond, &ar->lock);
+    }
+    qemu_mutex_unlock(&ar->lock);
+}
+
+static gint compare_entry_offsets(gconstpointer a, gconstpointer b)
+{
+    const ArchiveEntry *ea = *(ArchiveEntry *const *)a;
+    const ArchiveEntry *eb = *(ArchiveEntry *const *)b;
+    return ea->offset < eb->offset ? -1 : ea->offset > eb->offset;
+}
+
+static void load_index_entries(const IndexHeader *index, GHashTable *entries)
+{
+    if (!index) {
+        return;
+    }
+
+    const IndexEntry *buckets = (const IndexEntry *)(index + 1);
+    for (uint32_t i = 0; i < index->num_buckets; i++) {
+        if (buckets[i].offset) {
+            set_entry(entries, buckets[i].key, buckets[i].offset, false);
+        }
+    }
+}
+
+static void merge_entries(GHashTable *dst, GHashTable *src)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, src);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        const ArchiveEntry *e = value;
+        set_entry(dst, e->key, e->offset, e->removed);
+    }
+}
+
+static GPtrArray *get_live_entries(GHashTable *entries)
+{
+    GPtrArray *live = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ArchiveEntry *e = value;
+        if (!e->removed) {
+            g_ptr_array_add(live, e);
+        }
+    }
+    g_ptr_array_sort(live, compare_entry_offsets);
+
+    return live;
+}
+
+static bool compact_log(ShaderArchive *ar, GPtrArray *live)
+{
+    g_autoptr(GByteArray) buf = g_byte_array_new();
+    const ArchiveHeader *old_hdr = (const ArchiveHeader *)ar->log_data;
+
+    ArchiveHeader hdr = *old_hdr;
+    hdr.generation = ((uint64_t)g_random_int() << 32) | g_random_int();
+    g_byte_array_append(buf, (const uint8_t *)&hdr, sizeof(hdr));
+    g_byte_array_append(buf, ar->log_data + sizeof(hdr),
+                        ar->data_start - sizeof(hdr));
+
+    for (int i = 0; i < live->len; i++) {
+        ArchiveEntry *e = g_ptr_array_index(live, i);
+        const RecordHeader *rec =
+            (const RecordHeader *)(ar->log_data + e->offset);
+        e->offset = buf->len;
+        g_byte_array_append(buf, (const uint8_t *)rec,
+                            sizeof(RecordHeader) + align_size(rec->size));
+    }
+
+    unmap_log(ar);
+    if (!write_file(ar->path, buf->data, buf->len)) {
+        return false;
+    }
+
+    ar->generation = hdr.generation;
+    ar->log_size = buf->len;
+    return true;
+}
+
+static void write_index(ShaderArchive *ar, GPtrArray *live)
+{
+    uint32_t num_buckets = pow2ceil(MAX(16, live->len * 2));
+    size_t size = sizeof(IndexHeader) + num_buckets * sizeof(IndexEntry);
+    g_autofree uint8_t *buf = g_malloc0(size);
+
+    IndexHeader *hdr = (IndexHeader *)buf;
+    *hdr = (IndexHeader){
+        .magic = ARCHIVE_INDEX_MAGIC,
+        .generation = ar->generation,
+        .log_size = ar->log_size,
+        .num_buckets = num_buckets,
+        .num_entries = live->len,
+    };
+
+    IndexEntry *entries = (IndexEntry *)(hdr + 1);
+    uint32_t mask = num_buckets - 1;
+    for (int i = 0; i < live->len; i++) {
+        ArchiveEntry *e = g_ptr_array_index(live, i);
+        uint32_t j = e->key & mask;
+        while (entries[j].offset) {
+            j = (j + 1) & mask;
+        }
+        entries[j] = (IndexEntry){ .key = e->key, .offset = e->offset };
+    }
+
+    if (!write_file(ar->index_path, buf, size)) {
+        fprintf(stderr, "nv2a: Failed to write shader archive index %s\n",
+                ar->index_path);
+    }
+}
+
+void shader_archive_close(ShaderArchive *ar)
+{
+    qemu_mutex_lock(&ar->lock);
+    ar->shutdown = true;
+    qemu_cond_signal(&ar->work_cond);
+    qemu_mutex_unlock(&ar->lock);
+    qemu_thread_join(&ar->writer);
+
+    if (ar->fd >= 0) {
+        close(ar->fd);
+    }
+
+    /*
+     * The overlay holds every record past the indexed region: the tail
+     * scanned at open plus everything written since. If it is empty the
+     * index on disk is still current and there is nothing to rebuild.
+     */
+    g_autoptr(GHashTable) entries = NULL;
+    if (!ar->write_failed &&
+        (!ar->index || g_hash_table_size(ar->overlay) > 0)) {
+        entries = new_entry_table();
+        load_index_entries(ar->index, entries);
+        merge_entries(entries, ar->overlay);
+    }
+    unmap_index(ar);
+    unmap_log(ar);
+
+    /* Rewrite the index, compacting the log first if needed */
+    if (entries && map_log(ar) && ar->log_mapped_size >= ar->log_size) {
+        g_autoptr(GPtrArray) live = get_live_entries(entries);
+
+        uint64_t live_bytes = 0;
+        for (int i = 0; i < live->len; i++) {
+            ArchiveEntry *e = g_ptr_array_index(live, i);
+            const RecordHeader *rec =
+                (const RecordHeader *)(ar->log_data + e->offset);
+            live_bytes += sizeof(RecordHeader) + align_size(rec->size);
+        }
+        uint64_t dead_bytes = ar->log_size - ar->data_start - live_bytes;
+
+        bool ok = true;
+        if (dead_bytes > live_bytes &&
+            dead_bytes > ARCHIVE_COMPACT_MIN_DEAD_BYTES) {
+            ok = compact_log(ar, live);
+        }
+        unmap_log(ar);
+
+        if (ok) {
+            write_index(ar, live);
+        }
+    }
+    unmap_log(ar);
+
+    qemu_cond_destroy(&ar->idle_cond);
+    qemu_cond_destroy(&ar->work_cond);
+    qemu_mutex_destroy(&ar->lock);
+    g_hash_table_destroy(ar->overlay);
+    g_free(ar->tag);
+    g_free(ar->index_path);
+    g_free(ar->path);
+    g_free(ar);
+}
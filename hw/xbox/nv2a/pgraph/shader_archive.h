@@ -0,0 +1,60 @@
+/*
+ * Geforce NV2A PGRAPH Shader Archive
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_XBOX_NV2A_PGRAPH_SHADER_ARCHIVE_H
+#define HW_XBOX_NV2A_PGRAPH_SHADER_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ShaderArchive ShaderArchive;
+
+/*
+ * Open (or create) the archive at path. Archives written with a different tag
+ * (e.g. emulator version and driver vendor) are discarded.
+ */
+ShaderArchive *shader_archive_open(const char *path, const char *tag);
+
+/* Flush pending writes, compact if worthwhile, write the index and close. */
+void shader_archive_close(ShaderArchive *ar);
+
+/*
+ * Find an entry that was present when the archive was opened. The returned
+ * pointer refers to the mapped archive and remains valid until close.
+ */
+bool shader_archive_lookup(ShaderArchive *ar, uint64_t key, const void **data,
+                           size_t *size);
+
+/* Queue an entry for writing. Takes ownership of data (g_malloc'd). */
+void shader_archive_put(ShaderArchive *ar, uint64_t key, void *data,
+                        size_t size);
+
+void shader_archive_remove(ShaderArchive *ar, uint64_t key);
+
+/*
+ * Call fn on the writer thread once the first entry has been written, e.g. to
+ * remove a cache the archive replaces. Must be set before any entry is queued.
+ */
+void shader_archive_set_first_write_fn(ShaderArchive *ar, void (*fn)(void));
+
+/* Wait until all queued entries have been written and synced. */
+void shader_archive_flush(ShaderArchive *ar);
+
+#endif
@@ -22,6 +22,7 @@
 #include "hw/xbox/nv2a/nv2a_int.h"
 #include "texture.h"
 #include "util.h"
+#include "yuv.h"
 
 const BasicColorFormatInfo kelvin_color_format_info_map[66] = {
     [NV097_SET_TEXTURE_FORMAT_COLOR_SZ_Y8] = { 1, false },
@@ -327,6 +328,7 @@ TextureShape pgraph_get_texture_shape(PGRAPHState *pg, int texture_idx)
 
 uint8_t *pgraph_convert_texture_data(const TextureShape s, const uint8_t *data,
                                      const uint8_t *palette_data,
+                                     size_t palette_length,
                                      unsigned int width, unsigned int height,
                                      unsigned int depth, unsigned int row_pitch,
                                      unsigned int slice_pitch,
@@ -340,10 +342,12 @@ uint8_t *pgraph_convert_texture_data(const TextureShape s, const uint8_t *data,
         converted_data = g_malloc(size);
         const uint8_t *src = data;
         uint32_t *dst = (uint32_t *)converted_data;
+        unsigned int max_index = palette_length / 4 - 1;
         for (int z = 0; z < depth; z++) {
             for (int y = 0; y < height; y++) {
                 for (int x = 0; x < width; x++) {
-                    uint8_t index = src[y * row_pitch + x];
+                    unsigned int index =
+                        MIN(src[y * row_pitch + x], max_index);
                     uint32_t color = *(uint32_t *)(palette_data + index * 4);
                     *dst++ = color;
                 }
@@ -362,21 +366,11 @@ uint8_t *pgraph_convert_texture_data(const TextureShape s, const uint8_t *data,
         // conversion
         size = width * height * 4;
         converted_data = g_malloc(size);
-        uint8_t *pixel = converted_data;
-        for (int y = 0; y < height; y++) {
-            const uint8_t *line = &data[y * row_pitch * depth];
-            for (int x = 0; x < width; x++, pixel += 4) {
-                if (s.color_format ==
-                    NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_CR8YB8CB8YA8) {
-                    convert_yuy2_to_rgb(line, x, &pixel[0], &pixel[1],
-                                        &pixel[2]);
-                } else {
-                    convert_uyvy_to_rgb(line, x, &pixel[0], &pixel[1],
-                                        &pixel[2]);
-                }
-                pixel[3] = 255;
-            }
-        }
+        yuv422_to_rgba(s.color_format ==
+                               NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_CR8YB8CB8YA8 ?
+                           YUV422_FORMAT_YUY2 :
+                           YUV422_FORMAT_UYVY,
+                       data, width, height, row_pitch, converted_data);
     } else if (s.color_format == NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R6G5B5) {
         assert(depth == 1); /* FIXME */
         size = width * height * 3;
@@ -54,6 +54,7 @@ extern const BasicColorFormatInfo kelvin_color_format_info_map[66];
 
 uint8_t *pgraph_convert_texture_data(const TextureShape s, const uint8_t *data,
                                      const uint8_t *palette_data,
+                                     size_t palette_length,
                                      unsigned int width, unsigned int height,
                                      unsigned int depth, unsigned int row_pitch,
                                      unsigned int slice_pitch,
@@ -137,6 +137,12 @@ void pgraph_vk_init_buffers(NV2AState *d)
         .buffer_size = r->storage_buffers[BUFFER_UNIFORM].buffer_size,
     };
 
+    r->storage_buffers[BUFFER_QUERY_RESULTS] = (StorageBuffer){
+        .alloc_info = host_alloc_create_info,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .buffer_size = MAX_QUERIES_IN_FLIGHT * sizeof(uint64_t),
+    };
+
     for (int i = 0; i < BUFFER_COUNT; i++) {
         create_buffer(pg, &r->storage_buffers[i]);
     }
@@ -144,15 +150,20 @@ void pgraph_vk_init_buffers(NV2AState *d)
     // FIXME: Add fallback path for device using host mapped memory
 
     int buffers_to_map[] = { BUFFER_VERTEX_RAM,
+                             BUFFER_STAGING_SRC,
                              BUFFER_INDEX_STAGING,
                              BUFFER_VERTEX_INLINE_STAGING,
-                             BUFFER_UNIFORM_STAGING };
+                             BUFFER_UNIFORM_STAGING,
+                             BUFFER_QUERY_RESULTS };
 
     for (int i = 0; i < ARRAY_SIZE(buffers_to_map); i++) {
         VK_CHECK(vmaMapMemory(
             r->allocator, r->storage_buffers[buffers_to_map[i]].allocation,
             (void **)&r->storage_buffers[buffers_to_map[i]].mapped));
     }
+
+    r->staging_segments_head = 0;
+    r->num_staging_segments = 0;
 }
 
 void pgraph_vk_finalize_buffers(NV2AState *d)
@@ -205,3 +216,92 @@ VkDeviceSize pgraph_vk_append_to_buffer(PGRAPHState *pg, int index, void **data,
 
     return starting_offset;
 }
+
+/*
+ * Allocate a range of the upload staging buffer (BUFFER_STAGING_SRC). The
+ * buffer is used as a ring: before handing out a range, wait for any earlier
+ * upload still reading from it. The caller must record its copy from the
+ * range in the next auxiliary command buffer it ends; the range is retired
+ * with the timeline value of the submission that batch goes out in.
+ */
+VkDeviceSize pgraph_vk_staging_alloc(PGRAPHState *pg, VkDeviceSize size)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    StorageBuffer *b = &r->storage_buffers[BUFFER_STAGING_SRC];
+
+    VkDeviceSize alignment =
+        MAX(r->device_props.limits.optimalBufferCopyOffsetAlignment, 16);
+    assert(size <= b->buffer_size);
+
+    VkDeviceSize offset = ROUND_UP(b->buffer_offset, alignment);
+    if (offset + size > b->buffer_size) {
+        offset = 0;
+    }
+
+    while (r->num_staging_segments > 0) {
+        StagingSegment *seg = &r->staging_segments[r->staging_segments_head];
+        bool overlaps =
+            seg->offset < offset + size && offset < seg->offset + seg->size;
+        if (!overlaps && r->num_staging_segments < MAX_STAGING_SEGMENTS) {
+            break;
+        }
+        if (seg->timeline_value == UINT64_MAX) {
+            assert(seg->recorded);
+            pgraph_vk_submit_command_buffers(r, VK_NULL_HANDLE);
+        }
+        pgraph_vk_wait_timeline(r, seg->timeline_value);
+        r->staging_segments_head =
+            (r->staging_segments_head + 1) % MAX_STAGING_SEGMENTS;
+        r->num_staging_segments--;
+    }
+
+    int tail = (r->staging_segments_head + r->num_staging_segments) %
+               MAX_STAGING_SEGMENTS;
+    r->staging_segments[tail] = (StagingSegment){
+        .offset = offset,
+        .size = size,
+        .recorded = false,
+        .timeline_value = UINT64_MAX,
+    };
+    r->num_staging_segments++;
+
+    b->buffer_offset = offset + size;
+
+    return offset;
+}
+
+/*
+ * Called when an auxiliary command buffer is ended: every range allocated so
+ * far has had its copy recorded and is now waiting on submission.
+ */
+void pgraph_vk_staging_mark_recorded(PGRAPHVkState *r)
+{
+    for (int i = r->num_staging_segments - 1; i >= 0; i--) {
+        StagingSegment *seg =
+            &r->staging_segments[(r->staging_segments_head + i) %
+                                 MAX_STAGING_SEGMENTS];
+        if (seg->recorded) {
+            break;
+        }
+        seg->recorded = true;
+    }
+}
+
+/*
+ * Called on submission: ranges recorded into the batch being submitted are
+ * retired once it signals value.
+ */
+void pgraph_vk_staging_set_timeline_value(PGRAPHVkState *r, uint64_t value)
+{
+    for (int i = 0; i < r->num_staging_segments; i++) {
+        StagingSegment *seg =
+            &r->staging_segments[(r->staging_segments_head + i) %
+                                 MAX_STAGING_SEGMENTS];
+        if (!seg->recorded) {
+            break;
+        }
+        if (seg->timeline_value == UINT64_MAX) {
+            seg->timeline_value = value;
+        }
+    }
+}
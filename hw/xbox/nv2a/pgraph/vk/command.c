@@ -56,7 +56,11 @@ static void create_command_buffers(PGRAPHState *pg)
         vkAllocateCommandBuffers(r->device, &alloc_info, r->command_buffers));
 
     r->command_buffer = r->command_buffers[0];
-    r->aux_command_buffer = r->command_buffers[1];
+    r->aux_command_buffer = VK_NULL_HANDLE;
+    r->aux_command_buffer_index = 0;
+    r->num_pending_command_buffers = 0;
+    memset(r->aux_command_buffer_timeline_values, 0,
+           sizeof(r->aux_command_buffer_timeline_values));
 }
 
 static void destroy_command_buffers(PGRAPHState *pg)
@@ -70,6 +74,164 @@ static void destroy_command_buffers(PGRAPHState *pg)
     r->aux_command_buffer = VK_NULL_HANDLE;
 }
 
+static void create_sync_objects(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    r->timeline_submitted = 0;
+    r->timeline_completed = 0;
+
+    VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VK_CHECK(
+        vkCreateFence(r->device, &fence_info, NULL, &r->command_buffer_fence));
+
+    if (!r->timeline_semaphore_enabled) {
+        return;
+    }
+
+    VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info,
+    };
+    VK_CHECK(vkCreateSemaphore(r->device, &semaphore_info, NULL,
+                               &r->timeline_semaphore));
+}
+
+static void destroy_sync_objects(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    vkDestroyFence(r->device, r->command_buffer_fence, NULL);
+
+    if (r->timeline_semaphore_enabled) {
+        vkDestroySemaphore(r->device, r->timeline_semaphore, NULL);
+        r->timeline_semaphore = VK_NULL_HANDLE;
+    }
+}
+
+/*
+ * Submit all pending auxiliary command buffers, followed by cmd (if not
+ * VK_NULL_HANDLE), as a single batch. Returns the timeline value that will be
+ * signaled once the batch completes.
+ *
+ * Without timeline semaphore support the batch signals command_buffer_fence,
+ * which must be waited on (via pgraph_vk_wait_timeline) before the next
+ * submission.
+ */
+uint64_t pgraph_vk_submit_command_buffers(PGRAPHVkState *r,
+                                          VkCommandBuffer cmd)
+{
+    VkCommandBuffer cmds[NUM_AUX_COMMAND_BUFFERS + 1];
+    int num_cmds = r->num_pending_command_buffers;
+
+    memcpy(cmds, r->pending_command_buffers, num_cmds * sizeof(cmds[0]));
+    if (cmd != VK_NULL_HANDLE) {
+        cmds[num_cmds++] = cmd;
+    }
+    if (num_cmds == 0) {
+        return r->timeline_submitted;
+    }
+
+    uint64_t signal_value = r->timeline_submitted + 1;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &signal_value,
+    };
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = num_cmds,
+        .pCommandBuffers = cmds,
+    };
+    VkFence fence = VK_NULL_HANDLE;
+
+    if (r->timeline_semaphore_enabled) {
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &r->timeline_semaphore;
+    } else {
+        fence = r->command_buffer_fence;
+        VK_CHECK(vkResetFences(r->device, 1, &fence));
+    }
+
+    timeline_begin("vkQueueSubmit");
+    VK_CHECK(vkQueueSubmit(r->queue, 1, &submit_info, fence));
+    timeline_end();
+
+    r->timeline_submitted = signal_value;
+    r->num_pending_command_buffers = 0;
+    pgraph_vk_staging_set_timeline_value(r, signal_value);
+
+    return signal_value;
+}
+
+void pgraph_vk_wait_timeline(PGRAPHVkState *r, uint64_t value)
+{
+    if (value <= r->timeline_completed) {
+        return;
+    }
+
+    if (value > r->timeline_submitted) {
+        pgraph_vk_submit_command_buffers(r, VK_NULL_HANDLE);
+    }
+    assert(value <= r->timeline_submitted);
+
+    if (r->timeline_semaphore_enabled) {
+        VkSemaphoreWaitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &r->timeline_semaphore,
+            .pValues = &value,
+        };
+        if (r->vk_api_version >= VK_API_VERSION_1_2) {
+            VK_CHECK(vkWaitSemaphores(r->device, &wait_info, UINT64_MAX));
+        } else {
+            VK_CHECK(vkWaitSemaphoresKHR(r->device, &wait_info, UINT64_MAX));
+        }
+        r->timeline_completed = value;
+    } else {
+        VK_CHECK(vkWaitForFences(r->device, 1, &r->command_buffer_fence,
+                                 VK_TRUE, UINT64_MAX));
+        r->timeline_completed = r->timeline_submitted;
+    }
+}
+
+/*
+ * Non-blocking counterpart to pgraph_vk_wait_timeline. Returns the last
+ * timeline value known to have completed.
+ */
+uint64_t pgraph_vk_poll_timeline(PGRAPHVkState *r)
+{
+    if (r->timeline_completed == r->timeline_submitted) {
+        return r->timeline_completed;
+    }
+
+    if (r->timeline_semaphore_enabled) {
+        uint64_t value;
+        if (r->vk_api_version >= VK_API_VERSION_1_2) {
+            VK_CHECK(vkGetSemaphoreCounterValue(r->device,
+                                                r->timeline_semaphore, &value));
+        } else {
+            VK_CHECK(vkGetSemaphoreCounterValueKHR(
+                r->device, r->timeline_semaphore, &value));
+        }
+        r->timeline_completed = MAX(r->timeline_completed, value);
+    } else if (vkGetFenceStatus(r->device, r->command_buffer_fence) ==
+               VK_SUCCESS) {
+        r->timeline_completed = r->timeline_submitted;
+    }
+
+    return r->timeline_completed;
+}
+
 VkCommandBuffer pgraph_vk_begin_single_time_commands(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -77,6 +239,12 @@ VkCommandBuffer pgraph_vk_begin_single_time_commands(PGRAPHState *pg)
     assert(!r->in_aux_command_buffer);
     r->in_aux_command_buffer = true;
 
+    // Recycle the oldest auxiliary command buffer once the GPU is done with it
+    int index = r->aux_command_buffer_index;
+    r->aux_command_buffer_index = (index + 1) % NUM_AUX_COMMAND_BUFFERS;
+    pgraph_vk_wait_timeline(r, r->aux_command_buffer_timeline_values[index]);
+    r->aux_command_buffer = r->command_buffers[1 + index];
+
     VkCommandBufferBeginInfo begin_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
@@ -86,34 +254,61 @@ VkCommandBuffer pgraph_vk_begin_single_time_commands(PGRAPHState *pg)
     return r->aux_command_buffer;
 }
 
-void pgraph_vk_end_single_time_commands(PGRAPHState *pg, VkCommandBuffer cmd)
+/*
+ * Finish recording an auxiliary command buffer. The buffer is not submitted
+ * right away, but batched with the next submission. Returns the timeline value
+ * that will be signaled once the commands have completed; callers that need
+ * the results on the CPU should pass it to pgraph_vk_wait_timeline.
+ */
+uint64_t pgraph_vk_end_single_time_commands(PGRAPHState *pg,
+                                            VkCommandBuffer cmd)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     assert(r->in_aux_command_buffer);
+    assert(cmd == r->aux_command_buffer);
+
+    // Previously each submission was followed by a queue idle, so commands
+    // recorded later could assume all prior work was complete and visible.
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         NULL, 0, NULL);
 
     VK_CHECK(vkEndCommandBuffer(cmd));
 
-    VkSubmitInfo submit_info = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &cmd,
-    };
-    VK_CHECK(vkQueueSubmit(r->queue, 1, &submit_info, VK_NULL_HANDLE));
-    nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_AUX);
-    VK_CHECK(vkQueueWaitIdle(r->queue));
+    int index = (r->aux_command_buffer_index + NUM_AUX_COMMAND_BUFFERS - 1) %
+                NUM_AUX_COMMAND_BUFFERS;
+    uint64_t value = r->timeline_submitted + 1;
+    r->aux_command_buffer_timeline_values[index] = value;
+    r->pending_command_buffers[r->num_pending_command_buffers++] = cmd;
+    pgraph_vk_staging_mark_recorded(r);
 
     r->in_aux_command_buffer = false;
+    nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_AUX);
+
+    if (!r->timeline_semaphore_enabled) {
+        pgraph_vk_submit_command_buffers(r, VK_NULL_HANDLE);
+        pgraph_vk_wait_timeline(r, value);
+    }
+
+    return value;
 }
 
 void pgraph_vk_init_command_buffers(PGRAPHState *pg)
 {
     create_command_pool(pg);
     create_command_buffers(pg);
+    create_sync_objects(pg);
 }
 
 void pgraph_vk_finalize_command_buffers(PGRAPHState *pg)
 {
+    destroy_sync_objects(pg);
     destroy_command_buffers(pg);
     destroy_command_pool(pg);
 }
\ No newline at end of file
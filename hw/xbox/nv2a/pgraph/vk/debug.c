@@ -114,7 +114,13 @@ void pgraph_vk_begin_debug_marker(PGRAPHVkState *r, VkCommandBuffer cmd,
         .pLabelName = buf,
     };
     memcpy(label_info.color, color, 4 * sizeof(float));
-    vkCmdBeginDebugUtilsLabelEXT(cmd, &label_info);
+    if (cmd == r->command_buffer && r->in_render_pass) {
+        // Keep the label with the draws it describes, which may be recorded
+        // into a secondary command buffer
+        pgraph_vk_cmd_begin_debug_label(r, &label_info);
+    } else {
+        vkCmdBeginDebugUtilsLabelEXT(cmd, &label_info);
+    }
     free(buf);
 
     r->debug_depth += 1;
@@ -127,7 +133,11 @@ void pgraph_vk_end_debug_marker(PGRAPHVkState *r, VkCommandBuffer cmd)
         return;
     }
 
-    vkCmdEndDebugUtilsLabelEXT(cmd);
+    if (cmd == r->command_buffer && r->in_render_pass) {
+        pgraph_vk_cmd_end_debug_label(r);
+    } else {
+        vkCmdEndDebugUtilsLabelEXT(cmd);
+    }
     assert(r->debug_depth > 0);
     r->debug_depth -= 1;
 }
@@ -18,27 +18,9 @@
  */
 
 #include "renderer.h"
+#include "hw/xbox/nv2a/pgraph/yuv.h"
 #include <math.h>
 
-static uint8_t *convert_texture_data__CR8YB8CB8YA8(uint8_t *data_out,
-                                                   const uint8_t *data_in,
-                                                   unsigned int width,
-                                                   unsigned int height,
-                                                   unsigned int pitch)
-{
-    int x, y;
-    for (y = 0; y < height; y++) {
-        const uint8_t *line = &data_in[y * pitch];
-        const uint32_t row_offset = y * width;
-        for (x = 0; x < width; x++) {
-            uint8_t *pixel = &data_out[(row_offset + x) * 4];
-            convert_yuy2_to_rgb(line, x, &pixel[0], &pixel[1], &pixel[2]);
-            pixel[3] = 255;
-        }
-    }
-    return data_out;
-}
-
 static float pvideo_calculate_scale(unsigned int din_dout,
                                     unsigned int output_size)
 {
@@ -136,27 +118,25 @@ static void upload_pvideo_image(PGRAPHState *pg, PvideoState state)
     PGRAPHVkState *r = pg->vk_renderer_state;
     PGRAPHVkDisplayState *disp = &r->display;
 
-    create_pvideo_image(pg, state.in_width, state.in_height);
+    // Packed YUY2 is uploaded as-is, one texel per pixel pair, and converted
+    // in the display shader
+    unsigned int tex_width = (state.in_width + 1) / 2;
+    assert(state.pitch % 4 == 0);
+    create_pvideo_image(pg, tex_width, state.in_height);
 
     // FIXME: Dirty tracking. We don't necessarily need to upload so much.
 
     // Copy texture data to mapped device buffer
-    uint8_t *mapped_memory_ptr;
-
-    VK_CHECK(vmaMapMemory(r->allocator,
-                          r->storage_buffers[BUFFER_STAGING_SRC].allocation,
-                          (void *)&mapped_memory_ptr));
+    StorageBuffer *staging = &r->storage_buffers[BUFFER_STAGING_SRC];
+    size_t image_size =
+        state.pitch * (state.in_height - 1) + tex_width * 4;
+    VkDeviceSize staging_offset = pgraph_vk_staging_alloc(pg, image_size);
 
-    convert_texture_data__CR8YB8CB8YA8(
-        mapped_memory_ptr, d->vram_ptr + state.base + state.offset,
-        state.in_width, state.in_height, state.pitch);
+    memcpy(staging->mapped + staging_offset,
+           d->vram_ptr + state.base + state.offset, image_size);
 
-    vmaFlushAllocation(r->allocator,
-                       r->storage_buffers[BUFFER_STAGING_SRC].allocation, 0,
-                       VK_WHOLE_SIZE);
-
-    vmaUnmapMemory(r->allocator,
-                   r->storage_buffers[BUFFER_STAGING_SRC].allocation);
+    vmaFlushAllocation(r->allocator, staging->allocation, staging_offset,
+                       image_size);
 
     // FIXME: Merge with display renderer command buffer
 
@@ -180,15 +160,15 @@ static void upload_pvideo_image(PGRAPHState *pg, PvideoState state)
         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
     VkBufferImageCopy region = {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
+        .bufferOffset = staging_offset,
+        .bufferRowLength = state.pitch / 4,
         .bufferImageHeight = 0,
         .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
         .imageSubresource.mipLevel = 0,
         .imageSubresource.baseArrayLayer = 0,
         .imageSubresource.layerCount = 1,
         .imageOffset = (VkOffset3D){ 0, 0, 0 },
-        .imageExtent = (VkExtent3D){ state.in_width, state.in_height, 1 },
+        .imageExtent = (VkExtent3D){ tex_width, state.in_height, 1 },
     };
     vkCmdCopyBufferToImage(cmd, r->storage_buffers[BUFFER_STAGING_SRC].buffer,
                            disp->pvideo.image,
@@ -216,6 +196,7 @@ static const char *display_frag_glsl =
     "    vec3 pvideo_color_key;\n"
     "};\n"
     "layout(location = 0) out vec4 out_Color;\n"
+    PVIDEO_YUY2_GLSL
     "void main()\n"
     "{\n"
     "    vec2 tex_coord = gl_FragCoord.xy/display_size;\n"
@@ -230,8 +211,7 @@ static const char *display_frag_glsl =
     "                           greaterThan(screen_coord, output_region.zw));\n"
     "        if (!any(clip) && (!pvideo_color_key_enable || out_Color.rgb == pvideo_color_key)) {\n"
     "            vec2 out_xy = screen_coord - pvideo_pos.xy;\n"
-    "            vec2 in_st = (pvideo_in_pos + out_xy * pvideo_scale.xy) / textureSize(pvideo_tex, 0);\n"
-    "            out_Color.rgba = texture(pvideo_tex, in_st);\n"
+    "            out_Color.rgba = pvideo_sample(pvideo_in_pos + out_xy * pvideo_scale.xy);\n"
     "        }\n"
     "    }\n"
     "}\n";
@@ -506,7 +486,7 @@ static void destroy_display_pipeline(PGRAPHState *pg)
     r->display.display_frag = NULL;
 }
 
-static void create_frame_buffer(PGRAPHState *pg)
+static void create_frame_buffer(PGRAPHState *pg, PGRAPHVkDisplayImage *d)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
@@ -514,32 +494,31 @@ static void create_frame_buffer(PGRAPHState *pg)
         .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
         .renderPass = r->display.render_pass,
         .attachmentCount = 1,
-        .pAttachments = &r->display.image_view,
-        .width = r->display.width,
-        .height = r->display.height,
+        .pAttachments = &d->image_view,
+        .width = d->width,
+        .height = d->height,
         .layers = 1,
     };
     VK_CHECK(vkCreateFramebuffer(r->device, &create_info, NULL,
-                                 &r->display.framebuffer));
+                                 &d->framebuffer));
 }
 
-static void destroy_frame_buffer(PGRAPHState *pg)
+static void destroy_frame_buffer(PGRAPHState *pg, PGRAPHVkDisplayImage *d)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
-    vkDestroyFramebuffer(r->device, r->display.framebuffer, NULL);
-    r->display.framebuffer = NULL;
+    vkDestroyFramebuffer(r->device, d->framebuffer, NULL);
+    d->framebuffer = NULL;
 }
 
-static void destroy_current_display_image(PGRAPHState *pg)
+static void destroy_display_image(PGRAPHState *pg, PGRAPHVkDisplayImage *d)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
-    PGRAPHVkDisplayState *d = &r->display;
 
     if (d->image == VK_NULL_HANDLE) {
         return;
     }
 
-    destroy_frame_buffer(pg);
+    destroy_frame_buffer(pg, d);
 
 #if HAVE_EXTERNAL_MEMORY
     glDeleteTextures(1, &d->gl_texture_id);
@@ -569,13 +548,13 @@ static void destroy_current_display_image(PGRAPHState *pg)
 // FIXME: We may need to use two images. One for actually rendering display,
 // and another for GL in the correct tiling mode
 
-static void create_display_image(PGRAPHState *pg, int width, int height)
+static void create_display_image(PGRAPHState *pg, PGRAPHVkDisplayImage *d,
+                                 int width, int height)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
-    PGRAPHVkDisplayState *d = &r->display;
 
-    if (r->display.image != VK_NULL_HANDLE) {
-        destroy_current_display_image(pg);
+    if (d->image != VK_NULL_HANDLE) {
+        destroy_display_image(pg, d);
     }
 
     const GLint gl_internal_format = GL_RGBA8;
@@ -718,7 +697,7 @@ static void create_display_image(PGRAPHState *pg, int width, int height)
     d->width = image_create_info.extent.width;
     d->height = image_create_info.extent.height;
 
-    create_frame_buffer(pg);
+    create_frame_buffer(pg, d);
 }
 
 static void update_descriptor_set(PGRAPHState *pg, SurfaceBinding *surface)
@@ -859,14 +838,15 @@ static PvideoState get_pvideo_state(PGRAPHState *pg)
     return state;
 }
 
-static void update_uniforms(PGRAPHState *pg, SurfaceBinding *surface)
+static void update_uniforms(PGRAPHState *pg, SurfaceBinding *surface,
+                            PGRAPHVkDisplayImage *img)
 {
     NV2AState *d = container_of(pg, NV2AState, pgraph);
     PGRAPHVkState *r = pg->vk_renderer_state;
     ShaderUniformLayout *l = &r->display.display_frag->push_constants;
 
     int display_size_loc = uniform_index(l, "display_size");  // FIXME: Cache
-    uniform2f(l, display_size_loc, r->display.width, r->display.height);
+    uniform2f(l, display_size_loc, img->width, img->height);
 
     VGADisplayParams vga_display_params;
     d->vga.get_params(&d->vga, &vga_display_params);
@@ -895,7 +875,8 @@ static void update_uniforms(PGRAPHState *pg, SurfaceBinding *surface)
     }
 }
 
-static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
+static void render_display(PGRAPHState *pg, SurfaceBinding *surface,
+                           PGRAPHVkDisplayImage *img)
 {
     NV2AState *d = container_of(pg, NV2AState, pgraph);
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -913,7 +894,7 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
         upload_pvideo_image(pg, disp->pvideo.state);
     }
 
-    update_uniforms(pg, surface);
+    update_uniforms(pg, surface, img);
     update_descriptor_set(pg, surface);
 
     VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
@@ -925,15 +906,15 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     pgraph_vk_transition_image_layout(
-        pg, cmd, disp->image, VK_FORMAT_R8G8B8A8_UNORM,
+        pg, cmd, img->image, VK_FORMAT_R8G8B8A8_UNORM,
         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
     VkRenderPassBeginInfo render_pass_begin_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = disp->render_pass,
-        .framebuffer = disp->framebuffer,
-        .renderArea.extent.width = disp->width,
-        .renderArea.extent.height = disp->height,
+        .framebuffer = img->framebuffer,
+        .renderArea.extent.width = img->width,
+        .renderArea.extent.height = img->height,
     };
     vkCmdBeginRenderPass(cmd, &render_pass_begin_info,
                          VK_SUBPASS_CONTENTS_INLINE);
@@ -945,16 +926,16 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                             0, NULL);
 
     VkViewport viewport = {
-        .width = disp->width,
-        .height = disp->height,
+        .width = img->width,
+        .height = img->height,
         .minDepth = 0.0,
         .maxDepth = 1.0,
     };
     vkCmdSetViewport(cmd, 0, 1, &viewport);
 
     VkRect2D scissor = {
-        .extent.width = disp->width,
-        .extent.height = disp->height,
+        .extent.width = img->width,
+        .extent.height = img->height,
     };
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 
@@ -980,7 +961,7 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                                 &region.extent.height);
 
     vkCmdCopyImage(cmd, surface->image,
-                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, disp->image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, img->image,
                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 #endif
 
@@ -989,16 +970,17 @@ static void render_display(PGRAPHState *pg, SurfaceBinding *surface)
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    pgraph_vk_transition_image_layout(pg, cmd, disp->image,
+    pgraph_vk_transition_image_layout(pg, cmd, img->image,
                                       VK_FORMAT_R8G8B8_UNORM,
                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     pgraph_vk_end_debug_marker(r, cmd);
-    pgraph_vk_end_single_time_commands(pg, cmd);
+    // Display image is consumed outside of the queue
+    pgraph_vk_wait_timeline(r, pgraph_vk_end_single_time_commands(pg, cmd));
     nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_5);
 
-    disp->draw_time = surface->draw_time;
+    img->draw_time = surface->draw_time;
 }
 
 static void create_surface_sampler(PGRAPHState *pg)
@@ -1048,8 +1030,8 @@ void pgraph_vk_finalize_display(PGRAPHState *pg)
 
     destroy_pvideo_image(pg);
 
-    if (r->display.image != VK_NULL_HANDLE) {
-        destroy_current_display_image(pg);
+    for (int i = 0; i < ARRAY_SIZE(r->display.images); i++) {
+        destroy_display_image(pg, &r->display.images[i]);
     }
 
     destroy_surface_sampler(pg);
@@ -1074,6 +1056,8 @@ void pgraph_vk_render_display(PGRAPHState *pg)
         return;
     }
 
+    pgraph_vk_surface_rescale_if_stale(d, surface);
+
     unsigned int width = 0, height = 0;
     d->vga.get_resolution(&d->vga, (int *)&width, (int *)&height);
 
@@ -1084,10 +1068,12 @@ void pgraph_vk_render_display(PGRAPHState *pg)
 
     pgraph_apply_scaling_factor(pg, &width, &height);
 
-    PGRAPHVkDisplayState *disp = &r->display;
-    if (!disp->image || disp->width != width || disp->height != height) {
-        create_display_image(pg, width, height);
+    int slot = pgraph_present_begin(&pg->present);
+    PGRAPHVkDisplayImage *img = &r->display.images[slot];
+    if (!img->image || img->width != width || img->height != height) {
+        create_display_image(pg, img, width, height);
     }
 
-    render_display(pg, surface);
+    render_display(pg, surface, img);
+    pgraph_present_end(&pg->present, slot, surface->draw_time);
 }
@@ -154,6 +154,7 @@ static void finalize_pipeline_cache(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     lru_flush(&r->pipeline_cache);
+    lru_destroy(&r->pipeline_cache);
     g_free(r->pipeline_cache_entries);
     r->pipeline_cache_entries = NULL;
 
@@ -216,18 +217,6 @@ void pgraph_vk_init_pipelines(PGRAPHState *pg)
     init_pipeline_cache(pg);
     init_clear_shaders(pg);
     init_render_passes(r);
-
-    VkSemaphoreCreateInfo semaphore_info = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-    };
-    VK_CHECK(vkCreateSemaphore(r->device, &semaphore_info, NULL,
-                               &r->command_buffer_semaphore));
-
-    VkFenceCreateInfo fence_info = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    };
-    VK_CHECK(
-        vkCreateFence(r->device, &fence_info, NULL, &r->command_buffer_fence));
 }
 
 void pgraph_vk_finalize_pipelines(PGRAPHState *pg)
@@ -237,9 +226,6 @@ void pgraph_vk_finalize_pipelines(PGRAPHState *pg)
     finalize_clear_shaders(pg);
     finalize_pipeline_cache(pg);
     finalize_render_passes(r);
-
-    vkDestroyFence(r->device, r->command_buffer_fence, NULL);
-    vkDestroySemaphore(r->device, r->command_buffer_semaphore, NULL);
 }
 
 static void init_render_pass_state(PGRAPHState *pg, RenderPassState *state)
@@ -1019,7 +1005,7 @@ static void create_pipeline(PGRAPHState *pg)
     NV2A_VK_DGROUP_END();
 }
 
-static void push_vertex_attr_values(PGRAPHState *pg)
+static void get_vertex_attr_values(PGRAPHState *pg, DrawState *state)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
@@ -1029,29 +1015,31 @@ static void push_vertex_attr_values(PGRAPHState *pg)
 
     // FIXME: Partial updates
 
-    float values[NV2A_VERTEXSHADER_ATTRIBUTES][4];
     int num_uniform_attrs = 0;
 
     pgraph_get_inline_values(pg, r->shader_binding->state.vsh.uniform_attrs,
-                             values, &num_uniform_attrs);
-
-    if (num_uniform_attrs > 0) {
-        vkCmdPushConstants(r->command_buffer, r->pipeline_binding->layout,
-                           VK_SHADER_STAGE_VERTEX_BIT, 0,
-                           num_uniform_attrs * 4 * sizeof(float),
-                           &values);
-    }
+                             state->uniform_attrs, &num_uniform_attrs);
+    state->num_uniform_attrs = num_uniform_attrs;
 }
 
-static void bind_descriptor_sets(PGRAPHState *pg)
+static void get_descriptor_set(PGRAPHState *pg, DrawState *state)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
     assert(r->descriptor_set_index >= 1);
 
-    vkCmdBindDescriptorSets(r->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            r->pipeline_binding->layout, 0, 1,
-                            &r->descriptor_sets[r->descriptor_set_index - 1], 0,
-                            NULL);
+    state->bind_descriptors = true;
+
+    if (r->push_descriptor_extension_enabled) {
+        state->descriptor_state = r->descriptor_state;
+        return;
+    }
+
+    state->descriptor_set = r->descriptor_sets[r->descriptor_set_index - 1];
+    if (r->descriptor_set_needs_write) {
+        state->write_descriptor_set = true;
+        state->descriptor_state = r->descriptor_state;
+        r->descriptor_set_needs_write = false;
+    }
 }
 
 static void begin_query(PGRAPHVkState *r)
@@ -1062,13 +1050,12 @@ static void begin_query(PGRAPHVkState *r)
 
     // FIXME: We should handle this. Make the query buffer bigger, but at least
     // flush current queries.
-    assert(r->num_queries_in_flight < r->max_queries_in_flight);
+    assert(r->num_queries_in_flight < MAX_QUERIES_IN_FLIGHT);
 
     nv2a_profile_inc_counter(NV2A_PROF_QUERY);
-    vkCmdResetQueryPool(r->command_buffer, r->query_pool,
-                        r->num_queries_in_flight, 1);
-    vkCmdBeginQuery(r->command_buffer, r->query_pool, r->num_queries_in_flight,
-                    VK_QUERY_CONTROL_PRECISE_BIT);
+    pgraph_vk_cmd_reset_query(r, r->query_pool, r->num_queries_in_flight);
+    pgraph_vk_cmd_begin_query(r, r->query_pool, r->num_queries_in_flight,
+                              VK_QUERY_CONTROL_PRECISE_BIT);
 
     r->query_in_flight = true;
     r->new_query_needed = false;
@@ -1081,8 +1068,7 @@ static void end_query(PGRAPHVkState *r)
     assert(!r->in_render_pass);
     assert(r->query_in_flight);
 
-    vkCmdEndQuery(r->command_buffer, r->query_pool,
-                  r->num_queries_in_flight - 1);
+    pgraph_vk_cmd_end_query(r, r->query_pool, r->num_queries_in_flight - 1);
     r->query_in_flight = false;
 }
 
@@ -1184,8 +1170,7 @@ static void begin_render_pass(PGRAPHState *pg)
         .clearValueCount = 0,
         .pClearValues = NULL,
     };
-    vkCmdBeginRenderPass(r->command_buffer, &render_pass_begin_info,
-                         VK_SUBPASS_CONTENTS_INLINE);
+    pgraph_vk_cmd_begin_render_pass(r, &render_pass_begin_info);
     r->in_render_pass = true;
 
 }
@@ -1193,7 +1178,7 @@ static void begin_render_pass(PGRAPHState *pg)
 static void end_render_pass(PGRAPHVkState *r)
 {
     if (r->in_render_pass) {
-        vkCmdEndRenderPass(r->command_buffer);
+        pgraph_vk_cmd_end_render_pass(r);
         r->in_render_pass = false;
     }
 }
@@ -1210,6 +1195,18 @@ const enum NV2A_PROF_COUNTERS_ENUM finish_reason_to_counter_enum[] = {
     [VK_FINISH_REASON_STALLED] = NV2A_PROF_FINISH_STALLED,
 };
 
+static const char *const finish_reason_names[] = {
+    [VK_FINISH_REASON_VERTEX_BUFFER_DIRTY] = "Finish: Vertex Buffer Dirty",
+    [VK_FINISH_REASON_SURFACE_CREATE] = "Finish: Surface Create",
+    [VK_FINISH_REASON_SURFACE_DOWN] = "Finish: Surface Download",
+    [VK_FINISH_REASON_NEED_BUFFER_SPACE] = "Finish: Need Buffer Space",
+    [VK_FINISH_REASON_FRAMEBUFFER_DIRTY] = "Finish: Framebuffer Dirty",
+    [VK_FINISH_REASON_PRESENTING] = "Finish: Presenting",
+    [VK_FINISH_REASON_FLIP_STALL] = "Finish: Flip Stall",
+    [VK_FINISH_REASON_FLUSH] = "Finish: Flush",
+    [VK_FINISH_REASON_STALLED] = "Finish: Stalled",
+};
+
 void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -1217,6 +1214,8 @@ void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
     assert(!r->in_draw);
     assert(r->debug_depth == 0);
 
+    timeline_begin(finish_reason_names[finish_reason]);
+
     if (r->in_command_buffer) {
         nv2a_profile_inc_counter(finish_reason_to_counter_enum[finish_reason]);
 
@@ -1226,6 +1225,9 @@ void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
         if (r->query_in_flight) {
             end_query(r);
         }
+        pgraph_vk_flush_recording(pg);
+        pgraph_vk_copy_query_results(pg, r->command_buffer);
+        pgraph_vk_end_gpu_timer(pg, r->command_buffer);
         VK_CHECK(vkEndCommandBuffer(r->command_buffer));
 
         VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg); // FIXME: Cleanup
@@ -1235,32 +1237,13 @@ void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
         sync_staging_buffer(pg, cmd, BUFFER_UNIFORM_STAGING, BUFFER_UNIFORM);
         bitmap_clear(r->uploaded_bitmap, 0, r->bitmap_size);
         flush_memory_buffer(pg, cmd);
-        VK_CHECK(vkEndCommandBuffer(r->aux_command_buffer));
-        r->in_aux_command_buffer = false;
-
-        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-        VkSubmitInfo submit_infos[] = {
-            {
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &r->aux_command_buffer,
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &r->command_buffer_semaphore,
-            },
-            {
-
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &r->command_buffer,
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &r->command_buffer_semaphore,
-                .pWaitDstStageMask = &wait_stage,
-            }
-        };
+        pgraph_vk_end_single_time_commands(pg, cmd);
+
+        // Pending auxiliary work, staging sync, then the draw commands
         nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT);
-        vkResetFences(r->device, 1, &r->command_buffer_fence);
-        VK_CHECK(vkQueueSubmit(r->queue, ARRAY_SIZE(submit_infos), submit_infos,
-                               r->command_buffer_fence));
+        uint64_t timeline_value =
+            pgraph_vk_submit_command_buffers(r, r->command_buffer);
+        pgraph_vk_set_reports_timeline_value(pg, timeline_value);
         r->submit_count += 1;
 
         bool check_budget = false;
@@ -1277,22 +1260,29 @@ void pgraph_vk_finish(PGRAPHState *pg, FinishReason finish_reason)
             check_budget = true;
         }
 
-        VK_CHECK(vkWaitForFences(r->device, 1, &r->command_buffer_fence,
-                                 VK_TRUE, UINT64_MAX));
+        pgraph_vk_wait_timeline(r, timeline_value);
+        pgraph_vk_collect_gpu_timer(pg);
+        pgraph_vk_recording_complete(pg);
 
         r->descriptor_set_index = 0;
+        r->descriptor_set_needs_write = false;
         r->in_command_buffer = false;
         destroy_framebuffers(pg);
 
         if (check_budget) {
             pgraph_vk_check_memory_budget(pg);
         }
+    } else {
+        pgraph_vk_wait_timeline(
+            r, pgraph_vk_submit_command_buffers(r, VK_NULL_HANDLE));
     }
 
     NV2AState *d = container_of(pg, NV2AState, pgraph);
     pgraph_vk_process_pending_reports_internal(d);
 
     pgraph_vk_compute_finish_complete(r);
+
+    timeline_end();
 }
 
 void pgraph_vk_begin_command_buffer(PGRAPHState *pg)
@@ -1306,6 +1296,8 @@ void pgraph_vk_begin_command_buffer(PGRAPHState *pg)
     };
     VK_CHECK(vkBeginCommandBuffer(r->command_buffer,
                                   &command_buffer_begin_info));
+    pgraph_vk_begin_gpu_timer(pg, r->command_buffer);
+    pgraph_vk_begin_recording(pg);
     r->command_buffer_start_time = pg->draw_time;
     r->in_command_buffer = true;
 }
@@ -1336,6 +1328,7 @@ VkCommandBuffer pgraph_vk_begin_nondraw_commands(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
     pgraph_vk_ensure_command_buffer(pg);
     pgraph_vk_ensure_not_in_render_pass(pg);
+    pgraph_vk_flush_recording(pg);
     return r->command_buffer;
 }
 
@@ -1388,21 +1381,6 @@ static void begin_pre_draw(PGRAPHState *pg)
     pgraph_vk_ensure_command_buffer(pg);
 }
 
-static float clamp_line_width_to_device_limits(PGRAPHState *pg, float width)
-{
-    PGRAPHVkState *r = pg->vk_renderer_state;
-
-    float min_width = r->device_props.limits.lineWidthRange[0];
-    float max_width = r->device_props.limits.lineWidthRange[1];
-    float granularity = r->device_props.limits.lineWidthGranularity;
-
-    if (granularity != 0.0f) {
-        float steps = roundf((width - min_width) / granularity);
-        width = min_width + steps * granularity;
-    }
-    return fminf(fmaxf(min_width, width), max_width);
-}
-
 static void begin_draw(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
@@ -1435,23 +1413,27 @@ static void begin_draw(PGRAPHState *pg)
         must_bind_pipeline = true;
     }
 
+    DrawState state = {
+        .bind_pipeline = must_bind_pipeline,
+        .has_dynamic_line_width = r->pipeline_binding->has_dynamic_line_width,
+        .pipeline = r->pipeline_binding->pipeline,
+        .layout = r->pipeline_binding->layout,
+    };
+
     if (must_bind_pipeline) {
         nv2a_profile_inc_counter(NV2A_PROF_PIPELINE_BIND);
-        vkCmdBindPipeline(r->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          r->pipeline_binding->pipeline);
         r->pipeline_binding->draw_time = pg->draw_time;
 
         unsigned int vp_width = pg->surface_binding_dim.width,
                      vp_height = pg->surface_binding_dim.height;
         pgraph_apply_scaling_factor(pg, &vp_width, &vp_height);
 
-        VkViewport viewport = {
+        state.viewport = (VkViewport){
             .width = vp_width,
             .height = vp_height,
             .minDepth = 0.0,
             .maxDepth = 1.0,
         };
-        vkCmdSetViewport(r->command_buffer, 0, 1, &viewport);
 
         /* Surface clip */
         /* FIXME: Consider moving to PSH w/ window clip */
@@ -1467,26 +1449,23 @@ static void begin_draw(PGRAPHState *pg)
         pgraph_apply_scaling_factor(pg, &xmin, &ymin);
         pgraph_apply_scaling_factor(pg, &scissor_width, &scissor_height);
 
-        VkRect2D scissor = {
+        state.scissor = (VkRect2D){
             .offset.x = xmin,
             .offset.y = ymin,
             .extent.width = scissor_width,
             .extent.height = scissor_height,
         };
-        vkCmdSetScissor(r->command_buffer, 0, 1, &scissor);
 
-        if (r->pipeline_binding->has_dynamic_line_width) {
-            float line_width =
-                clamp_line_width_to_device_limits(pg, pg->surface_scale_factor);
-            vkCmdSetLineWidth(r->command_buffer, line_width);
-        }
+        state.line_width = pg->surface_scale_factor;
     }
 
     if (!pg->clearing) {
-        bind_descriptor_sets(pg);
-        push_vertex_attr_values(pg);
+        get_descriptor_set(pg, &state);
+        get_vertex_attr_values(pg, &state);
     }
 
+    pgraph_vk_cmd_bind_draw_state(r, &state);
+
     r->in_draw = true;
 }
 
@@ -1678,10 +1657,10 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
                          write_zeta ? " zeta" : "");
 
     begin_pre_draw(pg);
+    begin_draw(pg);
     pgraph_vk_begin_debug_marker(r, r->command_buffer,
         RGBA_BLUE, "Clear %08" HWADDR_PRIx,
         binding->vram_addr);
-    begin_draw(pg);
 
     // FIXME: What does hardware do when min >= max?
     // FIXME: What does hardware do when min >= surface size?
@@ -1728,9 +1707,9 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
         } else {
             float blend_constants[4];
             pgraph_get_clear_color(pg, blend_constants);
-            vkCmdSetScissor(r->command_buffer, 0, 1, &clear_rect.rect);
-            vkCmdSetBlendConstants(r->command_buffer, blend_constants);
-            vkCmdDraw(r->command_buffer, 3, 1, 0, 0);
+            pgraph_vk_cmd_set_scissor(r, &clear_rect.rect);
+            pgraph_vk_cmd_set_blend_constants(r, blend_constants);
+            pgraph_vk_cmd_draw(r, 3, 0);
         }
     }
 
@@ -1756,11 +1735,11 @@ void pgraph_vk_clear_surface(NV2AState *d, uint32_t parameter)
     }
 
     if (num_attachments) {
-        vkCmdClearAttachments(r->command_buffer, num_attachments, attachments,
-                              1, &clear_rect);
+        pgraph_vk_cmd_clear_attachments(r, num_attachments, attachments,
+                                        &clear_rect);
     }
-    end_draw(pg);
     pgraph_vk_end_debug_marker(r, r->command_buffer);
+    end_draw(pg);
 
     pg->clearing = false;
 
@@ -1818,9 +1797,8 @@ static void bind_vertex_buffer(PGRAPHState *pg, uint16_t inline_map,
         offsets[i] = offset + r->vertex_attribute_offsets[attr_idx];
     }
 
-    vkCmdBindVertexBuffers(r->command_buffer, 0,
-                           r->num_active_vertex_binding_descriptions, buffers,
-                           offsets);
+    pgraph_vk_cmd_bind_vertex_buffers(
+        r, r->num_active_vertex_binding_descriptions, buffers, offsets);
 }
 
 static void bind_inline_vertex_buffer(PGRAPHState *pg, VkDeviceSize offset)
@@ -2052,18 +2030,18 @@ void pgraph_vk_flush_draw(NV2AState *d)
 
         begin_pre_draw(pg);
         copy_remapped_attributes_to_inline_buffer(pg, remap, 0, max_element);
+        begin_draw(pg);
         pgraph_vk_begin_debug_marker(r, r->command_buffer, RGBA_BLUE,
                                      "Draw Arrays");
-        begin_draw(pg);
         bind_vertex_buffer(pg, remap.attributes, 0);
         for (int i = 0; i < pg->draw_arrays_length; i++) {
             uint32_t start = pg->draw_arrays_start[i],
                      count = pg->draw_arrays_count[i];
             NV2A_VK_DPRINTF("- [%d] Start:%d Count:%d", i, start, count);
-            vkCmdDraw(r->command_buffer, count, 1, start, 0);
+            pgraph_vk_cmd_draw(r, count, start);
         }
-        end_draw(pg);
         pgraph_vk_end_debug_marker(r, r->command_buffer);
+        end_draw(pg);
 
         NV2A_VK_DGROUP_END();
     } else if (pg->inline_elements_length) {
@@ -2094,17 +2072,16 @@ void pgraph_vk_flush_draw(NV2AState *d)
         copy_remapped_attributes_to_inline_buffer(pg, remap, 0, max_element + 1);
         VkDeviceSize buffer_offset = pgraph_vk_update_index_buffer(
             pg, pg->inline_elements, index_data_size);
+        begin_draw(pg);
         pgraph_vk_begin_debug_marker(r, r->command_buffer, RGBA_BLUE,
                                      "Inline Elements");
-        begin_draw(pg);
         bind_vertex_buffer(pg, remap.attributes, 0);
-        vkCmdBindIndexBuffer(r->command_buffer,
-                             r->storage_buffers[BUFFER_INDEX].buffer,
-                             buffer_offset, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(r->command_buffer, pg->inline_elements_length, 1, 0, 0,
-                         0);
-        end_draw(pg);
+        pgraph_vk_cmd_bind_index_buffer(r,
+                                        r->storage_buffers[BUFFER_INDEX].buffer,
+                                        buffer_offset, VK_INDEX_TYPE_UINT32);
+        pgraph_vk_cmd_draw_indexed(r, pg->inline_elements_length);
         pgraph_vk_end_debug_marker(r, r->command_buffer);
+        end_draw(pg);
 
         NV2A_VK_DGROUP_END();
     } else if (pg->inline_buffer_length) {
@@ -2135,13 +2112,13 @@ void pgraph_vk_flush_draw(NV2AState *d)
         begin_pre_draw(pg);
         VkDeviceSize buffer_offset = pgraph_vk_update_vertex_inline_buffer(
             pg, data, sizes, r->num_active_vertex_attribute_descriptions);
+        begin_draw(pg);
         pgraph_vk_begin_debug_marker(r, r->command_buffer, RGBA_BLUE,
                                      "Inline Buffer");
-        begin_draw(pg);
         bind_inline_vertex_buffer(pg, buffer_offset);
-        vkCmdDraw(r->command_buffer, pg->inline_buffer_length, 1, 0, 0);
-        end_draw(pg);
+        pgraph_vk_cmd_draw(r, pg->inline_buffer_length, 0);
         pgraph_vk_end_debug_marker(r, r->command_buffer);
+        end_draw(pg);
 
         NV2A_VK_DGROUP_END();
     } else if (pg->inline_array_length) {
@@ -2179,13 +2156,13 @@ void pgraph_vk_flush_draw(NV2AState *d)
         void *inline_array_data = pg->inline_array;
         VkDeviceSize buffer_offset = pgraph_vk_update_vertex_inline_buffer(
             pg, &inline_array_data, &inline_array_data_size, 1);
+        begin_draw(pg);
         pgraph_vk_begin_debug_marker(r, r->command_buffer, RGBA_BLUE,
                                      "Inline Array");
-        begin_draw(pg);
         bind_inline_vertex_buffer(pg, buffer_offset);
-        vkCmdDraw(r->command_buffer, index_count, 1, 0, 0);
-        end_draw(pg);
+        pgraph_vk_cmd_draw(r, index_count, 0);
         pgraph_vk_end_debug_marker(r, r->command_buffer);
+        end_draw(pg);
         NV2A_VK_DGROUP_END();
     } else {
         NV2A_VK_DPRINTF("EMPTY NV097_SET_BEGIN_END");
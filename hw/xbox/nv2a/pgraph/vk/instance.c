@@ -18,6 +18,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/error-report.h"
 #include "ui/xemu-settings.h"
 #include "renderer.h"
 #include "xemu-version.h"
@@ -74,8 +75,8 @@ static bool check_validation_layer_support(void)
             }
         }
         if (!found) {
-            fprintf(stderr, "desired validation layer not found: %s\n",
-                    validation_layers[i]);
+            warn_report("desired validation layer not found: %s",
+                        validation_layers[i]);
             return false;
         }
     }
@@ -126,8 +127,7 @@ add_extension_if_available(VkExtensionPropertiesArray *available_extensions,
         return true;
     }
 
-    fprintf(stderr, "Warning: extension not available: %s\n",
-            desired_extension_name);
+    warn_report("extension not available: %s", desired_extension_name);
     return false;
 }
 
@@ -216,13 +216,13 @@ static bool create_instance(PGRAPHState *pg, Error **errp)
 
     if (enable_validation) {
         if (check_validation_layer_support()) {
-            fprintf(stderr, "Warning: Validation layers enabled. Expect "
-                            "performance impact.\n");
+            warn_report("Validation layers enabled. Expect performance "
+                        "impact.");
             create_info.enabledLayerCount = ARRAY_SIZE(validation_layers);
             create_info.ppEnabledLayerNames = validation_layers;
             create_info.pNext = &validationFeatures;
         } else {
-            fprintf(stderr, "Warning: validation layers not available\n");
+            warn_report("validation layers not available");
             enable_validation = false;
         }
     }
@@ -331,6 +331,17 @@ static void add_optional_device_extension_names(
     r->memory_budget_extension_enabled = add_extension_if_available(
         available_extensions, enabled_extension_names,
         VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Timeline semaphores are core in 1.2
+    r->timeline_semaphore_enabled =
+        r->vk_api_version >= VK_API_VERSION_1_2 ||
+        add_extension_if_available(available_extensions,
+                                   enabled_extension_names,
+                                   VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+    r->push_descriptor_extension_enabled = add_extension_if_available(
+        available_extensions, enabled_extension_names,
+        VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
 }
 
 static bool check_device_support_required_extensions(VkPhysicalDevice device)
@@ -341,8 +352,8 @@ static bool check_device_support_required_extensions(VkPhysicalDevice device)
     for (int i = 0; i < ARRAY_SIZE(required_device_extensions); i++) {
         if (!is_extension_available(available_extensions,
                                     required_device_extensions[i])) {
-            fprintf(stderr, "required device extension not found: %s\n",
-                    required_device_extensions[i]);
+            warn_report("required device extension not found: %s",
+                        required_device_extensions[i]);
             return false;
         }
     }
@@ -490,10 +501,12 @@ static bool create_logical_device(PGRAPHState *pg, Error **errp)
         F(depthClamp, true),
         F(fillModeNonSolid, true),
         F(geometryShader, true),
+        F(inheritedQueries, false),
         F(occlusionQueryPrecise, true),
         F(samplerAnisotropy, false),
         F(shaderClipDistance, true),
         F(shaderTessellationAndGeometryPointSize, true),
+        F(textureCompressionBC, false),
         F(wideLines, false),
         #undef F
         // clang-format on
@@ -503,9 +516,8 @@ static bool create_logical_device(PGRAPHState *pg, Error **errp)
     for (int i = 0; i < ARRAY_SIZE(desired_features); i++) {
         if (desired_features[i].required &&
             desired_features[i].available != VK_TRUE) {
-            fprintf(stderr,
-                    "Error: Device does not support required feature %s\n",
-                    desired_features[i].name);
+            error_report("Device does not support required feature %s",
+                         desired_features[i].name);
             all_required_features_available = false;
         }
         *desired_features[i].enabled = desired_features[i].available;
@@ -529,6 +541,33 @@ static bool create_logical_device(PGRAPHState *pg, Error **errp)
         next_struct = &custom_border_features;
     }
 
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features;
+    if (r->timeline_semaphore_enabled) {
+        VkPhysicalDeviceTimelineSemaphoreFeatures supported = {
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        };
+        VkPhysicalDeviceFeatures2 features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supported,
+        };
+        vkGetPhysicalDeviceFeatures2(r->physical_device, &features);
+        r->timeline_semaphore_enabled = supported.timelineSemaphore;
+    }
+    if (r->timeline_semaphore_enabled) {
+        timeline_semaphore_features =
+            (VkPhysicalDeviceTimelineSemaphoreFeatures){
+                .sType =
+                    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+                .timelineSemaphore = VK_TRUE,
+                .pNext = next_struct,
+            };
+        next_struct = &timeline_semaphore_features;
+    } else {
+        warn_report("Timeline semaphores unavailable, falling back to "
+                    "blocking submissions");
+    }
+
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .queueCreateInfoCount = 1,
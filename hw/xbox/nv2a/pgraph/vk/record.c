@@ -0,0 +1,708 @@
+/*
+ * Geforce NV2A PGRAPH Vulkan Renderer
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Threaded command recording
+ *
+ * When enabled, draw commands are not recorded into the primary command buffer
+ * directly. Instead, the PFIFO thread encodes them into a compact command
+ * stream per render pass (a "job"), and a worker thread replays each stream
+ * into a secondary command buffer. Before anything else is recorded into the
+ * primary command buffer (nondraw commands, submission), completed jobs are
+ * executed into it in order.
+ *
+ * For each draw, the PFIFO thread only snapshots a DrawState. Turning it into
+ * pipeline, dynamic state, descriptor and push constant commands, and writing
+ * the descriptor set, happens on the worker.
+ */
+
+#include "ui/xemu-settings.h"
+#include "renderer.h"
+
+typedef enum RecordCommandType {
+    RECORD_BIND_DRAW_STATE,
+    RECORD_SET_SCISSOR,
+    RECORD_SET_BLEND_CONSTANTS,
+    RECORD_BIND_VERTEX_BUFFERS,
+    RECORD_BIND_INDEX_BUFFER,
+    RECORD_DRAW,
+    RECORD_DRAW_INDEXED,
+    RECORD_CLEAR_ATTACHMENTS,
+    RECORD_RESET_QUERY,
+    RECORD_BEGIN_QUERY,
+    RECORD_END_QUERY,
+    RECORD_BEGIN_DEBUG_LABEL,
+    RECORD_END_DEBUG_LABEL,
+} RecordCommandType;
+
+typedef struct RecordCommandHeader {
+    uint32_t type;
+    uint32_t size;
+} RecordCommandHeader;
+
+typedef struct RecordVertexBuffers {
+    uint32_t count;
+    VkBuffer buffers[NV2A_VERTEXSHADER_ATTRIBUTES];
+    VkDeviceSize offsets[NV2A_VERTEXSHADER_ATTRIBUTES];
+} RecordVertexBuffers;
+
+typedef struct RecordIndexBuffer {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkIndexType index_type;
+} RecordIndexBuffer;
+
+typedef struct RecordDraw {
+    uint32_t count;
+    uint32_t first;
+} RecordDraw;
+
+typedef struct RecordClearAttachments {
+    uint32_t count;
+    VkClearAttachment attachments[2];
+    VkClearRect rect;
+} RecordClearAttachments;
+
+typedef struct RecordQuery {
+    VkQueryPool pool;
+    uint32_t query;
+    VkQueryControlFlags flags;
+} RecordQuery;
+
+typedef struct RecordDebugLabel {
+    float color[4];
+    char name[];
+} RecordDebugLabel;
+
+static RecordJob *get_job(PGRAPHVkRecordState *rec, uint64_t index)
+{
+    return &rec->jobs[index % MAX_RECORD_JOBS];
+}
+
+static float clamp_line_width_to_device_limits(PGRAPHVkState *r, float width)
+{
+    float min_width = r->device_props.limits.lineWidthRange[0];
+    float max_width = r->device_props.limits.lineWidthRange[1];
+    float granularity = r->device_props.limits.lineWidthGranularity;
+
+    if (granularity != 0.0f) {
+        float steps = roundf((width - min_width) / granularity);
+        width = min_width + steps * granularity;
+    }
+    return fminf(fmaxf(min_width, width), max_width);
+}
+
+static void bind_draw_state(PGRAPHVkState *r, VkCommandBuffer cmd,
+                            const DrawState *state)
+{
+    if (state->bind_pipeline) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          state->pipeline);
+        vkCmdSetViewport(cmd, 0, 1, &state->viewport);
+        vkCmdSetScissor(cmd, 0, 1, &state->scissor);
+        if (state->has_dynamic_line_width) {
+            vkCmdSetLineWidth(cmd, clamp_line_width_to_device_limits(
+                                       r, state->line_width));
+        }
+    }
+
+    if (!state->bind_descriptors) {
+        return;
+    }
+
+    VkWriteDescriptorSet writes[NUM_DESCRIPTOR_WRITES];
+
+    if (r->push_descriptor_extension_enabled) {
+        pgraph_vk_get_descriptor_writes(&state->descriptor_state,
+                                        VK_NULL_HANDLE, writes);
+        vkCmdPushDescriptorSetKHR(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  state->layout, 0, ARRAY_SIZE(writes),
+                                  writes);
+    } else {
+        // Not yet bound by any command buffer, so it may be written here
+        if (state->write_descriptor_set) {
+            pgraph_vk_get_descriptor_writes(&state->descriptor_state,
+                                            state->descriptor_set, writes);
+            vkUpdateDescriptorSets(r->device, ARRAY_SIZE(writes), writes, 0,
+                                   NULL);
+        }
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                state->layout, 0, 1, &state->descriptor_set, 0,
+                                NULL);
+    }
+
+    if (state->num_uniform_attrs > 0) {
+        vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                           state->num_uniform_attrs * 4 * sizeof(float),
+                           state->uniform_attrs);
+    }
+}
+
+static void replay_commands(PGRAPHVkState *r, VkCommandBuffer cmd,
+                            GByteArray *commands)
+{
+    size_t offset = 0;
+
+    while (offset < commands->len) {
+        RecordCommandHeader *hdr =
+            (RecordCommandHeader *)(commands->data + offset);
+        void *payload = hdr + 1;
+        offset += sizeof(*hdr) + hdr->size;
+
+        switch (hdr->type) {
+        case RECORD_BIND_DRAW_STATE:
+            bind_draw_state(r, cmd, payload);
+            break;
+        case RECORD_SET_SCISSOR:
+            vkCmdSetScissor(cmd, 0, 1, payload);
+            break;
+        case RECORD_SET_BLEND_CONSTANTS:
+            vkCmdSetBlendConstants(cmd, payload);
+            break;
+        case RECORD_BIND_VERTEX_BUFFERS: {
+            RecordVertexBuffers *c = payload;
+            vkCmdBindVertexBuffers(cmd, 0, c->count, c->buffers, c->offsets);
+            break;
+        }
+        case RECORD_BIND_INDEX_BUFFER: {
+            RecordIndexBuffer *c = payload;
+            vkCmdBindIndexBuffer(cmd, c->buffer, c->offset, c->index_type);
+            break;
+        }
+        case RECORD_DRAW: {
+            RecordDraw *c = payload;
+            vkCmdDraw(cmd, c->count, 1, c->first, 0);
+            break;
+        }
+        case RECORD_DRAW_INDEXED: {
+            RecordDraw *c = payload;
+            vkCmdDrawIndexed(cmd, c->count, 1, c->first, 0, 0);
+            break;
+        }
+        case RECORD_CLEAR_ATTACHMENTS: {
+            RecordClearAttachments *c = payload;
+            vkCmdClearAttachments(cmd, c->count, c->attachments, 1, &c->rect);
+            break;
+        }
+        case RECORD_RESET_QUERY: {
+            RecordQuery *c = payload;
+            vkCmdResetQueryPool(cmd, c->pool, c->query, 1);
+            break;
+        }
+        case RECORD_BEGIN_QUERY: {
+            RecordQuery *c = payload;
+            vkCmdBeginQuery(cmd, c->pool, c->query, c->flags);
+            break;
+        }
+        case RECORD_END_QUERY: {
+            RecordQuery *c = payload;
+            vkCmdEndQuery(cmd, c->pool, c->query);
+            break;
+        }
+        case RECORD_BEGIN_DEBUG_LABEL: {
+            RecordDebugLabel *c = payload;
+            VkDebugUtilsLabelEXT label_info = {
+                .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+                .pLabelName = c->name,
+            };
+            memcpy(label_info.color, c->color, sizeof(c->color));
+            vkCmdBeginDebugUtilsLabelEXT(cmd, &label_info);
+            break;
+        }
+        case RECORD_END_DEBUG_LABEL:
+            vkCmdEndDebugUtilsLabelEXT(cmd);
+            break;
+        default:
+            assert(!"Unknown recorded command");
+        }
+    }
+}
+
+static VkCommandBuffer get_secondary_command_buffer(PGRAPHVkState *r)
+{
+    PGRAPHVkRecordState *rec = &r->record;
+
+    if (rec->command_buffer_index == rec->command_buffers->len) {
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = rec->command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+        VkCommandBuffer cmd;
+        VK_CHECK(vkAllocateCommandBuffers(r->device, &alloc_info, &cmd));
+        g_array_append_val(rec->command_buffers, cmd);
+    }
+
+    return g_array_index(rec->command_buffers, VkCommandBuffer,
+                         rec->command_buffer_index++);
+}
+
+static void record_job(PGRAPHVkState *r, RecordJob *job)
+{
+    if (!job->has_render_pass) {
+        return;
+    }
+
+    VkCommandBuffer cmd = get_secondary_command_buffer(r);
+
+    // Draws may fall inside an occlusion query begun in the primary
+    VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = job->render_pass,
+        .subpass = 0,
+        .framebuffer = job->framebuffer,
+        .occlusionQueryEnable = VK_TRUE,
+        .queryFlags = VK_QUERY_CONTROL_PRECISE_BIT,
+    };
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance_info,
+    };
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+    replay_commands(r, cmd, job->commands);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    job->secondary = cmd;
+}
+
+static void *record_thread(void *arg)
+{
+    PGRAPHVkState *r = arg;
+    PGRAPHVkRecordState *rec = &r->record;
+
+    qemu_mutex_lock(&rec->lock);
+
+    while (!rec->shutdown) {
+        if (rec->num_recorded == rec->num_queued) {
+            qemu_cond_wait(&rec->job_queued, &rec->lock);
+            continue;
+        }
+
+        RecordJob *job = get_job(rec, rec->num_recorded);
+        qemu_mutex_unlock(&rec->lock);
+        record_job(r, job);
+        qemu_mutex_lock(&rec->lock);
+
+        rec->num_recorded++;
+        qemu_cond_signal(&rec->job_recorded);
+    }
+
+    qemu_mutex_unlock(&rec->lock);
+    return NULL;
+}
+
+static void queue_job(PGRAPHVkState *r)
+{
+    PGRAPHVkRecordState *rec = &r->record;
+
+    assert(rec->job_open);
+    rec->job_open = false;
+
+    qemu_mutex_lock(&rec->lock);
+    rec->num_queued++;
+    qemu_cond_signal(&rec->job_queued);
+    qemu_mutex_unlock(&rec->lock);
+}
+
+static void execute_jobs(PGRAPHVkState *r)
+{
+    PGRAPHVkRecordState *rec = &r->record;
+
+    assert(!r->in_render_pass);
+
+    if (rec->job_open) {
+        queue_job(r);
+    }
+
+    qemu_mutex_lock(&rec->lock);
+    while (rec->num_recorded < rec->num_queued) {
+        qemu_cond_wait(&rec->job_recorded, &rec->lock);
+    }
+    qemu_mutex_unlock(&rec->lock);
+
+    for (; rec->num_executed < rec->num_queued; rec->num_executed++) {
+        RecordJob *job = get_job(rec, rec->num_executed);
+
+        replay_commands(r, r->command_buffer, job->primary_commands);
+
+        if (job->has_render_pass) {
+            VkRenderPassBeginInfo render_pass_begin_info = {
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .renderPass = job->render_pass,
+                .framebuffer = job->framebuffer,
+                .renderArea.extent = job->extent,
+            };
+            vkCmdBeginRenderPass(r->command_buffer, &render_pass_begin_info,
+                                 VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(r->command_buffer, 1, &job->secondary);
+            vkCmdEndRenderPass(r->command_buffer);
+        }
+    }
+}
+
+static RecordJob *open_job(PGRAPHVkState *r)
+{
+    PGRAPHVkRecordState *rec = &r->record;
+
+    if (!rec->job_open) {
+        if (rec->num_queued - rec->num_executed >= MAX_RECORD_JOBS) {
+            execute_jobs(r);
+        }
+        RecordJob *job = get_job(rec, rec->num_queued);
+        g_byte_array_set_size(job->primary_commands, 0);
+        g_byte_array_set_size(job->commands, 0);
+        job->has_render_pass = false;
+        job->secondary = VK_NULL_HANDLE;
+        rec->job_open = true;
+    }
+
+    return get_job(rec, rec->num_queued);
+}
+
+static void *emit(PGRAPHVkState *r, RecordCommandType type, size_t size)
+{
+    RecordJob *job = open_job(r);
+    GByteArray *commands =
+        r->in_render_pass ? job->commands : job->primary_commands;
+
+    RecordCommandHeader hdr = {
+        .type = type,
+        .size = ROUND_UP(size, sizeof(uint64_t)),
+    };
+    size_t offset = commands->len;
+    g_byte_array_set_size(commands, offset + sizeof(hdr) + hdr.size);
+    memcpy(commands->data + offset, &hdr, sizeof(hdr));
+
+    return commands->data + offset + sizeof(hdr);
+}
+
+void pgraph_vk_init_recording(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkRecordState *rec = &r->record;
+
+    // Secondary command buffers can only continue an occlusion query begun in
+    // the primary command buffer with inheritedQueries
+    rec->available = r->enabled_physical_device_features.inheritedQueries;
+    rec->enabled = false;
+    rec->thread_running = false;
+    rec->shutdown = false;
+    rec->job_open = false;
+    rec->num_queued = rec->num_recorded = rec->num_executed = 0;
+
+    for (int i = 0; i < MAX_RECORD_JOBS; i++) {
+        rec->jobs[i].primary_commands = g_byte_array_new();
+        rec->jobs[i].commands = g_byte_array_new();
+    }
+
+    QueueFamilyIndices indices =
+        pgraph_vk_find_queue_families(r->physical_device);
+    VkCommandPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = indices.queue_family,
+    };
+    VK_CHECK(vkCreateCommandPool(r->device, &create_info, NULL,
+                                 &rec->command_pool));
+    rec->command_buffers = g_array_new(false, false, sizeof(VkCommandBuffer));
+    rec->command_buffer_index = 0;
+
+    qemu_mutex_init(&rec->lock);
+    qemu_cond_init(&rec->job_queued);
+    qemu_cond_init(&rec->job_recorded);
+}
+
+void pgraph_vk_finalize_recording(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkRecordState *rec = &r->record;
+
+    if (rec->thread_running) {
+        qemu_mutex_lock(&rec->lock);
+        rec->shutdown = true;
+        qemu_cond_broadcast(&rec->job_queued);
+        qemu_mutex_unlock(&rec->lock);
+        qemu_thread_join(&rec->thread);
+        rec->thread_running = false;
+    }
+
+    vkDestroyCommandPool(r->device, rec->command_pool, NULL);
+    g_array_free(rec->command_buffers, true);
+
+    for (int i = 0; i < MAX_RECORD_JOBS; i++) {
+        g_byte_array_free(rec->jobs[i].primary_commands, true);
+        g_byte_array_free(rec->jobs[i].commands, true);
+    }
+
+    qemu_cond_destroy(&rec->job_recorded);
+    qemu_cond_destroy(&rec->job_queued);
+    qemu_mutex_destroy(&rec->lock);
+}
+
+/*
+ * Called when a new primary command buffer begins. The mode is only switched
+ * here so that a command buffer is never recorded half inline, half threaded.
+ */
+void pgraph_vk_begin_recording(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkRecordState *rec = &r->record;
+
+    assert(!rec->job_open && rec->num_executed == rec->num_queued);
+
+    rec->enabled =
+        rec->available && g_config.display.vulkan.threaded_recording;
+
+    if (rec->enabled && !rec->thread_running) {
+        qemu_thread_create(&rec->thread, "nv2a.vk_record", record_thread, r,
+                           QEMU_THREAD_JOINABLE);
+        rec->thread_running = true;
+    }
+}
+
+/*
+ * Execute all recorded jobs into the primary command buffer. Must be called
+ * before recording anything into the primary command buffer directly.
+ */
+void pgraph_vk_flush_recording(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (r->record.enabled) {
+        execute_jobs(r);
+    }
+}
+
+/*
+ * Called once the GPU has finished executing the primary command buffer, and
+ * with it all secondary command buffers.
+ */
+void pgraph_vk_recording_complete(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+    PGRAPHVkRecordState *rec = &r->record;
+
+    assert(!rec->job_open && rec->num_executed == rec->num_queued);
+
+    if (rec->command_buffer_index) {
+        VK_CHECK(vkResetCommandPool(r->device, rec->command_pool, 0));
+        rec->command_buffer_index = 0;
+    }
+}
+
+void pgraph_vk_cmd_begin_render_pass(PGRAPHVkState *r,
+                                     const VkRenderPassBeginInfo *info)
+{
+    if (!r->record.enabled) {
+        vkCmdBeginRenderPass(r->command_buffer, info,
+                             VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    RecordJob *job = open_job(r);
+    assert(!job->has_render_pass);
+    job->has_render_pass = true;
+    job->render_pass = info->renderPass;
+    job->framebuffer = info->framebuffer;
+    job->extent = info->renderArea.extent;
+}
+
+void pgraph_vk_cmd_end_render_pass(PGRAPHVkState *r)
+{
+    if (!r->record.enabled) {
+        vkCmdEndRenderPass(r->command_buffer);
+        return;
+    }
+
+    // Hand the finished render pass off to the recording thread
+    queue_job(r);
+}
+
+void pgraph_vk_cmd_bind_draw_state(PGRAPHVkState *r, const DrawState *state)
+{
+    if (!r->record.enabled) {
+        bind_draw_state(r, r->command_buffer, state);
+        return;
+    }
+
+    // Only the uniform attributes in use are copied
+    size_t size = offsetof(DrawState, uniform_attrs) +
+                  state->num_uniform_attrs * sizeof(state->uniform_attrs[0]);
+    memcpy(emit(r, RECORD_BIND_DRAW_STATE, size), state, size);
+}
+
+void pgraph_vk_cmd_set_scissor(PGRAPHVkState *r, const VkRect2D *scissor)
+{
+    if (!r->record.enabled) {
+        vkCmdSetScissor(r->command_buffer, 0, 1, scissor);
+        return;
+    }
+
+    VkRect2D *c = emit(r, RECORD_SET_SCISSOR, sizeof(*c));
+    *c = *scissor;
+}
+
+void pgraph_vk_cmd_set_blend_constants(PGRAPHVkState *r,
+                                       const float blend_constants[4])
+{
+    if (!r->record.enabled) {
+        vkCmdSetBlendConstants(r->command_buffer, blend_constants);
+        return;
+    }
+
+    float *c = emit(r, RECORD_SET_BLEND_CONSTANTS, 4 * sizeof(float));
+    memcpy(c, blend_constants, 4 * sizeof(float));
+}
+
+void pgraph_vk_cmd_bind_vertex_buffers(PGRAPHVkState *r, uint32_t count,
+                                       const VkBuffer *buffers,
+                                       const VkDeviceSize *offsets)
+{
+    if (!r->record.enabled) {
+        vkCmdBindVertexBuffers(r->command_buffer, 0, count, buffers, offsets);
+        return;
+    }
+
+    assert(count <= NV2A_VERTEXSHADER_ATTRIBUTES);
+    RecordVertexBuffers *c = emit(r, RECORD_BIND_VERTEX_BUFFERS, sizeof(*c));
+    c->count = count;
+    memcpy(c->buffers, buffers, count * sizeof(buffers[0]));
+    memcpy(c->offsets, offsets, count * sizeof(offsets[0]));
+}
+
+void pgraph_vk_cmd_bind_index_buffer(PGRAPHVkState *r, VkBuffer buffer,
+                                     VkDeviceSize offset,
+                                     VkIndexType index_type)
+{
+    if (!r->record.enabled) {
+        vkCmdBindIndexBuffer(r->command_buffer, buffer, offset, index_type);
+        return;
+    }
+
+    RecordIndexBuffer *c = emit(r, RECORD_BIND_INDEX_BUFFER, sizeof(*c));
+    *c = (RecordIndexBuffer){
+        .buffer = buffer,
+        .offset = offset,
+        .index_type = index_type,
+    };
+}
+
+void pgraph_vk_cmd_draw(PGRAPHVkState *r, uint32_t vertex_count,
+                        uint32_t first_vertex)
+{
+    if (!r->record.enabled) {
+        vkCmdDraw(r->command_buffer, vertex_count, 1, first_vertex, 0);
+        return;
+    }
+
+    RecordDraw *c = emit(r, RECORD_DRAW, sizeof(*c));
+    *c = (RecordDraw){ .count = vertex_count, .first = first_vertex };
+}
+
+void pgraph_vk_cmd_draw_indexed(PGRAPHVkState *r, uint32_t index_count)
+{
+    if (!r->record.enabled) {
+        vkCmdDrawIndexed(r->command_buffer, index_count, 1, 0, 0, 0);
+        return;
+    }
+
+    RecordDraw *c = emit(r, RECORD_DRAW_INDEXED, sizeof(*c));
+    *c = (RecordDraw){ .count = index_count, .first = 0 };
+}
+
+void pgraph_vk_cmd_clear_attachments(PGRAPHVkState *r, uint32_t count,
+                                     const VkClearAttachment *attachments,
+                                     const VkClearRect *rect)
+{
+    if (!r->record.enabled) {
+        vkCmdClearAttachments(r->command_buffer, count, attachments, 1, rect);
+        return;
+    }
+
+    RecordClearAttachments *c =
+        emit(r, RECORD_CLEAR_ATTACHMENTS, sizeof(*c));
+    assert(count <= ARRAY_SIZE(c->attachments));
+    c->count = count;
+    memcpy(c->attachments, attachments, count * sizeof(attachments[0]));
+    c->rect = *rect;
+}
+
+void pgraph_vk_cmd_reset_query(PGRAPHVkState *r, VkQueryPool pool,
+                               uint32_t query)
+{
+    if (!r->record.enabled) {
+        vkCmdResetQueryPool(r->command_buffer, pool, query, 1);
+        return;
+    }
+
+    RecordQuery *c = emit(r, RECORD_RESET_QUERY, sizeof(*c));
+    *c = (RecordQuery){ .pool = pool, .query = query };
+}
+
+void pgraph_vk_cmd_begin_query(PGRAPHVkState *r, VkQueryPool pool,
+                               uint32_t query, VkQueryControlFlags flags)
+{
+    if (!r->record.enabled) {
+        vkCmdBeginQuery(r->command_buffer, pool, query, flags);
+        return;
+    }
+
+    RecordQuery *c = emit(r, RECORD_BEGIN_QUERY, sizeof(*c));
+    *c = (RecordQuery){ .pool = pool, .query = query, .flags = flags };
+}
+
+void pgraph_vk_cmd_end_query(PGRAPHVkState *r, VkQueryPool pool,
+                             uint32_t query)
+{
+    if (!r->record.enabled) {
+        vkCmdEndQuery(r->command_buffer, pool, query);
+        return;
+    }
+
+    RecordQuery *c = emit(r, RECORD_END_QUERY, sizeof(*c));
+    *c = (RecordQuery){ .pool = pool, .query = query };
+}
+
+void pgraph_vk_cmd_begin_debug_label(PGRAPHVkState *r,
+                                     const VkDebugUtilsLabelEXT *label)
+{
+    if (!r->record.enabled) {
+        vkCmdBeginDebugUtilsLabelEXT(r->command_buffer, label);
+        return;
+    }
+
+    size_t name_size = strlen(label->pLabelName) + 1;
+    RecordDebugLabel *c =
+        emit(r, RECORD_BEGIN_DEBUG_LABEL, sizeof(*c) + name_size);
+    memcpy(c->color, label->color, sizeof(c->color));
+    memcpy(c->name, label->pLabelName, name_size);
+}
+
+void pgraph_vk_cmd_end_debug_label(PGRAPHVkState *r)
+{
+    if (!r->record.enabled) {
+        vkCmdEndDebugUtilsLabelEXT(r->command_buffer);
+        return;
+    }
+
+    emit(r, RECORD_END_DEBUG_LABEL, 0);
+}
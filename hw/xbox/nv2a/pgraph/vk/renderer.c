@@ -51,6 +51,7 @@ static void pgraph_vk_init(NV2AState *d, Error **errp)
     }
 
     pgraph_vk_init_command_buffers(pg);
+    pgraph_vk_init_recording(pg);
     pgraph_vk_init_buffers(d);
     pgraph_vk_init_surfaces(pg);
     pgraph_vk_init_shaders(pg);
@@ -69,6 +70,10 @@ static void pgraph_vk_init(NV2AState *d, Error **errp)
 static void pgraph_vk_finalize(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    pgraph_vk_wait_timeline(r,
+                            pgraph_vk_submit_command_buffers(r, VK_NULL_HANDLE));
 
     pgraph_vk_finalize_display(pg);
     pgraph_vk_finalize_compute(pg);
@@ -78,6 +83,7 @@ static void pgraph_vk_finalize(NV2AState *d)
     pgraph_vk_finalize_shaders(pg);
     pgraph_vk_finalize_surfaces(pg);
     pgraph_vk_finalize_buffers(d);
+    pgraph_vk_finalize_recording(pg);
     pgraph_vk_finalize_command_buffers(pg);
     pgraph_vk_finalize_instance(pg);
 
@@ -106,8 +112,11 @@ static void pgraph_vk_flush(NV2AState *d)
 
 static void pgraph_vk_sync(NV2AState *d)
 {
-    PGRAPHState *pg = &d->pgraph;
-    pgraph_vk_render_display(pg);
+#if HAVE_EXTERNAL_MEMORY
+    timeline_begin("Compose Display");
+    pgraph_vk_render_display(&d->pgraph);
+    timeline_end();
+#endif
 
     qatomic_set(&d->pgraph.sync_pending, false);
     qemu_event_set(&d->pgraph.sync_complete);
@@ -119,6 +128,7 @@ static void pgraph_vk_process_pending(NV2AState *d)
 
     if (qatomic_read(&r->downloads_pending) ||
         qatomic_read(&r->download_dirty_surfaces_pending) ||
+        qatomic_read(&r->surface_scale_pending) ||
         qatomic_read(&d->pgraph.sync_pending) ||
         qatomic_read(&d->pgraph.flush_pending)
     ) {
@@ -130,6 +140,9 @@ static void pgraph_vk_process_pending(NV2AState *d)
         if (qatomic_read(&r->download_dirty_surfaces_pending)) {
             pgraph_vk_download_dirty_surfaces(d);
         }
+        if (qatomic_read(&r->surface_scale_pending)) {
+            pgraph_vk_process_pending_surface_scale(d);
+        }
         if (qatomic_read(&d->pgraph.sync_pending)) {
             pgraph_vk_sync(d);
         }
@@ -141,9 +154,31 @@ static void pgraph_vk_process_pending(NV2AState *d)
     }
 }
 
+static void update_cache_stats(PGRAPHVkState *r)
+{
+    g_nv2a_stats.occupancy.textures = r->texture_cache.num_used;
+    g_nv2a_stats.occupancy.textures_max =
+        r->texture_cache.num_used + r->texture_cache.num_free;
+    g_nv2a_stats.occupancy.shaders = r->shader_cache.num_used;
+    g_nv2a_stats.occupancy.shaders_max =
+        r->shader_cache.num_used + r->shader_cache.num_free;
+    g_nv2a_stats.occupancy.pipelines = r->pipeline_cache.num_used;
+    g_nv2a_stats.occupancy.pipelines_max =
+        r->pipeline_cache.num_used + r->pipeline_cache.num_free;
+
+    unsigned int num_surfaces = 0;
+    SurfaceBinding *surface;
+    QTAILQ_FOREACH(surface, &r->surfaces, entry) {
+        num_surfaces++;
+    }
+    g_nv2a_stats.occupancy.surfaces = num_surfaces;
+}
+
 static void pgraph_vk_flip_stall(NV2AState *d)
 {
     pgraph_vk_finish(&d->pgraph, VK_FINISH_REASON_FLIP_STALL);
+    update_cache_stats(d->pgraph.vk_renderer_state);
+    pgraph_vk_update_dynamic_surface_scale(d);
     pgraph_vk_debug_frame_terminator();
 }
 
@@ -191,12 +226,9 @@ static int pgraph_vk_get_framebuffer_surface(NV2AState *d)
     surface->frame_time = pg->frame_time;
 
 #if HAVE_EXTERNAL_MEMORY
-    qemu_event_reset(&d->pgraph.sync_complete);
-    qatomic_set(&pg->sync_pending, true);
-    pfifo_kick(d);
-    qemu_mutex_unlock(&d->pfifo.lock);
-    qemu_event_wait(&d->pgraph.sync_complete);
-    return r->display.gl_texture_id;
+    int slot = pgraph_present_acquire(d, surface->draw_time,
+                                      surface->upload_pending);
+    return slot >= 0 ? r->display.images[slot].gl_texture_id : 0;
 #else
     qemu_mutex_unlock(&d->pfifo.lock);
     pgraph_vk_wait_for_surface_download(surface);
@@ -92,6 +92,7 @@ enum Buffer {
     BUFFER_VERTEX_INLINE_STAGING,
     BUFFER_UNIFORM,
     BUFFER_UNIFORM_STAGING,
+    BUFFER_QUERY_RESULTS,
     BUFFER_COUNT
 };
 
@@ -106,6 +107,16 @@ typedef struct StorageBuffer {
     uint8_t *mapped;
 } StorageBuffer;
 
+#define NUM_AUX_COMMAND_BUFFERS 8
+#define MAX_STAGING_SEGMENTS 64
+
+typedef struct StagingSegment {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    bool recorded;
+    uint64_t timeline_value;
+} StagingSegment;
+
 typedef struct SurfaceBinding {
     QTAILQ_ENTRY(SurfaceBinding) entry;
     MemAccessCallback *access_cb;
@@ -120,6 +131,7 @@ typedef struct SurfaceBinding {
 
     unsigned int width;
     unsigned int height;
+    unsigned int scale;
     unsigned int pitch;
     size_t size;
 
@@ -142,6 +154,7 @@ typedef struct SurfaceBinding {
     VkImageLayout image_scratch_current_layout;
     VmaAllocation allocation_scratch;
 
+    uint64_t timeline_value;
     bool initialized;
 } SurfaceBinding;
 
@@ -221,13 +234,18 @@ typedef struct TextureBinding {
     uint64_t hash;
     unsigned int draw_time;
     uint32_t submit_time;
+    uint64_t timeline_value;
 } TextureBinding;
 
+#define MAX_QUERIES_IN_FLIGHT 1024
+#define MAX_PENDING_REPORTS 1024
+
 typedef struct QueryReport {
-    QSIMPLEQ_ENTRY(QueryReport) entry;
     bool clear;
+    bool written; // Answered early with a latent value
     uint32_t parameter;
     unsigned int query_count;
+    uint64_t timeline_value; // Retires the report once signaled
 } QueryReport;
 
 typedef struct PvideoState {
@@ -256,6 +274,25 @@ typedef struct PvideoState {
     uint32_t color_key;
 } PvideoState;
 
+typedef struct PGRAPHVkDisplayImage {
+    VkFramebuffer framebuffer;
+    VkImage image;
+    VkImageView image_view;
+    VkDeviceMemory memory;
+
+    int width, height;
+    int draw_time;
+
+    // OpenGL Interop
+#ifdef WIN32
+    HANDLE handle;
+#else
+    int fd;
+#endif
+    GLuint gl_memory_obj;
+    GLuint gl_texture_id;
+} PGRAPHVkDisplayImage;
+
 typedef struct PGRAPHVkDisplayState {
     ShaderModuleInfo *display_frag;
 
@@ -267,13 +304,11 @@ typedef struct PGRAPHVkDisplayState {
     VkPipeline pipeline;
 
     VkRenderPass render_pass;
-    VkFramebuffer framebuffer;
-
-    VkImage image;
-    VkImageView image_view;
-    VkDeviceMemory memory;
     VkSampler sampler;
 
+    // One per presentation queue slot
+    PGRAPHVkDisplayImage images[PGRAPH_PRESENT_MAX_SLOTS];
+
     struct {
         PvideoState state;
         int width, height;
@@ -282,18 +317,6 @@ typedef struct PGRAPHVkDisplayState {
         VmaAllocation allocation;
         VkSampler sampler;
     } pvideo;
-
-    int width, height;
-    int draw_time;
-
-    // OpenGL Interop
-#ifdef WIN32
-    HANDLE handle;
-#else
-    int fd;
-#endif
-    GLuint gl_memory_obj;
-    GLuint gl_texture_id;
 } PGRAPHVkDisplayState;
 
 typedef struct ComputePipelineKey {
@@ -318,6 +341,69 @@ typedef struct PGRAPHVkComputeState {
     ComputePipeline *pipeline_cache_entries;
 } PGRAPHVkComputeState;
 
+#define NUM_DESCRIPTOR_WRITES (2 + NV2A_MAX_TEXTURES)
+
+typedef struct DescriptorState {
+    VkDescriptorBufferInfo ubo[2];
+    VkDescriptorImageInfo textures[NV2A_MAX_TEXTURES];
+} DescriptorState;
+
+/*
+ * What a draw needs bound, as captured by the PFIFO thread. It is resolved
+ * into commands, including writing the descriptor set, by whichever thread
+ * records the render pass.
+ */
+typedef struct DrawState {
+    bool bind_pipeline;
+    bool has_dynamic_line_width;
+    bool bind_descriptors;
+    bool write_descriptor_set;
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+    VkViewport viewport;
+    VkRect2D scissor;
+    float line_width; // Not yet clamped to the device limits
+    VkDescriptorSet descriptor_set; // Unused with push descriptors
+    DescriptorState descriptor_state;
+    uint32_t num_uniform_attrs;
+    float uniform_attrs[NV2A_VERTEXSHADER_ATTRIBUTES][4]; // Must be last
+} DrawState;
+
+#define MAX_RECORD_JOBS 64
+
+typedef struct RecordJob {
+    GByteArray *primary_commands; // Recorded before the render pass begins
+    GByteArray *commands;         // Recorded inside the render pass
+    bool has_render_pass;
+    VkRenderPass render_pass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    VkCommandBuffer secondary;
+} RecordJob;
+
+typedef struct PGRAPHVkRecordState {
+    bool available;
+    bool enabled;
+
+    QemuThread thread;
+    bool thread_running;
+    QemuMutex lock;
+    QemuCond job_queued;
+    QemuCond job_recorded;
+    bool shutdown;
+
+    // Owned by the recording thread
+    VkCommandPool command_pool;
+    GArray *command_buffers; // VkCommandBuffer
+    unsigned int command_buffer_index;
+
+    RecordJob jobs[MAX_RECORD_JOBS];
+    bool job_open;
+    uint64_t num_queued;
+    uint64_t num_recorded;
+    uint64_t num_executed;
+} PGRAPHVkRecordState;
+
 typedef struct PGRAPHVkState {
     uint32_t vk_api_version;
     VkInstance instance;
@@ -327,6 +413,8 @@ typedef struct PGRAPHVkState {
     bool debug_utils_extension_enabled;
     bool custom_border_color_extension_enabled;
     bool memory_budget_extension_enabled;
+    bool timeline_semaphore_enabled;
+    bool push_descriptor_extension_enabled;
 
     VkPhysicalDevice physical_device;
     VkPhysicalDeviceFeatures enabled_physical_device_features;
@@ -337,17 +425,28 @@ typedef struct PGRAPHVkState {
 
     VkQueue queue;
     VkCommandPool command_pool;
-    VkCommandBuffer command_buffers[2];
+    VkCommandBuffer command_buffers[1 + NUM_AUX_COMMAND_BUFFERS];
 
     VkCommandBuffer command_buffer;
-    VkSemaphore command_buffer_semaphore;
     VkFence command_buffer_fence;
     unsigned int command_buffer_start_time;
     bool in_command_buffer;
     uint32_t submit_count;
 
+    VkSemaphore timeline_semaphore;
+    uint64_t timeline_submitted;
+    uint64_t timeline_completed;
+
     VkCommandBuffer aux_command_buffer;
     bool in_aux_command_buffer;
+    int aux_command_buffer_index;
+    uint64_t aux_command_buffer_timeline_values[NUM_AUX_COMMAND_BUFFERS];
+    VkCommandBuffer pending_command_buffers[NUM_AUX_COMMAND_BUFFERS];
+    int num_pending_command_buffers;
+
+    StagingSegment staging_segments[MAX_STAGING_SEGMENTS];
+    int staging_segments_head;
+    int num_staging_segments;
 
     VkFramebuffer framebuffers[50];
     int framebuffer_index;
@@ -364,10 +463,13 @@ typedef struct PGRAPHVkState {
     PipelineBinding *pipeline_binding;
     bool pipeline_binding_changed;
 
-    VkDescriptorPool descriptor_pool;
+    GArray *descriptor_pools; // VkDescriptorPool
     VkDescriptorSetLayout descriptor_set_layout;
-    VkDescriptorSet descriptor_sets[1024];
+    VkDescriptorSet *descriptor_sets;
+    int num_descriptor_sets;
     int descriptor_set_index;
+    bool descriptor_set_needs_write;
+    DescriptorState descriptor_state;
 
     StorageBuffer storage_buffers[BUFFER_COUNT];
 
@@ -391,6 +493,8 @@ typedef struct PGRAPHVkState {
     QemuEvent downloads_complete;
     bool download_dirty_surfaces_pending;
     QemuEvent dirty_surfaces_download_complete; // common
+    bool surface_scale_pending;
+    QemuEvent surface_scale_complete;
 
     Lru texture_cache;
     TextureBinding *texture_cache_entries;
@@ -398,6 +502,7 @@ typedef struct PGRAPHVkState {
     TextureBinding dummy_texture;
     bool texture_bindings_changed;
     VkFormatProperties *texture_format_properties;
+    bool texture_bc_supported[2][3]; // [is_3d][S3TC_DECOMPRESS_FORMAT]
 
     Lru shader_cache;
     ShaderBinding *shader_cache_entries;
@@ -415,12 +520,22 @@ typedef struct PGRAPHVkState {
     bool uniforms_changed;
 
     VkQueryPool query_pool;
-    int max_queries_in_flight; // FIXME: Move out to constant
     int num_queries_in_flight;
     bool new_query_needed;
     bool query_in_flight;
     uint32_t zpass_pixel_count_result;
-    QSIMPLEQ_HEAD(, QueryReport) report_queue; // FIXME: Statically allocate
+    QueryReport report_queue[MAX_PENDING_REPORTS];
+    unsigned int report_queue_head;
+    unsigned int report_queue_len;
+
+    VkQueryPool timestamp_query_pool;
+    bool timestamps_supported;
+    uint64_t gpu_frame_time_ns;
+
+    struct {
+        float avg_frame_time_ms;
+        int cooldown;
+    } dynamic_scale;
 
     SurfaceFormatInfo kelvin_surface_zeta_vk_map[3];
 
@@ -428,6 +543,7 @@ typedef struct PGRAPHVkState {
 
     PGRAPHVkDisplayState display;
     PGRAPHVkComputeState compute;
+    PGRAPHVkRecordState record;
 } PGRAPHVkState;
 
 // renderer.c
@@ -477,12 +593,20 @@ bool pgraph_vk_buffer_has_space_for(PGRAPHState *pg, int index,
 VkDeviceSize pgraph_vk_append_to_buffer(PGRAPHState *pg, int index, void **data,
                                         VkDeviceSize *sizes, size_t count,
                                         VkDeviceAddress alignment);
+VkDeviceSize pgraph_vk_staging_alloc(PGRAPHState *pg, VkDeviceSize size);
+void pgraph_vk_staging_mark_recorded(PGRAPHVkState *r);
+void pgraph_vk_staging_set_timeline_value(PGRAPHVkState *r, uint64_t value);
 
 // command.c
 void pgraph_vk_init_command_buffers(PGRAPHState *pg);
 void pgraph_vk_finalize_command_buffers(PGRAPHState *pg);
 VkCommandBuffer pgraph_vk_begin_single_time_commands(PGRAPHState *pg);
-void pgraph_vk_end_single_time_commands(PGRAPHState *pg, VkCommandBuffer cmd);
+uint64_t pgraph_vk_end_single_time_commands(PGRAPHState *pg,
+                                            VkCommandBuffer cmd);
+uint64_t pgraph_vk_submit_command_buffers(PGRAPHVkState *r,
+                                          VkCommandBuffer cmd);
+void pgraph_vk_wait_timeline(PGRAPHVkState *r, uint64_t value);
+uint64_t pgraph_vk_poll_timeline(PGRAPHVkState *r);
 
 // image.c
 void pgraph_vk_transition_image_layout(PGRAPHState *pg, VkCommandBuffer cmd,
@@ -524,6 +648,9 @@ void pgraph_vk_set_surface_dirty(PGRAPHState *pg, bool color, bool zeta);
 void pgraph_vk_set_surface_scale_factor(NV2AState *d, unsigned int scale);
 unsigned int pgraph_vk_get_surface_scale_factor(NV2AState *d);
 void pgraph_vk_reload_surface_scale_factor(PGRAPHState *pg);
+void pgraph_vk_update_dynamic_surface_scale(NV2AState *d);
+void pgraph_vk_process_pending_surface_scale(NV2AState *d);
+void pgraph_vk_surface_rescale_if_stale(NV2AState *d, SurfaceBinding *surface);
 
 // surface-compute.c
 void pgraph_vk_init_compute(PGRAPHState *pg);
@@ -554,6 +681,9 @@ void pgraph_vk_trim_texture_cache(PGRAPHState *pg);
 void pgraph_vk_init_shaders(PGRAPHState *pg);
 void pgraph_vk_finalize_shaders(PGRAPHState *pg);
 void pgraph_vk_update_descriptor_sets(PGRAPHState *pg);
+void pgraph_vk_get_descriptor_writes(const DescriptorState *state,
+                                     VkDescriptorSet set,
+                                     VkWriteDescriptorSet *writes);
 void pgraph_vk_bind_shaders(PGRAPHState *pg);
 
 // reports.c
@@ -563,6 +693,11 @@ void pgraph_vk_clear_report_value(NV2AState *d);
 void pgraph_vk_get_report(NV2AState *d, uint32_t parameter);
 void pgraph_vk_process_pending_reports(NV2AState *d);
 void pgraph_vk_process_pending_reports_internal(NV2AState *d);
+void pgraph_vk_copy_query_results(PGRAPHState *pg, VkCommandBuffer cmd);
+void pgraph_vk_set_reports_timeline_value(PGRAPHState *pg, uint64_t value);
+void pgraph_vk_begin_gpu_timer(PGRAPHState *pg, VkCommandBuffer cmd);
+void pgraph_vk_end_gpu_timer(PGRAPHState *pg, VkCommandBuffer cmd);
+void pgraph_vk_collect_gpu_timer(PGRAPHState *pg);
 
 typedef enum FinishReason {
     VK_FINISH_REASON_VERTEX_BUFFER_DIRTY,
@@ -591,6 +726,41 @@ void pgraph_vk_ensure_not_in_render_pass(PGRAPHState *pg);
 VkCommandBuffer pgraph_vk_begin_nondraw_commands(PGRAPHState *pg);
 void pgraph_vk_end_nondraw_commands(PGRAPHState *pg, VkCommandBuffer cmd);
 
+// record.c
+void pgraph_vk_init_recording(PGRAPHState *pg);
+void pgraph_vk_finalize_recording(PGRAPHState *pg);
+void pgraph_vk_begin_recording(PGRAPHState *pg);
+void pgraph_vk_flush_recording(PGRAPHState *pg);
+void pgraph_vk_recording_complete(PGRAPHState *pg);
+void pgraph_vk_cmd_begin_render_pass(PGRAPHVkState *r,
+                                     const VkRenderPassBeginInfo *info);
+void pgraph_vk_cmd_end_render_pass(PGRAPHVkState *r);
+void pgraph_vk_cmd_bind_draw_state(PGRAPHVkState *r, const DrawState *state);
+void pgraph_vk_cmd_set_scissor(PGRAPHVkState *r, const VkRect2D *scissor);
+void pgraph_vk_cmd_set_blend_constants(PGRAPHVkState *r,
+                                       const float blend_constants[4]);
+void pgraph_vk_cmd_bind_vertex_buffers(PGRAPHVkState *r, uint32_t count,
+                                       const VkBuffer *buffers,
+                                       const VkDeviceSize *offsets);
+void pgraph_vk_cmd_bind_index_buffer(PGRAPHVkState *r, VkBuffer buffer,
+                                     VkDeviceSize offset,
+                                     VkIndexType index_type);
+void pgraph_vk_cmd_draw(PGRAPHVkState *r, uint32_t vertex_count,
+                        uint32_t first_vertex);
+void pgraph_vk_cmd_draw_indexed(PGRAPHVkState *r, uint32_t index_count);
+void pgraph_vk_cmd_clear_attachments(PGRAPHVkState *r, uint32_t count,
+                                     const VkClearAttachment *attachments,
+                                     const VkClearRect *rect);
+void pgraph_vk_cmd_reset_query(PGRAPHVkState *r, VkQueryPool pool,
+                               uint32_t query);
+void pgraph_vk_cmd_begin_query(PGRAPHVkState *r, VkQueryPool pool,
+                               uint32_t query, VkQueryControlFlags flags);
+void pgraph_vk_cmd_end_query(PGRAPHVkState *r, VkQueryPool pool,
+                             uint32_t query);
+void pgraph_vk_cmd_begin_debug_label(PGRAPHVkState *r,
+                                     const VkDebugUtilsLabelEXT *label);
+void pgraph_vk_cmd_end_debug_label(PGRAPHVkState *r);
+
 // blit.c
 void pgraph_vk_image_blit(NV2AState *d);
 
@@ -17,15 +17,16 @@
  * License along with this library; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "ui/xemu-settings.h"
 #include "renderer.h"
 
 void pgraph_vk_init_reports(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
-    QSIMPLEQ_INIT(&r->report_queue);
+    r->report_queue_head = 0;
+    r->report_queue_len = 0;
     r->num_queries_in_flight = 0;
-    r->max_queries_in_flight = 1024;
     r->new_query_needed = false;
     r->query_in_flight = false;
     r->zpass_pixel_count_result = 0;
@@ -33,23 +34,73 @@ void pgraph_vk_init_reports(PGRAPHState *pg)
     VkQueryPoolCreateInfo pool_create_info = (VkQueryPoolCreateInfo){
         .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
         .queryType = VK_QUERY_TYPE_OCCLUSION,
-        .queryCount = r->max_queries_in_flight,
+        .queryCount = MAX_QUERIES_IN_FLIGHT,
     };
     VK_CHECK(
         vkCreateQueryPool(r->device, &pool_create_info, NULL, &r->query_pool));
+
+    r->gpu_frame_time_ns = 0;
+    r->timestamps_supported =
+        r->device_props.limits.timestampComputeAndGraphics &&
+        r->device_props.limits.timestampPeriod > 0;
+
+    if (r->timestamps_supported) {
+        VkQueryPoolCreateInfo timestamp_pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(r->device, &timestamp_pool_create_info,
+                                   NULL, &r->timestamp_query_pool));
+    }
 }
 
 void pgraph_vk_finalize_reports(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
-    QueryReport *report;
-    while ((report = QSIMPLEQ_FIRST(&r->report_queue)) != NULL) {
-        QSIMPLEQ_REMOVE_HEAD(&r->report_queue, entry);
-        g_free(report);
-    }
+    r->report_queue_head = 0;
+    r->report_queue_len = 0;
 
     vkDestroyQueryPool(r->device, r->query_pool, NULL);
+
+    if (r->timestamps_supported) {
+        vkDestroyQueryPool(r->device, r->timestamp_query_pool, NULL);
+    }
+}
+
+static QueryReport *get_report_at(PGRAPHVkState *r, unsigned int i)
+{
+    assert(i < r->report_queue_len);
+    return &r->report_queue[(r->report_queue_head + i) % MAX_PENDING_REPORTS];
+}
+
+static QueryReport *push_report(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (r->report_queue_len == MAX_PENDING_REPORTS) {
+        pgraph_vk_finish(pg, VK_FINISH_REASON_NEED_BUFFER_SPACE);
+    }
+    assert(r->report_queue_len < MAX_PENDING_REPORTS);
+
+    QueryReport *report = &r->report_queue[
+        (r->report_queue_head + r->report_queue_len++) % MAX_PENDING_REPORTS];
+
+    /* Queries recorded in the open command buffer are retired by its
+     * submission, see pgraph_vk_set_reports_timeline_value. */
+    report->timeline_value = r->timeline_submitted;
+    report->query_count = r->num_queries_in_flight;
+    report->written = false;
+
+    return report;
+}
+
+static void pop_report(PGRAPHVkState *r)
+{
+    assert(r->report_queue_len > 0);
+    r->report_queue_head = (r->report_queue_head + 1) % MAX_PENDING_REPORTS;
+    r->report_queue_len--;
 }
 
 void pgraph_vk_clear_report_value(NV2AState *d)
@@ -57,11 +108,9 @@ void pgraph_vk_clear_report_value(NV2AState *d)
     PGRAPHState *pg = &d->pgraph;
     PGRAPHVkState *r = pg->vk_renderer_state;
 
-    QueryReport *report = g_malloc(sizeof(QueryReport)); // FIXME: Pre-allocate
+    QueryReport *report = push_report(pg);
     report->clear = true;
     report->parameter = 0;
-    report->query_count = r->num_queries_in_flight;
-    QSIMPLEQ_INSERT_TAIL(&r->report_queue, report, entry);
 
     r->new_query_needed = true;
 }
@@ -74,15 +123,103 @@ void pgraph_vk_get_report(NV2AState *d, uint32_t parameter)
     uint8_t type = GET_MASK(parameter, NV097_GET_REPORT_TYPE);
     assert(type == NV097_GET_REPORT_TYPE_ZPASS_PIXEL_CNT);
 
-    QueryReport *report = g_malloc(sizeof(QueryReport)); // FIXME: Pre-allocate
+    QueryReport *report = push_report(pg);
     report->clear = false;
     report->parameter = parameter;
-    report->query_count = r->num_queries_in_flight;
-    QSIMPLEQ_INSERT_TAIL(&r->report_queue, report, entry);
 
     r->new_query_needed = true;
 }
 
+void pgraph_vk_copy_query_results(PGRAPHState *pg, VkCommandBuffer cmd)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    assert(!r->in_render_pass);
+    assert(!r->query_in_flight);
+
+    if (r->num_queries_in_flight == 0) {
+        return;
+    }
+
+    StorageBuffer *b = &r->storage_buffers[BUFFER_QUERY_RESULTS];
+
+    vkCmdCopyQueryPoolResults(cmd, r->query_pool, 0, r->num_queries_in_flight,
+                              b->buffer, 0, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT |
+                                  VK_QUERY_RESULT_WAIT_BIT);
+
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = b->buffer,
+        .size = r->num_queries_in_flight * sizeof(uint64_t),
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &barrier, 0,
+                         NULL);
+}
+
+/*
+ * Called when the command buffer is submitted. Every queued report depends
+ * only on queries in this or earlier submissions.
+ */
+void pgraph_vk_set_reports_timeline_value(PGRAPHState *pg, uint64_t value)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    for (unsigned int i = 0; i < r->report_queue_len; i++) {
+        get_report_at(r, i)->timeline_value = value;
+    }
+}
+
+void pgraph_vk_begin_gpu_timer(PGRAPHState *pg, VkCommandBuffer cmd)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (!r->timestamps_supported) {
+        return;
+    }
+
+    vkCmdResetQueryPool(cmd, r->timestamp_query_pool, 0, 2);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        r->timestamp_query_pool, 0);
+}
+
+void pgraph_vk_end_gpu_timer(PGRAPHState *pg, VkCommandBuffer cmd)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (!r->timestamps_supported) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        r->timestamp_query_pool, 1);
+}
+
+void pgraph_vk_collect_gpu_timer(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (!r->timestamps_supported) {
+        return;
+    }
+
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(
+        r->device, r->timestamp_query_pool, 0, 2, sizeof(timestamps),
+        timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS || timestamps[1] < timestamps[0]) {
+        return;
+    }
+
+    r->gpu_frame_time_ns += (uint64_t)((timestamps[1] - timestamps[0]) *
+                                       r->device_props.limits.timestampPeriod);
+}
+
 void pgraph_vk_process_pending_reports_internal(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
@@ -92,20 +229,23 @@ void pgraph_vk_process_pending_reports_internal(NV2AState *d)
 
     assert(!r->in_command_buffer);
 
-    // Fetch all query results
-    g_autofree uint64_t *query_results = NULL;
+    // Results are copied out at the end of the last submission, so every
+    // queued report retires together once it has signaled
+    if (r->report_queue_len > 0 &&
+        get_report_at(r, r->report_queue_len - 1)->timeline_value >
+            pgraph_vk_poll_timeline(r)) {
+        NV2A_VK_DGROUP_END();
+        return;
+    }
+
+    uint64_t *query_results = NULL;
 
     if (r->num_queries_in_flight > 0) {
-        size_t size_of_results = r->num_queries_in_flight * sizeof(uint64_t);
-        query_results = g_malloc_n(r->num_queries_in_flight,
-                                   sizeof(uint64_t)); // FIXME: Pre-allocate
-        VkResult result;
-        do {
-            result = vkGetQueryPoolResults(
-                r->device, r->query_pool, 0, r->num_queries_in_flight,
-                size_of_results, query_results, sizeof(uint64_t),
-                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
-        } while (result == VK_NOT_READY);
+        StorageBuffer *b = &r->storage_buffers[BUFFER_QUERY_RESULTS];
+        VK_CHECK(vmaInvalidateAllocation(
+            r->allocator, b->allocation, 0,
+            r->num_queries_in_flight * sizeof(uint64_t)));
+        query_results = (uint64_t *)b->mapped;
     }
 
     // Write out queries
@@ -113,8 +253,8 @@ void pgraph_vk_process_pending_reports_internal(NV2AState *d)
     const int result_divisor =
         pg->surface_scale_factor * pg->surface_scale_factor;
 
-    QueryReport *report;
-    while ((report = QSIMPLEQ_FIRST(&r->report_queue)) != NULL) {
+    while (r->report_queue_len > 0) {
+        QueryReport *report = get_report_at(r, 0);
         assert(report->query_count >= num_results_counted);
         assert(report->query_count <= r->num_queries_in_flight);
 
@@ -126,14 +266,13 @@ void pgraph_vk_process_pending_reports_internal(NV2AState *d)
         if (report->clear) {
             NV2A_VK_DPRINTF("Cleared");
             r->zpass_pixel_count_result = 0;
-        } else {
+        } else if (!report->written) {
             pgraph_write_zpass_pixel_cnt_report(
                 d, report->parameter,
                 r->zpass_pixel_count_result / result_divisor);
         }
 
-        QSIMPLEQ_REMOVE_HEAD(&r->report_queue, entry);
-        g_free(report);
+        pop_report(r);
     }
 
     // Add remaining results
@@ -145,6 +284,34 @@ void pgraph_vk_process_pending_reports_internal(NV2AState *d)
     NV2A_VK_DGROUP_END();
 }
 
+/*
+ * Answer outstanding reports with the pixel count retired by the last
+ * completed submission instead of draining the GPU. The count for queries
+ * still in flight is folded in when the submission retires.
+ */
+static void write_latent_reports(NV2AState *d)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    const int result_divisor =
+        pg->surface_scale_factor * pg->surface_scale_factor;
+    uint32_t result = r->zpass_pixel_count_result;
+
+    for (unsigned int i = 0; i < r->report_queue_len; i++) {
+        QueryReport *report = get_report_at(r, i);
+
+        if (report->clear) {
+            result = 0;
+        } else if (!report->written) {
+            pgraph_write_zpass_pixel_cnt_report(d, report->parameter,
+                                                result / result_divisor);
+            report->written = true;
+            nv2a_profile_inc_counter(NV2A_PROF_QUERY_REPORT_LATENT);
+        }
+    }
+}
+
 void pgraph_vk_process_pending_reports(NV2AState *d)
 {
     PGRAPHState *pg = &d->pgraph;
@@ -153,8 +320,15 @@ void pgraph_vk_process_pending_reports(NV2AState *d)
     uint32_t *dma_get = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET];
     uint32_t *dma_put = &d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUT];
 
-    if (*dma_get == *dma_put && r->in_command_buffer &&
-        !QSIMPLEQ_EMPTY(&r->report_queue)) {
+    if (*dma_get != *dma_put || r->report_queue_len == 0) {
+        return;
+    }
+
+    if (!r->in_command_buffer) {
+        pgraph_vk_process_pending_reports_internal(d);
+    } else if (g_config.display.vulkan.report_latency) {
+        write_latent_reports(d);
+    } else {
         pgraph_vk_finish(pg, VK_FINISH_REASON_STALLED);
     }
 }
@@ -28,20 +28,25 @@
 
 const size_t MAX_UNIFORM_ATTR_VALUES_SIZE = NV2A_VERTEXSHADER_ATTRIBUTES * 4 * sizeof(float);
 
-static void create_descriptor_pool(PGRAPHState *pg)
+#define DESCRIPTOR_SETS_PER_POOL 1024
+
+/*
+ * Grow the descriptor set pool by another block of sets. Sets are handed out
+ * linearly and recycled once the command buffer using them has completed, so
+ * running out never forces a submission.
+ */
+static void add_descriptor_pool(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
-    size_t num_sets = ARRAY_SIZE(r->descriptor_sets);
-
     VkDescriptorPoolSize pool_sizes[] = {
         {
             .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 2 * num_sets,
+            .descriptorCount = 2 * DESCRIPTOR_SETS_PER_POOL,
         },
         {
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = NV2A_MAX_TEXTURES * num_sets,
+            .descriptorCount = NV2A_MAX_TEXTURES * DESCRIPTOR_SETS_PER_POOL,
         }
     };
 
@@ -49,26 +54,71 @@ static void create_descriptor_pool(PGRAPHState *pg)
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .poolSizeCount = ARRAY_SIZE(pool_sizes),
         .pPoolSizes = pool_sizes,
-        .maxSets = ARRAY_SIZE(r->descriptor_sets),
-        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+        .maxSets = DESCRIPTOR_SETS_PER_POOL,
+    };
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(r->device, &pool_info, NULL, &pool));
+    g_array_append_val(r->descriptor_pools, pool);
+
+    VkDescriptorSetLayout layouts[DESCRIPTOR_SETS_PER_POOL];
+    for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
+        layouts[i] = r->descriptor_set_layout;
+    }
+
+    r->descriptor_sets =
+        g_renew(VkDescriptorSet, r->descriptor_sets,
+                r->num_descriptor_sets + DESCRIPTOR_SETS_PER_POOL);
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool,
+        .descriptorSetCount = DESCRIPTOR_SETS_PER_POOL,
+        .pSetLayouts = layouts,
     };
-    VK_CHECK(vkCreateDescriptorPool(r->device, &pool_info, NULL,
-                                    &r->descriptor_pool));
+    VK_CHECK(vkAllocateDescriptorSets(
+        r->device, &alloc_info, &r->descriptor_sets[r->num_descriptor_sets]));
+    r->num_descriptor_sets += DESCRIPTOR_SETS_PER_POOL;
+
+    nv2a_profile_inc_counter(NV2A_PROF_DESCRIPTOR_POOL_GROW);
 }
 
-static void destroy_descriptor_pool(PGRAPHState *pg)
+static void create_descriptor_pools(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
-    vkDestroyDescriptorPool(r->device, r->descriptor_pool, NULL);
-    r->descriptor_pool = VK_NULL_HANDLE;
+    r->descriptor_pools = g_array_new(false, false, sizeof(VkDescriptorPool));
+    r->descriptor_sets = NULL;
+    r->num_descriptor_sets = 0;
+    r->descriptor_set_index = 0;
+    r->descriptor_set_needs_write = false;
+
+    if (!r->push_descriptor_extension_enabled) {
+        add_descriptor_pool(pg);
+    }
+}
+
+static void destroy_descriptor_pools(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    for (int i = 0; i < r->descriptor_pools->len; i++) {
+        vkDestroyDescriptorPool(
+            r->device, g_array_index(r->descriptor_pools, VkDescriptorPool, i),
+            NULL);
+    }
+    g_array_free(r->descriptor_pools, true);
+    r->descriptor_pools = NULL;
+
+    g_free(r->descriptor_sets);
+    r->descriptor_sets = NULL;
+    r->num_descriptor_sets = 0;
 }
 
 static void create_descriptor_set_layout(PGRAPHState *pg)
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
 
-    VkDescriptorSetLayoutBinding bindings[2 + NV2A_MAX_TEXTURES];
+    VkDescriptorSetLayoutBinding bindings[NUM_DESCRIPTOR_WRITES];
 
     bindings[0] = (VkDescriptorSetLayoutBinding){
         .binding = VSH_UBO_BINDING,
@@ -92,6 +142,9 @@ static void create_descriptor_set_layout(PGRAPHState *pg)
     }
     VkDescriptorSetLayoutCreateInfo layout_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .flags = r->push_descriptor_extension_enabled ?
+                     VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR :
+                     0,
         .bindingCount = ARRAY_SIZE(bindings),
         .pBindings = bindings,
     };
@@ -107,33 +160,31 @@ static void destroy_descriptor_set_layout(PGRAPHState *pg)
     r->descriptor_set_layout = VK_NULL_HANDLE;
 }
 
-static void create_descriptor_sets(PGRAPHState *pg)
+void pgraph_vk_get_descriptor_writes(const DescriptorState *state,
+                                     VkDescriptorSet set,
+                                     VkWriteDescriptorSet *writes)
 {
-    PGRAPHVkState *r = pg->vk_renderer_state;
-
-    VkDescriptorSetLayout layouts[ARRAY_SIZE(r->descriptor_sets)];
-    for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
-        layouts[i] = r->descriptor_set_layout;
+    for (int i = 0; i < ARRAY_SIZE(state->ubo); i++) {
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = i == 0 ? VSH_UBO_BINDING : PSH_UBO_BINDING,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &state->ubo[i],
+        };
     }
-
-    VkDescriptorSetAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool = r->descriptor_pool,
-        .descriptorSetCount = ARRAY_SIZE(r->descriptor_sets),
-        .pSetLayouts = layouts,
-    };
-    VK_CHECK(
-        vkAllocateDescriptorSets(r->device, &alloc_info, r->descriptor_sets));
-}
-
-static void destroy_descriptor_sets(PGRAPHState *pg)
-{
-    PGRAPHVkState *r = pg->vk_renderer_state;
-
-    vkFreeDescriptorSets(r->device, r->descriptor_pool,
-                         ARRAY_SIZE(r->descriptor_sets), r->descriptor_sets);
-    for (int i = 0; i < ARRAY_SIZE(r->descriptor_sets); i++) {
-        r->descriptor_sets[i] = VK_NULL_HANDLE;
+    for (int i = 0; i < NV2A_MAX_TEXTURES; i++) {
+        writes[2 + i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = PSH_TEX_BINDING + i,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &state->textures[i],
+        };
     }
 }
 
@@ -163,18 +214,11 @@ void pgraph_vk_update_descriptor_sets(PGRAPHState *pg)
                                         ubo_buffer_total_size,
                                         r->device_props.limits.minUniformBufferOffsetAlignment);
 
-    bool need_descriptor_write_reset =
-        (r->descriptor_set_index >= ARRAY_SIZE(r->descriptor_sets));
-
-    if (need_descriptor_write_reset || need_ubo_staging_buffer_reset) {
+    if (need_ubo_staging_buffer_reset) {
         pgraph_vk_finish(pg, VK_FINISH_REASON_NEED_BUFFER_SPACE);
         need_uniform_write = true;
     }
 
-    VkWriteDescriptorSet descriptor_writes[2 + NV2A_MAX_TEXTURES];
-
-    assert(r->descriptor_set_index < ARRAY_SIZE(r->descriptor_sets));
-
     if (need_uniform_write) {
         for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
             void *data = layouts[i]->allocation;
@@ -187,44 +231,34 @@ void pgraph_vk_update_descriptor_sets(PGRAPHState *pg)
         r->uniforms_changed = false;
     }
 
-    VkDescriptorBufferInfo ubo_buffer_infos[2];
+    DescriptorState *state = &r->descriptor_state;
     for (int i = 0; i < ARRAY_SIZE(layouts); i++) {
-        ubo_buffer_infos[i] = (VkDescriptorBufferInfo){
+        state->ubo[i] = (VkDescriptorBufferInfo){
             .buffer = r->storage_buffers[BUFFER_UNIFORM].buffer,
             .offset = r->uniform_buffer_offsets[i],
             .range = layouts[i]->total_size,
         };
-        descriptor_writes[i] = (VkWriteDescriptorSet){
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = r->descriptor_sets[r->descriptor_set_index],
-            .dstBinding = i == 0 ? VSH_UBO_BINDING : PSH_UBO_BINDING,
-            .dstArrayElement = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1,
-            .pBufferInfo = &ubo_buffer_infos[i],
-        };
     }
-
-    VkDescriptorImageInfo image_infos[NV2A_MAX_TEXTURES];
     for (int i = 0; i < NV2A_MAX_TEXTURES; i++) {
-        image_infos[i] = (VkDescriptorImageInfo){
+        state->textures[i] = (VkDescriptorImageInfo){
             .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             .imageView = r->texture_bindings[i]->image_view,
             .sampler = r->texture_bindings[i]->sampler,
         };
-        descriptor_writes[2 + i] = (VkWriteDescriptorSet){
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = r->descriptor_sets[r->descriptor_set_index],
-            .dstBinding = PSH_TEX_BINDING + i,
-            .dstArrayElement = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = 1,
-            .pImageInfo = &image_infos[i],
-        };
     }
 
-    vkUpdateDescriptorSets(r->device, 6, descriptor_writes, 0, NULL);
+    // Pushed at bind time, nothing to allocate or write
+    if (r->push_descriptor_extension_enabled) {
+        r->descriptor_set_index++;
+        return;
+    }
+
+    if (r->descriptor_set_index >= r->num_descriptor_sets) {
+        add_descriptor_pool(pg);
+    }
 
+    // Written when the next draw binds it, possibly on the recording thread
+    r->descriptor_set_needs_write = true;
     r->descriptor_set_index++;
 }
 
@@ -407,10 +441,12 @@ static void shader_cache_finalize(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     lru_flush(&r->shader_cache);
+    lru_destroy(&r->shader_cache);
     g_free(r->shader_cache_entries);
     r->shader_cache_entries = NULL;
 
     lru_flush(&r->shader_module_cache);
+    lru_destroy(&r->shader_module_cache);
     g_free(r->shader_module_cache_entries);
     r->shader_module_cache_entries = NULL;
 }
@@ -522,9 +558,8 @@ void pgraph_vk_init_shaders(PGRAPHState *pg)
     PGRAPHVkState *r = pg->vk_renderer_state;
 
     pgraph_vk_init_glsl_compiler();
-    create_descriptor_pool(pg);
     create_descriptor_set_layout(pg);
-    create_descriptor_sets(pg);
+    create_descriptor_pools(pg);
     shader_cache_init(pg);
 
     r->use_push_constants_for_uniform_attrs =
@@ -535,8 +570,7 @@ void pgraph_vk_init_shaders(PGRAPHState *pg)
 void pgraph_vk_finalize_shaders(PGRAPHState *pg)
 {
     shader_cache_finalize(pg);
-    destroy_descriptor_sets(pg);
+    destroy_descriptor_pools(pg);
     destroy_descriptor_set_layout(pg);
-    destroy_descriptor_pool(pg);
     pgraph_vk_finalize_glsl_compiler();
 }
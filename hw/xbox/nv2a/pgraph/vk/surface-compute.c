@@ -582,6 +582,7 @@ static void pipeline_cache_init(PGRAPHVkState *r)
 static void pipeline_cache_finalize(PGRAPHVkState *r)
 {
     lru_flush(&r->compute.pipeline_cache);
+    lru_destroy(&r->compute.pipeline_cache);
     g_free(r->compute.pipeline_cache_entries);
     r->compute.pipeline_cache_entries = NULL;
 }
@@ -34,35 +34,18 @@ const int max_surface_frame_time_delta = 5;
 
 void pgraph_vk_set_surface_scale_factor(NV2AState *d, unsigned int scale)
 {
-    g_config.display.quality.surface_scale = scale < 1 ? 1 : scale;
-
-    qemu_mutex_lock(&d->pfifo.lock);
-    qatomic_set(&d->pfifo.halt, true);
-    qemu_mutex_unlock(&d->pfifo.lock);
+    PGRAPHVkState *r = d->pgraph.vk_renderer_state;
 
-    // FIXME: It's just flush
-    qemu_mutex_lock(&d->pgraph.lock);
-    qemu_event_reset(&d->pgraph.vk_renderer_state->dirty_surfaces_download_complete);
-    qatomic_set(&d->pgraph.vk_renderer_state->download_dirty_surfaces_pending, true);
-    qemu_mutex_unlock(&d->pgraph.lock);
-    qemu_mutex_lock(&d->pfifo.lock);
-    pfifo_kick(d);
-    qemu_mutex_unlock(&d->pfifo.lock);
-    qemu_event_wait(&d->pgraph.vk_renderer_state->dirty_surfaces_download_complete);
+    g_config.display.quality.surface_scale = scale < 1 ? 1 : scale;
 
     qemu_mutex_lock(&d->pgraph.lock);
-    qemu_event_reset(&d->pgraph.flush_complete);
-    qatomic_set(&d->pgraph.flush_pending, true);
+    qemu_event_reset(&r->surface_scale_complete);
+    qatomic_set(&r->surface_scale_pending, true);
     qemu_mutex_unlock(&d->pgraph.lock);
     qemu_mutex_lock(&d->pfifo.lock);
     pfifo_kick(d);
     qemu_mutex_unlock(&d->pfifo.lock);
-    qemu_event_wait(&d->pgraph.flush_complete);
-
-    qemu_mutex_lock(&d->pfifo.lock);
-    qatomic_set(&d->pfifo.halt, false);
-    pfifo_kick(d);
-    qemu_mutex_unlock(&d->pfifo.lock);
+    qemu_event_wait(&r->surface_scale_complete);
 }
 
 unsigned int pgraph_vk_get_surface_scale_factor(NV2AState *d)
@@ -70,10 +53,29 @@ unsigned int pgraph_vk_get_surface_scale_factor(NV2AState *d)
     return d->pgraph.surface_scale_factor; // FIXME: Move internal to renderer
 }
 
+static void get_dynamic_scale_range(unsigned int *min_scale,
+                                    unsigned int *max_scale)
+{
+    *min_scale = MAX(g_config.display.quality.dynamic_scale_min, 1);
+    *max_scale = MAX(g_config.display.quality.dynamic_scale_max, *min_scale);
+}
+
+static unsigned int get_configured_surface_scale_factor(PGRAPHState *pg)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (g_config.display.quality.dynamic_scale && r->timestamps_supported) {
+        unsigned int min_scale, max_scale;
+        get_dynamic_scale_range(&min_scale, &max_scale);
+        return MIN(MAX(pg->surface_scale_factor, min_scale), max_scale);
+    }
+
+    return MAX(g_config.display.quality.surface_scale, 1);
+}
+
 void pgraph_vk_reload_surface_scale_factor(PGRAPHState *pg)
 {
-    int factor = g_config.display.quality.surface_scale;
-    pg->surface_scale_factor = MAX(factor, 1);
+    pg->surface_scale_factor = get_configured_surface_scale_factor(pg);
 }
 
 // FIXME: Move to common
@@ -155,6 +157,8 @@ static void download_surface_to_buffer(NV2AState *d, SurfaceBinding *surface,
     }
 
     nv2a_profile_inc_counter(NV2A_PROF_SURF_DOWNLOAD);
+    nv2a_profile_add_counter(NV2A_PROF_SURF_DOWNLOAD_BYTES,
+                             surface->pitch * surface->height);
 
     bool use_compute_to_convert_depth_stencil_format =
         surface->host_fmt.vk_format == VK_FORMAT_D24_UNORM_S8_UINT ||
@@ -444,7 +448,7 @@ static void download_surface_to_buffer(NV2AState *d, SurfaceBinding *surface,
 
     nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_1);
     pgraph_vk_end_debug_marker(r, cmd);
-    pgraph_vk_end_single_time_commands(pg, cmd);
+    pgraph_vk_wait_timeline(r, pgraph_vk_end_single_time_commands(pg, cmd));
 
     void *mapped_memory_ptr = NULL;
     VK_CHECK(vmaMapMemory(r->allocator,
@@ -478,6 +482,8 @@ static void download_surface(NV2AState *d, SurfaceBinding *surface, bool force)
         return;
     }
 
+    pgraph_vk_surface_rescale_if_stale(d, surface);
+
     // FIXME: Respect write enable at last TOU?
 
     download_surface_to_buffer(d, surface, d->vram_ptr + surface->vram_addr);
@@ -766,6 +772,7 @@ static void create_surface_image(PGRAPHState *pg, SurfaceBinding *surface)
     unsigned int width = surface->width ? surface->width : 1;
     unsigned int height = surface->height ? surface->height : 1;
     pgraph_apply_scaling_factor(pg, &width, &height);
+    surface->scale = pg->surface_scale_factor;
 
     assert(!surface->image);
     assert(!surface->image_scratch);
@@ -829,7 +836,7 @@ static void create_surface_image(PGRAPHState *pg, SurfaceBinding *surface)
 
     nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_3);
     pgraph_vk_end_debug_marker(r, cmd);
-    pgraph_vk_end_single_time_commands(pg, cmd);
+    surface->timeline_value = pgraph_vk_end_single_time_commands(pg, cmd);
     nv2a_profile_inc_counter(NV2A_PROF_SURF_CREATE);
 }
 
@@ -841,6 +848,7 @@ static void migrate_surface_image(SurfaceBinding *dst, SurfaceBinding *src)
     dst->image_scratch = src->image_scratch;
     dst->image_scratch_current_layout = src->image_scratch_current_layout;
     dst->allocation_scratch = src->allocation_scratch;
+    dst->timeline_value = src->timeline_value;
 
     src->image = VK_NULL_HANDLE;
     src->image_view = VK_NULL_HANDLE;
@@ -852,6 +860,8 @@ static void migrate_surface_image(SurfaceBinding *dst, SurfaceBinding *src)
 
 static void destroy_surface_image(PGRAPHVkState *r, SurfaceBinding *surface)
 {
+    pgraph_vk_wait_timeline(r, surface->timeline_value);
+
     vkDestroyImageView(r->device, surface->image_view, NULL);
     surface->image_view = VK_NULL_HANDLE;
 
@@ -871,6 +881,7 @@ static bool check_invalid_surface_is_compatibile(SurfaceBinding *surface,
     return surface->host_fmt.vk_format == target->host_fmt.vk_format &&
            surface->width == target->width &&
            surface->height == target->height &&
+           surface->scale == target->scale &&
            surface->host_fmt.usage == target->host_fmt.usage;
 }
 
@@ -954,6 +965,8 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
     }
 
     nv2a_profile_inc_counter(NV2A_PROF_SURF_UPLOAD);
+    nv2a_profile_add_counter(NV2A_PROF_SURF_UPLOAD_BYTES,
+                             surface->pitch * surface->height);
 
     pgraph_vk_finish(pg, VK_FINISH_REASON_SURFACE_CREATE); // FIXME: SURFACE_UP
 
@@ -997,11 +1010,8 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
     StorageBuffer *copy_buffer = &r->storage_buffers[BUFFER_STAGING_SRC];
     size_t uploaded_image_size = surface->height * surface->width *
                                  surface->fmt.bytes_per_pixel;
-    assert(uploaded_image_size <= copy_buffer->buffer_size);
-
-    void *mapped_memory_ptr = NULL;
-    VK_CHECK(vmaMapMemory(r->allocator, copy_buffer->allocation,
-                          &mapped_memory_ptr));
+    VkDeviceSize staging_offset =
+        pgraph_vk_staging_alloc(pg, uploaded_image_size);
 
     bool use_compute_to_convert_depth_stencil_format =
         surface->host_fmt.vk_format == VK_FORMAT_D24_UNORM_S8_UINT ||
@@ -1012,12 +1022,12 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
         use_compute_to_convert_depth_stencil_format;
     assert(no_conversion_necessary);
 
-    memcpy_image(mapped_memory_ptr, gl_read_buf,
+    memcpy_image(copy_buffer->mapped + staging_offset, gl_read_buf,
                  surface->width * surface->fmt.bytes_per_pixel, surface->pitch,
                  surface->height);
 
-    vmaFlushAllocation(r->allocator, copy_buffer->allocation, 0, VK_WHOLE_SIZE);
-    vmaUnmapMemory(r->allocator, copy_buffer->allocation);
+    vmaFlushAllocation(r->allocator, copy_buffer->allocation, staging_offset,
+                       uploaded_image_size);
 
     VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
     pgraph_vk_begin_debug_marker(r, cmd, RGBA_RED, __func__);
@@ -1041,6 +1051,7 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
     int num_regions = 0;
 
     regions[num_regions++] = (VkBufferImageCopy){
+        .bufferOffset = staging_offset,
         .imageSubresource.aspectMask = surface->color ?
                                            VK_IMAGE_ASPECT_COLOR_BIT :
                                            VK_IMAGE_ASPECT_DEPTH_BIT,
@@ -1068,6 +1079,7 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
 
         size_t packed_size = uploaded_image_size;
         VkBufferCopy buffer_copy_region = {
+            .srcOffset = staging_offset,
             .size = packed_size,
         };
         vkCmdCopyBuffer(cmd, copy_buffer->buffer,
@@ -1156,6 +1168,7 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
                              &post_unpack_dst_barrier, 0, NULL);
 
         // Already scaled during compute. Adjust copy regions.
+        regions[0].bufferOffset = 0;
         regions[0].imageExtent = (VkExtent3D){ scaled_width, scaled_height, 1 };
         regions[1].imageExtent = regions[0].imageExtent;
         regions[1].bufferOffset =
@@ -1267,7 +1280,7 @@ void pgraph_vk_upload_surface_data(NV2AState *d, SurfaceBinding *surface,
 
     nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_2);
     pgraph_vk_end_debug_marker(r, cmd);
-    pgraph_vk_end_single_time_commands(pg, cmd);
+    surface->timeline_value = pgraph_vk_end_single_time_commands(pg, cmd);
 
     surface->initialized = true;
 }
@@ -1356,6 +1369,7 @@ static void populate_surface_binding_target_sized(NV2AState *d, bool color,
     target->vram_addr = dma.address + surface->offset;
     target->width = width;
     target->height = height;
+    target->scale = pg->surface_scale_factor;
     target->pitch = surface->pitch;
     target->size = height * MAX(surface->pitch, width * fmt.bytes_per_pixel);
     target->upload_pending = true;
@@ -1558,6 +1572,7 @@ static void update_surface_part(NV2AState *d, bool upload, bool color)
                  surface->shape.clip_x, surface->shape.clip_width,
                  surface->shape.clip_y, surface->shape.clip_height, surface->pitch);
 
+        pgraph_vk_surface_rescale_if_stale(d, surface);
         bind_surface(r, surface);
         pg_surface->buffer_dirty = false;
     }
@@ -1722,6 +1737,7 @@ void pgraph_vk_init_surfaces(PGRAPHState *pg)
     r->downloads_pending = false;
     qemu_event_init(&r->downloads_complete, false);
     qemu_event_init(&r->dirty_surfaces_download_complete, false);
+    qemu_event_init(&r->surface_scale_complete, false);
 
     r->color_binding = NULL;
     r->zeta_binding = NULL;
@@ -1758,3 +1774,199 @@ void pgraph_vk_surface_flush(NV2AState *d)
 
     pgraph_vk_reload_surface_scale_factor(pg);
 }
+
+static bool check_surface_can_rescale_on_gpu(SurfaceBinding const *surface)
+{
+    // Packed depth-stencil formats cannot be reliably blitted, these take the
+    // download and re-upload path instead.
+    return surface->color ||
+           surface->host_fmt.vk_format == VK_FORMAT_D16_UNORM;
+}
+
+/*
+ * Surfaces are resampled to the current scale factor on the GPU the next time
+ * they are used, rather than all at once when the scale factor changes.
+ */
+void pgraph_vk_surface_rescale_if_stale(NV2AState *d, SurfaceBinding *surface)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (surface->scale == pg->surface_scale_factor) {
+        return;
+    }
+
+    assert(check_surface_can_rescale_on_gpu(surface));
+    assert(surface != r->color_binding && surface != r->zeta_binding);
+
+    // The old image is retired to the invalid surface list, where it cannot
+    // be reused at the wrong scale and is freed once the blit has completed
+    SurfaceBinding *old = g_malloc(sizeof(SurfaceBinding));
+    *old = *surface;
+    migrate_surface_image(old, surface);
+    create_surface_image(pg, surface);
+    set_surface_label(pg, surface);
+
+    if (surface->width && surface->height && surface->initialized) {
+        unsigned int old_width = surface->width * old->scale,
+                     old_height = surface->height * old->scale;
+        unsigned int new_width = surface->width,
+                     new_height = surface->height;
+        pgraph_apply_scaling_factor(pg, &new_width, &new_height);
+
+        VkImageLayout attachment_layout =
+            surface->color ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL :
+                             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
+        pgraph_vk_begin_debug_marker(r, cmd, RGBA_YELLOW, __func__);
+
+        pgraph_vk_transition_image_layout(pg, cmd, old->image,
+                                          surface->host_fmt.vk_format,
+                                          attachment_layout,
+                                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        pgraph_vk_transition_image_layout(pg, cmd, surface->image,
+                                          surface->host_fmt.vk_format,
+                                          attachment_layout,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        VkImageBlit blit_region = {
+            .srcSubresource.aspectMask = surface->host_fmt.aspect,
+            .srcSubresource.mipLevel = 0,
+            .srcSubresource.baseArrayLayer = 0,
+            .srcSubresource.layerCount = 1,
+            .srcOffsets[0] = (VkOffset3D){0, 0, 0},
+            .srcOffsets[1] = (VkOffset3D){old_width, old_height, 1},
+
+            .dstSubresource.aspectMask = surface->host_fmt.aspect,
+            .dstSubresource.mipLevel = 0,
+            .dstSubresource.baseArrayLayer = 0,
+            .dstSubresource.layerCount = 1,
+            .dstOffsets[0] = (VkOffset3D){0, 0, 0},
+            .dstOffsets[1] = (VkOffset3D){new_width, new_height, 1},
+        };
+        vkCmdBlitImage(cmd, old->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       surface->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                       &blit_region,
+                       surface->color ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+
+        pgraph_vk_transition_image_layout(pg, cmd, surface->image,
+                                          surface->host_fmt.vk_format,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          attachment_layout);
+
+        pgraph_vk_end_debug_marker(r, cmd);
+        uint64_t value = pgraph_vk_end_single_time_commands(pg, cmd);
+        old->timeline_value = value;
+        surface->timeline_value = value;
+    }
+
+    QTAILQ_INSERT_HEAD(&r->invalid_surfaces, old, entry);
+    nv2a_profile_inc_counter(NV2A_PROF_SURF_CREATE);
+}
+
+/*
+ * Change the scale factor without tearing down the surface cache. Live
+ * surfaces are left at their old scale until pgraph_vk_surface_rescale_if_stale
+ * resamples them on their next use.
+ */
+static void set_surface_scale_factor_internal(NV2AState *d, unsigned int scale)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (scale == pg->surface_scale_factor) {
+        return;
+    }
+
+    // Stale surfaces are resampled in auxiliary command buffers, which are
+    // submitted ahead of the current command buffer
+    pgraph_vk_finish(pg, VK_FINISH_REASON_FLUSH);
+
+    // Force surfaces to be rebound at next draw
+    memset(&pg->last_surface_shape, 0, sizeof(pg->last_surface_shape));
+    unbind_surface(d, true);
+    unbind_surface(d, false);
+
+    SurfaceBinding *s, *next;
+    QTAILQ_FOREACH_SAFE(s, &r->surfaces, entry, next) {
+        if (!check_surface_can_rescale_on_gpu(s)) {
+            pgraph_vk_surface_download_if_dirty(d, s);
+            invalidate_surface(d, s);
+        }
+    }
+
+    pg->surface_scale_factor = scale;
+}
+
+void pgraph_vk_process_pending_surface_scale(NV2AState *d)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    set_surface_scale_factor_internal(d,
+                                      get_configured_surface_scale_factor(pg));
+
+    qatomic_set(&r->surface_scale_pending, false);
+    qemu_event_set(&r->surface_scale_complete);
+}
+
+void pgraph_vk_update_dynamic_surface_scale(NV2AState *d)
+{
+    PGRAPHState *pg = &d->pgraph;
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    uint64_t frame_time_ns = r->gpu_frame_time_ns;
+    r->gpu_frame_time_ns = 0;
+
+    if (!g_config.display.quality.dynamic_scale || !r->timestamps_supported) {
+        // Return to the manual scale once dynamic scaling is turned off
+        set_surface_scale_factor_internal(
+            d, get_configured_surface_scale_factor(pg));
+        return;
+    }
+
+    const float smoothing = 0.1f;
+    const float headroom = 0.8f;
+    const int frames_between_changes = 60;
+
+    float frame_time_ms = frame_time_ns / 1000000.0f;
+    r->dynamic_scale.avg_frame_time_ms +=
+        (frame_time_ms - r->dynamic_scale.avg_frame_time_ms) * smoothing;
+
+    if (r->dynamic_scale.cooldown > 0) {
+        r->dynamic_scale.cooldown--;
+        return;
+    }
+
+    unsigned int min_scale, max_scale;
+    get_dynamic_scale_range(&min_scale, &max_scale);
+
+    float budget_ms = g_config.display.quality.dynamic_scale_target_ms;
+    unsigned int scale = pg->surface_scale_factor;
+
+    // Fragment load dominates, so assume cost is proportional to pixel count
+    float pixel_cost_ms = r->dynamic_scale.avg_frame_time_ms / (scale * scale);
+
+    unsigned int new_scale = scale;
+    if (r->dynamic_scale.avg_frame_time_ms > budget_ms && scale > min_scale) {
+        new_scale = scale - 1;
+    } else if (scale < max_scale &&
+               pixel_cost_ms * (scale + 1) * (scale + 1) <
+                   budget_ms * headroom) {
+        new_scale = scale + 1;
+    }
+    new_scale = MIN(MAX(new_scale, min_scale), max_scale);
+
+    if (new_scale == scale) {
+        return;
+    }
+
+    NV2A_VK_DPRINTF("Dynamic scale %d -> %d (%.2f ms/frame)", scale,
+                    new_scale, r->dynamic_scale.avg_frame_time_ms);
+
+    set_surface_scale_factor_internal(d, new_scale);
+    r->dynamic_scale.avg_frame_time_ms =
+        pixel_cost_ms * new_scale * new_scale;
+    r->dynamic_scale.cooldown = frames_between_changes;
+}
@@ -58,6 +58,7 @@ typedef struct TextureLevel {
     unsigned int width, height, depth;
     hwaddr vram_addr;
     void *decoded_data;
+    const uint8_t *compressed_data; // Decoded into staging, if not native
     size_t decoded_size;
 } TextureLevel;
 
@@ -67,6 +68,8 @@ typedef struct TextureLayer {
 
 typedef struct TextureLayout {
     TextureLayer layers[6];
+    bool native_bc;
+    enum S3TC_DECOMPRESS_FORMAT s3tc_format;
 } TextureLayout;
 
 // FIXME: Move to common
@@ -84,6 +87,39 @@ static enum S3TC_DECOMPRESS_FORMAT kelvin_format_to_s3tc_format(int color_format
     }
 }
 
+static const VkFormat s3tc_format_to_vk_bc_format[] = {
+    [S3TC_DECOMPRESS_FORMAT_DXT1] = VK_FORMAT_BC1_RGBA_UNORM_BLOCK,
+    [S3TC_DECOMPRESS_FORMAT_DXT3] = VK_FORMAT_BC2_UNORM_BLOCK,
+    [S3TC_DECOMPRESS_FORMAT_DXT5] = VK_FORMAT_BC3_UNORM_BLOCK,
+};
+
+// Bordered textures are resized and cropped, so they are always decoded
+static bool is_native_bc_texture(PGRAPHState *pg, const TextureShape *s)
+{
+    PGRAPHVkState *r = pg->vk_renderer_state;
+
+    if (!pgraph_is_texture_format_compressed(pg, s->color_format) ||
+        s->border) {
+        return false;
+    }
+
+    return r->texture_bc_supported[s->dimensionality == 3]
+                                  [kelvin_format_to_s3tc_format(s->color_format)];
+}
+
+static VkColorFormatInfo get_texture_vk_format(PGRAPHState *pg,
+                                               const TextureShape *s)
+{
+    VkColorFormatInfo vkf = kelvin_color_format_vk_map[s->color_format];
+
+    if (is_native_bc_texture(pg, s)) {
+        vkf.vk_format = s3tc_format_to_vk_bc_format[
+            kelvin_format_to_s3tc_format(s->color_format)];
+    }
+
+    return vkf;
+}
+
 // FIXME: Move to common
 static void memcpy_image(void *dst, void *src, int min_stride, int dst_stride, int src_stride, int height)
 {
@@ -136,7 +172,6 @@ static size_t get_cubemap_layer_size(PGRAPHState *pg, TextureShape s)
 
 // FIXME: Move to common
 // FIXME: More refactoring
-// FIXME: Possible parallelization of decoding
 // FIXME: Bounds checking
 static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
 {
@@ -195,8 +230,9 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
 
         size_t converted_size;
         uint8_t *converted = pgraph_convert_texture_data(
-            s, texture_data_ptr, palette_data_ptr, adjusted_width,
-            adjusted_height, 1, adjusted_pitch, 0, &converted_size);
+            s, texture_data_ptr, palette_data_ptr, texture_palette_data_size,
+            adjusted_width, adjusted_height, 1, adjusted_pitch, 0,
+            &converted_size);
 
         if (!converted) {
             int dst_stride = adjusted_width * f.bytes_per_pixel;
@@ -226,6 +262,8 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
         bool is_dxt1 =
             s.color_format == NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5;
         block_size = is_dxt1 ? 8 : 16;
+        layout->native_bc = is_native_bc_texture(pg, &s);
+        layout->s3tc_format = kelvin_format_to_s3tc_format(s.color_format);
     }
 
     if (s.dimensionality == 2) {
@@ -247,13 +285,13 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
                     unsigned int physical_width = (width + 3) & ~3,
                                  physical_height = (height + 3) & ~3;
 
-                    size_t converted_size = width * height * 4;
-                    uint8_t *converted = s3tc_decompress_2d(
-                        kelvin_format_to_s3tc_format(s.color_format),
-                        texture_data_ptr, width, height);
-                    assert(converted);
-
                     if (s.cubemap && adjusted_width != s.width) {
+                        size_t converted_size = width * height * 4;
+                        uint8_t *converted = s3tc_decompress_2d(
+                            layout->s3tc_format, texture_data_ptr, width,
+                            height);
+                        assert(converted);
+
                         // FIXME: Consider preserving the border.
                         // There does not seem to be a way to reference the border
                         // texels in a cubemap, so they are discarded.
@@ -267,15 +305,28 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
                         // }
 
                         // FIXME: Crop by 4 pixels on each side
-                    }
 
-                    layout->layers[layer].levels[level] = (TextureLevel){
-                        .width = tex_width,
-                        .height = tex_height,
-                        .depth = 1,
-                        .decoded_size = converted_size,
-                        .decoded_data = converted,
-                    };
+                        layout->layers[layer].levels[level] = (TextureLevel){
+                            .width = tex_width,
+                            .height = tex_height,
+                            .depth = 1,
+                            .decoded_size = converted_size,
+                            .decoded_data = converted,
+                        };
+                    } else {
+                        // Copied or decoded straight into staging on upload
+                        layout->layers[layer].levels[level] = (TextureLevel){
+                            .width = width,
+                            .height = height,
+                            .depth = 1,
+                            .decoded_size =
+                                layout->native_bc ?
+                                    physical_width / 4 * physical_height / 4 *
+                                        block_size :
+                                    width * height * 4,
+                            .compressed_data = texture_data_ptr,
+                        };
+                    }
 
                     texture_data_ptr +=
                         physical_width / 4 * physical_height / 4 * block_size;
@@ -289,8 +340,9 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
                                    unswizzled, pitch, f.bytes_per_pixel);
 
                     uint8_t *converted = pgraph_convert_texture_data(
-                        s, unswizzled, palette_data_ptr, width, height, 1,
-                        pitch, 0, &converted_size);
+                        s, unswizzled, palette_data_ptr,
+                        texture_palette_data_size, width, height, 1, pitch, 0,
+                        &converted_size);
 
                     if (converted) {
                         g_free(unswizzled);
@@ -338,18 +390,16 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
                              physical_height = (height + 3) & ~3;
                 depth = MAX(depth, 1);
 
-                size_t converted_size = width * height * depth * 4;
-                uint8_t *converted = s3tc_decompress_3d(
-                    kelvin_format_to_s3tc_format(s.color_format),
-                    texture_data_ptr, width, height, depth);
-                assert(converted);
-
                 layout->layers[0].levels[level] = (TextureLevel){
                     .width = width,
                     .height = height,
                     .depth = depth,
-                    .decoded_size = converted_size,
-                    .decoded_data = converted,
+                    .decoded_size =
+                        layout->native_bc ?
+                            physical_width / 4 * physical_height / 4 * depth *
+                                block_size :
+                            width * height * depth * 4,
+                    .compressed_data = texture_data_ptr,
                 };
 
                 texture_data_ptr += physical_width / 4 * physical_height / 4 * depth * block_size;
@@ -369,8 +419,9 @@ static TextureLayout *get_texture_layout(PGRAPHState *pg, int texture_idx)
 
                 size_t converted_size;
                 uint8_t *converted = pgraph_convert_texture_data(
-                    s, unswizzled, palette_data_ptr, width, height, depth,
-                    row_pitch, slice_pitch, &converted_size);
+                    s, unswizzled, palette_data_ptr, texture_palette_data_size,
+                    width, height, depth, row_pitch, slice_pitch,
+                    &converted_size);
 
                 if (converted) {
                     g_free(unswizzled);
@@ -480,9 +531,12 @@ static void upload_texture_image(PGRAPHState *pg, int texture_idx,
 {
     PGRAPHVkState *r = pg->vk_renderer_state;
     TextureShape *state = &binding->key.state;
-    VkColorFormatInfo vkf = kelvin_color_format_vk_map[state->color_format];
+    VkColorFormatInfo vkf = get_texture_vk_format(pg, state);
 
     nv2a_profile_inc_counter(NV2A_PROF_TEX_UPLOAD);
+    nv2a_profile_add_counter(NV2A_PROF_TEX_UPLOAD_BYTES,
+                             binding->key.texture_length +
+                                 binding->key.palette_length);
 
     g_autofree TextureLayout *layout = get_texture_layout(pg, texture_idx);
     const int num_layers = state->cubemap ? 6 : 1;
@@ -502,11 +556,10 @@ static void upload_texture_image(PGRAPHState *pg, int texture_idx,
            r->storage_buffers[BUFFER_STAGING_SRC].buffer_size);
 
     // Copy texture data to mapped device buffer
-    uint8_t *mapped_memory_ptr;
-
-    VK_CHECK(vmaMapMemory(r->allocator,
-                          r->storage_buffers[BUFFER_STAGING_SRC].allocation,
-                          (void *)&mapped_memory_ptr));
+    StorageBuffer *staging = &r->storage_buffers[BUFFER_STAGING_SRC];
+    VkDeviceSize staging_offset =
+        pgraph_vk_staging_alloc(pg, texture_data_size);
+    uint8_t *mapped_memory_ptr = staging->mapped + staging_offset;
 
     int num_regions = num_layers * state->levels;
     g_autofree VkBufferImageCopy *regions =
@@ -523,10 +576,22 @@ static void upload_texture_image(PGRAPHState *pg, int texture_idx,
             NV2A_VK_DPRINTF(" - Level %d, w=%d h=%d d=%d @ %08" HWADDR_PRIx,
                             level_idx, level->width, level->height,
                             level->depth, buffer_offset);
-            memcpy(mapped_memory_ptr + buffer_offset, level->decoded_data,
-                   level->decoded_size);
+            uint8_t *dst = mapped_memory_ptr + buffer_offset;
+            if (level->decoded_data) {
+                memcpy(dst, level->decoded_data, level->decoded_size);
+            } else if (!layout->native_bc) {
+                s3tc_decompress_3d_to(layout->s3tc_format,
+                                      level->compressed_data, level->width,
+                                      level->height, level->depth, dst);
+            } else if (level->depth > 1) {
+                s3tc_reorder_3d_blocks(layout->s3tc_format,
+                                       level->compressed_data, level->width,
+                                       level->height, level->depth, dst);
+            } else {
+                memcpy(dst, level->compressed_data, level->decoded_size);
+            }
             *region = (VkBufferImageCopy){
-                .bufferOffset = buffer_offset,
+                .bufferOffset = staging_offset + buffer_offset,
                 .bufferRowLength = 0, // Tightly packed
                 .bufferImageHeight = 0,
                 .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -541,14 +606,10 @@ static void upload_texture_image(PGRAPHState *pg, int texture_idx,
             region++;
         }
     }
-    assert(buffer_offset <= r->storage_buffers[BUFFER_STAGING_SRC].buffer_size);
-
-    vmaFlushAllocation(r->allocator,
-                       r->storage_buffers[BUFFER_STAGING_SRC].allocation, 0,
-                       VK_WHOLE_SIZE);
+    assert(buffer_offset == texture_data_size);
 
-    vmaUnmapMemory(r->allocator,
-                   r->storage_buffers[BUFFER_STAGING_SRC].allocation);
+    vmaFlushAllocation(r->allocator, staging->allocation, staging_offset,
+                       texture_data_size);
 
     // FIXME: Use nondraw. Need to fill and copy tex buffer at once
     VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
@@ -583,7 +644,7 @@ static void upload_texture_image(PGRAPHState *pg, int texture_idx,
 
     nv2a_profile_inc_counter(NV2A_PROF_QUEUE_SUBMIT_4);
     pgraph_vk_end_debug_marker(r, cmd);
-    pgraph_vk_end_single_time_commands(pg, cmd);
+    binding->timeline_value = pgraph_vk_end_single_time_commands(pg, cmd);
 
     // Release decoded texture data
     for (int layer_idx = 0; layer_idx < num_layers; layer_idx++) {
@@ -977,21 +1038,16 @@ static void create_dummy_texture(PGRAPHState *pg)
                              &texture_sampler));
 
     // Copy texture data to mapped device buffer
-    uint8_t *mapped_memory_ptr;
+    StorageBuffer *staging = &r->storage_buffers[BUFFER_STAGING_SRC];
     size_t texture_data_size =
         image_create_info.extent.width * image_create_info.extent.height;
+    VkDeviceSize staging_offset =
+        pgraph_vk_staging_alloc(pg, texture_data_size);
 
-    VK_CHECK(vmaMapMemory(r->allocator,
-                          r->storage_buffers[BUFFER_STAGING_SRC].allocation,
-                          (void *)&mapped_memory_ptr));
-    memset(mapped_memory_ptr, 0xff, texture_data_size);
-
-    vmaFlushAllocation(r->allocator,
-                       r->storage_buffers[BUFFER_STAGING_SRC].allocation, 0,
-                       VK_WHOLE_SIZE);
+    memset(staging->mapped + staging_offset, 0xff, texture_data_size);
 
-    vmaUnmapMemory(r->allocator,
-                   r->storage_buffers[BUFFER_STAGING_SRC].allocation);
+    vmaFlushAllocation(r->allocator, staging->allocation, staging_offset,
+                       texture_data_size);
 
     VkCommandBuffer cmd = pgraph_vk_begin_single_time_commands(pg);
     pgraph_vk_begin_debug_marker(r, cmd, RGBA_GREEN, __func__);
@@ -1001,7 +1057,7 @@ static void create_dummy_texture(PGRAPHState *pg)
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
     VkBufferImageCopy region = {
-        .bufferOffset = 0,
+        .bufferOffset = staging_offset,
         .bufferRowLength = 0,
         .bufferImageHeight = 0,
         .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -1022,10 +1078,11 @@ static void create_dummy_texture(PGRAPHState *pg)
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     pgraph_vk_end_debug_marker(r, cmd);
-    pgraph_vk_end_single_time_commands(pg, cmd);
+    uint64_t timeline_value = pgraph_vk_end_single_time_commands(pg, cmd);
 
     r->dummy_texture = (TextureBinding){
         .key.scale = 1.0,
+        .timeline_value = timeline_value,
         .image = texture_image,
         .current_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
         .allocation = texture_allocation,
@@ -1131,6 +1188,10 @@ static void create_texture(PGRAPHState *pg, int texture_idx)
                 state.color_format);
         }
 
+        if (surface_to_texture) {
+            pgraph_vk_surface_rescale_if_stale(d, surface);
+        }
+
         if (surface_to_texture && surface->upload_pending) {
             pgraph_vk_upload_surface_data(d, surface, false);
         }
@@ -1187,8 +1248,11 @@ static void create_texture(PGRAPHState *pg, int texture_idx)
             }
         } else {
             if (possibly_dirty && content_hash != snode->hash) {
+                nv2a_profile_inc_counter(NV2A_PROF_TEX_CACHE_MISS);
                 upload_texture_image(pg, texture_idx, snode);
                 snode->hash = content_hash;
+            } else {
+                nv2a_profile_inc_counter(NV2A_PROF_TEX_CACHE_HIT);
             }
         }
 
@@ -1197,13 +1261,14 @@ static void create_texture(PGRAPHState *pg, int texture_idx)
     }
 
     NV2A_VK_DPRINTF("Cache miss");
+    nv2a_profile_inc_counter(NV2A_PROF_TEX_CACHE_MISS);
 
     memcpy(&snode->key, &key, sizeof(key));
     snode->current_layout = VK_IMAGE_LAYOUT_UNDEFINED;
     snode->possibly_dirty = false;
     snode->hash = content_hash;
 
-    VkColorFormatInfo vkf = kelvin_color_format_vk_map[state.color_format];
+    VkColorFormatInfo vkf = get_texture_vk_format(pg, &state);
     assert(vkf.vk_format != 0);
     assert(0 < state.dimensionality);
     assert(state.dimensionality < ARRAY_SIZE(dimensionality_to_vk_image_type));
@@ -1452,10 +1517,14 @@ static void texture_cache_entry_init(Lru *lru, LruNode *node, const void *state)
     snode->allocation = VK_NULL_HANDLE;
     snode->image_view = VK_NULL_HANDLE;
     snode->sampler = VK_NULL_HANDLE;
+    snode->timeline_value = 0;
 }
 
 static void texture_cache_release_node_resources(PGRAPHVkState *r, TextureBinding *snode)
 {
+    // Upload may still be in flight
+    pgraph_vk_wait_timeline(r, snode->timeline_value);
+
     vkDestroySampler(r->device, snode->sampler, NULL);
     snode->sampler = VK_NULL_HANDLE;
 
@@ -1522,6 +1591,7 @@ static void texture_cache_init(PGRAPHVkState *r)
 static void texture_cache_finalize(PGRAPHVkState *r)
 {
     lru_flush(&r->texture_cache);
+    lru_destroy(&r->texture_cache);
     g_free(r->texture_cache_entries);
     r->texture_cache_entries = NULL;
 }
@@ -1556,6 +1626,37 @@ void pgraph_vk_init_textures(PGRAPHState *pg)
             r->physical_device, kelvin_color_format_vk_map[i].vk_format,
             &r->texture_format_properties[i]);
     }
+
+    if (!r->enabled_physical_device_features.textureCompressionBC) {
+        return;
+    }
+
+    const VkFormatFeatureFlags bc_features =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+        VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+    for (int i = 0; i < ARRAY_SIZE(s3tc_format_to_vk_bc_format); i++) {
+        VkFormat format = s3tc_format_to_vk_bc_format[i];
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(r->physical_device, format, &props);
+        if ((props.optimalTilingFeatures & bc_features) != bc_features) {
+            continue;
+        }
+
+        for (int is_3d = 0; is_3d < 2; is_3d++) {
+            VkImageFormatProperties image_props;
+            r->texture_bc_supported[is_3d][i] =
+                vkGetPhysicalDeviceImageFormatProperties(
+                    r->physical_device, format,
+                    is_3d ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                        VK_IMAGE_USAGE_SAMPLED_BIT,
+                    is_3d ? 0 : VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
+                    &image_props) == VK_SUCCESS;
+        }
+    }
 }
 
 void pgraph_vk_finalize_textures(PGRAPHState *pg)
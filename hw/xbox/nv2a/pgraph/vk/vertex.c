@@ -61,6 +61,7 @@ void pgraph_vk_update_vertex_ram_buffer(PGRAPHState *pg, hwaddr offset,
     }
 
     nv2a_profile_inc_counter(NV2A_PROF_GEOM_BUFFER_UPDATE_1);
+    nv2a_profile_add_counter(NV2A_PROF_VERTEX_SYNC_BYTES, size);
     memcpy(r->storage_buffers[BUFFER_VERTEX_RAM].mapped + offset, data, size);
 
     bitmap_set(r->uploaded_bitmap, start_bit, nbits);
@@ -0,0 +1,207 @@
+/*
+ * Geforce NV2A PGRAPH YUV 4:2:2 Conversion
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "util.h"
+#include "yuv.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+#define COEFF_PAIR(lo, hi) \
+    _mm_set1_epi32((uint16_t)(lo) | ((uint32_t)(uint16_t)(hi) << 16))
+
+/* Converts 8 pixels. c, d and e are Y - 16, U - 128 and V - 128 per pixel. */
+static inline void convert_8_pixels(__m128i c, __m128i d, __m128i e,
+                                    uint8_t *out)
+{
+    /* Coefficient pairs for _mm_madd_epi16 */
+    const __m128i k_r = COEFF_PAIR(298, 409);
+    const __m128i k_gb = COEFF_PAIR(298, -100);
+    const __m128i k_g = COEFF_PAIR(-208, 128);
+    const __m128i k_b = COEFF_PAIR(298, 516);
+    const __m128i round = _mm_set1_epi32(128);
+    const __m128i one = _mm_set1_epi16(1);
+
+    __m128i ce_lo = _mm_unpacklo_epi16(c, e), ce_hi = _mm_unpackhi_epi16(c, e);
+    __m128i cd_lo = _mm_unpacklo_epi16(c, d), cd_hi = _mm_unpackhi_epi16(c, d);
+    __m128i e1_lo = _mm_unpacklo_epi16(e, one),
+            e1_hi = _mm_unpackhi_epi16(e, one);
+
+    __m128i r_lo = _mm_add_epi32(_mm_madd_epi16(ce_lo, k_r), round);
+    __m128i r_hi = _mm_add_epi32(_mm_madd_epi16(ce_hi, k_r), round);
+    __m128i g_lo = _mm_add_epi32(_mm_madd_epi16(cd_lo, k_gb),
+                                 _mm_madd_epi16(e1_lo, k_g));
+    __m128i g_hi = _mm_add_epi32(_mm_madd_epi16(cd_hi, k_gb),
+                                 _mm_madd_epi16(e1_hi, k_g));
+    __m128i b_lo = _mm_add_epi32(_mm_madd_epi16(cd_lo, k_b), round);
+    __m128i b_hi = _mm_add_epi32(_mm_madd_epi16(cd_hi, k_b), round);
+
+    __m128i r = _mm_packs_epi32(_mm_srai_epi32(r_lo, 8),
+                                _mm_srai_epi32(r_hi, 8));
+    __m128i g = _mm_packs_epi32(_mm_srai_epi32(g_lo, 8),
+                                _mm_srai_epi32(g_hi, 8));
+    __m128i b = _mm_packs_epi32(_mm_srai_epi32(b_lo, 8),
+                                _mm_srai_epi32(b_hi, 8));
+
+    __m128i rb = _mm_packus_epi16(r, b);
+    __m128i ga = _mm_packus_epi16(g, _mm_set1_epi16(255));
+    __m128i rg = _mm_unpacklo_epi8(rb, ga);
+    __m128i ba = _mm_unpackhi_epi8(rb, ga);
+
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+static unsigned int convert_row_sse2(enum YUV422_FORMAT format,
+                                     const uint8_t *line, unsigned int width,
+                                     uint8_t *out)
+{
+    const __m128i low_mask = _mm_set1_epi16(0xff);
+    const __m128i y_bias = _mm_set1_epi16(16);
+    const __m128i uv_bias = _mm_set1_epi16(128);
+    unsigned int x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i *)&line[x * 2]);
+        __m128i y, uv;
+
+        if (format == YUV422_FORMAT_YUY2) {
+            y = _mm_and_si128(in, low_mask);
+            uv = _mm_srli_epi16(in, 8);
+        } else {
+            y = _mm_srli_epi16(in, 8);
+            uv = _mm_and_si128(in, low_mask);
+        }
+        uv = _mm_sub_epi16(uv, uv_bias);
+
+        /* Each pixel pair shares the U and V of its 32-bit group */
+        __m128i u = _mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0));
+        u = _mm_shufflehi_epi16(u, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i v = _mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 1, 1));
+
+        convert_8_pixels(_mm_sub_epi16(y, y_bias), u, v, &out[x * 4]);
+    }
+
+    return x;
+}
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+static inline uint8x8_t narrow_channel(int32x4_t lo, int32x4_t hi)
+{
+    /* Rounds like the + 128 >> 8 of the scalar path, then clamps */
+    return vqmovun_s16(vcombine_s16(vqrshrn_n_s32(lo, 8),
+                                    vqrshrn_n_s32(hi, 8)));
+}
+
+/* Converts 8 pixels. c, d and e are Y - 16, U - 128 and V - 128 per pixel. */
+static inline void convert_8_pixels(int16x8_t c, int16x8_t d, int16x8_t e,
+                                    uint8x8_t *r, uint8x8_t *g, uint8x8_t *b)
+{
+    int16x4_t d_lo = vget_low_s16(d), d_hi = vget_high_s16(d);
+    int16x4_t e_lo = vget_low_s16(e), e_hi = vget_high_s16(e);
+    int32x4_t c_lo = vmull_n_s16(vget_low_s16(c), 298);
+    int32x4_t c_hi = vmull_n_s16(vget_high_s16(c), 298);
+
+    *r = narrow_channel(vmlal_n_s16(c_lo, e_lo, 409),
+                        vmlal_n_s16(c_hi, e_hi, 409));
+    *g = narrow_channel(vmlal_n_s16(vmlal_n_s16(c_lo, d_lo, -100), e_lo, -208),
+                        vmlal_n_s16(vmlal_n_s16(c_hi, d_hi, -100), e_hi, -208));
+    *b = narrow_channel(vmlal_n_s16(c_lo, d_lo, 516),
+                        vmlal_n_s16(c_hi, d_hi, 516));
+}
+
+static inline int16x8_t unbias(uint8x8_t v, uint8_t bias)
+{
+    return vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(bias)));
+}
+
+static unsigned int convert_row_neon(enum YUV422_FORMAT format,
+                                     const uint8_t *line, unsigned int width,
+                                     uint8_t *out)
+{
+    unsigned int x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        /* One lane per pixel pair: even Y, U, odd Y and V */
+        uint8x8x4_t in = vld4_u8(&line[x * 2]);
+        uint8x8_t y0, u, y1, v;
+
+        if (format == YUV422_FORMAT_YUY2) {
+            y0 = in.val[0];
+            u = in.val[1];
+            y1 = in.val[2];
+            v = in.val[3];
+        } else {
+            u = in.val[0];
+            y0 = in.val[1];
+            v = in.val[2];
+            y1 = in.val[3];
+        }
+
+        int16x8_t d = unbias(u, 128), e = unbias(v, 128);
+        uint8x8_t r0, g0, b0, r1, g1, b1;
+        convert_8_pixels(unbias(y0, 16), d, e, &r0, &g0, &b0);
+        convert_8_pixels(unbias(y1, 16), d, e, &r1, &g1, &b1);
+
+        uint8x8x2_t r = vzip_u8(r0, r1);
+        uint8x8x2_t g = vzip_u8(g0, g1);
+        uint8x8x2_t b = vzip_u8(b0, b1);
+        uint8x16x4_t rgba = { {
+            vcombine_u8(r.val[0], r.val[1]),
+            vcombine_u8(g.val[0], g.val[1]),
+            vcombine_u8(b.val[0], b.val[1]),
+            vdupq_n_u8(255),
+        } };
+        vst4q_u8(&out[x * 4], rgba);
+    }
+
+    return x;
+}
+#endif
+
+void yuv422_to_rgba(enum YUV422_FORMAT format, const uint8_t *data,
+                    unsigned int width, unsigned int height,
+                    unsigned int pitch, uint8_t *out)
+{
+    for (unsigned int y = 0; y < height; y++) {
+        const uint8_t *line = &data[y * pitch];
+        uint8_t *pixel = &out[y * width * 4];
+        unsigned int x = 0;
+
+#ifdef __SSE2__
+        x = convert_row_sse2(format, line, width, pixel);
+#elif defined(__ARM_NEON)
+        x = convert_row_neon(format, line, width, pixel);
+#endif
+
+        for (; x < width; x++) {
+            if (format == YUV422_FORMAT_YUY2) {
+                convert_yuy2_to_rgb(line, x, &pixel[x * 4], &pixel[x * 4 + 1],
+                                    &pixel[x * 4 + 2]);
+            } else {
+                convert_uyvy_to_rgb(line, x, &pixel[x * 4], &pixel[x * 4 + 1],
+                                    &pixel[x * 4 + 2]);
+            }
+            pixel[x * 4 + 3] = 255;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Geforce NV2A PGRAPH YUV 4:2:2 Conversion
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_XBOX_NV2A_PGRAPH_YUV_H
+#define HW_XBOX_NV2A_PGRAPH_YUV_H
+
+#include <stdint.h>
+
+enum YUV422_FORMAT {
+    YUV422_FORMAT_YUY2, // Y0 U Y1 V (CR8YB8CB8YA8)
+    YUV422_FORMAT_UYVY, // U Y0 V Y1 (YB8CR8YA8CB8)
+};
+
+/*
+ * Convert packed 4:2:2 image data to tightly packed RGBA8 with opaque alpha,
+ * producing the same results as convert_yuy2_to_rgb/convert_uyvy_to_rgb.
+ */
+void yuv422_to_rgba(enum YUV422_FORMAT format, const uint8_t *data,
+                    unsigned int width, unsigned int height,
+                    unsigned int pitch, uint8_t *out);
+
+/*
+ * GLSL for sampling a YUY2 image uploaded as RGBA8 with one texel per pixel
+ * pair from `pvideo_tex`. Conversion matches convert_yuy2_to_rgb, then
+ * pvideo_sample() filters bilinearly in pixel coordinates with wrapping.
+ */
+#define PVIDEO_YUY2_GLSL \
+    "vec3 pvideo_fetch(ivec2 p)\n" \
+    "{\n" \
+    "    ivec2 size = textureSize(pvideo_tex, 0) * ivec2(2, 1);\n" \
+    "    p = ivec2(mod(vec2(p), vec2(size)));\n" \
+    "    vec4 t = floor(texelFetch(pvideo_tex, ivec2(p.x >> 1, p.y), 0) * 255.0 + 0.5);\n" \
+    "    float c = ((p.x & 1) != 0 ? t.b : t.r) - 16.0;\n" \
+    "    float d = t.g - 128.0, e = t.a - 128.0;\n" \
+    "    vec3 rgb = vec3(298.0 * c + 409.0 * e,\n" \
+    "                    298.0 * c - 100.0 * d - 208.0 * e,\n" \
+    "                    298.0 * c + 516.0 * d);\n" \
+    "    return clamp(floor((rgb + 128.0) / 256.0), 0.0, 255.0) / 255.0;\n" \
+    "}\n" \
+    "vec4 pvideo_sample(vec2 p)\n" \
+    "{\n" \
+    "    vec2 f = p - 0.5;\n" \
+    "    ivec2 i = ivec2(floor(f));\n" \
+    "    vec2 w = fract(f);\n" \
+    "    vec3 top = mix(pvideo_fetch(i), pvideo_fetch(i + ivec2(1, 0)), w.x);\n" \
+    "    vec3 bottom = mix(pvideo_fetch(i + ivec2(0, 1)),\n" \
+    "                      pvideo_fetch(i + ivec2(1, 1)), w.x);\n" \
+    "    return vec4(mix(top, bottom, w.y), 1.0);\n" \
+    "}\n"
+
+#endif
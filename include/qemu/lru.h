@@ -1,7 +1,7 @@
 /*
  * LRU object list
  *
- * Copyright (c) 2021-2024 Matt Borgerson
+ * Copyright (c) 2021-2025 Matt Borgerson
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -27,21 +27,33 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include "qemu/host-utils.h"
 #include "qemu/queue.h"
 
-#define LRU_NUM_BINS (1<<16)
+#define LRU_MIN_SLOTS 16
 
 typedef struct LruNode {
 	QTAILQ_ENTRY(LruNode) next_global;
-	QTAILQ_ENTRY(LruNode) next_bin;
 	uint64_t hash;
+	int slot; /* Index slot, or -1 when the node is free */
 } LruNode;
 
+/*
+ * Index entries keep a copy of the node hash so that probing and scanning
+ * only touch the slot array.
+ */
+typedef struct LruSlot {
+	uint64_t hash;
+	LruNode *node;
+} LruSlot;
+
 typedef struct Lru Lru;
 
 struct Lru {
 	QTAILQ_HEAD(, LruNode) global;
-	QTAILQ_HEAD(, LruNode) bins[LRU_NUM_BINS];
+	LruSlot *slots;
+	unsigned int num_slots;
+	unsigned int slot_shift;
 	int num_used;
 	int num_free;
 
@@ -62,9 +74,9 @@ static inline
 void lru_init(Lru *lru)
 {
 	QTAILQ_INIT(&lru->global);
-	for (unsigned int i = 0; i < LRU_NUM_BINS; i++) {
-		QTAILQ_INIT(&lru->bins[i]);
-	}
+	lru->slots = NULL;
+	lru->num_slots = 0;
+	lru->slot_shift = 64;
 	lru->init_node = NULL;
 	lru->compare_nodes = NULL;
 	lru->pre_node_evict = NULL;
@@ -73,30 +85,95 @@ void lru_init(Lru *lru)
 	lru->num_used = 0;
 }
 
+/* Release the index. Nodes are owned by the caller. */
 static inline
-void lru_add_free(Lru *lru, LruNode *node)
+void lru_destroy(Lru *lru)
 {
-	node->next_bin.tqe_circ.tql_prev = NULL;
-	QTAILQ_INSERT_TAIL(&lru->global, node, next_global);
-	lru->num_free += 1;
+	g_free(lru->slots);
+	lru->slots = NULL;
+	lru->num_slots = 0;
+}
+
+static inline
+unsigned int lru_hash_to_slot(Lru *lru, uint64_t hash)
+{
+	return (hash * 0x9e3779b97f4a7c15ULL) >> lru->slot_shift;
 }
 
 static inline
-unsigned int lru_hash_to_bin(Lru *lru, uint64_t hash)
+void lru_index_insert(Lru *lru, LruNode *node)
 {
-	return hash % LRU_NUM_BINS;
+	unsigned int mask = lru->num_slots - 1;
+	unsigned int i = lru_hash_to_slot(lru, node->hash);
+
+	while (lru->slots[i].node) {
+		i = (i + 1) & mask;
+	}
+
+	lru->slots[i].hash = node->hash;
+	lru->slots[i].node = node;
+	node->slot = i;
 }
 
 static inline
-unsigned int lru_get_node_bin(Lru *lru, LruNode *node)
+void lru_index_remove(Lru *lru, LruNode *node)
 {
-	return lru_hash_to_bin(lru, node->hash);
+	unsigned int mask = lru->num_slots - 1;
+	unsigned int i = node->slot;
+
+	/* Backward-shift deletion keeps probe sequences free of tombstones */
+	for (unsigned int j = (i + 1) & mask; lru->slots[j].node;
+		 j = (j + 1) & mask) {
+		unsigned int home = lru_hash_to_slot(lru, lru->slots[j].hash);
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			lru->slots[i] = lru->slots[j];
+			lru->slots[i].node->slot = i;
+			i = j;
+		}
+	}
+
+	lru->slots[i].node = NULL;
+	node->slot = -1;
+}
+
+static inline
+void lru_index_resize(Lru *lru, unsigned int num_slots)
+{
+	LruSlot *old_slots = lru->slots;
+	unsigned int old_num_slots = lru->num_slots;
+
+	assert(is_power_of_2(num_slots));
+	lru->slots = g_new0(LruSlot, num_slots);
+	lru->num_slots = num_slots;
+	lru->slot_shift = 64 - ctz32(num_slots);
+
+	for (unsigned int i = 0; i < old_num_slots; i++) {
+		if (old_slots[i].node) {
+			lru_index_insert(lru, old_slots[i].node);
+		}
+	}
+
+	g_free(old_slots);
+}
+
+static inline
+void lru_add_free(Lru *lru, LruNode *node)
+{
+	/* Keep the index at most half full */
+	unsigned int num_nodes = lru->num_used + lru->num_free + 1;
+	if (num_nodes * 2 > lru->num_slots) {
+		lru_index_resize(lru, MAX(LRU_MIN_SLOTS, pow2ceil(num_nodes * 2)));
+	}
+
+	node->slot = -1;
+	QTAILQ_INSERT_TAIL(&lru->global, node, next_global);
+	lru->num_free += 1;
 }
 
 static inline
 bool lru_is_node_in_use(Lru *lru, LruNode *node)
 {
-	return QTAILQ_IN_USE(node, next_bin);
+	return node->slot >= 0;
 }
 
 static inline
@@ -106,8 +183,7 @@ void lru_evict_node(Lru *lru, LruNode *node)
 		return;
 	}
 
-	unsigned int bin = lru_get_node_bin(lru, node);
-	QTAILQ_REMOVE(&lru->bins[bin], node, next_bin);
+	lru_index_remove(lru, node);
 	if (lru->post_node_evict) {
 		lru->post_node_evict(lru, node);
 	}
@@ -159,14 +235,18 @@ LruNode *lru_get_one_free(Lru *lru)
 static inline
 bool lru_contains_hash(Lru *lru, uint64_t hash)
 {
-	unsigned int bin = lru_hash_to_bin(lru, hash);
-	LruNode *iter;
+	if (!lru->num_slots) {
+		return false;
+	}
+
+	unsigned int mask = lru->num_slots - 1;
 
-	QTAILQ_FOREACH(iter, &lru->bins[bin], next_bin) {
-        if (iter->hash == hash) {
-            return true;
-        }
-    }
+	for (unsigned int i = lru_hash_to_slot(lru, hash); lru->slots[i].node;
+		 i = (i + 1) & mask) {
+		if (lru->slots[i].hash == hash) {
+			return true;
+		}
+	}
 
 	return false;
 }
@@ -174,25 +254,28 @@ bool lru_contains_hash(Lru *lru, uint64_t hash)
 static inline
 LruNode *lru_lookup(Lru *lru, uint64_t hash, const void *key)
 {
-	unsigned int bin = lru_hash_to_bin(lru, hash);
-	LruNode *iter, *found = NULL;
+	unsigned int mask = lru->num_slots - 1;
+	LruNode *found = NULL;
 
-	QTAILQ_FOREACH(iter, &lru->bins[bin], next_bin) {
-        if ((iter->hash == hash) && !lru->compare_nodes(lru, iter, key)) {
-            found = iter;
-            break;
-        }
-    }
+	assert(lru->num_slots);
 
-	if (found) {
-		QTAILQ_REMOVE(&lru->bins[bin], found, next_bin);
-	} else {
+	for (unsigned int i = lru_hash_to_slot(lru, hash); lru->slots[i].node;
+		 i = (i + 1) & mask) {
+		if ((lru->slots[i].hash == hash) &&
+			!lru->compare_nodes(lru, lru->slots[i].node, key)) {
+			found = lru->slots[i].node;
+			break;
+		}
+	}
+
+	if (!found) {
 		found = lru_get_one_free(lru);
 		found->hash = hash;
 		if (lru->init_node) {
 			lru->init_node(lru, found, key);
 		}
 		assert(found->hash == hash);
+		lru_index_insert(lru, found);
 
 		lru->num_used += 1;
 		lru->num_free -= 1;
@@ -200,7 +283,6 @@ LruNode *lru_lookup(Lru *lru, uint64_t hash, const void *key)
 
 	QTAILQ_REMOVE(&lru->global, found, next_global);
 	QTAILQ_INSERT_HEAD(&lru->global, found, next_global);
-	QTAILQ_INSERT_HEAD(&lru->bins[bin], found, next_bin);
 
 	return found;
 }
@@ -210,17 +292,19 @@ void lru_flush(Lru *lru)
 {
 	LruNode *iter, *iter_next;
 
-	for (unsigned int bin = 0; bin < LRU_NUM_BINS; bin++) {
-		QTAILQ_FOREACH_SAFE(iter, &lru->bins[bin], next_bin, iter_next) {
-			bool can_evict = true;
-			if (lru->pre_node_evict) {
-				can_evict = lru->pre_node_evict(lru, iter);
-			}
-			if (can_evict) {
-				lru_evict_node(lru, iter);
-				QTAILQ_REMOVE(&lru->global, iter, next_global);
-				QTAILQ_INSERT_TAIL(&lru->global, iter, next_global);
-			}
+	/* Evicted nodes move to the tail, where they are skipped as free */
+	QTAILQ_FOREACH_SAFE(iter, &lru->global, next_global, iter_next) {
+		if (!lru_is_node_in_use(lru, iter)) {
+			continue;
+		}
+		bool can_evict = true;
+		if (lru->pre_node_evict) {
+			can_evict = lru->pre_node_evict(lru, iter);
+		}
+		if (can_evict) {
+			lru_evict_node(lru, iter);
+			QTAILQ_REMOVE(&lru->global, iter, next_global);
+			QTAILQ_INSERT_TAIL(&lru->global, iter, next_global);
 		}
 	}
 }
@@ -230,11 +314,9 @@ typedef void (*LruNodeVisitorFunc)(Lru *lru, LruNode *node, void *opaque);
 static inline
 void lru_visit_active(Lru *lru, LruNodeVisitorFunc visitor_func, void *opaque)
 {
-	LruNode *iter, *iter_next;
-
-	for (unsigned int bin = 0; bin < LRU_NUM_BINS; bin++) {
-		QTAILQ_FOREACH_SAFE(iter, &lru->bins[bin], next_bin, iter_next) {
-			visitor_func(lru, iter, opaque);
+	for (unsigned int i = 0; i < lru->num_slots; i++) {
+		if (lru->slots[i].node) {
+			visitor_func(lru, lru->slots[i].node, opaque);
 		}
 	}
 }
@@ -9,6 +9,17 @@ typedef struct {
     int refcnt;
 } MString;
 
+/*
+ * Released strings are kept on a small per-thread free list and reused by
+ * later allocations, so building source out of many short-lived fragments
+ * does not hit the heap once the list is warm.
+ */
+MString *mstring_new(void);
+MString *mstring_new_sized(size_t size);
+MString *mstring_from_str(const char *str);
+MString * G_GNUC_PRINTF(1, 2) mstring_from_fmt(const char *fmt, ...);
+void mstring_release(MString *mstr);
+
 static inline void mstring_ref(MString *mstr)
 {
     mstr->refcnt++;
@@ -18,48 +29,31 @@ static inline void mstring_unref(MString *mstr)
 {
     mstr->refcnt--;
     if (mstr->refcnt == 0) {
-        g_string_free(mstr->gstr, true);
-        g_free(mstr);
+        mstring_release(mstr);
     }
 }
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(MString, mstring_unref)
 
-static inline MString *mstring_new(void)
+static inline void mstring_append(MString *mstr, const char *str)
 {
-    MString *mstr = g_malloc(sizeof(MString));
-    mstr->refcnt = 1;
-    mstr->gstr = g_string_new("");
-    return mstr;
+    g_string_append(mstr->gstr, str);
 }
 
-static inline MString *mstring_from_str(const char *str)
+static inline void mstring_append_len(MString *mstr, const char *str,
+                                      size_t len)
 {
-    MString *mstr = g_malloc(sizeof(MString));
-    mstr->refcnt = 1;
-    mstr->gstr = g_string_new(str);
-    return mstr;
+    g_string_append_len(mstr->gstr, str, len);
 }
 
-static inline MString * G_GNUC_PRINTF(1, 2)
-mstring_from_fmt(const char *fmt, ...)
+static inline void mstring_append_mstring(MString *mstr, MString *other)
 {
-    MString *mstr = g_malloc(sizeof(MString));
-    mstr->refcnt = 1;
-
-    va_list args;
-    va_start(args, fmt);
-    // FIXME: Use g_string_new_take (GLib 2.78+)
-    g_autofree gchar *str = g_strdup_vprintf(fmt, args);
-    mstr->gstr = g_string_new(str);
-    va_end(args);
-
-    return mstr;
+    g_string_append_len(mstr->gstr, other->gstr->str, other->gstr->len);
 }
 
-static inline void mstring_append(MString *mstr, const char *str)
+static inline void mstring_append_chr(MString *mstr, char c)
 {
-    g_string_append(mstr->gstr, str);
+    g_string_append_c(mstr->gstr, c);
 }
 
 static inline void G_GNUC_PRINTF(2, 3)
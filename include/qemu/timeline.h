@@ -0,0 +1,76 @@
+/*
+ * Cross-thread event timeline
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QEMU_TIMELINE_H
+#define QEMU_TIMELINE_H
+
+#include "qemu/atomic.h"
+
+/*
+ * Records begin/end spans, instants and counters from any thread while a
+ * capture is active, and writes them out in the Chrome Trace Event JSON
+ * format (viewable in ui.perfetto.dev or chrome://tracing).
+ *
+ * Every thread appends to its own buffer, so recording takes no locks. Event
+ * names are stored by pointer and must be string literals or otherwise live
+ * for the rest of the process. They are written without escaping.
+ */
+
+extern bool timeline_enabled;
+
+void timeline_start(void);
+bool timeline_stop(const char *path, Error **errp);
+void timeline_set_thread_name(const char *name);
+void timeline_record(char phase, const char *name, int64_t value);
+
+static inline bool timeline_active(void)
+{
+    return unlikely(qatomic_read(&timeline_enabled));
+}
+
+static inline void timeline_begin(const char *name)
+{
+    if (timeline_active()) {
+        timeline_record('B', name, 0);
+    }
+}
+
+/* Ends the most recently begun span on this thread */
+static inline void timeline_end(void)
+{
+    if (timeline_active()) {
+        timeline_record('E', NULL, 0);
+    }
+}
+
+static inline void timeline_instant(const char *name)
+{
+    if (timeline_active()) {
+        timeline_record('i', name, 0);
+    }
+}
+
+static inline void timeline_counter(const char *name, int64_t value)
+{
+    if (timeline_active()) {
+        timeline_record('C', name, value);
+    }
+}
+
+#endif
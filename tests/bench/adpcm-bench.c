@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Measures the MCPX APU ADPCM block decoder on random mono and stereo blocks.
+ * The "branchy" variant is the ADPCM-XQ nibble loop the decoder replaced, and
+ * is also used to check that both produce identical samples.
+ */
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "hw/xbox/mcpx/apu/vp/adpcm.h"
+
+#define NUM_BLOCKS 4096
+
+static uint8_t *corpus;
+
+static int branchy_decode_block(int16_t *outbuf, const uint8_t *inbuf,
+                                size_t inbufsize, int channels)
+{
+    int32_t pcmdata[2];
+    int8_t index[2];
+
+    if (inbufsize < (uint32_t)channels * 4) {
+        return 0;
+    }
+
+    for (int ch = 0; ch < channels; ch++) {
+        *outbuf++ = pcmdata[ch] = (int16_t)(inbuf[0] | (inbuf[1] << 8));
+        index[ch] = inbuf[2];
+        if (index[ch] < 0 || index[ch] > 88 || inbuf[3]) {
+            return 0;
+        }
+        inbufsize -= 4;
+        inbuf += 4;
+    }
+
+    int chunks = inbufsize / (channels * 4);
+    int samples = 1 + chunks * 8;
+
+    while (chunks--) {
+        for (int ch = 0; ch < channels; ch++) {
+            for (int i = 0; i < 8; i++) {
+                int nibble = (inbuf[i / 2] >> ((i & 1) * 4)) & 0xf;
+                int step = adpcm_step_table[index[ch]], delta = step >> 3;
+
+                if (nibble & 1) {
+                    delta += step >> 2;
+                }
+                if (nibble & 2) {
+                    delta += step >> 1;
+                }
+                if (nibble & 4) {
+                    delta += step;
+                }
+                if (nibble & 8) {
+                    delta = -delta;
+                }
+
+                pcmdata[ch] += delta;
+                index[ch] += adpcm_index_table[nibble & 7];
+                index[ch] = MIN(MAX(index[ch], 0), 88);
+                pcmdata[ch] = MIN(MAX(pcmdata[ch], -32768), 32767);
+                outbuf[i * channels] = pcmdata[ch];
+            }
+            inbuf += 4;
+            outbuf++;
+        }
+        outbuf += channels * 7;
+    }
+
+    return samples;
+}
+
+static void init_corpus(void)
+{
+    GRand *rand = g_rand_new_with_seed(0x2a);
+
+    corpus = g_new(uint8_t, NUM_BLOCKS * 72);
+    for (int i = 0; i < NUM_BLOCKS * 72; i++) {
+        corpus[i] = g_rand_int_range(rand, 0, 256);
+    }
+    for (int i = 0; i < NUM_BLOCKS * 2; i++) {
+        uint8_t *header = &corpus[i * 36];
+        header[2] = g_rand_int_range(rand, 0, 89);
+        header[3] = 0;
+    }
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+        /* Stereo blocks keep the right channel header after the left */
+        uint8_t *block = &corpus[i * 72];
+        memcpy(&block[4], &block[36], 4);
+    }
+    g_rand_free(rand);
+}
+
+static void check(int channels)
+{
+    int16_t expected[65 * 2], actual[65 * 2];
+    size_t block_size = 36 * channels;
+
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+        const uint8_t *block = &corpus[i * block_size];
+        int n = branchy_decode_block(expected, block, block_size, channels);
+        g_assert_cmpint(adpcm_decode_block(actual, block, block_size, channels),
+                        ==, n);
+        g_assert(!memcmp(expected, actual, n * channels * sizeof(int16_t)));
+    }
+}
+
+static void run(const char *name, bool branchy, int channels, int iterations)
+{
+    int16_t out[65 * 2];
+    size_t block_size = 36 * channels;
+    int blocks = NUM_BLOCKS * 72 / block_size;
+    int64_t samples = 0;
+    int64_t start_ns = get_clock();
+
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int i = 0; i < blocks; i++) {
+            const uint8_t *block = &corpus[i * block_size];
+            samples += branchy ?
+                branchy_decode_block(out, block, block_size, channels) :
+                adpcm_decode_block(out, block, block_size, channels);
+        }
+    }
+
+    int64_t ns = get_clock() - start_ns;
+    printf("%-8s %-6s %10.2f Msamples/s\n", name,
+           channels == 2 ? "stereo" : "mono", samples / (ns / 1e9) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+    adpcm_init_tables();
+    init_corpus();
+    for (int channels = 1; channels <= 2; channels++) {
+        check(channels);
+        run("branchy", true, channels, iterations);
+        run("adpcm", false, channels, iterations);
+    }
+    g_free(corpus);
+
+    return 0;
+}
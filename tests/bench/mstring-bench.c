@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Measures MString in the way the NV2A GLSL generators use it, by running the
+ * real vertex program translator over a corpus of random but well-formed
+ * programs. Each program is built from a few large buffers and many
+ * short-lived per-token fragments.
+ */
+#include "qemu/osdep.h"
+#include "qemu/mstring.h"
+#include "qemu/timer.h"
+#include "hw/xbox/nv2a/pgraph/glsl/vsh-prog.h"
+#include "hw/xbox/nv2a/pgraph/vsh_regs.h"
+
+#define NUM_PROGRAMS 2000
+#define MIN_PROGRAM_LENGTH 16
+
+typedef struct Program {
+    unsigned int length;
+    uint32_t tokens[NV2A_MAX_TRANSFORM_PROGRAM_LENGTH][VSH_TOKEN_SIZE];
+} Program;
+
+static Program *corpus;
+
+/* Rejects the encodings the translator asserts on */
+static bool check_token(const uint32_t *token, bool final)
+{
+    return vsh_get_field(token, FLD_MAC) <= MAC_ARL &&
+           vsh_get_field(token, FLD_A_MUX) != PARAM_UNKNOWN &&
+           vsh_get_field(token, FLD_B_MUX) != PARAM_UNKNOWN &&
+           vsh_get_field(token, FLD_C_MUX) != PARAM_UNKNOWN &&
+           vsh_get_field(token, FLD_OUT_ORB) == OUTPUT_O &&
+           vsh_get_field(token, FLD_FINAL) == final;
+}
+
+static void init_corpus(void)
+{
+    GRand *rand = g_rand_new_with_seed(0x2a);
+
+    corpus = g_new(Program, NUM_PROGRAMS);
+    for (int i = 0; i < NUM_PROGRAMS; i++) {
+        Program *p = &corpus[i];
+        p->length = g_rand_int_range(rand, MIN_PROGRAM_LENGTH,
+                                     NV2A_MAX_TRANSFORM_PROGRAM_LENGTH + 1);
+        for (unsigned int slot = 0; slot < p->length; slot++) {
+            uint32_t *token = p->tokens[slot];
+            do {
+                for (int j = 0; j < VSH_TOKEN_SIZE; j++) {
+                    token[j] = g_rand_int(rand);
+                }
+            } while (!check_token(token, slot == p->length - 1));
+        }
+    }
+    g_rand_free(rand);
+}
+
+static size_t gen_program(const Program *p)
+{
+    MString *header = mstring_new();
+    MString *body = mstring_new_sized(8192);
+
+    pgraph_glsl_gen_vsh_prog(1, &p->tokens[0][0], p->length, header, body);
+
+    size_t len = mstring_get_length(header) + mstring_get_length(body);
+    mstring_unref(header);
+    mstring_unref(body);
+
+    return len;
+}
+
+static void run(const char *name, int iterations)
+{
+    size_t total = 0;
+    int64_t start_ns = get_clock();
+
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int i = 0; i < NUM_PROGRAMS; i++) {
+            total += gen_program(&corpus[i]);
+        }
+    }
+
+    int64_t ns = get_clock() - start_ns;
+    double programs = (double)NUM_PROGRAMS * iterations;
+    printf("%-8s %10.2f us/program %10.2f MB/s\n", name,
+           ns / programs / 1000.0, total / (ns / 1e9) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 5;
+
+    init_corpus();
+    run("vsh-prog", iterations);
+    g_free(corpus);
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Compares the MCPX APU voice resampler tiers with the libsamplerate
+ * callback path they replaced. Quality is the SNR of a resampled sine after
+ * fitting out the gain and phase, speed is per 32-frame stereo voice frame.
+ */
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include <samplerate.h>
+#include "hw/xbox/mcpx/apu/vp/resample.h"
+
+#define FRAME_LEN 32
+#define SINE_FRAMES 8192
+#define SETTLE_FRAMES 256
+
+typedef float Frame[2];
+
+typedef struct Source {
+    Frame *frames;
+    int num_frames;
+    int pos;
+    Frame chunk[FRAME_LEN];
+} Source;
+
+static const struct {
+    const char *name;
+    int quality; // < 0 for libsamplerate
+} variants[] = {
+    { "src-fastest", -1 },
+    { "linear", RESAMPLE_QUALITY_LINEAR },
+    { "sinc8", RESAMPLE_QUALITY_SINC8 },
+    { "sinc32", RESAMPLE_QUALITY_SINC32 },
+};
+
+static int source_read(void *opaque, float frames[][2], int max_frames)
+{
+    Source *s = opaque;
+    int count = MIN(max_frames, s->num_frames - s->pos);
+
+    memcpy(frames, s->frames[s->pos], count * sizeof(frames[0]));
+    s->pos += count;
+    return count;
+}
+
+static long source_src_callback(void *opaque, float **data)
+{
+    Source *s = opaque;
+    int count = source_read(s, s->chunk, FRAME_LEN);
+
+    if (count < FRAME_LEN) {
+        memset(s->chunk[count], 0, (FRAME_LEN - count) * sizeof(s->chunk[0]));
+    }
+    *data = &s->chunk[0][0];
+    return FRAME_LEN;
+}
+
+typedef struct Voice {
+    Source source;
+    SRC_STATE *src;
+    Resampler resampler;
+} Voice;
+
+static void voice_init(Voice *voice, int quality, Frame *frames,
+                       int num_frames)
+{
+    voice->source = (Source){ .frames = frames, .num_frames = num_frames };
+    voice->src = NULL;
+    if (quality < 0) {
+        int err;
+        voice->src = src_callback_new(source_src_callback, SRC_SINC_FASTEST, 2,
+                                      &err, &voice->source);
+        g_assert(voice->src);
+    } else {
+        resampler_init(&voice->resampler, quality);
+    }
+}
+
+static void voice_process(Voice *voice, double ratio, float out[][2])
+{
+    if (voice->src) {
+        g_assert(src_callback_read(voice->src, ratio, FRAME_LEN,
+                                   &out[0][0]) == FRAME_LEN);
+    } else {
+        resampler_process(&voice->resampler, ratio, true, out, FRAME_LEN,
+                          source_read, &voice->source);
+    }
+}
+
+static void voice_cleanup(Voice *voice)
+{
+    if (voice->src) {
+        src_delete(voice->src);
+    }
+}
+
+static double sine_snr(int quality, double freq, double ratio)
+{
+    Frame *in = g_new(Frame, SINE_FRAMES);
+    int num_out = (int)(SINE_FRAMES * ratio - 64) / FRAME_LEN * FRAME_LEN;
+    Frame *out = g_new(Frame, num_out);
+    Voice voice;
+
+    for (int i = 0; i < SINE_FRAMES; i++) {
+        in[i][0] = in[i][1] = 0.5 * sin(2 * M_PI * freq * i);
+    }
+
+    voice_init(&voice, quality, in, SINE_FRAMES);
+    for (int n = 0; n < num_out; n += FRAME_LEN) {
+        voice_process(&voice, ratio, &out[n]);
+    }
+    voice_cleanup(&voice);
+
+    /* Project onto the expected output tone, the rest is error */
+    double w = 2 * M_PI * freq / ratio, ss = 0, sc = 0, cc = 0, ys = 0,
+           yc = 0, yy = 0;
+    for (int n = SETTLE_FRAMES; n < num_out; n++) {
+        double s = sin(w * n), c = cos(w * n), y = out[n][0];
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        ys += y * s;
+        yc += y * c;
+        yy += y * y;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+    double signal = a * ys + b * yc;
+    double noise = MAX(yy - signal, 1e-30);
+
+    g_free(in);
+    g_free(out);
+
+    return 10 * log10(signal / noise);
+}
+
+static void run_speed(int quality, const char *name, int iterations)
+{
+    const int num_voices = 64;
+    const int num_frames = FRAME_LEN * 4 * iterations;
+    Frame *in = g_new(Frame, num_frames);
+    Voice *voices = g_new(Voice, num_voices);
+    Frame out[FRAME_LEN];
+    GRand *rand = g_rand_new_with_seed(0x2a);
+
+    for (int i = 0; i < num_frames; i++) {
+        in[i][0] = g_rand_double_range(rand, -1.0, 1.0);
+        in[i][1] = g_rand_double_range(rand, -1.0, 1.0);
+    }
+    for (int v = 0; v < num_voices; v++) {
+        voice_init(&voices[v], quality, in, num_frames);
+    }
+
+    int64_t start_ns = get_clock();
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int v = 0; v < num_voices; v++) {
+            /* Typical DirectSound pitches, mostly converting up to 48 kHz */
+            voice_process(&voices[v], 1.0 + 0.0123 * v, out);
+        }
+    }
+    int64_t ns = get_clock() - start_ns;
+
+    printf("%-12s %10.2f ns/voice-frame\n", name,
+           (double)ns / (iterations * num_voices));
+
+    for (int v = 0; v < num_voices; v++) {
+        voice_cleanup(&voices[v]);
+    }
+    g_free(voices);
+    g_free(in);
+    g_rand_free(rand);
+}
+
+int main(int argc, char *argv[])
+{
+    static const double freqs[] = { 0.02, 0.1, 0.2 };
+    static const double ratios[] = { 0.6, 0.9, 1.3, 2.0 };
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+    printf("SNR (dB)     ");
+    for (int f = 0; f < ARRAY_SIZE(freqs); f++) {
+        for (int r = 0; r < ARRAY_SIZE(ratios); r++) {
+            printf(" %4.2f@%3.1f", freqs[f], ratios[r]);
+        }
+    }
+    printf("\n");
+
+    for (int i = 0; i < ARRAY_SIZE(variants); i++) {
+        printf("%-12s ", variants[i].name);
+        for (int f = 0; f < ARRAY_SIZE(freqs); f++) {
+            for (int r = 0; r < ARRAY_SIZE(ratios); r++) {
+                printf(" %8.1f", sine_snr(variants[i].quality, freqs[f],
+                                          ratios[r]));
+            }
+        }
+        printf("\n");
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(variants); i++) {
+        run_speed(variants[i].quality, variants[i].name, iterations);
+    }
+
+    return 0;
+}
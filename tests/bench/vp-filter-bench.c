@@ -0,0 +1,281 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Measures the MCPX APU voice filters on a frame of noise per voice: the
+ * HRTF convolution selected for the host, and the per-voice state variable
+ * low pass, per voice and batched across voices. The "scalar" variants are
+ * the loops they replaced, processing one channel and one tap at a time, and
+ * are used to check the results.
+ */
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "hw/xbox/mcpx/apu/vp/hrtf.h"
+#include "hw/xbox/mcpx/apu/vp/svf.h"
+
+#define NUM_VOICES 64
+#define SCALAR_BUFLEN (HRTF_NUM_TAPS + HRTF_MAX_DELAY_SAMPLES)
+
+typedef float Frame[NUM_SAMPLES_PER_FRAME][2];
+
+typedef struct ScalarHrtf {
+    int buf_pos;
+    float buf[2][SCALAR_BUFLEN];
+    float coeff_cur[2][HRTF_NUM_TAPS];
+    float coeff_tar[2][HRTF_NUM_TAPS];
+    float itd_cur, itd_tar;
+} ScalarHrtf;
+
+static Frame *input;
+static float hrir[NUM_VOICES][2][HRTF_NUM_TAPS];
+static float itd[NUM_VOICES];
+
+static void scalar_hrtf_process(ScalarHrtf *f, Frame in, Frame out)
+{
+    for (int n = 0; n < NUM_SAMPLES_PER_FRAME; n++) {
+        for (int ch = 0; ch < 2; ch++) {
+            for (int k = 0; k < HRTF_NUM_TAPS; k++) {
+                f->coeff_cur[ch][k] = hrtf_filter_smooth_param(
+                    f->coeff_cur[ch][k], f->coeff_tar[ch][k]);
+            }
+        }
+        f->itd_cur = hrtf_filter_smooth_param(f->itd_cur, f->itd_tar);
+
+        for (int ch = 0; ch < 2; ch++) {
+            float *buf = f->buf[ch];
+            buf[f->buf_pos] = in[n][ch];
+
+            float d = MAX(f->itd_cur * (ch == 0 ? +1.0f : -1.0f), 0.0f);
+            int di = d;
+            float dfrac = d - di;
+
+            float acc = 0.0f;
+            for (int k = 0; k < HRTF_NUM_TAPS; k++) {
+                int idx1 = (f->buf_pos - di - k + SCALAR_BUFLEN) % SCALAR_BUFLEN;
+                float s = buf[idx1];
+                if (dfrac > 0.0f) {
+                    int idx2 = (idx1 - 1 + SCALAR_BUFLEN) % SCALAR_BUFLEN;
+                    s = s * (1 - dfrac) + buf[idx2] * dfrac;
+                }
+                acc += f->coeff_cur[ch][k] * s;
+            }
+            out[n][ch] = acc;
+        }
+
+        f->buf_pos = (f->buf_pos + 1) % SCALAR_BUFLEN;
+    }
+}
+
+static void init_input(void)
+{
+    GRand *rand = g_rand_new_with_seed(0x2a);
+
+    input = g_new(Frame, NUM_VOICES);
+    for (int v = 0; v < NUM_VOICES; v++) {
+        for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
+            input[v][i][0] = g_rand_double_range(rand, -1.0, 1.0);
+            input[v][i][1] = g_rand_double_range(rand, -1.0, 1.0);
+        }
+        for (int k = 0; k < HRTF_NUM_TAPS; k++) {
+            hrir[v][0][k] = g_rand_double_range(rand, -1.0, 1.0);
+            hrir[v][1][k] = g_rand_double_range(rand, -1.0, 1.0);
+        }
+        itd[v] = g_rand_double_range(rand, -HRTF_MAX_DELAY_SAMPLES,
+                                     HRTF_MAX_DELAY_SAMPLES);
+    }
+    g_rand_free(rand);
+}
+
+static void init_hrtf(HrtfFilter *f, ScalarHrtf *s, int v)
+{
+    hrtf_filter_init(f);
+    hrtf_filter_set_target_params(f, hrir[v], itd[v]);
+
+    memset(s, 0, sizeof(*s));
+    for (int ch = 0; ch < 2; ch++) {
+        memcpy(s->coeff_tar[ch], f->ch[ch].hrir_coeff_tar,
+               sizeof(s->coeff_tar[ch]));
+    }
+    s->itd_tar = f->itd_tar;
+}
+
+static void check_hrtf(void)
+{
+    HrtfFilter f;
+    ScalarHrtf s;
+    Frame a, b;
+
+    for (int v = 0; v < NUM_VOICES; v++) {
+        init_hrtf(&f, &s, v);
+        /* Stop before the coefficients settle and snap to their targets */
+        for (int frame = 0; frame < 60; frame++) {
+            Frame *in = &input[(v + frame) % NUM_VOICES];
+            hrtf_filter_process(&f, *in, a);
+            scalar_hrtf_process(&s, *in, b);
+            for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
+                g_assert_cmpfloat_with_epsilon(a[i][0], b[i][0], 1e-5);
+                g_assert_cmpfloat_with_epsilon(a[i][1], b[i][1], 1e-5);
+            }
+        }
+    }
+}
+
+static void check_svf(void)
+{
+    sv_filter a[2] = { 0 }, b[2] = { 0 };
+    Frame x, y;
+
+    for (int frame = 0; frame < 1000; frame++) {
+        memcpy(x, input[frame % NUM_VOICES], sizeof(x));
+        memcpy(y, x, sizeof(y));
+        for (int ch = 0; ch < 2; ch++) {
+            float fc = 0.01f + (frame % 97) / 100.0f;
+            float q = 0.08f + ch * 0.5f;
+            setup_svf(&a[ch], fc, q, F_LP);
+            setup_svf(&b[ch], fc, q, F_LP);
+            for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
+                x[i][ch] = run_svf(&a[ch], x[i][ch]);
+                x[i][ch] = fmin(fmax(x[i][ch], -1.0), 1.0);
+            }
+        }
+        run_svf_stereo(b, y, NUM_SAMPLES_PER_FRAME);
+        g_assert(!memcmp(x, y, sizeof(x)));
+    }
+}
+
+static void check_svf_batch(void)
+{
+    sv_filter a[SVF_MAX_BATCH][2] = { 0 }, b[SVF_MAX_BATCH][2] = { 0 };
+    sv_filter *sv[SVF_MAX_BATCH];
+    float (*samples[SVF_MAX_BATCH])[2];
+    Frame x[SVF_MAX_BATCH], y[SVF_MAX_BATCH];
+
+    for (int frame = 0; frame < 1000; frame++) {
+        int n = 1 + frame % SVF_MAX_BATCH;
+        for (int k = 0; k < n; k++) {
+            memcpy(x[k], input[(frame + k) % NUM_VOICES], sizeof(x[k]));
+            memcpy(y[k], x[k], sizeof(y[k]));
+            for (int ch = 0; ch < 2; ch++) {
+                float fc = 0.01f + ((frame + k) % 97) / 100.0f;
+                float q = 0.08f + ch * 0.5f + k * 0.05f;
+                setup_svf(&a[k][ch], fc, q, F_LP);
+                setup_svf(&b[k][ch], fc, q, F_LP);
+            }
+            run_svf_stereo(a[k], x[k], NUM_SAMPLES_PER_FRAME);
+            sv[k] = b[k];
+            samples[k] = y[k];
+        }
+        run_svf_batch(sv, samples, n);
+        g_assert(!memcmp(x, y, n * sizeof(x[0])));
+        for (int k = 0; k < n; k++) {
+            for (int ch = 0; ch < 2; ch++) {
+                g_assert(a[k][ch].b == b[k][ch].b);
+                g_assert(a[k][ch].l == b[k][ch].l);
+                g_assert(a[k][ch].n == b[k][ch].n);
+                g_assert(a[k][ch].p == b[k][ch].p);
+            }
+        }
+    }
+}
+
+static void report(const char *name, int64_t start_ns, int frames)
+{
+    int64_t ns = get_clock() - start_ns;
+    printf("%-12s %10.2f ns/voice-frame\n", name, (double)ns / frames);
+}
+
+static void run_hrtf_bench(bool scalar, int iterations)
+{
+    HrtfFilter *f = g_new(HrtfFilter, NUM_VOICES);
+    ScalarHrtf *s = g_new(ScalarHrtf, NUM_VOICES);
+    Frame out;
+
+    for (int v = 0; v < NUM_VOICES; v++) {
+        init_hrtf(&f[v], &s[v], v);
+    }
+
+    int64_t start_ns = get_clock();
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int v = 0; v < NUM_VOICES; v++) {
+            if (scalar) {
+                scalar_hrtf_process(&s[v], input[v], out);
+            } else {
+                hrtf_filter_process(&f[v], input[v], out);
+            }
+        }
+    }
+    report(scalar ? "hrtf-scalar" : "hrtf", start_ns, iterations * NUM_VOICES);
+
+    g_free(f);
+    g_free(s);
+}
+
+static void run_svf_bench(bool scalar, int iterations)
+{
+    sv_filter *filters = g_new0(sv_filter, NUM_VOICES * 2);
+    Frame buf;
+
+    int64_t start_ns = get_clock();
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int v = 0; v < NUM_VOICES; v++) {
+            sv_filter *sv = &filters[v * 2];
+            memcpy(buf, input[v], sizeof(buf));
+            setup_svf(&sv[0], 0.25f, 0.5f, F_LP);
+            setup_svf(&sv[1], 0.25f, 0.5f, F_LP);
+            if (scalar) {
+                for (int ch = 0; ch < 2; ch++) {
+                    for (int i = 0; i < NUM_SAMPLES_PER_FRAME; i++) {
+                        buf[i][ch] = run_svf(&sv[ch], buf[i][ch]);
+                        buf[i][ch] = fmin(fmax(buf[i][ch], -1.0), 1.0);
+                    }
+                }
+            } else {
+                run_svf_stereo(sv, buf, NUM_SAMPLES_PER_FRAME);
+            }
+        }
+    }
+    report(scalar ? "svf-scalar" : "svf", start_ns, iterations * NUM_VOICES);
+
+    g_free(filters);
+}
+
+static void run_svf_batch_bench(int iterations)
+{
+    sv_filter *filters = g_new0(sv_filter, NUM_VOICES * 2);
+    sv_filter *sv[SVF_MAX_BATCH];
+    float (*samples[SVF_MAX_BATCH])[2];
+    Frame buf[SVF_MAX_BATCH];
+
+    int64_t start_ns = get_clock();
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int v = 0; v < NUM_VOICES; v += SVF_MAX_BATCH) {
+            for (int k = 0; k < SVF_MAX_BATCH; k++) {
+                sv[k] = &filters[(v + k) * 2];
+                samples[k] = buf[k];
+                memcpy(buf[k], input[v + k], sizeof(buf[k]));
+                setup_svf(&sv[k][0], 0.25f, 0.5f, F_LP);
+                setup_svf(&sv[k][1], 0.25f, 0.5f, F_LP);
+            }
+            run_svf_batch(sv, samples, SVF_MAX_BATCH);
+        }
+    }
+    report("svf-batch", start_ns, iterations * NUM_VOICES);
+
+    g_free(filters);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+    init_input();
+    check_hrtf();
+    check_svf();
+    check_svf_batch();
+    run_hrtf_bench(true, iterations);
+    run_hrtf_bench(false, iterations);
+    run_svf_bench(true, iterations);
+    run_svf_bench(false, iterations);
+    run_svf_batch_bench(iterations);
+    g_free(input);
+
+    return 0;
+}
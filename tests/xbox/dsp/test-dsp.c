@@ -19,6 +19,7 @@
 
 #include "qemu/osdep.h"
 #include "hw/xbox/mcpx/apu/dsp/dsp.h"
+#include "hw/xbox/mcpx/apu/dsp/dsp_state.h"
 
 static void scratch_rw(void *opaque, uint8_t *ptr, uint32_t addr, size_t len, bool dir)
 {
@@ -74,11 +75,303 @@ static void test_dsp_basic(void)
     dsp_destroy(s);
 }
 
+/* Batched execution in dsp_run must match stepping one instruction at a time */
+static void test_dsp_block(void)
+{
+    g_autofree gchar *path = g_test_build_filename(G_TEST_DIST, "data", "basic", NULL);
+
+    DSPState *run = dsp_init(NULL, scratch_rw, fifo_rw);
+    DSPState *step = dsp_init(NULL, scratch_rw, fifo_rw);
+
+    load_prog(run, path);
+    load_prog(step, path);
+
+    dsp_run(run, 1000);
+    for (int i = 0; i < 1000 && !step->core.is_idle; i++) {
+        dsp_step(step);
+    }
+
+    g_assert_true(run->core.is_idle);
+    g_assert_true(step->core.is_idle);
+    g_assert_cmphex(run->core.pc, ==, step->core.pc);
+    g_assert_cmpmem(run->core.registers, sizeof(run->core.registers),
+                    step->core.registers, sizeof(step->core.registers));
+    g_assert_cmpmem(run->core.xram, sizeof(run->core.xram),
+                    step->core.xram, sizeof(step->core.xram));
+
+    dsp_destroy(run);
+    dsp_destroy(step);
+}
+
+/* Steps step until it has run as many instructions as run */
+static void step_to(DSPState *run, DSPState *step)
+{
+    while (step->core.cycle_count < run->core.cycle_count) {
+        dsp_step(step);
+        step->core.cycle_count++;
+    }
+}
+
+static void assert_same_state(DSPState *run, DSPState *step)
+{
+    g_assert_cmphex(run->core.pc, ==, step->core.pc);
+    g_assert_cmpuint(run->core.num_inst, ==, step->core.num_inst);
+    g_assert_cmpuint(run->core.loop_rep, ==, step->core.loop_rep);
+    g_assert_cmpint(run->core.interrupt_state, ==,
+                    step->core.interrupt_state);
+    g_assert_cmpmem(run->core.registers, sizeof(run->core.registers),
+                    step->core.registers, sizeof(step->core.registers));
+    g_assert_cmpmem(run->core.stack, sizeof(run->core.stack),
+                    step->core.stack, sizeof(step->core.stack));
+    g_assert_cmpmem(run->core.xram, sizeof(run->core.xram),
+                    step->core.xram, sizeof(step->core.xram));
+}
+
+/*
+ * Runs a program with dsp_run in small budgets, so batches end mid loop, next
+ * to a copy stepped one instruction at a time, and checks the two match after
+ * every call. If irq_call is not negative, SWI is raised on both before that
+ * call. With jit, the batches run from translated code. Returns the batched
+ * core.
+ */
+static DSPState *run_lockstep(const char *name, int calls, int cycles,
+                              int irq_call, bool jit)
+{
+    g_autofree gchar *path = g_test_build_filename(G_TEST_DIST, "data", name, NULL);
+
+    DSPState *run = dsp_init(NULL, scratch_rw, fifo_rw);
+    DSPState *step = dsp_init(NULL, scratch_rw, fifo_rw);
+
+    load_prog(run, path);
+    load_prog(step, path);
+    run->core.jit_enabled = jit;
+
+    for (int i = 0; i < calls && !run->core.is_idle; i++) {
+        if (i == irq_call) {
+            dsp56k_add_interrupt(&run->core, DSP_INTER_SWI);
+            dsp56k_add_interrupt(&step->core, DSP_INTER_SWI);
+        }
+
+        dsp_run(run, cycles);
+        step_to(run, step);
+        assert_same_state(run, step);
+    }
+
+#ifdef DSP_JIT_HOST
+    if (jit) {
+        g_assert_cmpuint(run->core.jit_blocks, >, 0);
+    }
+#endif
+
+    dsp_destroy(step);
+    return run;
+}
+
+/* Nested DO loops around REP, with batches ending inside the repeat */
+static void test_dsp_block_loops(const void *jit)
+{
+    DSPState *s = run_lockstep("loops", 200, 5, -1, GPOINTER_TO_INT(jit));
+
+    g_assert_true(s->core.is_idle);
+    g_assert_cmphex(s->core.registers[DSP_REG_A0], ==, 4 * (3 * 5 + 2));
+    g_assert_cmphex(s->core.registers[DSP_REG_R0], ==, 4 * 4);
+    g_assert_cmphex(s->core.registers[DSP_REG_LC], ==, 0);
+
+    dsp_destroy(s);
+}
+
+/* ALU operations with X:Y and X:R parallel moves */
+static void test_dsp_block_parallel_move(const void *jit)
+{
+    DSPState *s = run_lockstep("pmove", 200, 3, -1, GPOINTER_TO_INT(jit));
+
+    g_assert_true(s->core.is_idle);
+    /* Each add sees the x0 loaded by the previous iteration */
+    g_assert_cmphex(s->core.registers[DSP_REG_A1], ==,
+                    1 + 2 + 3 + 4 + 5 + 6 + 7);
+    g_assert_cmphex(s->core.registers[DSP_REG_R0], ==, 0x18);
+    g_assert_cmphex(s->core.registers[DSP_REG_R4], ==, 0x28);
+    g_assert_cmphex(dsp_read_memory(s, 'X', 0x37), ==,
+                    s->core.registers[DSP_REG_A1]);
+
+    dsp_destroy(s);
+}
+
+/* A long interrupt raised between batches runs its handler and returns */
+static void test_dsp_block_interrupt(const void *jit)
+{
+    DSPState *s = run_lockstep("irq", 100, 9, 10, GPOINTER_TO_INT(jit));
+
+    g_assert_false(s->core.is_idle);
+    g_assert_cmphex(s->core.registers[DSP_REG_B0], ==, 1);
+    g_assert_cmpint(s->core.interrupt_state, ==, DSP_INTERRUPT_NONE);
+    g_assert_cmphex(s->core.registers[DSP_REG_SP], ==, 0);
+
+    dsp_destroy(s);
+}
+
+/* Skipping a polling loop must leave the core as if the loop had run */
+static void test_dsp_idle_loop(void)
+{
+    g_autofree gchar *path = g_test_build_filename(G_TEST_DIST, "data", "poll", NULL);
+
+    DSPState *run = dsp_init(NULL, scratch_rw, fifo_rw);
+    DSPState *step = dsp_init(NULL, scratch_rw, fifo_rw);
+
+    load_prog(run, path);
+    load_prog(step, path);
+
+    dsp_run(run, 1000);
+    for (int cycles = 1000; cycles > 0; cycles -= step->core.instr_cycle) {
+        dsp_step(step);
+    }
+
+    g_assert_cmpuint(run->core.idle_skips, >, 0);
+    g_assert_false(run->core.is_idle);
+    g_assert_cmphex(run->core.pc, ==, step->core.pc);
+    g_assert_cmpuint(run->core.num_inst, ==, step->core.num_inst);
+    g_assert_cmpmem(run->core.registers, sizeof(run->core.registers),
+                    step->core.registers, sizeof(step->core.registers));
+
+    /* Leaves the loop once the frame starts */
+    dsp_start_frame(run);
+    dsp_run(run, 1000);
+    g_assert_true(run->core.is_idle);
+    g_assert_cmphex(dsp_read_memory(run, 'X', 3), ==, 0x123456);
+
+    dsp_destroy(run);
+    dsp_destroy(step);
+}
+
+/* Rewriting the extension word of a decoded instruction must take effect */
+static void test_dsp_decode_extension_word(void)
+{
+    DSPState *s = dsp_init(NULL, scratch_rw, fifo_rw);
+
+    /* add #xxxx,a */
+    dsp_write_memory(s, 'P', 0, 0x0140c0);
+    dsp_write_memory(s, 'P', 1, 5);
+    dsp_step(s);
+    g_assert_cmphex(s->core.pc, ==, 2);
+    g_assert_cmphex(s->core.registers[DSP_REG_A1], ==, 5);
+
+    dsp_write_memory(s, 'P', 1, 7);
+    s->core.pc = 0;
+    dsp_step(s);
+    g_assert_cmphex(s->core.registers[DSP_REG_A1], ==, 5 + 7);
+
+    dsp_destroy(s);
+}
+
+/* Rewriting translated PRAM words, one by one or in bulk, must take effect */
+static void test_dsp_jit_invalidate(void)
+{
+    static const uint32_t prog[] = {
+        0x0140c0, 0x000005,     /* add #5,a */
+        0x0c0000,               /* jmp 0 */
+    };
+
+    DSPState *run = dsp_init(NULL, scratch_rw, fifo_rw);
+    DSPState *step = dsp_init(NULL, scratch_rw, fifo_rw);
+
+    dsp_write_memory_block(run, 'P', 0, prog, ARRAY_SIZE(prog));
+    dsp_write_memory_block(step, 'P', 0, prog, ARRAY_SIZE(prog));
+    run->core.jit_enabled = true;
+
+    for (int i = 0; i < 30; i++) {
+        if (i == 10) {
+            dsp_write_memory(run, 'P', 1, 7);
+            dsp_write_memory(step, 'P', 1, 7);
+        }
+        if (i == 20) {
+            run->core.pram[1] = 3;
+            step->core.pram[1] = 3;
+            dsp56k_invalidate_decoded(&run->core);
+            dsp56k_invalidate_decoded(&step->core);
+        }
+
+        dsp_run(run, 15);
+        step_to(run, step);
+        assert_same_state(run, step);
+    }
+
+#ifdef DSP_JIT_HOST
+    g_assert_cmpuint(run->core.jit_blocks, >=, 3);
+#endif
+
+    dsp_destroy(run);
+    dsp_destroy(step);
+}
+
+/* Block transfers must match word by word access, including across regions */
+static void test_dsp_memory_block(void)
+{
+    static const struct {
+        char space;
+        uint32_t addr;
+        size_t count;
+    } ranges[] = {
+        { 'X', 0x0000, 0x100 },
+        { 'X', 0x0bf0, 0x20 },  /* Into the mixbuffer alias */
+        { 'X', 0x1400, 0x400 },
+        { 'Y', 0x07f0, 0x10 },
+        { 'P', 0x0100, 0x40 },
+    };
+
+    DSPState *block = dsp_init(NULL, scratch_rw, fifo_rw);
+    DSPState *word = dsp_init(NULL, scratch_rw, fifo_rw);
+
+    for (int i = 0; i < ARRAY_SIZE(ranges); i++) {
+        uint32_t src[0x400], a[0x400], b[0x400];
+
+        for (int j = 0; j < ranges[i].count; j++) {
+            src[j] = (i * 0x10000 + j * 0x123) & 0xffffff;
+            dsp_write_memory(word, ranges[i].space, ranges[i].addr + j, src[j]);
+        }
+        dsp_write_memory_block(block, ranges[i].space, ranges[i].addr, src,
+                               ranges[i].count);
+
+        dsp_read_memory_block(block, ranges[i].space, ranges[i].addr, a,
+                              ranges[i].count);
+        for (int j = 0; j < ranges[i].count; j++) {
+            b[j] = dsp_read_memory(word, ranges[i].space, ranges[i].addr + j);
+        }
+        g_assert_cmpmem(a, ranges[i].count * 4, b, ranges[i].count * 4);
+    }
+
+    g_assert_cmpmem(block->core.xram, sizeof(block->core.xram),
+                    word->core.xram, sizeof(word->core.xram));
+    g_assert_cmpmem(block->core.mixbuffer, sizeof(block->core.mixbuffer),
+                    word->core.mixbuffer, sizeof(word->core.mixbuffer));
+    g_assert_cmpmem(block->core.pram, sizeof(block->core.pram),
+                    word->core.pram, sizeof(word->core.pram));
+
+    dsp_destroy(block);
+    dsp_destroy(word);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
 
     g_test_add_func("/basic", test_dsp_basic);
+    g_test_add_func("/block", test_dsp_block);
+    g_test_add_data_func("/block/loops", GINT_TO_POINTER(false),
+                         test_dsp_block_loops);
+    g_test_add_data_func("/block/parallel_move", GINT_TO_POINTER(false),
+                         test_dsp_block_parallel_move);
+    g_test_add_data_func("/block/interrupt", GINT_TO_POINTER(false),
+                         test_dsp_block_interrupt);
+    g_test_add_data_func("/jit/loops", GINT_TO_POINTER(true),
+                         test_dsp_block_loops);
+    g_test_add_data_func("/jit/parallel_move", GINT_TO_POINTER(true),
+                         test_dsp_block_parallel_move);
+    g_test_add_data_func("/jit/interrupt", GINT_TO_POINTER(true),
+                         test_dsp_block_interrupt);
+    g_test_add_func("/jit/invalidate", test_dsp_jit_invalidate);
+    g_test_add_func("/idle_loop", test_dsp_idle_loop);
+    g_test_add_func("/memory_block", test_dsp_memory_block);
+    g_test_add_func("/decode/extension_word", test_dsp_decode_extension_word);
 
     return g_test_run();
 }
@@ -0,0 +1,94 @@
+/*
+ * Crosscheck YUV 4:2:2 texture conversion against the per-pixel helpers.
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/xbox/nv2a/pgraph/util.h"
+#include "hw/xbox/nv2a/pgraph/yuv.h"
+
+static void convert_reference(enum YUV422_FORMAT format, const uint8_t *data,
+                              unsigned int width, unsigned int height,
+                              unsigned int pitch, uint8_t *out)
+{
+    for (unsigned int y = 0; y < height; y++) {
+        const uint8_t *line = &data[y * pitch];
+        uint8_t *pixel = &out[y * width * 4];
+
+        for (unsigned int x = 0; x < width; x++) {
+            if (format == YUV422_FORMAT_YUY2) {
+                convert_yuy2_to_rgb(line, x, &pixel[x * 4], &pixel[x * 4 + 1],
+                                    &pixel[x * 4 + 2]);
+            } else {
+                convert_uyvy_to_rgb(line, x, &pixel[x * 4], &pixel[x * 4 + 1],
+                                    &pixel[x * 4 + 2]);
+            }
+            pixel[x * 4 + 3] = 255;
+        }
+    }
+}
+
+static void test_yuv_format(enum YUV422_FORMAT format)
+{
+    /* Widths around the 8 and 16 pixel vector steps, and their tails */
+    static const unsigned int widths[] = { 2, 6, 8, 14, 16, 18, 30, 32, 34, 640 };
+    const unsigned int height = 3;
+    GRand *rand = g_rand_new_with_seed(format);
+
+    for (int i = 0; i < ARRAY_SIZE(widths); i++) {
+        unsigned int width = widths[i];
+        unsigned int pitch = width * 2 + 4;
+        g_autofree uint8_t *data = g_malloc(pitch * height);
+        g_autofree uint8_t *expected = g_malloc(width * height * 4);
+        g_autofree uint8_t *actual = g_malloc(width * height * 4);
+
+        for (unsigned int j = 0; j < pitch * height; j++) {
+            data[j] = g_rand_int_range(rand, 0, 256);
+        }
+        /* Cover the clamping at both ends */
+        data[0] = data[1] = data[2] = data[3] = 0;
+        data[pitch - 8] = data[pitch - 7] = data[pitch - 6] =
+            data[pitch - 5] = 255;
+
+        convert_reference(format, data, width, height, pitch, expected);
+        yuv422_to_rgba(format, data, width, height, pitch, actual);
+        g_assert_cmpmem(expected, width * height * 4, actual,
+                        width * height * 4);
+    }
+
+    g_rand_free(rand);
+}
+
+static void test_yuv_yuy2(void)
+{
+    test_yuv_format(YUV422_FORMAT_YUY2);
+}
+
+static void test_yuv_uyvy(void)
+{
+    test_yuv_format(YUV422_FORMAT_UYVY);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/yuy2", test_yuv_yuy2);
+    g_test_add_func("/uyvy", test_yuv_uyvy);
+
+    return g_test_run();
+}
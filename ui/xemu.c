@@ -32,6 +32,7 @@
 #include "qemu/thread.h"
 #include "qemu/main-loop.h"
 #include "qemu/rcu.h"
+#include "qemu/timeline.h"
 #include "qemu-version.h"
 #include "qapi/error.h"
 #include "qapi/qapi-commands-block.h"
@@ -807,6 +808,7 @@ static void gl_render_frame(struct xemu_console *scon)
         return;
     }
 
+    timeline_begin("UI Frame");
     SDL_GL_MakeCurrent(scon->real_window, scon->winctx);
 
     bool flip_required = false;
@@ -860,8 +862,15 @@ static void gl_render_frame(struct xemu_console *scon)
     }
 
     nv2a_release_framebuffer_surface();
+    timeline_begin("Swap");
     SDL_GL_SwapWindow(scon->real_window);
+    timeline_end();
+    if (!release_surface_texture) {
+        /* Only frames from the present queue count towards its stats */
+        nv2a_framebuffer_presented();
+    }
     assert(glGetError() == GL_NO_ERROR);
+    timeline_end();
 
     qatomic_set(&rendering, false);
 
@@ -1280,6 +1289,7 @@ int main(int argc, char **argv)
     QemuThread thread;
 
     setlocale(LC_NUMERIC, "C");
+    timeline_set_thread_name("UI");
 
 #ifdef _WIN32
     if (AttachConsole(ATTACH_PARENT_PROCESS)) {
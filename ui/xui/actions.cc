@@ -91,6 +91,30 @@ void ActionScreenshot(void)
 	g_screenshot_pending = true;
 }
 
+void ActionToggleTimelineCapture(void)
+{
+    if (!timeline_active()) {
+        timeline_start();
+        xemu_queue_notification("Timeline capture started");
+        return;
+    }
+
+    g_autoptr(GDateTime) now = g_date_time_new_now_local();
+    g_autofree gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    g_autofree gchar *path = g_strdup_printf(
+        "%stimeline-%s.json", xemu_settings_get_base_path(), stamp);
+
+    Error *err = NULL;
+    if (!timeline_stop(path, &err)) {
+        xemu_queue_error_message(error_get_pretty(err));
+        error_free(err);
+        return;
+    }
+
+    g_autofree gchar *msg = g_strdup_printf("Timeline saved to %s", path);
+    xemu_queue_notification(msg);
+}
+
 void ActionActivateBoundSnapshot(int slot, bool save)
 {
     assert(slot < 4 && slot >= 0);
@@ -25,5 +25,6 @@ void ActionTogglePause();
 void ActionReset();
 void ActionShutdown();
 void ActionScreenshot();
+void ActionToggleTimelineCapture();
 void ActionActivateBoundSnapshot(int slot, bool save);
 void ActionLoadSnapshotChecked(const char *name);
@@ -34,6 +34,7 @@
 extern "C" {
 // Include necessary QEMU headers
 #include "qemu/osdep.h"
+#include "qemu/timeline.h"
 #include "qapi/error.h"
 #include "system/runstate.h"
 #include "hw/xbox/mcpx/apu/apu_debug.h"
@@ -309,6 +309,10 @@ void DebugApuWindow::Draw()
     }
     ImGui::Text("GP Cycles:   %04d", dbg->gp.cycles);
     ImGui::Text("EP Cycles:   %04d", dbg->ep.cycles);
+    ImGui::Text("GP Skipped:  %04d (%d loops)", dbg->gp.idle_skipped,
+                dbg->gp.idle_skips);
+    ImGui::Text("EP Skipped:  %04d (%d loops)", dbg->ep.idle_skipped,
+                dbg->ep.idle_skips);
 
     ImGui::PopFont();
     ImGui::Columns(1);
@@ -421,6 +425,11 @@ void DebugVideoWindow::Draw()
         }
         ImPlot::PopStyleColor();
 
+        ImGui::Text("Present latency: %.1f ms, jitter: %.2f ms, dropped: %u",
+                    g_nv2a_stats.present.latency_us / 1000.0,
+                    g_nv2a_stats.present.jitter_us / 1000.0,
+                    g_nv2a_stats.present.dropped);
+
         ImGui::SetNextItemOpen(g_config.display.debug.video.advanced_tree_state,
                                ImGuiCond_Once);
         g_config.display.debug.video.advanced_tree_state =
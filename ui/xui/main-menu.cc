@@ -748,7 +748,14 @@ void MainMenuDisplayView::Draw()
 #endif
                  ,
                  "Select desired renderer implementation");
+    bool dynamic_scale = false;
+#ifdef CONFIG_VULKAN
+    dynamic_scale =
+        g_config.display.renderer == CONFIG_DISPLAY_RENDERER_VULKAN &&
+        g_config.display.quality.dynamic_scale;
+#endif
     int rendering_scale = nv2a_get_surface_scale_factor() - 1;
+    if (dynamic_scale) ImGui::BeginDisabled();
     if (ChevronCombo("Internal resolution scale", &rendering_scale,
                      "1x\0"
                      "2x\0"
@@ -760,9 +767,22 @@ void MainMenuDisplayView::Draw()
                      "8x\0"
                      "9x\0"
                      "10x\0",
-                     "Increase surface scaling factor for higher quality")) {
+                     dynamic_scale ?
+                         "Currently chosen by dynamic resolution scale" :
+                         "Increase surface scaling factor for higher quality")) {
         nv2a_set_surface_scale_factor(rendering_scale+1);
     }
+    if (dynamic_scale) ImGui::EndDisabled();
+#ifdef CONFIG_VULKAN
+    Toggle("Dynamic resolution scale", &g_config.display.quality.dynamic_scale,
+           "Adjust internal resolution to fit the GPU frame budget, "
+           "overriding the fixed scale above (Vulkan)");
+    Toggle("Latent occlusion reports", &g_config.display.vulkan.report_latency,
+           "Answer visibility queries without waiting for the GPU (Vulkan)");
+    Toggle("Threaded command recording",
+           &g_config.display.vulkan.threaded_recording,
+           "Record draw commands on a worker thread (Vulkan)");
+#endif
 
     SectionTitle("Window");
     bool fs = xemu_is_fullscreen();
@@ -791,6 +811,9 @@ void MainMenuDisplayView::Draw()
     }
     Toggle("Vertical refresh sync", &g_config.display.window.vsync,
            "Sync to screen vertical refresh to reduce tearing artifacts");
+    Toggle("Low-latency presentation",
+           &g_config.display.presentation.low_latency,
+           "Always show the newest frame, skipping queued frames");
 
     SectionTitle("Interface");
     Toggle("Show main menu bar", &g_config.display.ui.show_menubar,
@@ -846,6 +869,16 @@ void MainMenuAudioView::Draw()
     SectionTitle("Quality");
     Toggle("Real-time DSP processing", &g_config.audio.use_dsp,
            "Enable improved audio accuracy (experimental)");
+    Toggle("Pipelined DSP", &g_config.audio.pipelined_dsp,
+           "Run the encode processor DSP on its own thread, delaying GP "
+           "output to guest memory by up to 8 frames (experimental)");
+    Toggle("DSP recompiler", &g_config.audio.dsp_jit,
+           "Translate DSP code to native x86-64 code (experimental)");
+    ChevronCombo("Voice resampling", &g_config.audio.vp.resampler,
+                 "Linear\0"
+                 "8-tap sinc\0"
+                 "32-tap sinc (Default)\0",
+                 "Select the interpolation used for pitched voices");
 
 }
 
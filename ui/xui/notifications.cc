@@ -64,6 +64,8 @@ void NotificationManager::Draw()
         }
     }
 
+    DrawShaderWarmupProgress();
+
     ImGuiIO& io = ImGui::GetIO();
 
     if (m_error_queue.size() > 0) {
@@ -146,6 +148,39 @@ void NotificationManager::DrawNotification(float t, const char *msg)
     ImGui::End();
 }
 
+void NotificationManager::DrawShaderWarmupProgress()
+{
+    int done, total;
+    if (!g_config.display.ui.show_notifications ||
+        !nv2a_get_shader_warmup_progress(&done, &total) || done >= total) {
+        return;
+    }
+
+    const float DISTANCE = 10.0f;
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - DISTANCE,
+                                   io.DisplaySize.y - DISTANCE),
+                            ImGuiCond_Always, ImVec2(1.0f, 1.0f));
+    ImGui::SetNextWindowBgAlpha(0.90f);
+    if (ImGui::Begin("Shader Warmup", NULL,
+        ImGuiWindowFlags_Tooltip |
+        ImGuiWindowFlags_NoMove |
+        ImGuiWindowFlags_NoDecoration |
+        ImGuiWindowFlags_AlwaysAutoResize |
+        ImGuiWindowFlags_NoSavedSettings |
+        ImGuiWindowFlags_NoFocusOnAppearing |
+        ImGuiWindowFlags_NoNav |
+        ImGuiWindowFlags_NoInputs
+        ))
+    {
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "%d / %d", done, total);
+        ImGui::Text("Preparing cached shaders");
+        ImGui::ProgressBar(done / (float)total, ImVec2(200, 0), overlay);
+    }
+    ImGui::End();
+}
+
 /* External interface, exposed via xemu-notifications.h */
 
 void xemu_queue_notification(const char *msg)
@@ -41,6 +41,7 @@ public:
 
 private:
     void DrawNotification(float t, const char *msg);
+    void DrawShaderWarmupProgress();
 };
 
 extern NotificationManager notification_manager;
@@ -0,0 +1,124 @@
+/*
+ * Pooled string builder for shader source generation
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/mstring.h"
+
+#define MSTRING_POOL_SIZE 256
+#define MSTRING_DEFAULT_SIZE 64
+#define MSTRING_POOL_MAX_CAPACITY 4096
+
+typedef struct MStringPool {
+    MString *free[MSTRING_POOL_SIZE];
+    int num_free;
+} MStringPool;
+
+static void mstring_pool_free(gpointer opaque)
+{
+    MStringPool *pool = opaque;
+
+    for (int i = 0; i < pool->num_free; i++) {
+        g_string_free(pool->free[i]->gstr, true);
+        g_free(pool->free[i]);
+    }
+    g_free(pool);
+}
+
+static GPrivate mstring_pool_key = G_PRIVATE_INIT(mstring_pool_free);
+
+static MStringPool *mstring_get_pool(void)
+{
+    MStringPool *pool = g_private_get(&mstring_pool_key);
+    if (!pool) {
+        pool = g_new0(MStringPool, 1);
+        g_private_set(&mstring_pool_key, pool);
+    }
+    return pool;
+}
+
+MString *mstring_new(void)
+{
+    MStringPool *pool = mstring_get_pool();
+    MString *mstr;
+
+    if (pool->num_free) {
+        mstr = pool->free[--pool->num_free];
+        g_string_truncate(mstr->gstr, 0);
+    } else {
+        mstr = g_new(MString, 1);
+        mstr->gstr = g_string_sized_new(MSTRING_DEFAULT_SIZE);
+    }
+    mstr->refcnt = 1;
+
+    return mstr;
+}
+
+MString *mstring_new_sized(size_t size)
+{
+    if (size >= MSTRING_POOL_MAX_CAPACITY) {
+        MString *mstr = g_new(MString, 1);
+        mstr->refcnt = 1;
+        mstr->gstr = g_string_sized_new(size);
+        return mstr;
+    }
+
+    MString *mstr = mstring_new();
+    if (mstr->gstr->allocated_len <= size) {
+        /* GString has no reserve call, growing then truncating keeps the
+         * buffer */
+        g_string_set_size(mstr->gstr, size);
+        g_string_truncate(mstr->gstr, 0);
+    }
+
+    return mstr;
+}
+
+MString *mstring_from_str(const char *str)
+{
+    MString *mstr = mstring_new();
+    g_string_append(mstr->gstr, str);
+    return mstr;
+}
+
+MString *mstring_from_fmt(const char *fmt, ...)
+{
+    MString *mstr = mstring_new();
+
+    va_list args;
+    va_start(args, fmt);
+    g_string_append_vprintf(mstr->gstr, fmt, args);
+    va_end(args);
+
+    return mstr;
+}
+
+void mstring_release(MString *mstr)
+{
+    MStringPool *pool = mstring_get_pool();
+
+    /* Large buffers are not worth holding on to */
+    if (pool->num_free < MSTRING_POOL_SIZE &&
+        mstr->gstr->allocated_len <= MSTRING_POOL_MAX_CAPACITY) {
+        pool->free[pool->num_free++] = mstr;
+        return;
+    }
+
+    g_string_free(mstr->gstr, true);
+    g_free(mstr);
+}
@@ -0,0 +1,280 @@
+/*
+ * Cross-thread event timeline
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qemu/notify.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qemu/timeline.h"
+
+#define TIMELINE_CHUNK_EVENTS 4096
+#define TIMELINE_MAX_CHUNKS 256 // Per thread, 32 MiB
+
+typedef struct TimelineEvent {
+    const char *name;
+    int64_t ts;
+    int64_t value;
+    char phase;
+} TimelineEvent;
+
+typedef struct TimelineChunk {
+    struct TimelineChunk *next;
+    unsigned int count;
+    TimelineEvent events[TIMELINE_CHUNK_EVENTS];
+} TimelineChunk;
+
+/*
+ * Only the owning thread writes events. Chunks are kept for reuse by later
+ * captures and are reset lazily by the owner when it sees a new epoch, so the
+ * exporter only has to skip buffers left over from an earlier capture. Buffers
+ * of threads that have exited are freed when the next capture starts.
+ */
+typedef struct TimelineBuffer {
+    struct TimelineBuffer *next;
+    const char *thread_name;
+    int tid;
+    unsigned int epoch;
+    TimelineChunk *head;
+    TimelineChunk *tail;
+    unsigned int num_chunks;
+    unsigned int dropped;
+    bool exited;
+    Notifier exit_notifier;
+} TimelineBuffer;
+
+bool timeline_enabled;
+
+static TimelineBuffer *timeline_buffers;
+static unsigned int timeline_epoch;
+static int64_t timeline_start_time;
+
+static __thread TimelineBuffer *timeline_buffer;
+static __thread const char *timeline_thread_name;
+
+static TimelineChunk *timeline_chunk_new(void)
+{
+    TimelineChunk *chunk = g_new(TimelineChunk, 1);
+    chunk->next = NULL;
+    chunk->count = 0;
+    return chunk;
+}
+
+static void timeline_thread_exit(Notifier *n, void *data)
+{
+    TimelineBuffer *buf = container_of(n, TimelineBuffer, exit_notifier);
+
+    timeline_buffer = NULL;
+    qatomic_store_release(&buf->exited, true);
+}
+
+static void timeline_buffer_free(TimelineBuffer *buf)
+{
+    TimelineChunk *c = buf->head;
+
+    while (c) {
+        TimelineChunk *next = c->next;
+        g_free(c);
+        c = next;
+    }
+    g_free(buf);
+}
+
+/*
+ * Threads only ever push onto the head of the list, so buffers after it can be
+ * unlinked directly. The head itself is left for a later capture if a thread
+ * has just pushed in front of it. Must be called from the thread that exports
+ * captures, so no export is walking the list.
+ */
+static void timeline_reclaim_buffers(void)
+{
+    TimelineBuffer *head = qatomic_load_acquire(&timeline_buffers);
+
+    if (!head) {
+        return;
+    }
+
+    TimelineBuffer *prev = head;
+    for (TimelineBuffer *buf = head->next; buf; buf = prev->next) {
+        if (qatomic_load_acquire(&buf->exited)) {
+            prev->next = buf->next;
+            timeline_buffer_free(buf);
+        } else {
+            prev = buf;
+        }
+    }
+
+    if (qatomic_load_acquire(&head->exited) &&
+        qatomic_cmpxchg(&timeline_buffers, head, head->next) == head) {
+        timeline_buffer_free(head);
+    }
+}
+
+static TimelineBuffer *timeline_get_buffer(void)
+{
+    TimelineBuffer *buf = timeline_buffer;
+    unsigned int epoch = qatomic_load_acquire(&timeline_epoch);
+
+    if (!buf) {
+        buf = g_new0(TimelineBuffer, 1);
+        buf->thread_name = timeline_thread_name;
+        buf->tid = qemu_get_thread_id();
+        buf->head = buf->tail = timeline_chunk_new();
+        buf->num_chunks = 1;
+        buf->epoch = epoch;
+        buf->exit_notifier.notify = timeline_thread_exit;
+        qemu_thread_atexit_add(&buf->exit_notifier);
+
+        TimelineBuffer *old;
+        do {
+            old = qatomic_read(&timeline_buffers);
+            buf->next = old;
+        } while (qatomic_cmpxchg(&timeline_buffers, old, buf) != old);
+
+        timeline_buffer = buf;
+    } else if (buf->epoch != epoch) {
+        for (TimelineChunk *c = buf->head; c; c = c->next) {
+            qatomic_set(&c->count, 0);
+        }
+        buf->tail = buf->head;
+        qatomic_set(&buf->dropped, 0);
+        qatomic_store_release(&buf->epoch, epoch);
+    }
+
+    return buf;
+}
+
+void timeline_record(char phase, const char *name, int64_t value)
+{
+    TimelineBuffer *buf = timeline_get_buffer();
+    TimelineChunk *chunk = buf->tail;
+    unsigned int n = chunk->count;
+
+    if (n == TIMELINE_CHUNK_EVENTS) {
+        if (!chunk->next) {
+            if (buf->num_chunks == TIMELINE_MAX_CHUNKS) {
+                qatomic_set(&buf->dropped, buf->dropped + 1);
+                return;
+            }
+            qatomic_store_release(&chunk->next, timeline_chunk_new());
+            buf->num_chunks++;
+        }
+        chunk = buf->tail = chunk->next;
+        n = 0;
+    }
+
+    TimelineEvent *ev = &chunk->events[n];
+    ev->name = name;
+    ev->ts = get_clock();
+    ev->value = value;
+    ev->phase = phase;
+    qatomic_store_release(&chunk->count, n + 1);
+}
+
+void timeline_set_thread_name(const char *name)
+{
+    timeline_thread_name = name;
+    if (timeline_buffer) {
+        qatomic_set(&timeline_buffer->thread_name, name);
+    }
+}
+
+void timeline_start(void)
+{
+    timeline_reclaim_buffers();
+    qatomic_set(&timeline_start_time, get_clock());
+    qatomic_inc(&timeline_epoch);
+    qatomic_set(&timeline_enabled, true);
+}
+
+static void append_event(GString *json, const TimelineEvent *ev, int tid,
+                         int64_t start)
+{
+    g_string_append(json, ",\n{");
+    if (ev->name) {
+        g_string_append_printf(json, "\"name\":\"%s\",", ev->name);
+    }
+    g_string_append_printf(json,
+                           "\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                           ev->phase, (ev->ts - start) / 1000.0, tid);
+    if (ev->phase == 'C') {
+        g_string_append_printf(json, ",\"args\":{\"value\":%" PRId64 "}",
+                               ev->value);
+    } else if (ev->phase == 'i') {
+        g_string_append(json, ",\"s\":\"t\"");
+    }
+    g_string_append_c(json, '}');
+}
+
+bool timeline_stop(const char *path, Error **errp)
+{
+    qatomic_set(&timeline_enabled, false);
+
+    unsigned int epoch = qatomic_read(&timeline_epoch);
+    int64_t start = qatomic_read(&timeline_start_time);
+    unsigned int dropped = 0;
+
+    g_autoptr(GString) json = g_string_new(
+        "{\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+        "\"args\":{\"name\":\"xemu\"}}");
+
+    for (TimelineBuffer *buf = qatomic_load_acquire(&timeline_buffers); buf;
+         buf = buf->next) {
+        if (qatomic_load_acquire(&buf->epoch) != epoch) {
+            continue;
+        }
+
+        const char *thread_name = qatomic_read(&buf->thread_name);
+        if (thread_name) {
+            g_string_append_printf(json,
+                                   ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                                   "\"pid\":1,\"tid\":%d,"
+                                   "\"args\":{\"name\":\"%s\"}}",
+                                   buf->tid, thread_name);
+        }
+
+        for (TimelineChunk *c = buf->head; c;
+             c = qatomic_load_acquire(&c->next)) {
+            unsigned int n = qatomic_load_acquire(&c->count);
+            for (unsigned int i = 0; i < n; i++) {
+                append_event(json, &c->events[i], buf->tid, start);
+            }
+            if (n < TIMELINE_CHUNK_EVENTS) {
+                break;
+            }
+        }
+
+        dropped += qatomic_read(&buf->dropped);
+    }
+
+    g_string_append_printf(json,
+                           "\n],\"displayTimeUnit\":\"ms\","
+                           "\"otherData\":{\"dropped_events\":%u}}\n",
+                           dropped);
+
+    g_autoptr(GError) err = NULL;
+    if (!g_file_set_contents(path, json->str, json->len, &err)) {
+        error_setg(errp, "Failed to write timeline to %s: %s", path,
+                   err->message);
+        return false;
+    }
+
+    return true;
+}